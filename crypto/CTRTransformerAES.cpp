@@ -3,35 +3,166 @@
  */
 
 #include "CTRTransformerAES.h"
+#include "CpuFeatures.h"
 #include <cstring>
 #include <stdexcept>
-#include <tomcrypt.h>
+
+#ifdef U8_X86_CRYPTO
+#include <immintrin.h>
+#endif
 
 namespace crypto {
 
+#ifdef U8_X86_CRYPTO
+
+    __attribute__((target("aes,sse2")))
+    static inline __m128i expandKeyStep(__m128i key, __m128i assist) {
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        return _mm_xor_si128(key, assist);
+    }
+
+    template <int rcon>
+    __attribute__((target("aes,sse2")))
+    static inline void expandKey128Round(__m128i *rk) {
+        rk[1] = expandKeyStep(rk[0], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[0], rcon), 0xFF));
+    }
+
+    template <int rcon>
+    __attribute__((target("aes,sse2")))
+    static inline void expandKey256Round(__m128i *rk, bool last) {
+        rk[2] = expandKeyStep(rk[0], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[1], rcon), 0xFF));
+        if (!last)
+            rk[3] = expandKeyStep(rk[1], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[2], 0), 0xAA));
+    }
+
+    /**
+     * Expand AES-128 or AES-256 key to round keys, return number of rounds.
+     */
+    __attribute__((target("aes,sse2")))
+    static int aesniExpandKey(const unsigned char *key, size_t keySize, unsigned char *roundKeys) {
+        __m128i *rk = (__m128i *) roundKeys;
+        rk[0] = _mm_loadu_si128((const __m128i *) key);
+        if (keySize == 16) {
+            expandKey128Round<0x01>(rk + 0);
+            expandKey128Round<0x02>(rk + 1);
+            expandKey128Round<0x04>(rk + 2);
+            expandKey128Round<0x08>(rk + 3);
+            expandKey128Round<0x10>(rk + 4);
+            expandKey128Round<0x20>(rk + 5);
+            expandKey128Round<0x40>(rk + 6);
+            expandKey128Round<0x80>(rk + 7);
+            expandKey128Round<0x1B>(rk + 8);
+            expandKey128Round<0x36>(rk + 9);
+            return 10;
+        }
+        rk[1] = _mm_loadu_si128((const __m128i *) (key + 16));
+        expandKey256Round<0x01>(rk + 0, false);
+        expandKey256Round<0x02>(rk + 2, false);
+        expandKey256Round<0x04>(rk + 4, false);
+        expandKey256Round<0x08>(rk + 6, false);
+        expandKey256Round<0x10>(rk + 8, false);
+        expandKey256Round<0x20>(rk + 10, false);
+        expandKey256Round<0x40>(rk + 12, true);
+        return 14;
+    }
+
+    __attribute__((target("aes,sse2")))
+    static inline __m128i counterBlock(__m128i nonce, uint32_t counter) {
+        return _mm_xor_si128(nonce, _mm_set_epi32((int) __builtin_bswap32(counter), 0, 0, 0));
+    }
+
+    __attribute__((target("aes,sse2")))
+    static void aesniCtr(const unsigned char *roundKeys, int rounds, const unsigned char *nonceBytes,
+                         uint32_t counter, const unsigned char *src, unsigned char *dst, size_t blocks) {
+        const int LANES = 8;
+        __m128i rk[15];
+        for (int r = 0; r <= rounds; ++r)
+            rk[r] = _mm_load_si128((const __m128i *) roundKeys + r);
+        __m128i nonce = _mm_loadu_si128((const __m128i *) nonceBytes);
+
+        // independent blocks are interleaved to hide aesenc latency
+        while (blocks >= LANES) {
+            __m128i b[LANES];
+            for (int i = 0; i < LANES; ++i)
+                b[i] = _mm_xor_si128(counterBlock(nonce, counter + i), rk[0]);
+            for (int r = 1; r < rounds; ++r)
+                for (int i = 0; i < LANES; ++i)
+                    b[i] = _mm_aesenc_si128(b[i], rk[r]);
+            for (int i = 0; i < LANES; ++i)
+                b[i] = _mm_xor_si128(_mm_aesenclast_si128(b[i], rk[rounds]),
+                                     _mm_loadu_si128((const __m128i *) src + i));
+            for (int i = 0; i < LANES; ++i)
+                _mm_storeu_si128((__m128i *) dst + i, b[i]);
+            counter += LANES;
+            blocks -= LANES;
+            src += LANES * 16;
+            dst += LANES * 16;
+        }
+
+        for (; blocks > 0; --blocks) {
+            __m128i b = _mm_xor_si128(counterBlock(nonce, counter++), rk[0]);
+            for (int r = 1; r < rounds; ++r)
+                b = _mm_aesenc_si128(b, rk[r]);
+            b = _mm_aesenclast_si128(b, rk[rounds]);
+            _mm_storeu_si128((__m128i *) dst, _mm_xor_si128(b, _mm_loadu_si128((const __m128i *) src)));
+            src += 16;
+            dst += 16;
+        }
+    }
+
+#endif
+
     CTRTransformerAES::CTRTransformerAES(const byte_vector &key) :
             CTRTransformerAES(key, byte_vector()) {
     }
 
     CTRTransformerAES::CTRTransformerAES(const byte_vector &key, const byte_vector &iv) :
-            key(key),
             blockSize(aes_desc.block_length) {
         if (iv.empty()) {
             nonce.resize(blockSize);
             sprng_read(&nonce[0], blockSize, NULL);
         } else {
+            if (iv.size() != (size_t) blockSize)
+                throw std::invalid_argument("CTRTransformerAES: wrong iv size");
             nonce = iv;
         }
-        counter = 0;
         source.resize(blockSize);
-        counterBytes.resize(4);
-        prepareBlock();
+        index = blockSize;
+
+#ifdef U8_X86_CRYPTO
+        if (cpuFeatures().aesni && (key.size() == 16 || key.size() == 32))
+            aesniRounds = aesniExpandKey(&key[0], key.size(), aesniKeys);
+#endif
+        if (aesniRounds == 0 && aes_setup(&key[0], (int) key.size(), 0, &skey) != CRYPT_OK)
+            throw std::invalid_argument("CTRTransformerAES: wrong key size");
     }
 
     unsigned char CTRTransformerAES::transformByte(unsigned char source) {
         return source ^ nextByte();
     }
 
+    void CTRTransformerAES::transform(const unsigned char *src, unsigned char *dst, size_t size) {
+        // rest of the key stream block started by previous calls
+        for (; size > 0 && index < blockSize; --size)
+            *dst++ = *src++ ^ source[index++];
+
+        size_t blocks = size / blockSize;
+        if (blocks > 0) {
+            transformBlocks(src, dst, blocks);
+            src += blocks * blockSize;
+            dst += blocks * blockSize;
+            size -= blocks * blockSize;
+        }
+
+        if (size > 0) {
+            prepareBlock();
+            for (; size > 0; --size)
+                *dst++ = *src++ ^ source[index++];
+        }
+    }
+
     byte_vector CTRTransformerAES::getIV() {
         return nonce;
     }
@@ -43,22 +174,36 @@ namespace crypto {
     }
 
     void CTRTransformerAES::prepareBlock() {
-        memcpy(&source[0], &nonce[0], blockSize);
-        counterBytes[0] = (unsigned char) (counter >> 24);
-        counterBytes[1] = (unsigned char) (counter >> 16);
-        counterBytes[2] = (unsigned char) (counter >> 8);
-        counterBytes[3] = (unsigned char) counter;
-        applyXor(source, blockSize - 4, counterBytes);
-
-        symmetric_key skey;
-        aes_setup(&key[0], key.size(), 0, &skey);
-        //aes_ecb_decrypt(&source[0], &source[0], &skey);
-        aes_ecb_encrypt(&source[0], &source[0], &skey);
-
-        ++counter;
+        // key stream block is the transformed zero block
+        memset(&source[0], 0, blockSize);
+        transformBlocks(&source[0], &source[0], 1);
         index = 0;
     }
 
+    void CTRTransformerAES::transformBlocks(const unsigned char *src, unsigned char *dst, size_t blocks) {
+#ifdef U8_X86_CRYPTO
+        if (aesniRounds > 0) {
+            aesniCtr(aesniKeys, aesniRounds, &nonce[0], counter, src, dst, blocks);
+            counter += (uint32_t) blocks;
+            return;
+        }
+#endif
+        unsigned char block[MAXBLOCKSIZE];
+        for (; blocks > 0; --blocks) {
+            memcpy(block, &nonce[0], blockSize);
+            block[blockSize - 4] ^= (unsigned char) (counter >> 24);
+            block[blockSize - 3] ^= (unsigned char) (counter >> 16);
+            block[blockSize - 2] ^= (unsigned char) (counter >> 8);
+            block[blockSize - 1] ^= (unsigned char) counter;
+            aes_ecb_encrypt(block, block, &skey);
+            for (int i = 0; i < blockSize; ++i)
+                dst[i] = src[i] ^ block[i];
+            ++counter;
+            src += blockSize;
+            dst += blockSize;
+        }
+    }
+
     void applyXor(byte_vector &source, int offset, const byte_vector &mask) {
         int end = offset + (int) mask.size();
         if (end > (int) source.size())
@@ -70,4 +215,4 @@ namespace crypto {
         } while (sourceIndex < end);
     }
 
-};
\ No newline at end of file
+};
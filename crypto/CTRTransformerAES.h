@@ -6,10 +6,18 @@
 #define U8_CTRTRANSFORMERAES_H
 
 #include <vector>
+#include <cstdint>
+#undef NORETURN // shut NORETURN redefinition warning in tomcrypt.h
+#include <tomcrypt.h>
 #include "../tools/tools.h"
 
 namespace crypto {
 
+    /**
+     * AES in CTR mode. Key stream block number N is AES of the nonce with its last 4 bytes xored with big-endian N.
+     *
+     * Key schedule is set up once per transformer. AES-128 and AES-256 use AES-NI instructions when the CPU has them.
+     */
     class CTRTransformerAES {
 
     public:
@@ -20,6 +28,12 @@ namespace crypto {
 
         unsigned char transformByte(unsigned char source);
 
+        /**
+         * Transform size bytes from src to dst, continuing the key stream of previous calls.
+         * dst may be equal to src or precede it, so data can be transformed in place.
+         */
+        void transform(const unsigned char *src, unsigned char *dst, size_t size);
+
         byte_vector getIV();
 
     private:
@@ -27,14 +41,18 @@ namespace crypto {
 
         void prepareBlock();
 
+        void transformBlocks(const unsigned char *src, unsigned char *dst, size_t blocks);
+
     private:
-        byte_vector key;
-        int counter;
-        int index = 0;
+        symmetric_key skey;
+        // AES-NI round keys, used if aesniRounds > 0
+        alignas(16) unsigned char aesniKeys[15 * 16];
+        int aesniRounds = 0;
+        uint32_t counter = 0;
         const int blockSize;
+        int index;
         byte_vector source;
         byte_vector nonce;
-        byte_vector counterBytes;
     };
 
     void applyXor(byte_vector &source, int offset, const byte_vector &mask);
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include "ChaChaRandom.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__) || defined(__APPLE__)
+// getrandom on linux, getentropy on macOS
+#include <sys/random.h>
+#endif
+#include <tomcrypt.h>
+
+namespace crypto {
+
+    // incremented in the child process after fork(), so generators seeded before it see they must reseed
+    static std::atomic<unsigned> forkCounter(0);
+
+    static void onForkChild() {
+        ++forkCounter;
+    }
+
+    static void registerForkHandler() {
+        static std::once_flag once;
+        std::call_once(once, []() {
+            pthread_atfork(nullptr, nullptr, onForkChild);
+        });
+    }
+
+    static void systemRandom(unsigned char *out, size_t size) {
+        while (size > 0) {
+#ifdef __linux__
+            ssize_t n = getrandom(out, size, 0);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                // kernels before 3.17 have no getrandom
+                FILE *f = fopen("/dev/urandom", "rb");
+                n = f ? (ssize_t) fread(out, 1, size, f) : 0;
+                if (f)
+                    fclose(f);
+                if (n <= 0)
+                    throw std::runtime_error("ChaChaRandom: no system source of random");
+            }
+#else
+            // getentropy gives at most 256 bytes at once
+            ssize_t n = (ssize_t) std::min(size, (size_t) 256);
+            if (getentropy(out, (size_t) n) != 0)
+                throw std::runtime_error("ChaChaRandom: getentropy failed");
+#endif
+            out += n;
+            size -= (size_t) n;
+        }
+    }
+
+    static inline uint32_t rotl(uint32_t x, int n) {
+        return (x << n) | (x >> (32 - n));
+    }
+
+#define QUARTER_ROUND(a, b, c, d) \
+    a += b; d = rotl(d ^ a, 16); \
+    c += d; b = rotl(b ^ c, 12); \
+    a += b; d = rotl(d ^ a, 8); \
+    c += d; b = rotl(b ^ c, 7);
+
+    static inline uint32_t load32(const unsigned char *p) {
+        return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    }
+
+    static inline void store32(unsigned char *p, uint32_t value) {
+        p[0] = (unsigned char) value;
+        p[1] = (unsigned char) (value >> 8);
+        p[2] = (unsigned char) (value >> 16);
+        p[3] = (unsigned char) (value >> 24);
+    }
+
+    void ChaChaRandom::block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], unsigned char *out) {
+        uint32_t input[16] = {
+                0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+                key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+                counter, nonce[0], nonce[1], nonce[2]
+        };
+        uint32_t x[16];
+        memcpy(x, input, sizeof(x));
+        for (int i = 0; i < 10; ++i) {
+            QUARTER_ROUND(x[0], x[4], x[8], x[12])
+            QUARTER_ROUND(x[1], x[5], x[9], x[13])
+            QUARTER_ROUND(x[2], x[6], x[10], x[14])
+            QUARTER_ROUND(x[3], x[7], x[11], x[15])
+            QUARTER_ROUND(x[0], x[5], x[10], x[15])
+            QUARTER_ROUND(x[1], x[6], x[11], x[12])
+            QUARTER_ROUND(x[2], x[7], x[8], x[13])
+            QUARTER_ROUND(x[3], x[4], x[9], x[14])
+        }
+        for (int i = 0; i < 16; ++i)
+            store32(out + i * 4, x[i] + input[i]);
+    }
+
+#undef QUARTER_ROUND
+
+    ChaChaRandom::ChaChaRandom() : autoReseed(true) {
+        registerForkHandler();
+        reseedFromSystem();
+    }
+
+    ChaChaRandom::ChaChaRandom(const unsigned char *seedData) : autoReseed(false) {
+        seed(seedData);
+    }
+
+    ChaChaRandom::~ChaChaRandom() {
+        zeromem(key, sizeof(key));
+        zeromem(nonce, sizeof(nonce));
+        zeromem(buffer, sizeof(buffer));
+    }
+
+    void ChaChaRandom::setKey(const unsigned char *keyData) {
+        for (int i = 0; i < 8; ++i)
+            key[i] = load32(keyData + i * 4);
+        // first nonce word is the high part of the block counter, buffers never need it
+        nonce[0] = 0;
+        nonce[1] = load32(keyData + 32);
+        nonce[2] = load32(keyData + 36);
+    }
+
+    void ChaChaRandom::seed(const unsigned char *seedData) {
+        setKey(seedData);
+        available = 0;
+        generatedSinceSeed = 0;
+        forkGeneration = forkCounter;
+    }
+
+    void ChaChaRandom::reseedFromSystem() {
+        unsigned char seedData[SEED_SIZE];
+        systemRandom(seedData, sizeof(seedData));
+        seed(seedData);
+        zeromem(seedData, sizeof(seedData));
+    }
+
+    void ChaChaRandom::refill() {
+        for (uint32_t i = 0; i < BUFFER_BLOCKS; ++i)
+            block(key, i, nonce, buffer + i * 64);
+        // fast key erasure: the next key is taken from the output and wiped from the buffer
+        setKey(buffer);
+        zeromem(buffer, SEED_SIZE);
+        available = BUFFER_SIZE - SEED_SIZE;
+    }
+
+    void ChaChaRandom::generate(void *out, size_t size) {
+        if (autoReseed && (generatedSinceSeed >= RESEED_INTERVAL || forkGeneration != forkCounter))
+            reseedFromSystem();
+        auto dst = (unsigned char *) out;
+        while (size > 0) {
+            if (available == 0)
+                refill();
+            size_t n = std::min(size, available);
+            unsigned char *src = buffer + BUFFER_SIZE - available;
+            memcpy(dst, src, n);
+            memset(src, 0, n);
+            available -= n;
+            dst += n;
+            size -= n;
+        }
+        generatedSinceSeed += (size_t) (dst - (unsigned char *) out);
+    }
+
+    void randomBytes(void *out, size_t size) {
+        static thread_local ChaChaRandom generator;
+        generator.generate(out, size);
+    }
+
+};
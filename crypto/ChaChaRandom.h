@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_CHACHARANDOM_H
+#define U8_CHACHARANDOM_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace crypto {
+
+    /**
+     * Fill out with size cryptographically secure random bytes.
+     *
+     * Bytes come from a ChaChaRandom of the calling thread, so most calls cost a memcpy from its buffer instead of
+     * a system call. Safe to call from any thread, and in a forked child, which never repeats the parent's output.
+     */
+    void randomBytes(void *out, size_t size);
+
+    /**
+     * ChaCha20 based random generator with fast key erasure, as arc4random of OpenBSD.
+     *
+     * Keystream is generated by BUFFER_BLOCKS blocks at a time, and the first bytes of every buffer become the
+     * key and nonce for the next one, so bytes once returned can't be recovered from the state later. Generator
+     * is seeded from the OS (getrandom), and reseeded after RESEED_INTERVAL bytes of output and in a child process
+     * after fork(). Object is not thread safe; randomBytes() keeps one per thread.
+     */
+    class ChaChaRandom {
+    public:
+        static const size_t SEED_SIZE = 40;
+        static const size_t BUFFER_BLOCKS = 16;
+        static const size_t RESEED_INTERVAL = 1024 * 1024;
+
+        /**
+         * Seeded from the OS.
+         */
+        ChaChaRandom();
+
+        /**
+         * Seeded with SEED_SIZE bytes of the seed: 32 bytes of the key and 8 bytes of the nonce. Such a generator
+         * is deterministic and never reseeds itself, which is only good for tests.
+         */
+        explicit ChaChaRandom(const unsigned char *seed);
+
+        ChaChaRandom(const ChaChaRandom &) = delete;
+
+        ChaChaRandom &operator=(const ChaChaRandom &) = delete;
+
+        ~ChaChaRandom();
+
+        void generate(void *out, size_t size);
+
+        /**
+         * ChaCha20 block function of RFC 8439, section 2.3: 64 bytes of keystream for the block counter.
+         */
+        static void block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], unsigned char *out);
+
+    private:
+        static const size_t BUFFER_SIZE = BUFFER_BLOCKS * 64;
+
+        uint32_t key[8];
+        uint32_t nonce[3];
+        unsigned char buffer[BUFFER_SIZE];
+        // unused bytes are at the end of the buffer
+        size_t available;
+        size_t generatedSinceSeed;
+        bool autoReseed;
+        // fork generation the generator was seeded in
+        unsigned forkGeneration;
+
+        // take key and nonce from SEED_SIZE bytes
+        void setKey(const unsigned char *keyData);
+
+        void seed(const unsigned char *seedData);
+
+        void reseedFromSystem();
+
+        void refill();
+    };
+
+};
+
+#endif //U8_CHACHARANDOM_H
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include "CpuFeatures.h"
+
+#ifdef U8_X86_CRYPTO
+#include <cpuid.h>
+#ifndef bit_SHA
+#define bit_SHA (1 << 29)
+#endif
+#endif
+
+namespace crypto {
+
+    static CpuFeatures detectCpuFeatures() {
+        CpuFeatures features;
+#ifdef U8_X86_CRYPTO
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            features.ssse3 = (ecx & bit_SSSE3) != 0;
+            features.sse41 = (ecx & bit_SSE4_1) != 0;
+            features.pclmul = (ecx & bit_PCLMUL) != 0;
+            features.aesni = (ecx & bit_AES) != 0;
+            // AVX2 also needs the OS to save ymm registers, AVX-512 the opmask and zmm registers too
+            bool osxsave = (ecx & bit_OSXSAVE) != 0 && (ecx & bit_AVX) != 0;
+            bool osxsave512 = false;
+            if (osxsave) {
+                unsigned int xcr0Low, xcr0High;
+                __asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+                osxsave = (xcr0Low & 0x06) == 0x06;
+                osxsave512 = (xcr0Low & 0xE6) == 0xE6;
+            }
+            if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+                features.avx2 = osxsave && (ebx & bit_AVX2) != 0;
+                features.avx512f = osxsave512 && (ebx & bit_AVX512F) != 0;
+                features.sha = (ebx & bit_SHA) != 0;
+            }
+        }
+#endif
+        return features;
+    }
+
+    const CpuFeatures& cpuFeatures() {
+        static const CpuFeatures features = detectCpuFeatures();
+        return features;
+    }
+
+};
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_CPUFEATURES_H
+#define U8_CPUFEATURES_H
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+// crypto primitives have x86 code paths, compiled with per-function target attributes and selected at runtime
+#define U8_X86_CRYPTO
+#endif
+
+namespace crypto {
+
+    /**
+     * Instruction set extensions of the CPU, used by crypto primitives. All flags are false on non-x86 builds.
+     */
+    struct CpuFeatures {
+        bool sse41 = false;
+        bool ssse3 = false;
+        bool avx2 = false;
+        bool avx512f = false;
+        bool aesni = false;
+        bool pclmul = false;
+        bool sha = false;
+    };
+
+    /**
+     * Features of the current CPU, detected with cpuid on first call.
+     */
+    const CpuFeatures& cpuFeatures();
+
+};
+
+#endif //U8_CPUFEATURES_H
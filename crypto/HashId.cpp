@@ -4,12 +4,23 @@
 
 #include <tomcrypt.h>
 #include "HashId.h"
-#include "gost3411-2012.h"
+#include "Sha3.h"
+#include "Streebog.h"
+#include "ChaChaRandom.h"
 #include "base64.h"
 #include "../tools/tools.h"
+#include "../tools/AutoThreadPool.h"
+#include "../AsyncIO/IOFile.h"
+#include <mutex>
 
 namespace crypto {
 
+    // composite digest: SHA-512/256, SHA3-256, Streebog-256
+    static const size_t SHA3_OFFSET = 32;
+    static const size_t GOST_OFFSET = 64;
+    static const size_t DIGEST_SIZE = 96;
+    static const size_t GOST_BITS = 256;
+
     HashId::HashId(const std::vector<unsigned char> &packedData) : HashId((void *) &packedData[0], packedData.size()) {
     }
 
@@ -46,33 +57,195 @@ namespace crypto {
 
     HashId HashId::createRandom() {
         byte_vector body(64);
-        sprng_read(&body[0], 64, NULL);
+        randomBytes(&body[0], 64);
         return HashId::of(body);
     }
 
+    std::vector<HashId> HashId::ofMany(const std::vector<Span> &inputs) {
+        // groups are big enough for the widest multi-lane SHA3 kernel
+        const size_t groupSize = 8;
+        std::vector<std::vector<unsigned char>> digests(inputs.size());
+        parallelFor((inputs.size() + groupSize - 1) / groupSize, [&](size_t group) {
+            size_t from = group * groupSize;
+            size_t count = std::min(groupSize, inputs.size() - from);
+            const void *data[groupSize];
+            size_t sizes[groupSize];
+            unsigned char *sha3Out[groupSize];
+            for (size_t i = 0; i < count; ++i) {
+                auto &input = inputs[from + i];
+                digests[from + i] = digestOf(input.data, input.size, false);
+                data[i] = input.data;
+                sizes[i] = input.size;
+                sha3Out[i] = &digests[from + i][SHA3_OFFSET];
+            }
+            Sha3::digestMany(256, count, data, sizes, sha3Out);
+        });
+        std::vector<HashId> result;
+        result.reserve(inputs.size());
+        for (auto &d: digests) {
+            HashId id;
+            id.digest = std::move(d);
+            result.push_back(std::move(id));
+        }
+        return result;
+    }
+
+    struct HashId::Builder::State {
+        hash_state sha2;
+        Sha3 sha3{256};
+        Streebog streebog{GOST_BITS};
+    };
+
+    HashId::Builder::Builder() : state(new State()) {
+        sha512_256_init(&state->sha2);
+    }
+
+    HashId::Builder::~Builder() = default;
+
+    void HashId::Builder::update(const void *data, size_t size) {
+        if (!state)
+            throw std::runtime_error("HashId::Builder is already finished");
+        if (size == 0)
+            return;
+        auto computePart = [&](size_t part) {
+            if (part == 0)
+                sha512_256_process(&state->sha2, (const unsigned char *) data, size);
+            else if (part == 1)
+                state->sha3.update(data, size);
+            else
+                state->streebog.update(data, size);
+        };
+        if (size >= CONCURRENT_THRESHOLD) {
+            parallelFor(3, computePart);
+        } else {
+            for (size_t part = 0; part < 3; ++part)
+                computePart(part);
+        }
+    }
+
+    HashId HashId::Builder::finish() {
+        if (!state)
+            throw std::runtime_error("HashId::Builder is already finished");
+        HashId result;
+        result.digest.resize(DIGEST_SIZE);
+        sha512_256_done(&state->sha2, &result.digest[0]);
+        state->sha3.finish(&result.digest[SHA3_OFFSET]);
+        state->streebog.finish(&result.digest[GOST_OFFSET]);
+        state.reset();
+        return result;
+    }
+
+    // ofFile() pipeline: the next chunk is read into one buffer while the other one is being hashed
+    struct FileHashing : std::enable_shared_from_this<FileHashing> {
+        asyncio::IOFile &file;
+        HashId::ofFile_cb callback;
+        size_t chunkSize;
+        HashId::Builder builder;
+        std::vector<unsigned char> buffers[2];
+
+        std::mutex mutex;
+        bool hashing = false;
+        bool hasPendingRead = false;
+        int pendingIndex = 0;
+        ssize_t pendingResult = 0;
+
+        FileHashing(asyncio::IOFile &file, HashId::ofFile_cb callback, size_t chunkSize)
+                : file(file), callback(std::move(callback)), chunkSize(chunkSize) {
+            buffers[0].resize(chunkSize);
+            buffers[1].resize(chunkSize);
+        }
+
+        void read(int index) {
+            auto self = shared_from_this();
+            file.read(buffers[index].data(), chunkSize, [self, index](ssize_t result) {
+                {
+                    std::lock_guard lock(self->mutex);
+                    if (self->hashing) {
+                        // process it when the previous chunk is hashed
+                        self->hasPendingRead = true;
+                        self->pendingIndex = index;
+                        self->pendingResult = result;
+                        return;
+                    }
+                }
+                self->process(index, result);
+            });
+        }
+
+        void process(int index, ssize_t result) {
+            if (result < 0) {
+                callback(nullptr, result);
+                return;
+            }
+            if (result == 0) {
+                callback(std::make_shared<HashId>(builder.finish()), 0);
+                return;
+            }
+            {
+                std::lock_guard lock(mutex);
+                hashing = true;
+            }
+            read(1 - index);
+            auto self = shared_from_this();
+            runAsync([self, index, result]() {
+                self->builder.update(self->buffers[index].data(), (size_t) result);
+                int nextIndex;
+                ssize_t nextResult;
+                {
+                    std::lock_guard lock(self->mutex);
+                    self->hashing = false;
+                    if (!self->hasPendingRead)
+                        return;
+                    self->hasPendingRead = false;
+                    nextIndex = self->pendingIndex;
+                    nextResult = self->pendingResult;
+                }
+                self->process(nextIndex, nextResult);
+            });
+        }
+    };
+
+    void HashId::ofFile(asyncio::IOFile &file, ofFile_cb callback, size_t chunkSize) {
+        if (chunkSize == 0)
+            throw std::invalid_argument("HashId::ofFile: chunk size must be positive");
+        std::make_shared<FileHashing>(file, std::move(callback), chunkSize)->read(0);
+    }
+
     void HashId::initWith(void *data, size_t size) {
         if (digest.size() == 0) {
-            const unsigned long gostSize = 256;
-            digest.resize(sha512_256_desc.hashsize + sha3_256_desc.hashsize + gostSize / 8);
-
-            hash_state md2;
-            sha512_256_init(&md2);
-            sha512_256_process(&md2, (unsigned char *) data, size);
-            sha512_256_done(&md2, &digest[0]);
-
-            hash_state md3;
-            sha3_256_init(&md3);
-            sha3_process(&md3, (unsigned char *) data, size);
-            sha3_done(&md3, &digest[sha512_256_desc.hashsize]);
-
-            size_t len = 0;
-            gost3411_2012_get_digest(gostSize, (unsigned char *) data, size,
-                                     &digest[sha512_256_desc.hashsize + sha3_256_desc.hashsize], &len);
+            digest = digestOf(data, size);
         } else {
             throw std::runtime_error("HashId is already initialized");
         }
     }
 
+    std::vector<unsigned char> HashId::digestOf(const void *data, size_t size, bool withSha3) {
+        std::vector<unsigned char> result(DIGEST_SIZE);
+
+        auto computePart = [&](size_t part) {
+            if (part == 0) {
+                hash_state md2;
+                sha512_256_init(&md2);
+                sha512_256_process(&md2, (unsigned char *) data, size);
+                sha512_256_done(&md2, &result[0]);
+            } else if (part == 1) {
+                if (withSha3)
+                    Sha3::digest(256, data, size, &result[SHA3_OFFSET]);
+            } else {
+                Streebog::digest(GOST_BITS, data, size, &result[GOST_OFFSET]);
+            }
+        };
+
+        // for large data three passes on different cores are faster, for small data the hand-off costs more
+        if (size >= CONCURRENT_THRESHOLD) {
+            parallelFor(3, computePart);
+        } else {
+            for (size_t part = 0; part < 3; ++part)
+                computePart(part);
+        }
+        return result;
+    }
+
     std::string HashId::toBase64() const {
         return base64_encode(&digest[0], digest.size());
     }
@@ -8,6 +8,12 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <functional>
+#include <sys/types.h>
+
+namespace asyncio {
+    class IOFile;
+};
 
 namespace crypto {
 
@@ -59,6 +65,73 @@ namespace crypto {
          */
         static HashId of(void *packedData, size_t packedDataSize);
 
+        /**
+         * Reference to the data for ofMany().
+         */
+        struct Span {
+            const void *data;
+            size_t size;
+        };
+
+        /**
+         * Return HashIds of all inputs, in the same order. Inputs are hashed in parallel on the thread pool, which is
+         * much faster than calling of() for each of many small inputs.
+         */
+        static std::vector<HashId> ofMany(const std::vector<Span> &inputs);
+
+        /**
+         * Data of this size or larger is hashed with all three digests computed concurrently.
+         */
+        static const size_t CONCURRENT_THRESHOLD = 64 * 1024;
+
+        /**
+         * Computes HashId of data given in parts, e.g. read from a file, without collecting it in one buffer.
+         * Result is the same as of() for all parts concatenated.
+         */
+        class Builder {
+        public:
+            Builder();
+
+            ~Builder();
+
+            /**
+             * Add next part of the data. Parts of CONCURRENT_THRESHOLD bytes or more are hashed with all three
+             * digests computed concurrently.
+             */
+            void update(const void *data, size_t size);
+
+            void update(const std::vector<unsigned char> &data) {
+                update(data.data(), data.size());
+            }
+
+            /**
+             * Return HashId of all data added. Builder can't be used after it, throws std::runtime_error if called
+             * again or if update() is called after it.
+             */
+            HashId finish();
+
+        private:
+            struct State;
+            std::unique_ptr<State> state;
+        };
+
+        /**
+         * Callback for ofFile(): hashId is nullptr on error, and result is the error code from the read.
+         */
+        typedef std::function<void(std::shared_ptr<HashId> hashId, ssize_t result)> ofFile_cb;
+
+        /**
+         * Default size of chunks for ofFile().
+         */
+        static const size_t FILE_CHUNK_SIZE = 1024 * 1024;
+
+        /**
+         * Asynchronously compute HashId of the opened file, from its current position to the end. File is read in
+         * chunks of chunkSize bytes, hashing of a chunk runs on the thread pool while the next one is being read.
+         * File must stay open until callback is called, callback is called from the async loop or pool thread.
+         */
+        static void ofFile(asyncio::IOFile &file, ofFile_cb callback, size_t chunkSize = FILE_CHUNK_SIZE);
+
         /**
          * Create instance from a saved digest (obtained before with getDigest())
          */
@@ -108,6 +181,11 @@ namespace crypto {
 
         void initWith(void *data, size_t size);
 
+        /**
+         * Compute composite digest of the data. Without withSha3, the SHA3 part is left zero for the caller to fill.
+         */
+        static std::vector<unsigned char> digestOf(const void *data, size_t size, bool withSha3 = true);
+
     };
 
 };
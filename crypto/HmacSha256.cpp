@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include "HmacSha256.h"
+#include "CpuFeatures.h"
+#include <cstring>
+#include <algorithm>
+
+#ifdef U8_X86_CRYPTO
+#include <immintrin.h>
+#endif
+
+namespace crypto {
+
+    alignas(16) static const uint32_t K256[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    static inline uint32_t rotr(uint32_t x, int n) {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    static void compressPortable(uint32_t *state, const unsigned char *data, size_t blocks) {
+        uint32_t w[64];
+        while (blocks--) {
+            for (int i = 0; i < 16; ++i)
+                w[i] = (uint32_t(data[i * 4]) << 24) | (uint32_t(data[i * 4 + 1]) << 16) |
+                       (uint32_t(data[i * 4 + 2]) << 8) | uint32_t(data[i * 4 + 3]);
+            for (int i = 16; i < 64; ++i) {
+                uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int i = 0; i < 64; ++i) {
+                uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K256[i] + w[i];
+                uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g; g = f; f = e; e = d + t1;
+                d = c; c = b; b = a; a = t1 + t2;
+            }
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+            data += 64;
+        }
+    }
+
+#ifdef U8_X86_CRYPTO
+    __attribute__((target("sha,sse4.1,ssse3")))
+    static void compressShaNi(uint32_t *state, const unsigned char *data, size_t blocks) {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        // state words are kept as ABEF and CDGH, as sha256rnds2 expects them
+        __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xB1);
+        __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1B);
+        __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+        state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+        while (blocks--) {
+            __m128i savedState0 = state0;
+            __m128i savedState1 = state1;
+            __m128i w[4];
+            for (int i = 0; i < 4; ++i)
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + i * 16)), byteSwap);
+
+            for (int i = 0; i < 16; ++i) {
+                if (i >= 4) {
+                    // w[i] from w[i-4], w[i-3], w[i-2], w[i-1], the oldest one is replaced
+                    __m128i w7 = _mm_alignr_epi8(w[(i - 1) & 3], w[(i - 2) & 3], 4);
+                    __m128i next = _mm_add_epi32(_mm_sha256msg1_epu32(w[i & 3], w[(i - 3) & 3]), w7);
+                    w[i & 3] = _mm_sha256msg2_epu32(next, w[(i - 1) & 3]);
+                }
+                __m128i msg = _mm_add_epi32(w[i & 3], _mm_load_si128((const __m128i *) &K256[i * 4]));
+                state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+                state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+            }
+
+            state0 = _mm_add_epi32(state0, savedState0);
+            state1 = _mm_add_epi32(state1, savedState1);
+            data += 64;
+        }
+
+        tmp = _mm_shuffle_epi32(state0, 0x1B);
+        state1 = _mm_shuffle_epi32(state1, 0xB1);
+        _mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+        _mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(state1, tmp, 8));
+    }
+#endif
+
+    typedef void (*CompressFunction)(uint32_t *state, const unsigned char *data, size_t blocks);
+
+    static CompressFunction selectCompress() {
+#ifdef U8_X86_CRYPTO
+        auto& cpu = cpuFeatures();
+        if (cpu.sha && cpu.sse41 && cpu.ssse3)
+            return compressShaNi;
+#endif
+        return compressPortable;
+    }
+
+    static void compress(uint32_t *state, const unsigned char *data, size_t blocks) {
+        static const CompressFunction function = selectCompress();
+        function(state, data, blocks);
+    }
+
+    void HmacSha256::Sha256::init() {
+        static const uint32_t initialState[8] = {
+                0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        memcpy(state, initialState, sizeof(state));
+        bufferSize = 0;
+        length = 0;
+    }
+
+    void HmacSha256::Sha256::update(const unsigned char *data, size_t size) {
+        length += size;
+        if (bufferSize > 0) {
+            size_t part = std::min(size, BLOCK_SIZE - bufferSize);
+            memcpy(buffer + bufferSize, data, part);
+            bufferSize += part;
+            data += part;
+            size -= part;
+            if (bufferSize < BLOCK_SIZE)
+                return;
+            compress(state, buffer, 1);
+            bufferSize = 0;
+        }
+        size_t blocks = size / BLOCK_SIZE;
+        if (blocks > 0) {
+            compress(state, data, blocks);
+            data += blocks * BLOCK_SIZE;
+            size -= blocks * BLOCK_SIZE;
+        }
+        memcpy(buffer, data, size);
+        bufferSize = size;
+    }
+
+    void HmacSha256::Sha256::finish(unsigned char *out) {
+        uint64_t bitLength = length * 8;
+        buffer[bufferSize++] = 0x80;
+        if (bufferSize > BLOCK_SIZE - 8) {
+            memset(buffer + bufferSize, 0, BLOCK_SIZE - bufferSize);
+            compress(state, buffer, 1);
+            bufferSize = 0;
+        }
+        memset(buffer + bufferSize, 0, BLOCK_SIZE - 8 - bufferSize);
+        for (int i = 0; i < 8; ++i)
+            buffer[BLOCK_SIZE - 1 - i] = (unsigned char) (bitLength >> (i * 8));
+        compress(state, buffer, 1);
+        for (int i = 0; i < 8; ++i) {
+            out[i * 4] = (unsigned char) (state[i] >> 24);
+            out[i * 4 + 1] = (unsigned char) (state[i] >> 16);
+            out[i * 4 + 2] = (unsigned char) (state[i] >> 8);
+            out[i * 4 + 3] = (unsigned char) state[i];
+        }
+    }
+
+    HmacSha256::HmacSha256(const void *key, size_t keySize) {
+        unsigned char pad[BLOCK_SIZE] = {0};
+        if (keySize > BLOCK_SIZE) {
+            inner.init();
+            inner.update((const unsigned char *) key, keySize);
+            inner.finish(pad);
+        } else if (keySize > 0) {
+            memcpy(pad, key, keySize);
+        }
+
+        for (auto& b: pad)
+            b ^= 0x36;
+        inner.init();
+        inner.update(pad, BLOCK_SIZE);
+
+        for (auto& b: pad)
+            b ^= 0x36 ^ 0x5c;
+        outer.init();
+        outer.update(pad, BLOCK_SIZE);
+    }
+
+    void HmacSha256::update(const void *data, size_t size) {
+        inner.update((const unsigned char *) data, size);
+    }
+
+    void HmacSha256::finish(unsigned char *out) {
+        unsigned char innerDigest[DIGEST_SIZE];
+        inner.finish(innerDigest);
+        outer.update(innerDigest, DIGEST_SIZE);
+        outer.finish(out);
+    }
+
+    byte_vector HmacSha256::finish() {
+        byte_vector out(DIGEST_SIZE);
+        finish(&out[0]);
+        return out;
+    }
+
+};
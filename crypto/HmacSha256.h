@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_HMACSHA256_H
+#define U8_HMACSHA256_H
+
+#include <cstdint>
+#include <cstddef>
+#include "../tools/tools.h"
+
+namespace crypto {
+
+    /**
+     * HMAC based on SHA256, computed over a stream of data.
+     *
+     * Uses SHA extensions of the CPU when present, portable code otherwise. Output is the same as of libtomcrypt
+     * hmac with sha256. A copy of just constructed object has the key pads already hashed, so it can be reused as
+     * a starting point to authenticate many messages with the same key.
+     */
+    class HmacSha256 {
+    public:
+        static const size_t DIGEST_SIZE = 32;
+        static const size_t BLOCK_SIZE = 64;
+
+        HmacSha256(const void *key, size_t keySize);
+
+        void update(const void *data, size_t size);
+
+        /**
+         * Write DIGEST_SIZE bytes of HMAC to out. Object must not be updated after it.
+         */
+        void finish(unsigned char *out);
+
+        /**
+         * \see void finish(unsigned char *out)
+         */
+        byte_vector finish();
+
+    private:
+        struct Sha256 {
+            uint32_t state[8];
+            unsigned char buffer[BLOCK_SIZE];
+            size_t bufferSize;
+            uint64_t length;
+
+            void init();
+
+            void update(const unsigned char *data, size_t size);
+
+            void finish(unsigned char *out);
+        };
+
+        Sha256 inner;
+        Sha256 outer;
+    };
+
+};
+
+#endif //U8_HMACSHA256_H
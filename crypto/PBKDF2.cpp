@@ -3,10 +3,91 @@
  */
 
 #include "PBKDF2.h"
+#include "HmacSha256.h"
 #include "cryptoCommonPrivate.h"
+#include "../tools/AutoThreadPool.h"
 
 namespace crypto {
 
+/**
+ * HMAC with any registered hash, computed over a stream of data. As with HmacSha256, the key pads are hashed by
+ * the constructor, so a copy of the just constructed object authenticates another message with the same key
+ * without re-keying.
+ */
+class HashHmac {
+public:
+    HashHmac(HashType hashType, const void *key, size_t keySize) : desc(&hash_descriptor[getHashIndex(hashType)]) {
+        byte_vector block(desc->blocksize, 0);
+        if (keySize > block.size()) {
+            // long keys are hashed first, as RFC 2104 says
+            hash_state md;
+            desc->init(&md);
+            desc->process(&md, (const unsigned char *) key, keySize);
+            desc->done(&md, block.data());
+        } else if (keySize > 0) {
+            memcpy(block.data(), key, keySize);
+        }
+        for (auto &b: block)
+            b ^= 0x36;
+        desc->init(&inner);
+        desc->process(&inner, block.data(), block.size());
+        // 0x36 ^ 0x5C turns inner pad into outer one
+        for (auto &b: block)
+            b ^= 0x36 ^ 0x5C;
+        desc->init(&outer);
+        desc->process(&outer, block.data(), block.size());
+        zeromem(block.data(), block.size());
+    }
+
+    void update(const void *data, size_t size) {
+        desc->process(&inner, (const unsigned char *) data, size);
+    }
+
+    void finish(unsigned char *out) {
+        unsigned char innerHash[MAXBLOCKSIZE];
+        desc->done(&inner, innerHash);
+        desc->process(&outer, innerHash, desc->hashsize);
+        desc->done(&outer, out);
+    }
+
+private:
+    const ltc_hash_descriptor *desc;
+    hash_state inner;
+    hash_state outer;
+};
+
+/**
+ * Output block T_i = U_1 ^ U_2 ^ ... ^ U_c of RFC 8018, section 5.2, with every U computed from a copy of
+ * the keyed hmac.
+ */
+template<class Hmac>
+static void computeBlock(const Hmac &keyed, const byte_vector &salt, uint32_t i, int c, size_t hLen, unsigned char *out) {
+    unsigned char index[4] = {(unsigned char) (i >> 24), (unsigned char) (i >> 16),
+                              (unsigned char) (i >> 8), (unsigned char) i};
+    unsigned char u[MAXBLOCKSIZE];
+    Hmac hmac = keyed;
+    hmac.update(salt.data(), salt.size());
+    hmac.update(index, sizeof(index));
+    hmac.finish(u);
+    memcpy(out, u, hLen);
+    for (int k = 1; k < c; ++k) {
+        hmac = keyed;
+        hmac.update(u, hLen);
+        hmac.finish(u);
+        for (size_t j = 0; j < hLen; ++j)
+            out[j] ^= u[j];
+    }
+}
+
+template<class Hmac>
+static void computeBlocks(const Hmac &keyed, const byte_vector &salt, int c, size_t hLen, byte_vector &result) {
+    size_t nBlocks = result.size() / hLen;
+    // blocks are independent, so the longer keys are derived in parallel
+    parallelFor(nBlocks, [&](size_t i) {
+        computeBlock(keyed, salt, (uint32_t) (i + 1), c, hLen, &result[i * hLen]);
+    });
+}
+
 PBKDF2::PBKDF2(crypto::HashType hashType, const std::string& password, const byte_vector& salt, int c, int dkLen) {
     hashType_ = hashType;
     passwordBytes_ = stringToBytes(password);
@@ -26,10 +107,11 @@ byte_vector PBKDF2::compute() {
         int nBlocks = (dkLen_ + hLen_ - 1) / hLen_;
         byte_vector result(size_t(nBlocks * hLen_));
 
-        for (int i = 0; i < nBlocks; ++i) {
-            byte_vector f = F(i+1);
-            memcpy(&result[i*hLen_], &f[0], (size_t)hLen_);
-        }
+        if (hashType_ == HashType::SHA256)
+            computeBlocks(HmacSha256(passwordBytes_.data(), passwordBytes_.size()), salt_, c_, (size_t) hLen_, result);
+        else
+            computeBlocks(HashHmac(hashType_, passwordBytes_.data(), passwordBytes_.size()), salt_, c_, (size_t) hLen_, result);
+
         computed_.resize((size_t)dkLen_);
         zeromem(&computed_[0], computed_.size());
         memcpy(&computed_[0], &result[0], (size_t)dkLen_);
@@ -39,36 +121,4 @@ byte_vector PBKDF2::compute() {
     return computed_;
 }
 
-byte_vector PBKDF2::F(int i) {
-    unsigned char b;
-    hmac_state hs;
-    hmac_init(&hs, crypto::getHashIndex(hashType_), &passwordBytes_[0], passwordBytes_.size());
-
-    hmac_process(&hs, &salt_[0], salt_.size());
-    b = (unsigned char) ((i>>24) & 0xFF);
-    hmac_process(&hs, &b, 1);
-    b = (unsigned char) ((i>>16) & 0xFF);
-    hmac_process(&hs, &b, 1);
-    b = (unsigned char) ((i>>8) & 0xFF);
-    hmac_process(&hs, &b, 1);
-    b = (unsigned char) ((i) & 0xFF);
-    hmac_process(&hs, &b, 1);
-
-    byte_vector block(crypto::getHashDescriptor(hashType_).hashsize);
-    size_t sz = block.size();
-    hmac_done(&hs, &block[0], &sz);
-    byte_vector u1 = block;
-
-    for (int k = 1; k < c_; ++k) {
-        byte_vector u2(block.size());
-        sz = u2.size();
-        hmac_memory(crypto::getHashIndex(hashType_), &passwordBytes_[0], passwordBytes_.size(), &u1[0], u1.size(), &u2[0], &sz);
-        for (int j = 0; j < hLen_; ++j) {
-            block[j] ^= u2[j];
-        }
-        u1 = u2;
-    }
-    return block;
-}
-
 }
@@ -10,13 +10,19 @@
 
 namespace crypto {
 
+/**
+ * PBKDF2 key derivation (RFC 8018) with HMAC of the given hash.
+ *
+ * Password pads of HMAC are hashed once per derivation rather than in every iteration, with the accelerated
+ * HmacSha256 for SHA256. Output blocks are independent and computed in parallel on the default thread pool when
+ * dkLen is longer than the hash.
+ */
 class PBKDF2 {
 public:
     PBKDF2(crypto::HashType hashType, const std::string& password, const byte_vector& salt, int c, int dkLen);
     static byte_vector derive(crypto::HashType hashType, const std::string& password, const byte_vector& salt, int c, int dkLen);
 private:
     byte_vector compute();
-    byte_vector F(int i);
 private:
     crypto::HashType hashType_;
     byte_vector salt_;
@@ -7,7 +7,6 @@
 #include "PrivateKey.h"
 #include "PublicKey.h"
 #include "cryptoCommonPrivate.h"
-#include "no_prng.h"
 #include "KeyInfo.h"
 #include "../types/UBytes.h"
 #include "../types/UArray.h"
@@ -292,31 +291,7 @@ namespace crypto {
 	}
 
 	std::vector<unsigned char> PrivateKey::sign(void *data, size_t size, HashType hashType) const {
-		int mgf1hash_idx = getHashIndex(SHA1);
-		int hash_idx = getHashIndex(hashType);
-		auto desc = getHashDescriptor(hashType);
-		int prng_indx = find_prng("sprng");
-
-		unsigned char hashResult[desc.hashsize];
-		hash_state md;
-		desc.init(&md);
-		desc.process(&md, (unsigned char *) data, size);
-		desc.done(&md, hashResult);
-
-		int saltLen = rsa_sign_saltlen_get_max_ex(LTC_PKCS_1_PSS, hash_idx, &key.key);
-
-		unsigned long tomSigLen = 1024;
-		unsigned char tomSig[tomSigLen];
-		int res = rsa_sign_hash_ex(
-				hashResult, desc.hashsize, hash_idx,
-				tomSig, &tomSigLen,
-				LTC_PKCS_1_PSS, NULL, prng_indx, mgf1hash_idx, saltLen, &key.key);
-		if (res != CRYPT_OK)
-			printf("rsa_sign_hash_ex error: %i\n", res);
-
-		std::vector<unsigned char> output;
-		output.insert(output.begin(), tomSig, tomSig + tomSigLen);
-		return output;
+		return signEx(data, size, hashType, SHA1, -1);
 	}
 
 	std::vector<unsigned char> PrivateKey::signEx(const std::vector<unsigned char> &input, HashType hashType, HashType mgf1HashType, int saltLen) const {
@@ -324,40 +299,19 @@ namespace crypto {
 	}
 
 	std::vector<unsigned char> PrivateKey::signEx(void *data, size_t size, HashType hashType, HashType mgf1HashType, int saltLen) const {
-		int mgf1hash_idx = getHashIndex(mgf1HashType);
-		int hash_idx = getHashIndex(hashType);
-		auto desc = getHashDescriptor(hashType);
-		int prng_indx = find_prng("sprng");
-
-		unsigned char hashResult[desc.hashsize];
-		hash_state md;
-		desc.init(&md);
-		desc.process(&md, (unsigned char *) data, size);
-		desc.done(&md, hashResult);
-
 		if (saltLen == -1)
-			saltLen = rsa_sign_saltlen_get_max_ex(LTC_PKCS_1_PSS, hash_idx, &key.key);
-
-		unsigned long tomSigLen = 1024;
-		unsigned char tomSig[tomSigLen];
-		int res = rsa_sign_hash_ex(
-				hashResult, desc.hashsize, hash_idx,
-				tomSig, &tomSigLen,
-				LTC_PKCS_1_PSS, NULL, prng_indx, mgf1hash_idx, saltLen, &key.key);
-		if (res != CRYPT_OK)
-			printf("rsa_sign_hash_ex error: %i\n", res);
-
-		std::vector<unsigned char> output;
-		output.insert(output.begin(), tomSig, tomSig + tomSigLen);
-		return output;
+			saltLen = key.kernel().maxSaltLength(hashType);
+		if (saltLen < 0)
+			throw std::invalid_argument("signEx: wrong salt length");
+
+		byte_vector salt((size_t) saltLen);
+		if (saltLen > 0)
+			sprng_read(&salt[0], salt.size(), nullptr);
+		return signExWithCustomSalt(data, size, hashType, mgf1HashType, salt.data(), salt.size());
 	}
 
 	std::vector<unsigned char> PrivateKey::signExWithCustomSalt(void *data, size_t size, HashType hashType, HashType mgf1HashType, void *saltData, size_t saltSize) const {
-		ltc_prng_descriptor* no_prng_desc = no_prng_desc_get();
-		int mgf1hash_idx = getHashIndex(mgf1HashType);
-		int hash_idx = getHashIndex(hashType);
-		auto desc = getHashDescriptor(hashType);
-		int prng_indx = register_prng(no_prng_desc);
+		auto &desc = hash_descriptor[getHashIndex(hashType)];
 
 		unsigned char hashResult[desc.hashsize];
 		hash_state md;
@@ -365,27 +319,7 @@ namespace crypto {
 		desc.process(&md, (unsigned char *) data, size);
 		desc.done(&md, hashResult);
 
-		if (saltSize > 0)
-			prng_descriptor[prng_indx].add_entropy((unsigned char *) saltData, saltSize, (prng_state*)no_prng_desc);
-
-		int saltLen = (int) saltSize;
-
-		unsigned long tomSigLen = 1024;
-		unsigned char tomSig[tomSigLen];
-		int res = rsa_sign_hash_ex(
-				hashResult, desc.hashsize, hash_idx,
-				tomSig, &tomSigLen,
-				LTC_PKCS_1_PSS, (prng_state*)no_prng_desc, prng_indx, mgf1hash_idx, saltLen, &key.key);
-		if (res != CRYPT_OK)
-			printf("rsa_sign_hash_ex error: %i\n", res);
-
-		std::vector<unsigned char> output;
-		output.insert(output.begin(), tomSig, tomSig + tomSigLen);
-
-		unregister_prng(no_prng_desc);
-		no_prng_desc_free(no_prng_desc);
-
-		return output;
+		return key.kernel().signPss(hashResult, hashType, mgf1HashType, saltData, saltSize);
 	}
 
 	void PrivateKey::decrypt(const std::vector<unsigned char> &encrypted, std::vector<unsigned char> &output) {
@@ -399,43 +333,11 @@ namespace crypto {
 	}
 
 	std::vector<unsigned char> PrivateKey::decrypt(void *data, size_t size) {
-		int hash_idx = find_hash("sha1");
-
-		size_t bufLen = 1024;
-		unsigned char buf[bufLen];
-
-		int stat = -1;
-		int err = rsa_decrypt_key_ex(
-				(unsigned char *) data, size,
-				buf, &bufLen,
-				NULL, 0,
-				hash_idx, LTC_PKCS_1_OAEP, &stat, &key.key);
-		if (err != CRYPT_OK)
-			throw std::runtime_error(std::string("rsa_decrypt_key_ex error: ") + std::string(error_to_string(err)));
-
-		std::vector<unsigned char> output;
-		output.insert(output.begin(), buf, buf + bufLen);
-		return output;
+		return key.kernel().decryptOaep(data, size, SHA1);
 	}
 
 	std::vector<unsigned char> PrivateKey::decryptEx(void *data, size_t size, int oaepHashType) {
-		int hash_idx = crypto::getHashIndex((crypto::HashType)oaepHashType);
-
-		size_t bufLen = 1024;
-		unsigned char buf[bufLen];
-
-		int stat = -1;
-		int err = rsa_decrypt_key_ex(
-				(unsigned char *) data, size,
-				buf, &bufLen,
-				NULL, 0,
-				hash_idx, LTC_PKCS_1_OAEP, &stat, &key.key);
-		if (err != CRYPT_OK)
-			throw std::runtime_error(std::string("rsa_decrypt_key_ex error: ") + std::string(error_to_string(err)));
-
-		std::vector<unsigned char> output;
-		output.insert(output.begin(), buf, buf + bufLen);
-		return output;
+		return key.kernel().decryptOaep(data, size, (HashType) oaepHashType);
 	}
 
 	std::string PrivateKey::get_e() const {
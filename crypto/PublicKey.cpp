@@ -9,12 +9,13 @@
 #include <tomcrypt.h>
 #include "KeyAddress.h"
 #include "PublicKey.h"
-#include "no_prng.h"
 #include "cryptoCommonPrivate.h"
+#include "SignatureCache.h"
 #include "base64.h"
 #include "../types/UBytes.h"
 #include "../types/UArray.h"
 #include "../serialization/BossSerializer.h"
+#include "../tools/AutoThreadPool.h"
 
 namespace crypto {
 
@@ -132,9 +133,11 @@ namespace crypto {
 	}
 
 	bool PublicKey::verify(void *sigData, size_t sigSize, void *bodyData, size_t bodySize, HashType hashType) const {
-		int mgf1hash_idx = getHashIndex(SHA1);
-		int hash_idx = getHashIndex(hashType);
-		auto desc = hash_descriptor[hash_idx];
+		return verifyEx(sigData, sigSize, bodyData, bodySize, hashType, SHA1, -1);
+	}
+
+	bool PublicKey::verifyEx(void *sigData, size_t sigSize, void *bodyData, size_t bodySize, HashType pssHashType, HashType mgf1HashType, int saltLen) const {
+		auto &desc = hash_descriptor[getHashIndex(pssHashType)];
 
 		unsigned char hashResult[desc.hashsize];
 		hash_state md;
@@ -142,40 +145,36 @@ namespace crypto {
 		desc.process(&md, (unsigned char *) bodyData, bodySize);
 		desc.done(&md, hashResult);
 
-		int saltLen = rsa_sign_saltlen_get_max_ex(LTC_PKCS_1_PSS, hash_idx, &key.key);
-
-		int stat = -1;
-		int err = rsa_verify_hash_ex(
-				(unsigned char *) sigData, sigSize,
-				hashResult, desc.hashsize, hash_idx,
-				LTC_PKCS_1_PSS, mgf1hash_idx, saltLen, &stat, &key.key);
-//	if (err != CRYPT_OK)
-//		printf("  warning (rsa_verify_hash_ex): %s\n", error_to_string(err));
-		return stat != 0;
+		return verifyHash(sigData, sigSize, hashResult, pssHashType, mgf1HashType, saltLen);
 	}
 
-	bool PublicKey::verifyEx(void *sigData, size_t sigSize, void *bodyData, size_t bodySize, HashType pssHashType, HashType mgf1HashType, int saltLen) const {
-		int mgf1hash_idx = getHashIndex(mgf1HashType);
-		int hash_idx = getHashIndex(pssHashType);
-		auto desc = hash_descriptor[hash_idx];
+	bool PublicKey::verifyDigest(const void *sigData, size_t sigSize, const std::vector<unsigned char> &digest, HashType hashType) const {
+		if (digest.size() != hash_descriptor[getHashIndex(hashType)].hashsize)
+			throw std::invalid_argument("digest size doesn't match hash type");
+		return verifyHash(sigData, sigSize, digest.data(), hashType, SHA1, -1);
+	}
 
-		unsigned char hashResult[desc.hashsize];
-		hash_state md;
-		desc.init(&md);
-		desc.process(&md, (unsigned char *) bodyData, bodySize);
-		desc.done(&md, hashResult);
+	bool PublicKey::verifyHash(const void *sigData, size_t sigSize, const unsigned char *hash, HashType hashType,
+							   HashType mgf1HashType, int saltLen) const {
+		auto &kernel = key.kernel();
+		auto &cache = SignatureCache::instance();
+		auto cacheKey = SignatureCache::makeKey(kernel.keyDigest(), sigData, sigSize, hash, hashType, mgf1HashType, saltLen);
+		if (cache.contains(cacheKey))
+			return true;
+		if (!kernel.verifyPss(sigData, sigSize, hash, hashType, mgf1HashType, saltLen))
+			return false;
+		cache.insert(cacheKey);
+		return true;
+	}
 
-		if (saltLen == -1)
-			saltLen = rsa_sign_saltlen_get_max_ex(LTC_PKCS_1_PSS, hash_idx, &key.key);
-
-		int stat = -1;
-		int err = rsa_verify_hash_ex(
-				(unsigned char *) sigData, sigSize,
-				hashResult, desc.hashsize, hash_idx,
-				LTC_PKCS_1_PSS, mgf1hash_idx, saltLen, &stat, &key.key);
-//	if (err != CRYPT_OK)
-//		printf("  warning (rsa_verify_hash_ex): %s\n", error_to_string(err));
-		return stat != 0;
+	std::vector<bool> PublicKey::verifyBatch(const std::vector<SignatureToVerify> &signatures) {
+		// std::vector<bool> can't be written from different threads
+		std::vector<char> results(signatures.size());
+		parallelFor(signatures.size(), [&](size_t i) {
+			auto& s = signatures[i];
+			results[i] = s.key->verify((void *) s.sigData, s.sigSize, (void *) s.bodyData, s.bodySize, s.hashType);
+		});
+		return std::vector<bool>(results.begin(), results.end());
 	}
 
 	void PublicKey::encrypt(const std::vector<unsigned char> &input, std::vector<unsigned char> &output) const {
@@ -189,73 +188,17 @@ namespace crypto {
 	}
 
 	std::vector<unsigned char> PublicKey::encrypt(void *data, size_t size) const {
-		int hash_idx = find_hash("sha1");
-		int prng_indx = find_prng("sprng");
-
-		size_t bufLen = 1024;
-		unsigned char buf[bufLen];
-
-		int err = rsa_encrypt_key_ex(
-				(unsigned char *) data, size,
-				buf, &bufLen,
-				NULL, 0,
-				NULL, prng_indx,
-				hash_idx, LTC_PKCS_1_OAEP, &key.key);
-		if (err != CRYPT_OK)
-			printf("rsa_encrypt_key_ex error: %i\n", err);
-
-		std::vector<unsigned char> output;
-		output.insert(output.begin(), buf, buf + bufLen);
-		return output;
+		return key.kernel().encryptOaep(data, size, SHA1);
 	}
 
 	std::vector<unsigned char> PublicKey::encryptEx(void *input_data, size_t input_size, int oaepHashType) const {
-		int hash_idx = crypto::getHashIndex((crypto::HashType)oaepHashType);
-		int prng_indx = find_prng("sprng");
-
-		size_t bufLen = 1024;
-		unsigned char buf[bufLen];
-
-		int err = rsa_encrypt_key_ex(
-				(unsigned char *) input_data, input_size,
-				buf, &bufLen,
-				NULL, 0,
-				NULL, prng_indx,
-				hash_idx, LTC_PKCS_1_OAEP, &key.key);
-		if (err != CRYPT_OK)
-			printf("rsa_encrypt_key_ex error: %i\n", err);
-
-		std::vector<unsigned char> output;
-		output.insert(output.begin(), buf, buf + bufLen);
-		return output;
+		return key.kernel().encryptOaep(input_data, input_size, (HashType) oaepHashType);
 	}
 
 	std::vector<unsigned char> PublicKey::encryptExWithSeed(void *input_data, size_t input_size, int oaepHashType, void *seed_data, size_t seed_size) const {
-		ltc_prng_descriptor* no_prng_desc = no_prng_desc_get();
-		int hash_idx = crypto::getHashIndex((crypto::HashType)oaepHashType);
-		int prng_indx = register_prng(no_prng_desc);
-
-		prng_descriptor[prng_indx].add_entropy((unsigned char*)seed_data, seed_size, (prng_state*)no_prng_desc);
-
-		size_t bufLen = 1024;
-		unsigned char buf[bufLen];
-
-		int err = rsa_encrypt_key_ex(
-				(unsigned char *) input_data, input_size,
-				buf, &bufLen,
-				NULL, 0,
-				(prng_state*)no_prng_desc, prng_indx,
-				hash_idx, LTC_PKCS_1_OAEP, &key.key);
-		if (err != CRYPT_OK)
-			printf("rsa_encrypt_key_ex error: %i\n", err);
-
-		std::vector<unsigned char> output;
-		output.insert(output.begin(), buf, buf + bufLen);
-
-		unregister_prng(no_prng_desc);
-		no_prng_desc_free(no_prng_desc);
-
-		return output;
+		if (seed_size != hash_descriptor[getHashIndex((HashType) oaepHashType)].hashsize)
+			throw std::invalid_argument("encryptExWithSeed: seed size must be equal to the hash size");
+		return key.kernel().encryptOaep(input_data, input_size, (HashType) oaepHashType, seed_data);
 	}
 
 	const KeyAddress &PublicKey::getShortAddress() {
@@ -22,6 +22,18 @@ namespace crypto {
 
 	public:
 
+		/**
+		 * Signature to check with verifyBatch(). Key, signature and data must stay alive until it returns.
+		 */
+		struct SignatureToVerify {
+			const PublicKey *key;
+			const void *sigData;
+			size_t sigSize;
+			const void *bodyData;
+			size_t bodySize;
+			HashType hashType;
+		};
+
 		PublicKey(mpz_ptr N, mpz_ptr e);
 
 		PublicKey(const std::string &strE, const std::string &strN);
@@ -34,11 +46,29 @@ namespace crypto {
 
 		std::vector<unsigned char> pack() const;
 
+		/**
+		 * Check RSA-PSS signature of the data. Valid signatures are remembered in SignatureCache::instance(), so
+		 * checking the same signature again costs only hashing of the data.
+		 */
 		bool verify(const std::vector<unsigned char> &sig, const std::vector<unsigned char> &data, HashType hashType) const;
 
 		bool verify(void *sigData, size_t sigSize, void *bodyData, size_t bodySize, HashType hashType) const;
 		bool verifyEx(void *sigData, size_t sigSize, void *bodyData, size_t bodySize, HashType pssHashType, HashType mgf1HashType, int saltLen = -1) const;
 
+		/**
+		 * Same as verify(), for data which digest of hashType is computed already, e.g. with Digest in parts.
+		 * Throws std::invalid_argument if digest size doesn't match hashType.
+		 */
+		bool verifyDigest(const void *sigData, size_t sigSize, const std::vector<unsigned char> &digest, HashType hashType) const;
+
+		/**
+		 * Verify many signatures at once, same as calling verify() for each, but hashing and RSA operations of
+		 * different signatures run in parallel on the default thread pool. Can be called from its tasks.
+		 *
+		 * @return verification results in the order of signatures
+		 */
+		static std::vector<bool> verifyBatch(const std::vector<SignatureToVerify> &signatures);
+
 		void encrypt(const std::vector<unsigned char> &input, std::vector<unsigned char> &output) const;
 
 		std::vector<unsigned char> encrypt(const std::vector<unsigned char> &input) const;
@@ -73,6 +103,10 @@ namespace crypto {
 
 		void initFromDecimalStrings(const std::string &strE, const std::string &strN);
 
+		// check PSS signature of the message hash, consulting SignatureCache first
+		bool verifyHash(const void *sigData, size_t sigSize, const unsigned char *hash, HashType hashType,
+						HashType mgf1HashType, int saltLen) const;
+
 	private:
 
 		const static char FINGERPRINT_SHA256 = 7;
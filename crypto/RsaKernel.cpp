@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include <cstring>
+#include "RsaKernel.h"
+#include "cryptoCommonPrivate.h"
+
+namespace crypto {
+
+    static const ltc_hash_descriptor &hashDescriptor(HashType hashType) {
+        return hash_descriptor[getHashIndex(hashType)];
+    }
+
+    // 0xFF if x is zero, 0 otherwise, without branches
+    static inline unsigned char ctIsZero(unsigned char x) {
+        return (unsigned char) (((unsigned int) x - 1) >> 8);
+    }
+
+    /**
+     * XOR target with MGF1 mask generated from the seed.
+     */
+    static void mgf1Xor(const ltc_hash_descriptor &desc, const unsigned char *seed, size_t seedSize,
+                        unsigned char *target, size_t targetSize) {
+        unsigned char block[MAXBLOCKSIZE];
+        uint32_t counter = 0;
+        while (targetSize > 0) {
+            unsigned char counterBytes[4] = {
+                    (unsigned char) (counter >> 24), (unsigned char) (counter >> 16),
+                    (unsigned char) (counter >> 8), (unsigned char) counter
+            };
+            hash_state md;
+            desc.init(&md);
+            desc.process(&md, seed, seedSize);
+            desc.process(&md, counterBytes, 4);
+            desc.done(&md, block);
+            size_t n = std::min(targetSize, (size_t) desc.hashsize);
+            for (size_t i = 0; i < n; ++i)
+                target[i] ^= block[i];
+            target += n;
+            targetSize -= n;
+            ++counter;
+        }
+    }
+
+    /**
+     * PSS hash of the message hash and salt: H(00 00 00 00 00 00 00 00 || mHash || salt).
+     */
+    static void pssHash(const ltc_hash_descriptor &desc, const unsigned char *hash, const unsigned char *salt,
+                        size_t saltSize, unsigned char *out) {
+        static const unsigned char zeros[8] = {0};
+        hash_state md;
+        desc.init(&md);
+        desc.process(&md, zeros, sizeof(zeros));
+        desc.process(&md, hash, desc.hashsize);
+        if (saltSize > 0)
+            desc.process(&md, salt, saltSize);
+        desc.done(&md, out);
+    }
+
+    // big-endian bytes of the value without leading zeros, as mpz_to_unsigned_bin does
+    static byte_vector exportBytes(const mpz_t value) {
+        byte_vector result((mpz_sizeinbase(value, 2) + 7) / 8);
+        size_t count = 0;
+        mpz_export(result.data(), &count, 1, 1, 1, 0, value);
+        result.resize(count);
+        return result;
+    }
+
+    static void initCopy(mpz_t dst, void *src) {
+        if (src != nullptr)
+            mpz_init_set(dst, (mpz_srcptr) src);
+        else
+            mpz_init(dst);
+    }
+
+    RsaKernel::RsaKernel(const rsa_key &key) {
+        initCopy(n, key.N);
+        initCopy(e, key.e);
+        hasPrivate = key.type == PK_PRIVATE;
+        initCopy(d, hasPrivate ? key.d : nullptr);
+        initCopy(p, hasPrivate ? key.p : nullptr);
+        initCopy(q, hasPrivate ? key.q : nullptr);
+        initCopy(dP, hasPrivate ? key.dP : nullptr);
+        initCopy(dQ, hasPrivate ? key.dQ : nullptr);
+        initCopy(qInv, hasPrivate ? key.qP : nullptr);
+        hasCrt = hasPrivate && mpz_sgn(p) != 0 && mpz_sgn(q) != 0 && mpz_sgn(dP) != 0 && mpz_sgn(dQ) != 0 &&
+                 mpz_sgn(qInv) != 0;
+        modulusBits = mpz_sizeinbase(n, 2);
+        modulusBytes = (modulusBits + 7) / 8;
+        byte_vector components = exportBytes(e);
+        byte_vector modulus = exportBytes(n);
+        components.insert(components.end(), modulus.begin(), modulus.end());
+        hash_state md;
+        sha256_init(&md);
+        sha256_process(&md, components.data(), components.size());
+        sha256_done(&md, publicDigest);
+        mpz_init(blindValue);
+        mpz_init(unblindValue);
+        blindingUses = 0;
+    }
+
+    RsaKernel::~RsaKernel() {
+        mpz_clears(n, e, d, p, q, dP, dQ, qInv, blindValue, unblindValue, nullptr);
+    }
+
+    int RsaKernel::maxSaltLength(HashType hashType) const {
+        return (int) modulusBytes - (int) hashDescriptor(hashType).hashsize - 2;
+    }
+
+    void RsaKernel::publicOp(mpz_t result, const mpz_t input) const {
+        mpz_powm(result, input, e, n);
+    }
+
+    void RsaKernel::nextBlinding(mpz_t blind, mpz_t unblind) const {
+        std::lock_guard lock(blindingMutex);
+        if (blindingUses == 0) {
+            // new random r: blind with r^e, unblind with r^-1
+            byte_vector buf(modulusBytes);
+            mpz_t r;
+            mpz_init(r);
+            do {
+                sprng_read(buf.data(), modulusBytes, nullptr);
+                mpz_import(r, modulusBytes, 1, 1, 0, 0, buf.data());
+                mpz_mod(r, r, n);
+            } while (mpz_cmp_ui(r, 1) <= 0 || mpz_invert(unblindValue, r, n) == 0);
+            mpz_powm(blindValue, r, e, n);
+            mpz_clear(r);
+        } else {
+            // r^2 is as good as the next random, and much cheaper
+            mpz_mul(blindValue, blindValue, blindValue);
+            mpz_mod(blindValue, blindValue, n);
+            mpz_mul(unblindValue, unblindValue, unblindValue);
+            mpz_mod(unblindValue, unblindValue, n);
+        }
+        blindingUses = (blindingUses + 1) % BLINDING_REFRESH;
+        mpz_set(blind, blindValue);
+        mpz_set(unblind, unblindValue);
+    }
+
+    void RsaKernel::privateOp(mpz_t result, const mpz_t input) const {
+        if (!hasPrivate)
+            throw std::runtime_error("RsaKernel: private operation with public key");
+
+        mpz_t blind, unblind, x, m1, m2;
+        mpz_inits(blind, unblind, x, m1, m2, nullptr);
+        nextBlinding(blind, unblind);
+
+        mpz_mul(x, input, blind);
+        mpz_mod(x, x, n);
+        if (hasCrt) {
+            mpz_powm(m1, x, dP, p);
+            mpz_powm(m2, x, dQ, q);
+            // x = m2 + q * (qInv * (m1 - m2) mod p)
+            mpz_sub(x, m1, m2);
+            mpz_mul(x, x, qInv);
+            mpz_mod(x, x, p);
+            mpz_mul(x, x, q);
+            mpz_add(x, x, m2);
+        } else {
+            mpz_powm(x, x, d, n);
+        }
+        mpz_mul(x, x, unblind);
+        mpz_mod(x, x, n);
+
+        // a fault in CRT computation leaks the factors, so the result never goes out unchecked
+        publicOp(m1, x);
+        bool valid = mpz_cmp(m1, input) == 0;
+        if (valid)
+            mpz_set(result, x);
+        mpz_clears(blind, unblind, x, m1, m2, nullptr);
+        if (!valid)
+            throw std::runtime_error("RsaKernel: private operation check failed");
+    }
+
+    void RsaKernel::exportModulusSize(unsigned char *out, const mpz_t value) const {
+        size_t size = mpz_sgn(value) != 0 ? (mpz_sizeinbase(value, 2) + 7) / 8 : 0;
+        memset(out, 0, modulusBytes - size);
+        mpz_export(out + modulusBytes - size, nullptr, 1, 1, 1, 0, value);
+    }
+
+    bool RsaKernel::verifyPss(const void *sig, size_t sigSize, const unsigned char *hash, HashType hashType,
+                              HashType mgf1HashType, int saltLength) const {
+        auto &desc = hashDescriptor(hashType);
+        size_t hashSize = desc.hashsize;
+        if (saltLength == -1)
+            saltLength = maxSaltLength(hashType);
+        size_t emBits = modulusBits - 1;
+        size_t emSize = (emBits + 7) / 8;
+        if (sigSize != modulusBytes || saltLength < 0 || emSize < hashSize + saltLength + 2)
+            return false;
+
+        mpz_t s;
+        mpz_init(s);
+        mpz_import(s, sigSize, 1, 1, 0, 0, sig);
+        if (mpz_cmp(s, n) >= 0) {
+            mpz_clear(s);
+            return false;
+        }
+        publicOp(s, s);
+        byte_vector buf(modulusBytes);
+        exportModulusSize(buf.data(), s);
+        mpz_clear(s);
+
+        // when emBits is a multiple of 8, EM is one byte shorter than the modulus
+        if (emSize < modulusBytes && buf[0] != 0)
+            return false;
+        unsigned char *em = buf.data() + modulusBytes - emSize;
+        if (em[emSize - 1] != 0xBC)
+            return false;
+        size_t dbSize = emSize - hashSize - 1;
+        unsigned char *db = em;
+        const unsigned char *h = em + dbSize;
+        unsigned char topMask = (unsigned char) (0xFF >> (8 * emSize - emBits));
+        if ((db[0] & ~topMask) != 0)
+            return false;
+
+        mgf1Xor(hashDescriptor(mgf1HashType), h, hashSize, db, dbSize);
+        db[0] &= topMask;
+        size_t separator = dbSize - saltLength - 1;
+        for (size_t i = 0; i < separator; ++i)
+            if (db[i] != 0)
+                return false;
+        if (db[separator] != 0x01)
+            return false;
+
+        unsigned char expected[MAXBLOCKSIZE];
+        pssHash(desc, hash, db + separator + 1, (size_t) saltLength, expected);
+        return memcmp(expected, h, hashSize) == 0;
+    }
+
+    byte_vector RsaKernel::signPss(const unsigned char *hash, HashType hashType, HashType mgf1HashType,
+                                   const void *salt, size_t saltSize) const {
+        auto &desc = hashDescriptor(hashType);
+        size_t hashSize = desc.hashsize;
+        size_t emBits = modulusBits - 1;
+        size_t emSize = (emBits + 7) / 8;
+        if (emSize < hashSize + saltSize + 2)
+            throw std::runtime_error("RsaKernel: salt is too long for the key");
+
+        byte_vector output(modulusBytes, 0);
+        unsigned char *em = output.data() + modulusBytes - emSize;
+        size_t dbSize = emSize - hashSize - 1;
+        unsigned char *db = em;
+        unsigned char *h = em + dbSize;
+
+        pssHash(desc, hash, (const unsigned char *) salt, saltSize, h);
+        db[dbSize - saltSize - 1] = 0x01;
+        if (saltSize > 0)
+            memcpy(db + dbSize - saltSize, salt, saltSize);
+        mgf1Xor(hashDescriptor(mgf1HashType), h, hashSize, db, dbSize);
+        db[0] &= (unsigned char) (0xFF >> (8 * emSize - emBits));
+        em[emSize - 1] = 0xBC;
+
+        mpz_t m;
+        mpz_init(m);
+        mpz_import(m, modulusBytes, 1, 1, 0, 0, output.data());
+        try {
+            privateOp(m, m);
+        } catch (...) {
+            mpz_clear(m);
+            throw;
+        }
+        exportModulusSize(output.data(), m);
+        mpz_clear(m);
+        return output;
+    }
+
+    byte_vector RsaKernel::encryptOaep(const void *data, size_t size, HashType hashType, const void *seed) const {
+        auto &desc = hashDescriptor(hashType);
+        size_t hashSize = desc.hashsize;
+        if (modulusBytes < 2 * hashSize + 2 || size > modulusBytes - 2 * hashSize - 2)
+            throw std::runtime_error(
+                    std::string("rsa_encrypt_key_ex error: ") + std::string(error_to_string(CRYPT_PK_INVALID_SIZE)));
+
+        // EM = 00 || maskedSeed || maskedDB, DB = lHash || 00...00 || 01 || M
+        byte_vector output(modulusBytes, 0);
+        unsigned char *maskedSeed = output.data() + 1;
+        unsigned char *db = maskedSeed + hashSize;
+        size_t dbSize = modulusBytes - hashSize - 1;
+        hash_state md;
+        desc.init(&md);
+        desc.done(&md, db);
+        db[dbSize - size - 1] = 0x01;
+        if (size > 0)
+            memcpy(db + dbSize - size, data, size);
+
+        if (seed != nullptr)
+            memcpy(maskedSeed, seed, hashSize);
+        else
+            sprng_read(maskedSeed, hashSize, nullptr);
+        mgf1Xor(desc, maskedSeed, hashSize, db, dbSize);
+        mgf1Xor(desc, db, dbSize, maskedSeed, hashSize);
+
+        mpz_t m;
+        mpz_init(m);
+        mpz_import(m, modulusBytes, 1, 1, 0, 0, output.data());
+        publicOp(m, m);
+        exportModulusSize(output.data(), m);
+        mpz_clear(m);
+        return output;
+    }
+
+    byte_vector RsaKernel::decryptOaep(const void *data, size_t size, HashType hashType) const {
+        auto &desc = hashDescriptor(hashType);
+        size_t hashSize = desc.hashsize;
+        auto invalidPacket = []() {
+            return std::runtime_error(
+                    std::string("rsa_decrypt_key_ex error: ") + std::string(error_to_string(CRYPT_INVALID_PACKET)));
+        };
+        if (size != modulusBytes || modulusBytes < 2 * hashSize + 2)
+            throw invalidPacket();
+
+        mpz_t c;
+        mpz_init(c);
+        mpz_import(c, size, 1, 1, 0, 0, data);
+        if (mpz_cmp(c, n) >= 0) {
+            mpz_clear(c);
+            throw invalidPacket();
+        }
+        try {
+            privateOp(c, c);
+        } catch (...) {
+            mpz_clear(c);
+            throw;
+        }
+        byte_vector em(modulusBytes);
+        exportModulusSize(em.data(), c);
+        mpz_clear(c);
+
+        unsigned char *seed = em.data() + 1;
+        unsigned char *db = seed + hashSize;
+        size_t dbSize = modulusBytes - hashSize - 1;
+        mgf1Xor(desc, db, dbSize, seed, hashSize);
+        mgf1Xor(desc, seed, hashSize, db, dbSize);
+
+        unsigned char lHash[MAXBLOCKSIZE];
+        hash_state md;
+        desc.init(&md);
+        desc.done(&md, lHash);
+
+        // check everything before deciding, so timing doesn't tell which part is wrong: the whole DB is scanned with
+        // masks, without branches or early exit on its bytes
+        unsigned char bad = em[0];
+        for (size_t i = 0; i < hashSize; ++i)
+            bad |= db[i] ^ lHash[i];
+        // 0xFF until the 0x01 separator is met, messagePos is the byte after it
+        unsigned char searching = 0xFF;
+        size_t messagePos = 0;
+        for (size_t i = hashSize; i < dbSize; ++i) {
+            unsigned char isZero = ctIsZero(db[i]);
+            unsigned char isSeparator = searching & ctIsZero(db[i] ^ 0x01);
+            size_t mask = (size_t) 0 - (size_t) (isSeparator & 1);
+            messagePos = (messagePos & ~mask) | ((i + 1) & mask);
+            // padding is zeroes followed by the separator, any other byte before it is wrong
+            bad |= searching & ~isZero & ~isSeparator;
+            searching &= isZero;
+        }
+        bad |= searching;
+        if (bad != 0)
+            throw invalidPacket();
+        return byte_vector(db + messagePos, db + dbSize);
+    }
+
+};
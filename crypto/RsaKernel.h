@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_RSAKERNEL_H
+#define U8_RSAKERNEL_H
+
+#include <mutex>
+#include "cryptoCommon.h"
+
+namespace crypto {
+
+    /**
+     * RSA operations of one key, done directly with GMP.
+     *
+     * Values of the key (modulus, exponents, CRT parameters) are copied once, when the kernel is created, instead of
+     * going through the generic libtomcrypt entry points with their descriptor lookups on every call. Paddings are
+     * PSS and OAEP as in PKCS #1 v2.2, same as libtomcrypt does them, so signatures and ciphertexts are
+     * interchangeable with rsa_sign_hash_ex/rsa_encrypt_key_ex and bit-identical for the same salt or seed.
+     *
+     * Private operation uses CRT with blinding, and its result is checked with the public exponent before use.
+     * Kernel is immutable except for the blinding values, which are guarded by a mutex, so it is safe to use
+     * from many threads.
+     */
+    class RsaKernel {
+    public:
+        /**
+         * Create kernel for the key, public or private.
+         */
+        explicit RsaKernel(const rsa_key &key);
+
+        RsaKernel(const RsaKernel &) = delete;
+
+        RsaKernel &operator=(const RsaKernel &) = delete;
+
+        ~RsaKernel();
+
+        bool isPrivate() const {
+            return hasPrivate;
+        }
+
+        /**
+         * Modulus size in bytes, also the size of signatures and ciphertexts.
+         */
+        size_t modulusSize() const {
+            return modulusBytes;
+        }
+
+        /**
+         * SHA-256 of the public exponent and modulus, 32 bytes; same as PublicKey::fingerprint() without its type
+         * byte. Identifies the key in SignatureCache.
+         */
+        const unsigned char *keyDigest() const {
+            return publicDigest;
+        }
+
+        /**
+         * Maximum salt length of PSS signature with the hashType, the one Java implementation uses.
+         */
+        int maxSaltLength(HashType hashType) const;
+
+        /**
+         * Check PSS signature of the message hash.
+         *
+         * @param saltLength exact salt length of the signature; -1 for maxSaltLength(hashType).
+         */
+        bool verifyPss(const void *sig, size_t sigSize, const unsigned char *hash, HashType hashType,
+                       HashType mgf1HashType, int saltLength) const;
+
+        /**
+         * Sign the message hash with PSS using the given salt. Kernel must be private.
+         */
+        byte_vector signPss(const unsigned char *hash, HashType hashType, HashType mgf1HashType,
+                            const void *salt, size_t saltSize) const;
+
+        /**
+         * Encrypt data with OAEP, using the given seed of the hash size, or a random one if seed is nullptr.
+         * Throws std::runtime_error if data is too long for the key.
+         */
+        byte_vector encryptOaep(const void *data, size_t size, HashType hashType, const void *seed = nullptr) const;
+
+        /**
+         * Decrypt OAEP ciphertext. Kernel must be private. Throws std::runtime_error if ciphertext is malformed.
+         */
+        byte_vector decryptOaep(const void *data, size_t size, HashType hashType) const;
+
+    private:
+        // refresh blinding values with a new random after so many private operations
+        static const int BLINDING_REFRESH = 32;
+
+        void publicOp(mpz_t result, const mpz_t input) const;
+
+        void privateOp(mpz_t result, const mpz_t input) const;
+
+        void nextBlinding(mpz_t blind, mpz_t unblind) const;
+
+        void exportModulusSize(unsigned char *out, const mpz_t value) const;
+
+        mpz_t n, e, d, p, q, dP, dQ, qInv;
+        size_t modulusBits;
+        size_t modulusBytes;
+        bool hasPrivate;
+        bool hasCrt;
+        unsigned char publicDigest[32];
+
+        mutable std::mutex blindingMutex;
+        mutable mpz_t blindValue, unblindValue;
+        mutable int blindingUses;
+    };
+
+};
+
+#endif //U8_RSAKERNEL_H
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include "Sha3.h"
+#include "CpuFeatures.h"
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef U8_X86_CRYPTO
+#include <immintrin.h>
+#endif
+
+namespace crypto {
+
+    static const uint64_t ROUND_CONSTANTS[24] = {
+            0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+            0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+            0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+            0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+            0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+            0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+    };
+
+    static const size_t MAX_LANES = 8;
+
+    static inline uint64_t load64(const unsigned char *p) {
+        uint64_t value;
+        memcpy(&value, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap64(value);
+#endif
+        return value;
+    }
+
+    static inline uint64_t rol64(uint64_t x, int n) {
+        return (x << n) | (x >> ((64 - n) & 63));
+    }
+
+// Keccak-f[1600] round, from state S to state T, for any lane type: the kernel defines KECCAK_T and the operations
+// KECCAK_XOR, KECCAK_ANDNOT (~a & b) and KECCAK_ROL before using it. Rho, pi and chi are done together, plane by
+// plane: each output plane takes five lanes of the input, rotated by their rho offsets.
+#define KECCAK_PLANE(S, T, y, i0, r0, i1, r1, i2, r2, i3, r3, i4, r4) { \
+        KECCAK_T b0 = KECCAK_ROL(KECCAK_XOR(S[i0], D[i0 % 5]), r0); \
+        KECCAK_T b1 = KECCAK_ROL(KECCAK_XOR(S[i1], D[i1 % 5]), r1); \
+        KECCAK_T b2 = KECCAK_ROL(KECCAK_XOR(S[i2], D[i2 % 5]), r2); \
+        KECCAK_T b3 = KECCAK_ROL(KECCAK_XOR(S[i3], D[i3 % 5]), r3); \
+        KECCAK_T b4 = KECCAK_ROL(KECCAK_XOR(S[i4], D[i4 % 5]), r4); \
+        T[y * 5 + 0] = KECCAK_XOR(b0, KECCAK_ANDNOT(b1, b2)); \
+        T[y * 5 + 1] = KECCAK_XOR(b1, KECCAK_ANDNOT(b2, b3)); \
+        T[y * 5 + 2] = KECCAK_XOR(b2, KECCAK_ANDNOT(b3, b4)); \
+        T[y * 5 + 3] = KECCAK_XOR(b3, KECCAK_ANDNOT(b4, b0)); \
+        T[y * 5 + 4] = KECCAK_XOR(b4, KECCAK_ANDNOT(b0, b1)); \
+    }
+
+#define KECCAK_ROUND(S, T, roundConstant) { \
+        KECCAK_T C[5], D[5]; \
+        for (int x = 0; x < 5; ++x) \
+            C[x] = KECCAK_XOR(KECCAK_XOR(KECCAK_XOR(S[x], S[x + 5]), KECCAK_XOR(S[x + 10], S[x + 15])), S[x + 20]); \
+        for (int x = 0; x < 5; ++x) \
+            D[x] = KECCAK_XOR(C[(x + 4) % 5], KECCAK_ROL(C[(x + 1) % 5], 1)); \
+        KECCAK_PLANE(S, T, 0, 0, 0, 6, 44, 12, 43, 18, 21, 24, 14) \
+        KECCAK_PLANE(S, T, 1, 3, 28, 9, 20, 10, 3, 16, 45, 22, 61) \
+        KECCAK_PLANE(S, T, 2, 1, 1, 7, 6, 13, 25, 19, 8, 20, 18) \
+        KECCAK_PLANE(S, T, 3, 4, 27, 5, 36, 11, 10, 17, 15, 23, 56) \
+        KECCAK_PLANE(S, T, 4, 2, 62, 8, 55, 14, 39, 15, 41, 21, 2) \
+        T[0] = KECCAK_XOR(T[0], roundConstant); \
+    }
+
+#define KECCAK_T uint64_t
+#define KECCAK_XOR(a, b) ((a) ^ (b))
+#define KECCAK_ANDNOT(a, b) (~(a) & (b))
+#define KECCAK_ROL(a, n) rol64(a, n)
+
+    static void keccakF1600(uint64_t *state) {
+        // local copies stay in registers, the state could alias anything
+        uint64_t A[25], E[25];
+        memcpy(A, state, sizeof(A));
+        for (int round = 0; round < 24; round += 2) {
+            KECCAK_ROUND(A, E, ROUND_CONSTANTS[round])
+            KECCAK_ROUND(E, A, ROUND_CONSTANTS[round + 1])
+        }
+        memcpy(state, A, sizeof(A));
+    }
+
+#undef KECCAK_T
+#undef KECCAK_XOR
+#undef KECCAK_ANDNOT
+#undef KECCAK_ROL
+
+    /**
+     * Block b of the lane: a full block of its data, or the last padded one.
+     */
+    static inline const unsigned char *laneBlock(const unsigned char *const *data, const unsigned char *const *tails,
+                                                 const size_t *fullBlocks, size_t lane, size_t b, size_t rate) {
+        return b < fullBlocks[lane] ? data[lane] + b * rate : tails[lane];
+    }
+
+#ifdef U8_X86_CRYPTO
+
+#define KECCAK_T __m256i
+#define KECCAK_XOR(a, b) _mm256_xor_si256(a, b)
+#define KECCAK_ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define KECCAK_ROL(a, n) _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - (n)))
+
+    __attribute__((target("avx2")))
+    static void absorbLanes4(uint64_t *const *states, const unsigned char *const *data,
+                             const unsigned char *const *tails, const size_t *fullBlocks, size_t blocks, size_t rate) {
+        __m256i A[25], E[25];
+        for (int i = 0; i < 25; ++i)
+            A[i] = _mm256_set_epi64x(states[3][i], states[2][i], states[1][i], states[0][i]);
+        for (size_t b = 0; b < blocks; ++b) {
+            const unsigned char *p[4];
+            for (size_t lane = 0; lane < 4; ++lane)
+                p[lane] = laneBlock(data, tails, fullBlocks, lane, b, rate);
+            for (size_t w = 0; w < rate / 8; ++w)
+                A[w] = _mm256_xor_si256(A[w], _mm256_set_epi64x(load64(p[3] + w * 8), load64(p[2] + w * 8),
+                                                                load64(p[1] + w * 8), load64(p[0] + w * 8)));
+            for (int round = 0; round < 24; round += 2) {
+                KECCAK_ROUND(A, E, _mm256_set1_epi64x(ROUND_CONSTANTS[round]))
+                KECCAK_ROUND(E, A, _mm256_set1_epi64x(ROUND_CONSTANTS[round + 1]))
+            }
+        }
+        alignas(32) uint64_t lanes[4];
+        for (int i = 0; i < 25; ++i) {
+            _mm256_store_si256((__m256i *) lanes, A[i]);
+            for (size_t lane = 0; lane < 4; ++lane)
+                states[lane][i] = lanes[lane];
+        }
+    }
+
+#undef KECCAK_T
+#undef KECCAK_XOR
+#undef KECCAK_ANDNOT
+#undef KECCAK_ROL
+
+#define KECCAK_T __m512i
+#define KECCAK_XOR(a, b) _mm512_xor_si512(a, b)
+#define KECCAK_ANDNOT(a, b) _mm512_andnot_si512(a, b)
+#define KECCAK_ROL(a, n) _mm512_rol_epi64(a, n)
+
+    __attribute__((target("avx512f")))
+    static void absorbLanes8(uint64_t *const *states, const unsigned char *const *data,
+                             const unsigned char *const *tails, const size_t *fullBlocks, size_t blocks, size_t rate) {
+        __m512i A[25], E[25];
+        for (int i = 0; i < 25; ++i)
+            A[i] = _mm512_set_epi64(states[7][i], states[6][i], states[5][i], states[4][i],
+                                    states[3][i], states[2][i], states[1][i], states[0][i]);
+        for (size_t b = 0; b < blocks; ++b) {
+            const unsigned char *p[8];
+            for (size_t lane = 0; lane < 8; ++lane)
+                p[lane] = laneBlock(data, tails, fullBlocks, lane, b, rate);
+            for (size_t w = 0; w < rate / 8; ++w)
+                A[w] = _mm512_xor_si512(A[w], _mm512_set_epi64(
+                        load64(p[7] + w * 8), load64(p[6] + w * 8), load64(p[5] + w * 8), load64(p[4] + w * 8),
+                        load64(p[3] + w * 8), load64(p[2] + w * 8), load64(p[1] + w * 8), load64(p[0] + w * 8)));
+            for (int round = 0; round < 24; round += 2) {
+                KECCAK_ROUND(A, E, _mm512_set1_epi64(ROUND_CONSTANTS[round]))
+                KECCAK_ROUND(E, A, _mm512_set1_epi64(ROUND_CONSTANTS[round + 1]))
+            }
+        }
+        alignas(64) uint64_t lanes[8];
+        for (int i = 0; i < 25; ++i) {
+            _mm512_store_si512((__m512i *) lanes, A[i]);
+            for (size_t lane = 0; lane < 8; ++lane)
+                states[lane][i] = lanes[lane];
+        }
+    }
+
+#undef KECCAK_T
+#undef KECCAK_XOR
+#undef KECCAK_ANDNOT
+#undef KECCAK_ROL
+
+#endif
+
+#undef KECCAK_ROUND
+#undef KECCAK_PLANE
+
+    Sha3::Sha3(size_t digestBits) {
+        if (digestBits != 256 && digestBits != 384 && digestBits != 512)
+            throw std::invalid_argument("Sha3: wrong digest size");
+        memset(state, 0, sizeof(state));
+        digestBytes = digestBits / 8;
+        rate = 200 - 2 * digestBytes;
+        position = 0;
+    }
+
+    void Sha3::xorByte(size_t index, unsigned char value) {
+        state[index / 8] ^= uint64_t(value) << (8 * (index % 8));
+    }
+
+    void Sha3::update(const void *data, size_t size) {
+        auto p = (const unsigned char *) data;
+        if (position > 0) {
+            while (size > 0 && position < rate) {
+                xorByte(position++, *p++);
+                --size;
+            }
+            if (position < rate)
+                return;
+            keccakF1600(state);
+            position = 0;
+        }
+        while (size >= rate) {
+            for (size_t w = 0; w < rate / 8; ++w)
+                state[w] ^= load64(p + w * 8);
+            keccakF1600(state);
+            p += rate;
+            size -= rate;
+        }
+        while (size > 0) {
+            xorByte(position++, *p++);
+            --size;
+        }
+    }
+
+    void Sha3::squeeze(unsigned char *out) const {
+        for (size_t i = 0; i < digestBytes; ++i)
+            out[i] = (unsigned char) (state[i / 8] >> (8 * (i % 8)));
+    }
+
+    void Sha3::finish(unsigned char *out) {
+        xorByte(position, 0x06);
+        xorByte(rate - 1, 0x80);
+        keccakF1600(state);
+        squeeze(out);
+    }
+
+    void Sha3::digest(size_t digestBits, const void *data, size_t size, unsigned char *out) {
+        Sha3 sha3(digestBits);
+        sha3.update(data, size);
+        sha3.finish(out);
+    }
+
+    void Sha3::digestLanes(size_t digestBits, size_t lanes, const void *const *data, const size_t *sizes,
+                           unsigned char *const *out, AbsorbLanesFunction absorb) {
+        Sha3 hashes[MAX_LANES];
+        uint64_t *states[MAX_LANES];
+        const unsigned char *bytes[MAX_LANES];
+        size_t fullBlocks[MAX_LANES];
+        unsigned char tails[MAX_LANES][200];
+        const unsigned char *tailPointers[MAX_LANES];
+
+        // lanes go together while each one has a block, the shortest one is finished with its padded last block
+        size_t commonBlocks = SIZE_MAX;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            Sha3 &h = hashes[lane];
+            h = Sha3(digestBits);
+            states[lane] = h.state;
+            bytes[lane] = (const unsigned char *) data[lane];
+            fullBlocks[lane] = sizes[lane] / h.rate;
+            commonBlocks = std::min(commonBlocks, fullBlocks[lane] + 1);
+
+            size_t tailSize = sizes[lane] % h.rate;
+            memset(tails[lane], 0, h.rate);
+            if (tailSize > 0)
+                memcpy(tails[lane], bytes[lane] + fullBlocks[lane] * h.rate, tailSize);
+            tails[lane][tailSize] ^= 0x06;
+            tails[lane][h.rate - 1] ^= 0x80;
+            tailPointers[lane] = tails[lane];
+        }
+
+        absorb(states, bytes, tailPointers, fullBlocks, commonBlocks, hashes[0].rate);
+
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            Sha3 &h = hashes[lane];
+            if (commonBlocks == fullBlocks[lane] + 1) {
+                h.squeeze(out[lane]);
+            } else {
+                size_t done = commonBlocks * h.rate;
+                h.update(bytes[lane] + done, sizes[lane] - done);
+                h.finish(out[lane]);
+            }
+        }
+    }
+
+    void Sha3::digestMany(size_t digestBits, size_t count, const void *const *data, const size_t *sizes,
+                          unsigned char *const *out) {
+        size_t i = 0;
+#ifdef U8_X86_CRYPTO
+        auto &cpu = cpuFeatures();
+        if (cpu.avx512f)
+            for (; i + 8 <= count; i += 8)
+                digestLanes(digestBits, 8, data + i, sizes + i, out + i, absorbLanes8);
+        if (cpu.avx2)
+            for (; i + 4 <= count; i += 4)
+                digestLanes(digestBits, 4, data + i, sizes + i, out + i, absorbLanes4);
+#endif
+        for (; i < count; ++i)
+            digest(digestBits, data[i], sizes[i], out[i]);
+    }
+
+};
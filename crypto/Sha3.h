@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_SHA3_H
+#define U8_SHA3_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace crypto {
+
+    /**
+     * SHA3-256/384/512 (FIPS 202), computed over a stream of data.
+     *
+     * Output is the same as of libtomcrypt sha3. Single stream uses unrolled portable Keccak-f[1600], digestMany()
+     * also runs 4 (AVX2) or 8 (AVX-512) independent streams in parallel lanes of vector registers, selected at
+     * runtime. The object is trivially copyable and has no destructor to call, so it can be placed in libtomcrypt's
+     * hash_state.
+     */
+    class Sha3 {
+    public:
+        /**
+         * @param digestBits 256, 384 or 512; throws std::invalid_argument otherwise.
+         */
+        explicit Sha3(size_t digestBits);
+
+        void update(const void *data, size_t size);
+
+        /**
+         * Write digestSize() bytes of digest to out. Object must not be updated after it.
+         */
+        void finish(unsigned char *out);
+
+        size_t digestSize() const {
+            return digestBytes;
+        }
+
+        static void digest(size_t digestBits, const void *data, size_t size, unsigned char *out);
+
+        /**
+         * Compute digests of count inputs: data[i] of sizes[i] bytes into out[i]. Inputs of similar sizes are
+         * processed much faster than with digest() one by one.
+         */
+        static void digestMany(size_t digestBits, size_t count, const void *const *data, const size_t *sizes,
+                               unsigned char *const *out);
+
+    private:
+        // absorb the same number of blocks into several states in parallel, see Sha3.cpp
+        typedef void (*AbsorbLanesFunction)(uint64_t *const *states, const unsigned char *const *data,
+                                            const unsigned char *const *tails, const size_t *fullBlocks,
+                                            size_t blocks, size_t rate);
+
+        uint64_t state[25];
+        size_t rate;
+        size_t position;
+        size_t digestBytes;
+
+        Sha3() = default;
+
+        void xorByte(size_t index, unsigned char value);
+
+        void squeeze(unsigned char *out) const;
+
+        static void digestLanes(size_t digestBits, size_t lanes, const void *const *data, const size_t *sizes,
+                                unsigned char *const *out, AbsorbLanesFunction absorb);
+    };
+
+};
+
+#endif //U8_SHA3_H
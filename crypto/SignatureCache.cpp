@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include "SignatureCache.h"
+#include "cryptoCommonPrivate.h"
+
+namespace crypto {
+
+    SignatureCache::SignatureCache(size_t capacity) : capacity(0) {
+        setCapacity(capacity);
+    }
+
+    SignatureCache::Key SignatureCache::makeKey(const unsigned char *keyDigest, const void *sig, size_t sigSize,
+                                                const unsigned char *hash, HashType hashType,
+                                                HashType mgf1HashType, int saltLength) {
+        auto &desc = hash_descriptor[getHashIndex(hashType)];
+        int32_t params[3] = {(int32_t) hashType, (int32_t) mgf1HashType, (int32_t) saltLength};
+        // signature size goes first so that signature and hash bytes can't be shifted between each other
+        uint64_t size = sigSize;
+        Key result;
+        hash_state md;
+        sha256_init(&md);
+        sha256_process(&md, keyDigest, 32);
+        sha256_process(&md, (const unsigned char *) params, sizeof(params));
+        sha256_process(&md, (const unsigned char *) &size, sizeof(size));
+        sha256_process(&md, (const unsigned char *) sig, sigSize);
+        sha256_process(&md, hash, desc.hashsize);
+        sha256_done(&md, result.data());
+        return result;
+    }
+
+    bool SignatureCache::contains(const Key &key) {
+        if (capacity == 0)
+            return false;
+        auto &shard = shardOf(key);
+        {
+            std::lock_guard lock(shard.mutex);
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end()) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                ++hits;
+                return true;
+            }
+        }
+        ++misses;
+        return false;
+    }
+
+    void SignatureCache::insert(const Key &key) {
+        auto &shard = shardOf(key);
+        std::lock_guard lock(shard.mutex);
+        if (shard.capacity == 0)
+            return;
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return;
+        }
+        shard.lru.push_front(key);
+        shard.entries[key] = shard.lru.begin();
+        trim(shard);
+    }
+
+    void SignatureCache::trim(Shard &shard) {
+        while (shard.entries.size() > shard.capacity) {
+            shard.entries.erase(shard.lru.back());
+            shard.lru.pop_back();
+            ++evictions;
+        }
+    }
+
+    void SignatureCache::clear() {
+        for (auto &shard: shards) {
+            std::lock_guard lock(shard.mutex);
+            shard.entries.clear();
+            shard.lru.clear();
+        }
+    }
+
+    void SignatureCache::setCapacity(size_t newCapacity) {
+        capacity = newCapacity;
+        for (size_t i = 0; i < SHARDS_COUNT; ++i) {
+            auto &shard = shards[i];
+            std::lock_guard lock(shard.mutex);
+            // spread the remainder so that shard capacities sum up to the requested one
+            shard.capacity = newCapacity / SHARDS_COUNT + (i < newCapacity % SHARDS_COUNT ? 1 : 0);
+            trim(shard);
+        }
+    }
+
+    SignatureCache::Stats SignatureCache::stats() const {
+        Stats result{hits, misses, evictions, 0, capacity};
+        for (auto &shard: shards) {
+            std::lock_guard lock(shard.mutex);
+            result.size += shard.entries.size();
+        }
+        return result;
+    }
+
+    SignatureCache &SignatureCache::instance() {
+        static SignatureCache cache;
+        return cache;
+    }
+
+};
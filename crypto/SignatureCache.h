@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_SIGNATURECACHE_H
+#define U8_SIGNATURECACHE_H
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "cryptoCommon.h"
+
+namespace crypto {
+
+    /**
+     * Bounded LRU set of RSA-PSS signatures that were checked and found valid.
+     *
+     * Entry is a SHA-256 of everything verification depends on: the public key, hash and MGF1 types, salt length,
+     * signature and the message hash, so a hit means exactly the same check has passed before and modular
+     * exponentiation can be skipped. Invalid signatures are never stored. Entries are split into shards with
+     * their own mutexes and LRU lists, so threads verifying different signatures rarely wait for each other.
+     */
+    class SignatureCache {
+    public:
+        static const size_t DEFAULT_CAPACITY = 16384;
+
+        typedef std::array<unsigned char, 32> Key;
+
+        struct Stats {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t evictions;
+            size_t size;
+            size_t capacity;
+        };
+
+        /**
+         * @param capacity maximum number of entries, 0 disables the cache.
+         */
+        explicit SignatureCache(size_t capacity = DEFAULT_CAPACITY);
+
+        SignatureCache(const SignatureCache &) = delete;
+
+        SignatureCache &operator=(const SignatureCache &) = delete;
+
+        /**
+         * @param keyDigest SHA-256 of the public key components, see RsaKernel::keyDigest()
+         * @param hash message hash of the hashType size
+         */
+        static Key makeKey(const unsigned char *keyDigest, const void *sig, size_t sigSize, const unsigned char *hash,
+                           HashType hashType, HashType mgf1HashType, int saltLength);
+
+        /**
+         * Check that the signature is known to be valid, and if so, make it most recently used.
+         */
+        bool contains(const Key &key);
+
+        void insert(const Key &key);
+
+        void clear();
+
+        /**
+         * Change maximum number of entries, dropping least recently used ones if needed. 0 disables the cache.
+         */
+        void setCapacity(size_t capacity);
+
+        Stats stats() const;
+
+        /**
+         * The cache used by PublicKey::verify() and related methods.
+         */
+        static SignatureCache &instance();
+
+    private:
+        static const size_t SHARDS_COUNT = 16;
+
+        struct KeyHash {
+            size_t operator()(const Key &key) const {
+                // key is a digest already, so its bytes are as good as any hash of them
+                size_t h;
+                memcpy(&h, key.data(), sizeof(h));
+                return h;
+            }
+        };
+
+        struct Shard {
+            mutable std::mutex mutex;
+            std::list<Key> lru;
+            std::unordered_map<Key, std::list<Key>::iterator, KeyHash> entries;
+            size_t capacity = 0;
+        };
+
+        Shard &shardOf(const Key &key) {
+            return shards[key[sizeof(size_t)] % SHARDS_COUNT];
+        }
+
+        // drop least recently used entries over shard capacity; shard mutex must be locked
+        void trim(Shard &shard);
+
+        Shard shards[SHARDS_COUNT];
+        std::atomic<size_t> capacity;
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+    };
+
+};
+
+#endif //U8_SIGNATURECACHE_H
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include "Streebog.h"
+#include "gost3411-2012.h"
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+namespace crypto {
+
+    static const uint64_t ZERO[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+    static inline uint64_t load64(const unsigned char *p) {
+        uint64_t value;
+        memcpy(&value, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap64(value);
+#endif
+        return value;
+    }
+
+    static inline void store64(unsigned char *p, uint64_t value) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap64(value);
+#endif
+        memcpy(p, &value, 8);
+    }
+
+    static inline uint64_t lpsWord(const uint64_t *x, int shift) {
+        return gost3411_2012_Ax[0][(x[0] >> shift) & 0xFF] ^ gost3411_2012_Ax[1][(x[1] >> shift) & 0xFF] ^
+               gost3411_2012_Ax[2][(x[2] >> shift) & 0xFF] ^ gost3411_2012_Ax[3][(x[3] >> shift) & 0xFF] ^
+               gost3411_2012_Ax[4][(x[4] >> shift) & 0xFF] ^ gost3411_2012_Ax[5][(x[5] >> shift) & 0xFF] ^
+               gost3411_2012_Ax[6][(x[6] >> shift) & 0xFF] ^ gost3411_2012_Ax[7][(x[7] >> shift) & 0xFF];
+    }
+
+    // out = LPS(a ^ b); byte i of every input word goes through table Ax[word] into output word i
+    static inline void xlps(uint64_t *out, const uint64_t *a, const uint64_t *b) {
+        uint64_t x[8];
+        for (int i = 0; i < 8; ++i)
+            x[i] = a[i] ^ b[i];
+        for (int i = 0; i < 8; ++i)
+            out[i] = lpsWord(x, i * 8);
+    }
+
+    // compression function g_N(h, m) of RFC 6986, section 8
+    static inline void transform(uint64_t *h, const uint64_t *n, const uint64_t *m) {
+        uint64_t k[8], t[8];
+        xlps(k, h, n);
+        xlps(t, k, m);
+        for (int round = 0; round < GOST3411_2012_ROUNDS_COUNT - 1; ++round) {
+            xlps(k, k, gost3411_2012_C[round]);
+            xlps(t, t, k);
+        }
+        xlps(k, k, gost3411_2012_C[GOST3411_2012_ROUNDS_COUNT - 1]);
+        for (int i = 0; i < 8; ++i)
+            h[i] ^= t[i] ^ k[i] ^ m[i];
+    }
+
+    // a += b mod 2^512
+    static inline void addMod512(uint64_t *a, const uint64_t *b) {
+        uint64_t carry = 0;
+        for (int i = 0; i < 8; ++i) {
+            uint64_t sum = a[i] + b[i];
+            uint64_t total = sum + carry;
+            carry = (uint64_t) (sum < a[i]) | (uint64_t) (total < sum);
+            a[i] = total;
+        }
+    }
+
+    Streebog::Streebog(size_t digestBits) {
+        if (digestBits != 256 && digestBits != 512)
+            throw std::invalid_argument("Streebog: unsupported digest size " + std::to_string(digestBits));
+        digestBytes = digestBits / 8;
+        // initialization vector is 0x01 bytes for 256 bits, zero for 512
+        memset(hash, digestBits == 256 ? 0x01 : 0x00, sizeof(hash));
+        memset(counter, 0, sizeof(counter));
+        memset(sigma, 0, sizeof(sigma));
+        position = 0;
+    }
+
+    void Streebog::compress(const unsigned char *block, uint64_t bits) {
+        uint64_t m[8];
+        for (int i = 0; i < 8; ++i)
+            m[i] = load64(block + i * 8);
+        transform(hash, counter, m);
+        uint64_t length[8] = {bits, 0, 0, 0, 0, 0, 0, 0};
+        addMod512(counter, length);
+        addMod512(sigma, m);
+    }
+
+    void Streebog::update(const void *data, size_t size) {
+        auto src = (const unsigned char *) data;
+        if (position > 0) {
+            size_t part = std::min(size, BLOCK_SIZE - position);
+            memcpy(buffer + position, src, part);
+            position += part;
+            src += part;
+            size -= part;
+            if (position < BLOCK_SIZE)
+                return;
+            compress(buffer, BLOCK_SIZE * 8);
+            position = 0;
+        }
+        for (; size >= BLOCK_SIZE; src += BLOCK_SIZE, size -= BLOCK_SIZE)
+            compress(src, BLOCK_SIZE * 8);
+        memcpy(buffer, src, size);
+        position = size;
+    }
+
+    void Streebog::finish(unsigned char *out) {
+        // last block is always padded, even the empty one: 0x01, then zeros
+        memset(buffer + position, 0, BLOCK_SIZE - position);
+        buffer[position] = 0x01;
+        compress(buffer, position * 8);
+        transform(hash, ZERO, counter);
+        transform(hash, ZERO, sigma);
+        // Streebog-256 is the higher half of the state
+        unsigned char result[BLOCK_SIZE];
+        for (int i = 0; i < 8; ++i)
+            store64(result + i * 8, hash[i]);
+        memcpy(out, result + BLOCK_SIZE - digestBytes, digestBytes);
+    }
+
+    void Streebog::digest(size_t digestBits, const void *data, size_t size, unsigned char *out) {
+        Streebog streebog(digestBits);
+        streebog.update(data, size);
+        streebog.finish(out);
+    }
+
+};
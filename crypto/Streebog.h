@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_STREEBOG_H
+#define U8_STREEBOG_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace crypto {
+
+    /**
+     * Streebog-256/512 (GOST R 34.11-2012, RFC 6986), computed over a stream of data.
+     *
+     * Output is the same as of gost3411-2012.h. Each round does the combined S, P and L transforms with the
+     * precomputed 8x256 lookup tables of that implementation, keeping the 512-bit state in general purpose
+     * registers. The object is trivially copyable and has no destructor to call.
+     */
+    class Streebog {
+    public:
+        /**
+         * @param digestBits 256 or 512; throws std::invalid_argument otherwise.
+         */
+        explicit Streebog(size_t digestBits);
+
+        void update(const void *data, size_t size);
+
+        /**
+         * Write digestSize() bytes of digest to out. Object must not be updated after it.
+         */
+        void finish(unsigned char *out);
+
+        size_t digestSize() const {
+            return digestBytes;
+        }
+
+        static void digest(size_t digestBits, const void *data, size_t size, unsigned char *out);
+
+    private:
+        static const size_t BLOCK_SIZE = 64;
+
+        uint64_t hash[8];
+        uint64_t counter[8];
+        uint64_t sigma[8];
+        unsigned char buffer[BLOCK_SIZE];
+        size_t position;
+        size_t digestBytes;
+
+        // process one message block of the given bit length, updating hash, counter and sigma
+        void compress(const unsigned char *block, uint64_t bits);
+    };
+
+};
+
+#endif //U8_STREEBOG_H
@@ -4,12 +4,14 @@
 
 #include "SymmetricKey.h"
 #include "CTRTransformerAES.h"
+#include "HmacSha256.h"
 #include <tomcrypt.h>
-#include <queue>
+#include <algorithm>
 
 namespace crypto {
 
-    const static ltc_cipher_descriptor cipher_desc = aes_desc;
+    // EtA data is encrypted and authenticated by chunks which fit in L1 cache
+    static const size_t ETA_CHUNK_SIZE = 4096;
 
     SymmetricKey::SymmetricKey() {
         this->key.resize(32);
@@ -34,43 +36,42 @@ namespace crypto {
     }
 
     byte_vector SymmetricKey::etaDecrypt(void *data, size_t size) const {
-        byte_vector output;
+        if (size < ETA_OVERHEAD)
+            throw std::invalid_argument("input data size too small");
+        byte_vector output(size - ETA_OVERHEAD);
+        etaDecrypt(data, size, output.data());
+        return output;
+    }
 
-        if (size < cipher_desc.block_length + sha256_desc.hashsize)
+    size_t SymmetricKey::etaDecrypt(const void *data, size_t size, void *output) const {
+        if (size < ETA_OVERHEAD)
             throw std::invalid_argument("input data size too small");
 
-        byte_vector iv(cipher_desc.block_length);
-        memcpy(&iv[0], data, iv.size());
-        CTRTransformerAES transformerAES(key, iv);
-
-        hmac_state hs;
-        hmac_init(&hs, find_hash(sha256_desc.name), &key[0], key.size());
-
-        std::deque<unsigned char> ring;
-        for (int i = iv.size(); i < iv.size() + sha256_desc.hashsize; ++i)
-            ring.push_back(((unsigned char *) data)[i]);
-
-        int readIndex = iv.size() + sha256_desc.hashsize;
-        int bytesLeft = size - readIndex;
-        while (bytesLeft > 0) {
-            unsigned char nextByte = ((unsigned char *) data)[readIndex++];
-            --bytesLeft;
-            ring.push_back(nextByte);
-            unsigned char encrypted = ring.front();
-            ring.pop_front();
-            hmac_process(&hs, &encrypted, 1);
-            output.push_back(transformerAES.transformByte(encrypted));
+        auto src = (const unsigned char *) data;
+        auto dst = (unsigned char *) output;
+        size_t dataSize = size - ETA_OVERHEAD;
+
+        CTRTransformerAES transformerAES(key, byte_vector(src, src + ETA_IV_SIZE));
+        HmacSha256 hmac(&key[0], key.size());
+
+        // authenticate each chunk before decrypting it, while it is in cache and before it is overwritten in place
+        src += ETA_IV_SIZE;
+        for (size_t offset = 0; offset < dataSize; offset += ETA_CHUNK_SIZE) {
+            size_t chunkSize = std::min(ETA_CHUNK_SIZE, dataSize - offset);
+            hmac.update(src + offset, chunkSize);
+            transformerAES.transform(src + offset, dst + offset, chunkSize);
         }
 
-        unsigned long hmacOutLen = sha256_desc.hashsize;
-        if (ring.size() != hmacOutLen)
-            throw std::invalid_argument("data corrupted: bad hmac record size");
-        byte_vector hmacOut(hmacOutLen);
-        hmac_done(&hs, &hmacOut[0], &hmacOutLen);
-        if (hmacOut != byte_vector(ring.begin(), ring.end()))
+        unsigned char hmacOut[HmacSha256::DIGEST_SIZE];
+        hmac.finish(hmacOut);
+        const unsigned char *hmacIn = src + dataSize;
+        unsigned char diff = 0;
+        for (size_t i = 0; i < ETA_HMAC_SIZE; ++i)
+            diff |= hmacOut[i] ^ hmacIn[i];
+        if (diff != 0)
             throw std::invalid_argument("HMAC authentication failed, data corrupted");
 
-        return output;
+        return dataSize;
     }
 
     byte_vector SymmetricKey::etaEncrypt(const byte_vector &data) const {
@@ -78,52 +79,48 @@ namespace crypto {
     }
 
     byte_vector SymmetricKey::etaEncrypt(void *data, size_t size) const {
-        byte_vector output;
+        byte_vector output(size + ETA_OVERHEAD);
+        etaEncrypt(data, size, output.data());
+        return output;
+    }
 
-        hmac_state hs;
-        hmac_init(&hs, find_hash(sha256_desc.name), &key[0], key.size());
+    void SymmetricKey::etaEncrypt(const void *data, size_t size, void *output) const {
+        auto src = (const unsigned char *) data;
+        auto dst = (unsigned char *) output;
 
         CTRTransformerAES transformerAES(key);
-        auto iv = transformerAES.getIV();
-        output.insert(output.end(), iv.begin(), iv.end());
+        HmacSha256 hmac(&key[0], key.size());
 
-        for (int i = 0; i < size; ++i) {
-            unsigned char encrypted = transformerAES.transformByte(((unsigned char *) data)[i]);
-            hmac_process(&hs, &encrypted, 1);
-            output.push_back(encrypted);
+        auto iv = transformerAES.getIV();
+        memcpy(dst, &iv[0], ETA_IV_SIZE);
+        dst += ETA_IV_SIZE;
+
+        // authenticate each chunk right after encrypting it, while it is in cache
+        for (size_t offset = 0; offset < size; offset += ETA_CHUNK_SIZE) {
+            size_t chunkSize = std::min(ETA_CHUNK_SIZE, size - offset);
+            transformerAES.transform(src + offset, dst + offset, chunkSize);
+            hmac.update(dst + offset, chunkSize);
         }
 
-        unsigned long hmacOutLen = sha256_desc.hashsize;
-        byte_vector hmacOut(hmacOutLen);
-        hmac_done(&hs, &hmacOut[0], &hmacOutLen);
-        output.insert(output.end(), hmacOut.begin(), hmacOut.end());
-
-        return output;
+        hmac.finish(dst + size);
     }
 
     byte_vector SymmetricKey::encrypt(const byte_vector &data) const {
         CTRTransformerAES transformerAES(key);
-        byte_vector result;
+        byte_vector result(aes_desc.block_length + data.size());
         byte_vector IV = transformerAES.getIV();
-        result.insert(result.end(), IV.begin(), IV.end());
-        for (int i = 0; i < data.size(); ++i)
-            result.push_back(transformerAES.transformByte(data[i]));
+        memcpy(&result[0], &IV[0], IV.size());
+        transformerAES.transform(data.data(), &result[IV.size()], data.size());
         return result;
     }
 
     byte_vector SymmetricKey::decrypt(const byte_vector &data) const {
         if (data.size() < aes_desc.block_length)
             throw std::invalid_argument("SymmetricKey::decrypt error: input data too small");
-        byte_vector result;
-        byte_vector IV(aes_desc.block_length);
-        memcpy(&IV[0], &data[0], aes_desc.block_length);
+        byte_vector IV(data.begin(), data.begin() + aes_desc.block_length);
         CTRTransformerAES transformerAES(key, IV);
-        int size = data.size() - aes_desc.block_length;
-        for (int i = 0; i < size; ++i) {
-            unsigned char encrypted = data[aes_desc.block_length + i];
-            unsigned char decrypted = (i >= 0) ? transformerAES.transformByte(encrypted) : -1;
-            result.push_back(decrypted);
-        }
+        byte_vector result(data.size() - aes_desc.block_length);
+        transformerAES.transform(&data[aes_desc.block_length], result.data(), result.size());
         return result;
     }
 
@@ -15,6 +15,13 @@ namespace crypto {
 
     public:
 
+        /**
+         * EtA data is IV, encrypted data and HMAC of it.
+         */
+        static const size_t ETA_IV_SIZE = 16;
+        static const size_t ETA_HMAC_SIZE = 32;
+        static const size_t ETA_OVERHEAD = ETA_IV_SIZE + ETA_HMAC_SIZE;
+
         /**
          * Create random symmetric key (AES256, CTR)
          */
@@ -41,7 +48,7 @@ namespace crypto {
         byte_vector pack();
 
         /**
-         * Encrypt data using AE (EtA) with HMAC based on SHA256
+         * Decrypt data using AE (EtA) with SHA256-based HMAC
          */
         byte_vector etaDecrypt(const byte_vector &data) const;
 
@@ -51,7 +58,14 @@ namespace crypto {
         byte_vector etaDecrypt(void *data, size_t size) const;
 
         /**
-         * Decrypt data using AE (EtA) with SHA256-based HMAC
+         * Decrypt size bytes of EtA data to output, which must have room for size - ETA_OVERHEAD bytes.
+         * Output may point to the data itself or to the data past its IV to decrypt in place; its contents are
+         * undefined if the HMAC check fails. Returns the size of decrypted data.
+         */
+        size_t etaDecrypt(const void *data, size_t size, void *output) const;
+
+        /**
+         * Encrypt data using AE (EtA) with HMAC based on SHA256
          */
         byte_vector etaEncrypt(const byte_vector &data) const;
 
@@ -60,6 +74,12 @@ namespace crypto {
          */
         byte_vector etaEncrypt(void *data, size_t size) const;
 
+        /**
+         * Encrypt size bytes of data using EtA to output, which must have room for size + ETA_OVERHEAD bytes.
+         * To encrypt in place, data should be placed in the output buffer after ETA_IV_SIZE bytes for the IV.
+         */
+        void etaEncrypt(const void *data, size_t size, void *output) const;
+
         /**
          * Encrypt data using AES256 CTR
          */
@@ -2,16 +2,47 @@
  * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
  */
 
+#include <new>
 #include "cryptoCommon.h"
 #include "cryptoCommonPrivate.h"
 #include "PrivateKey.h"
 #include "PublicKey.h"
+#include "Sha3.h"
+#include "ChaChaRandom.h"
 #include "../tools/tools.h"
 
 namespace crypto {
 
     static int hashIndexes[6];
 
+    // SHA3 descriptors are libtomcrypt ones with Sha3 placed in hash_state, so every user of the descriptors
+    // (Digest, RSA signatures, HMAC) gets the faster implementation
+    static_assert(sizeof(Sha3) <= sizeof(hash_state), "Sha3 must fit in hash_state");
+
+    template<size_t BITS>
+    static int sha3Init(hash_state *md) {
+        new(md) Sha3(BITS);
+        return CRYPT_OK;
+    }
+
+    static int sha3Process(hash_state *md, const unsigned char *in, unsigned long inlen) {
+        reinterpret_cast<Sha3 *>(md)->update(in, inlen);
+        return CRYPT_OK;
+    }
+
+    static int sha3Done(hash_state *md, unsigned char *out) {
+        reinterpret_cast<Sha3 *>(md)->finish(out);
+        return CRYPT_OK;
+    }
+
+    static ltc_hash_descriptor sha3Descriptor(const ltc_hash_descriptor &base, int (*init)(hash_state *)) {
+        ltc_hash_descriptor desc = base;
+        desc.init = init;
+        desc.process = sha3Process;
+        desc.done = sha3Done;
+        return desc;
+    }
+
     void initCrypto() {
         ltc_mp = gmp_desc;
 
@@ -24,11 +55,14 @@ namespace crypto {
             throw std::runtime_error("Error registering sha256");
         if (register_hash(&sha512_desc) == -1)
             throw std::runtime_error("Error registering sha512");
-        if (register_hash(&sha3_256_desc) == -1)
+        static const ltc_hash_descriptor sha3_256 = sha3Descriptor(sha3_256_desc, sha3Init<256>);
+        static const ltc_hash_descriptor sha3_384 = sha3Descriptor(sha3_384_desc, sha3Init<384>);
+        static const ltc_hash_descriptor sha3_512 = sha3Descriptor(sha3_512_desc, sha3Init<512>);
+        if (register_hash(&sha3_256) == -1)
             throw std::runtime_error("Error registering sha3_256");
-        if (register_hash(&sha3_384_desc) == -1)
+        if (register_hash(&sha3_384) == -1)
             throw std::runtime_error("Error registering sha3_384");
-        if (register_hash(&sha3_512_desc) == -1)
+        if (register_hash(&sha3_512) == -1)
             throw std::runtime_error("Error registering sha3_512");
 
         if (register_cipher(&aes_desc) == -1)
@@ -143,15 +177,27 @@ namespace crypto {
         if (sz > sizeof(buf))
             throw std::runtime_error(std::string("rsa_export error: output buffer too small"));
         rsa_import(buf, sz, &key);
+        kernel_ = std::atomic_load(&copyFrom.kernel_);
     }
 
     RsaKeyWrapper::~RsaKeyWrapper() {
         rsa_free(&key);
     }
 
+    const RsaKernel &RsaKeyWrapper::kernel() const {
+        auto current = std::atomic_load(&kernel_);
+        if (!current) {
+            std::shared_ptr<const RsaKernel> created = std::make_shared<RsaKernel>(key);
+            // if another thread was first, current gets its kernel
+            if (std::atomic_compare_exchange_strong(&kernel_, &current, created))
+                current = created;
+        }
+        return *current;
+    }
+
     byte_vector generateSecurePseudoRandomBytes(int length) {
         byte_vector res((size_t)length);
-        sprng_read(&res[0], (size_t)length, nullptr);
+        randomBytes(&res[0], (size_t)length);
         return res;
     }
 
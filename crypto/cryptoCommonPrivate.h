@@ -5,7 +5,9 @@
 #ifndef U8_CRYPTOCOMMONPRIVATE_H
 #define U8_CRYPTOCOMMONPRIVATE_H
 
+#include <memory>
 #include "cryptoCommon.h"
+#include "RsaKernel.h"
 
 namespace crypto {
 
@@ -26,6 +28,15 @@ namespace crypto {
         RsaKeyWrapper(const RsaKeyWrapper &copyFrom);
 
         ~RsaKeyWrapper();
+
+        /**
+         * Kernel with cached values of the key, created on the first use and shared by copies of the wrapper.
+         * The key must not be changed after it.
+         */
+        const RsaKernel &kernel() const;
+
+    private:
+        mutable std::shared_ptr<const RsaKernel> kernel_;
     };
 
 };
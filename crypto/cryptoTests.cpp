@@ -10,6 +10,9 @@
 #include <random>
 #include <atomic>
 #include <queue>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "base64.h"
 #include "PrivateKey.h"
 #include "PublicKey.h"
@@ -17,8 +20,21 @@
 #include "KeyAddress.h"
 #include "Safe58.h"
 #include "../tools/AutoThreadPool.h"
+#include "../tools/latch.h"
 #include "SymmetricKey.h"
+#include "CTRTransformerAES.h"
+#include "HmacSha256.h"
+#include "PBKDF2.h"
+#include "ChaChaRandom.h"
+#include "RsaKernel.h"
+#include "Sha3.h"
+#include "Streebog.h"
+#include "SignatureCache.h"
+#include "gost3411-2012.h"
+#include "cryptoCommonPrivate.h"
+#include "no_prng.h"
 #include "../AsyncIO/IOUDP.h"
+#include "../AsyncIO/IOFile.h"
 
 using namespace std;
 using namespace crypto;
@@ -183,6 +199,60 @@ void testHashId() {
     auto h = HashId::of(str64Tovector("dcwrTA=="));
     checkResult("", base64_encode(h.getDigest()), h.toBase64());
 
+    // above CONCURRENT_THRESHOLD digests are computed in parallel
+    byte_vector big(100000);
+    for (size_t i = 0; i < big.size(); ++i)
+        big[i] = (unsigned char) (i % 251);
+    string bigHashId = "buFWA1DnwYAqKE0FvT36IptPKR/iU/HpsD2Hd8RBb7m3Ud9ilCvITbn2pcLe94VYFiwoV9WxJtei5WoKNXzfYv68vOi92C7C91b9B0HAE7jFBZrfDnb8k8OrsZkwzhbr";
+    checkResult("hashId concurrent", bigHashId, HashId::of(big).toBase64());
+
+    auto small1 = str64Tovector("HQ==");
+    auto small2 = str64Tovector("zsYO");
+    auto many = HashId::ofMany({{small1.data(), small1.size()}, {big.data(), big.size()}, {small2.data(), small2.size()}});
+    checkResult("ofMany size", (size_t) 3, many.size());
+    checkResult<string>("ofMany 0", "abQChMlTZ6nrby9UTNfr91MdjKjr4H5VtywvWq/K+o1mIeoJ/cNLYuoOVBtLW0eBd5OC0e7fQlMZsMcKbzBJ97uwQ7QI+jY26Jd19G4byd3ve06VY2y+t3wHj2y1hmjp", many[0].toBase64());
+    checkResult("ofMany 1", bigHashId, many[1].toBase64());
+    checkResult<string>("ofMany 2", "Yk8V6UNw4Fx42ctTjI6O2bquKqhO/C2nOoHQBGtfk9J+2zp/p34hcyhjIF419QhpA5UNw3+e7Lp/8sHEar41gt+KQ1Da8gStNs8WaN9wsBPgJwys3UQCSvPUCeYaPEZy", many[2].toBase64());
+    checkResult("ofMany empty", (size_t) 0, HashId::ofMany({}).size());
+
+    // builder gives the same in pieces, small ones and above CONCURRENT_THRESHOLD
+    HashId::Builder builder;
+    for (size_t pos = 0, piece = 1; pos < big.size(); pos += piece, piece = piece * 7 + 1)
+        builder.update(&big[pos], std::min(piece, big.size() - pos));
+    checkResult("builder", bigHashId, builder.finish().toBase64());
+    bool finishedTwice = false;
+    try {
+        builder.finish();
+    } catch (const std::runtime_error&) {
+        finishedTwice = true;
+    }
+    checkResult("builder finish twice", true, finishedTwice);
+
+    string fileName = "/tmp/u8_testHashId.bin";
+    FILE* f = fopen(fileName.data(), "wb");
+    fwrite(big.data(), 1, big.size(), f);
+    fclose(f);
+    for (size_t chunkSize: {(size_t) 4096, (size_t) 65536, HashId::FILE_CHUNK_SIZE}) {
+        Latch<int> latch(1);
+        string fileHashId;
+        asyncio::IOFile::openRead(fileName.data(), [&](std::shared_ptr<asyncio::IOFile> file, ssize_t result) {
+            if (result < 0) {
+                latch.countDown();
+                return;
+            }
+            HashId::ofFile(*file, [&, file](std::shared_ptr<HashId> hashId, ssize_t result) {
+                if (hashId)
+                    fileHashId = hashId->toBase64();
+                file->close([&, file](ssize_t result) {
+                    latch.countDown();
+                });
+            }, chunkSize);
+        });
+        latch.wait();
+        checkResult("ofFile " + to_string(chunkSize), bigHashId, fileHashId);
+    }
+    remove(fileName.data());
+
     cout << "testHashId()... done!" << endl << endl;
 }
 
@@ -420,6 +490,140 @@ void testAllHashTypes() {
     cout << "testAllHashTypes()... done!" << endl << endl;
 }
 
+void testSha3() {
+    cout << "testSha3()..." << endl;
+
+    // libtomcrypt sha3 directly, as it was used before
+    auto reference = [](size_t bits, const byte_vector& data) {
+        hash_state md;
+        if (bits == 256)
+            sha3_256_init(&md);
+        else if (bits == 384)
+            sha3_384_init(&md);
+        else
+            sha3_512_init(&md);
+        sha3_process(&md, data.data(), data.size());
+        byte_vector out(bits / 8);
+        sha3_done(&md, &out[0]);
+        return out;
+    };
+
+    byte_vector empty;
+    byte_vector out(32);
+    Sha3::digest(256, empty.data(), 0, &out[0]);
+    checkResult<string>("sha3_256 empty", "p//G+L8e12ZRwUdWoGHWYvWA/03kO0n6gtgKS4D4Q0o=", base64_encode(out));
+
+    std::minstd_rand rng(1);
+    for (size_t bits: {256, 384, 512}) {
+        int errors = 0;
+        vector<byte_vector> inputs;
+        for (size_t size = 0; size < 600; size += 1 + size / 16) {
+            byte_vector data(size);
+            for (auto& b: data)
+                b = (unsigned char) rng();
+            inputs.push_back(data);
+
+            byte_vector expected = reference(bits, data);
+            byte_vector result(bits / 8);
+            Sha3::digest(bits, data.data(), data.size(), &result[0]);
+            errors += result != expected;
+
+            // same data in random pieces
+            Sha3 sha3(bits);
+            for (size_t pos = 0; pos < size;) {
+                size_t piece = std::min(size - pos, (size_t) rng() % 100);
+                sha3.update(&data[pos], piece);
+                pos += piece;
+            }
+            sha3.finish(&result[0]);
+            errors += result != expected;
+        }
+        checkResult("sha3 " + to_string(bits) + " single", 0, errors);
+
+        // multi-lane kernels take 8 and 4 inputs, rest goes one by one
+        vector<const void*> data;
+        vector<size_t> sizes;
+        vector<byte_vector> results(inputs.size(), byte_vector(bits / 8));
+        vector<unsigned char*> outputs;
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            data.push_back(inputs[i].data());
+            sizes.push_back(inputs[i].size());
+            outputs.push_back(&results[i][0]);
+        }
+        Sha3::digestMany(bits, inputs.size(), data.data(), sizes.data(), outputs.data());
+        errors = 0;
+        for (size_t i = 0; i < inputs.size(); ++i)
+            errors += results[i] != reference(bits, inputs[i]);
+        checkResult("sha3 " + to_string(bits) + " many", 0, errors);
+    }
+
+    cout << "testSha3()... done!" << endl << endl;
+}
+
+void testStreebog() {
+    cout << "testStreebog()..." << endl;
+
+    auto hex = [](const unsigned char* digest, size_t size) {
+        char str[GOST3411_2012_HASH_STR_MAX_SIZE + 1];
+        gost3411_2012_cvt_hex(digest, size, (uint8_t*) str);
+        return string(str);
+    };
+
+    // RFC 6986 examples M1 and M2
+    string m1 = "012345678901234567890123456789012345678901234567890123456789012";
+    byte_vector m2 = {
+            0xd1, 0xe5, 0x20, 0xe2, 0xe5, 0xf2, 0xf0, 0xe8, 0x2c, 0x20, 0xd1, 0xf2, 0xf0, 0xe8, 0xe1, 0xee,
+            0xe6, 0xe8, 0x20, 0xe2, 0xed, 0xf3, 0xf6, 0xe8, 0x2c, 0x20, 0xe2, 0xe5, 0xfe, 0xf2, 0xfa, 0x20,
+            0xf1, 0x20, 0xec, 0xee, 0xf0, 0xff, 0x20, 0xf1, 0xf2, 0xf0, 0xe5, 0xeb, 0xe0, 0xec, 0xe8, 0x20,
+            0xed, 0xe0, 0x20, 0xf5, 0xf0, 0xe0, 0xe1, 0xf0, 0xfb, 0xff, 0x20, 0xef, 0xeb, 0xfa, 0xea, 0xfb,
+            0x20, 0xc8, 0xe3, 0xee, 0xf0, 0xe5, 0xe2, 0xfb
+    };
+    unsigned char out[64];
+    Streebog::digest(256, "", 0, out);
+    checkResult<string>("streebog 256 empty", "3f539a213e97c802cc229d474c6aa32a825a360b2a933a949fd925208d9ce1bb", hex(out, 32));
+    Streebog::digest(256, m1.data(), m1.size(), out);
+    checkResult<string>("streebog 256 m1", "9d151eefd8590b89daa6ba6cb74af9275dd051026bb149a452fd84e5e57b5500", hex(out, 32));
+    Streebog::digest(512, m1.data(), m1.size(), out);
+    checkResult<string>("streebog 512 m1", "1b54d01a4af5b9d5cc3d86d68d285462b19abc2475222f35c085122be4ba1ffa"
+                                           "00ad30f8767b3a82384c6574f024c311e2a481332b08ef7f41797891c1646f48", hex(out, 64));
+    Streebog::digest(256, m2.data(), m2.size(), out);
+    checkResult<string>("streebog 256 m2", "9dd2fe4e90409e5da87f53976d7405b0c0cac628fc669a741d50063c557e8f50", hex(out, 32));
+    Streebog::digest(512, m2.data(), m2.size(), out);
+    checkResult<string>("streebog 512 m2", "1e88e62226bfca6f9994f1f2d51569e0daf8475a3b0fe61a5300eee46d961376"
+                                           "035fe83549ada2b8620fcd7c496ce5b33f0cb9dddc2b6460143b03dabac9fb28", hex(out, 64));
+
+    // compare with gost3411-2012.h, as it was used before
+    std::minstd_rand rng(1);
+    for (size_t bits: {256, 512}) {
+        int errors = 0;
+        for (size_t size = 0; size < 600; size += 1 + size / 16) {
+            byte_vector data(size);
+            for (auto& b: data)
+                b = (unsigned char) rng();
+
+            byte_vector expected(bits / 8);
+            size_t len = 0;
+            gost3411_2012_get_digest(bits, data.data(), data.size(), &expected[0], &len);
+            byte_vector result(bits / 8);
+            Streebog::digest(bits, data.data(), data.size(), &result[0]);
+            errors += result != expected;
+
+            // same data in random pieces
+            Streebog streebog(bits);
+            for (size_t pos = 0; pos < size;) {
+                size_t piece = std::min(size - pos, (size_t) rng() % 100);
+                streebog.update(&data[pos], piece);
+                pos += piece;
+            }
+            streebog.finish(&result[0]);
+            errors += result != expected;
+        }
+        checkResult("streebog " + to_string(bits), 0, errors);
+    }
+
+    cout << "testStreebog()... done!" << endl << endl;
+}
+
 void testKeysConcurrency() {
     cout << "testKeysConcurrency()..." << endl;
 
@@ -460,6 +664,307 @@ void testKeysConcurrency() {
     cout << "testKeysConcurrency()... done!" << endl << endl;
 }
 
+void testVerifyBatch() {
+    cout << "testVerifyBatch()..." << endl;
+
+    PrivateKey privateKey(2048);
+    PublicKey publicKey(privateKey);
+    PublicKey otherKey(PrivateKey(2048));
+
+    vector<byte_vector> bodies, sigs;
+    vector<PublicKey::SignatureToVerify> toVerify;
+    vector<bool> expected;
+    for (int i = 0; i < 50; ++i) {
+        bodies.push_back(base64_decodeToBytes("cXdlcnR5MTIzNDU2"));
+        bodies.back().push_back((unsigned char) i);
+        sigs.push_back(privateKey.sign(bodies.back(), i % 2 ? SHA3_256 : SHA512));
+    }
+    for (int i = 0; i < 50; ++i) {
+        bool valid = i % 7 != 3;
+        toVerify.push_back({valid ? &publicKey : &otherKey, sigs[i].data(), sigs[i].size(),
+                            bodies[i].data(), bodies[i].size(), i % 2 ? SHA3_256 : SHA512});
+        expected.push_back(valid);
+    }
+    checkResult("verifyBatch", expected, PublicKey::verifyBatch(toVerify));
+    checkResult("verifyBatch empty", (size_t) 0, PublicKey::verifyBatch({}).size());
+
+    // nested call from a task of the same pool must not lock up
+    std::atomic<bool> nestedResult(false);
+    Latch<int> done(1);
+    runAsync([&]() {
+        auto results = PublicKey::verifyBatch(toVerify);
+        nestedResult = results == expected;
+        done.countDown();
+    });
+    done.wait();
+    checkResult("verifyBatch from the pool", true, (bool) nestedResult);
+
+    cout << "testVerifyBatch()... done!" << endl << endl;
+}
+
+void testSignatureCache() {
+    cout << "testSignatureCache()..." << endl;
+
+    // entries are digests, so are test keys: pseudo random bytes
+    auto keyOf = [](int i) {
+        std::mt19937 generator((unsigned) i);
+        SignatureCache::Key key;
+        for (auto &b: key)
+            b = (unsigned char) generator();
+        return key;
+    };
+    SignatureCache cache(SignatureCache::DEFAULT_CAPACITY);
+    cache.insert(keyOf(0));
+    checkResult("contains", true, cache.contains(keyOf(0)));
+    checkResult("not contains", false, cache.contains(keyOf(1)));
+    checkResult("hits", (uint64_t) 1, cache.stats().hits);
+    checkResult("misses", (uint64_t) 1, cache.stats().misses);
+
+    for (int i = 0; i < 100; ++i)
+        cache.insert(keyOf(i));
+    checkResult("size", (size_t) 100, cache.stats().size);
+    cache.setCapacity(50);
+    checkResult("size after shrink", true, cache.stats().size <= 50);
+    checkResult("evictions", (uint64_t) (100 - cache.stats().size), cache.stats().evictions);
+
+    // least recently used entries go first, the one just checked stays. Capacity is spread over 16 shards,
+    // so with 32 each shard keeps 2 entries; keys with the same byte after the first size_t share a shard
+    auto sameShard = [&](int i) {
+        auto key = keyOf(i);
+        key[sizeof(size_t)] = 0;
+        return key;
+    };
+    cache.clear();
+    cache.setCapacity(32);
+    cache.insert(sameShard(1));
+    cache.insert(sameShard(2));
+    checkResult("lru contains", true, cache.contains(sameShard(1)));
+    cache.insert(sameShard(3));
+    checkResult("lru recent stays", true, cache.contains(sameShard(1)));
+    checkResult("lru oldest evicted", false, cache.contains(sameShard(2)));
+    checkResult("lru newest", true, cache.contains(sameShard(3)));
+
+    cache.setCapacity(0);
+    checkResult("disabled", false, cache.contains(sameShard(3)));
+    checkResult("disabled size", (size_t) 0, cache.stats().size);
+    cache.insert(keyOf(1));
+    checkResult("disabled insert", (size_t) 0, cache.stats().size);
+
+    // key identity: any parameter of the check changes the entry
+    PrivateKey privateKey(2048);
+    PublicKey publicKey(privateKey);
+    PublicKey otherKey(PrivateKey(2048));
+    rsa_key rsaKey;
+    checkResult("rsa_make_key", CRYPT_OK, rsa_make_key(NULL, find_prng("sprng"), 2048 / 8, 65537, &rsaKey));
+    RsaKernel kernel(rsaKey);
+    auto fingerprint = PublicKey((mpz_ptr) rsaKey.N, (mpz_ptr) rsaKey.e).fingerprint();
+    checkResult("keyDigest is fingerprint", byte_vector(fingerprint.begin() + 1, fingerprint.end()),
+                byte_vector(kernel.keyDigest(), kernel.keyDigest() + 32));
+    rsa_free(&rsaKey);
+
+    auto publicFingerprint = publicKey.fingerprint();
+    auto keyDigest = publicFingerprint.data() + 1;
+    byte_vector body = base64_decodeToBytes("cXdlcnR5MTIzNDU2");
+    byte_vector sig = privateKey.sign(body, SHA3_256);
+    byte_vector hash = Digest(SHA3_256, body).getDigest();
+    auto key = SignatureCache::makeKey(keyDigest, sig.data(), sig.size(), hash.data(), SHA3_256, SHA1, -1);
+    checkResult("makeKey other mgf1", false,
+                key == SignatureCache::makeKey(keyDigest, sig.data(), sig.size(), hash.data(), SHA3_256, SHA256, -1));
+    checkResult("makeKey other salt", false,
+                key == SignatureCache::makeKey(keyDigest, sig.data(), sig.size(), hash.data(), SHA3_256, SHA1, 20));
+    checkResult("makeKey other key", false,
+                key == SignatureCache::makeKey(otherKey.fingerprint().data() + 1, sig.data(), sig.size(), hash.data(), SHA3_256, SHA1, -1));
+
+    // verify() remembers valid signatures only
+    auto &shared = SignatureCache::instance();
+    shared.clear();
+    auto before = shared.stats();
+    checkResult("verify", true, publicKey.verify(sig, body, SHA3_256));
+    checkResult("verify again", true, publicKey.verify(sig, body, SHA3_256));
+    checkResult("verify hit", before.hits + 1, shared.stats().hits);
+    checkResult("verify other key", false, otherKey.verify(sig, body, SHA3_256));
+    byte_vector badBody = body;
+    badBody[0] ^= 1;
+    checkResult("verify bad data", false, publicKey.verify(sig, badBody, SHA3_256));
+    checkResult("verify bad data again", false, publicKey.verify(sig, badBody, SHA3_256));
+    checkResult("cached valid only", (size_t) 1, shared.stats().size);
+
+    cout << "testSignatureCache()... done!" << endl << endl;
+}
+
+// straightforward PBKDF2 with libtomcrypt hmac, re-keyed on every iteration
+static byte_vector pbkdf2Reference(HashType hashType, const string &password, const byte_vector &salt, int c, int dkLen) {
+    size_t hLen = getHashDescriptor(hashType).hashsize;
+    byte_vector result;
+    for (uint32_t i = 1; result.size() < (size_t) dkLen; ++i) {
+        byte_vector message = salt;
+        for (int shift = 24; shift >= 0; shift -= 8)
+            message.push_back((unsigned char) (i >> shift));
+        byte_vector u(hLen), block;
+        unsigned long size = hLen;
+        hmac_memory(getHashIndex(hashType), (const unsigned char *) password.data(), password.size(),
+                    message.data(), message.size(), u.data(), &size);
+        block = u;
+        for (int k = 1; k < c; ++k) {
+            byte_vector next(hLen);
+            size = hLen;
+            hmac_memory(getHashIndex(hashType), (const unsigned char *) password.data(), password.size(),
+                        u.data(), u.size(), next.data(), &size);
+            for (size_t j = 0; j < hLen; ++j)
+                block[j] ^= next[j];
+            u = next;
+        }
+        result.insert(result.end(), block.begin(), block.end());
+    }
+    result.resize((size_t) dkLen);
+    return result;
+}
+
+void testPBKDF2() {
+    cout << "testPBKDF2()..." << endl;
+
+    // RFC 6070 and RFC 7914, section 11
+    checkResult("pbkdf2 sha1", string("SwB5AbdlSJq+rUnZJvch0GWkKcE="),
+                base64_encode(PBKDF2::derive(SHA1, "password", base64_decodeToBytes("c2FsdA=="), 4096, 20)));
+    checkResult("pbkdf2 sha1 long", string("PS7sT+QchJuAyNg2YsDkSospGpZM8vBwOA=="),
+                base64_encode(PBKDF2::derive(SHA1, "passwordPASSWORDpassword",
+                                             base64_decodeToBytes("c2FsdFNBTFRzYWx0U0FMVHNhbHRTQUxUc2FsdFNBTFRzYWx0"),
+                                             4096, 25)));
+    checkResult("pbkdf2 sha256", string("VawEblbjCJ/sFpHCJUS2BflBhSFt3gRl5oudV8INrLxJypzM8Xm2RZkWZLOdd+8xfHG4RbHjC9UJESBB06GXgw=="),
+                base64_encode(PBKDF2::derive(SHA256, "passwd", base64_decodeToBytes("c2FsdA=="), 1, 64)));
+    checkResult("pbkdf2 sha256 80000", string("TdzY9guYviGDDO5e8icB+WQaRBjQTAQUrv8Ih2s0q1ah1CWhIlgzVJrbhBtRybMXaicr3ruh0HhHj2Kzl/M8jQ=="),
+                base64_encode(PBKDF2::derive(SHA256, "Password", base64_decodeToBytes("TmFDbA=="), 80000, 64)));
+
+    // other hashes, passwords longer than hash block and output of several blocks
+    byte_vector salt = base64_decodeToBytes("cXdlcnR5MTIzNDU2");
+    for (HashType hashType: {SHA1, SHA256, SHA512, SHA3_256, SHA3_384, SHA3_512}) {
+        for (const string &password: {string(""), string("password"), string(300, 'x')}) {
+            checkResult("pbkdf2 " + string(getJavaHashName(hashType)) + " password " + to_string(password.size()),
+                        pbkdf2Reference(hashType, password, salt, 50, 150),
+                        PBKDF2::derive(hashType, password, salt, 50, 150));
+        }
+    }
+
+    cout << "testPBKDF2()... done!" << endl << endl;
+}
+
+void testChaChaRandom() {
+    cout << "testChaChaRandom()..." << endl;
+
+    // RFC 8439, section 2.3.2
+    uint32_t key[8], nonce[3] = {0x09000000, 0x4a000000, 0};
+    for (uint32_t i = 0; i < 8; ++i)
+        key[i] = (4 * i) | ((4 * i + 1) << 8) | ((4 * i + 2) << 16) | ((4 * i + 3) << 24);
+    byte_vector block(64);
+    ChaChaRandom::block(key, 1, nonce, block.data());
+    checkResult("chacha20 block", string("EPHn5NE7WRVQD90foyBxxMfR9MczwGgDBCKqmsPUbE7SgmRGB5+qCRTC1wXZiwKitRKc0d4WTrnL0IPoolA8Tg=="),
+                base64_encode(block));
+
+    // output doesn't depend on how it is requested
+    unsigned char seed[ChaChaRandom::SEED_SIZE] = {0};
+    ChaChaRandom whole(seed), parts(seed);
+    byte_vector x(5000), y(5000);
+    whole.generate(x.data(), x.size());
+    for (size_t offset = 0, size = 1; offset < y.size(); offset += size, size = size * 3 + 1)
+        parts.generate(&y[offset], std::min(size, y.size() - offset));
+    checkResult("chacha random in parts", x, y);
+
+    byte_vector a(32), b(32), fromThread(32), fromChild(32);
+    randomBytes(a.data(), a.size());
+    randomBytes(b.data(), b.size());
+    checkResult("randomBytes differ", false, a == b);
+    std::thread([&]() { randomBytes(fromThread.data(), fromThread.size()); }).join();
+    randomBytes(b.data(), b.size());
+    checkResult("randomBytes thread differs", false, fromThread == b);
+
+    // child must not repeat the parent's next bytes
+    int fds[2];
+    checkResult("pipe", 0, pipe(fds));
+    pid_t pid = fork();
+    if (pid == 0) {
+        randomBytes(fromChild.data(), fromChild.size());
+        ssize_t unused = write(fds[1], fromChild.data(), fromChild.size());
+        _exit(0);
+    }
+    randomBytes(b.data(), b.size());
+    checkResult("read from child", (ssize_t) fromChild.size(), read(fds[0], fromChild.data(), fromChild.size()));
+    waitpid(pid, nullptr, 0);
+    close(fds[0]);
+    close(fds[1]);
+    checkResult("randomBytes after fork differs", false, fromChild == b);
+
+    cout << "testChaChaRandom()... done!" << endl << endl;
+}
+
+void testRsaKernel() {
+    cout << "testRsaKernel()..." << endl;
+
+    rsa_key key;
+    checkResult("rsa_make_key", CRYPT_OK, rsa_make_key(NULL, find_prng("sprng"), 2048 / 8, 65537, &key));
+    RsaKernel kernel(key);
+    byte_vector hash = Digest(SHA256, base64_decodeToBytes("cXdlcnR5MTIzNDU2")).getDigest();
+    byte_vector salt = generateSecurePseudoRandomBytes(kernel.maxSaltLength(SHA256));
+    byte_vector seed = generateSecurePseudoRandomBytes(20);
+    byte_vector message = base64_decodeToBytes("cXdlcnR5MTIzNDU2");
+
+    // libtomcrypt gives the same signature for the same salt
+    ltc_prng_descriptor* no_prng_desc = no_prng_desc_get();
+    int prng_indx = register_prng(no_prng_desc);
+    prng_descriptor[prng_indx].add_entropy(&salt[0], salt.size(), (prng_state*)no_prng_desc);
+    unsigned long tomSigLen = 1024;
+    unsigned char tomSig[1024];
+    rsa_sign_hash_ex(&hash[0], hash.size(), getHashIndex(SHA256), tomSig, &tomSigLen,
+                     LTC_PKCS_1_PSS, (prng_state*)no_prng_desc, prng_indx, getHashIndex(SHA1), (int) salt.size(), &key);
+    byte_vector signature = kernel.signPss(&hash[0], SHA256, SHA1, &salt[0], salt.size());
+    checkResult("signPss", byte_vector(tomSig, tomSig + tomSigLen), signature);
+    checkResult("verifyPss", true, kernel.verifyPss(&signature[0], signature.size(), &hash[0], SHA256, SHA1, -1));
+    checkResult("verifyPss wrong mgf1", false, kernel.verifyPss(&signature[0], signature.size(), &hash[0], SHA256, SHA256, -1));
+    signature[10] ^= 1;
+    checkResult("verifyPss corrupted", false, kernel.verifyPss(&signature[0], signature.size(), &hash[0], SHA256, SHA1, -1));
+
+    // and the same ciphertext for the same seed
+    prng_descriptor[prng_indx].add_entropy(&seed[0], seed.size(), (prng_state*)no_prng_desc);
+    unsigned long tomEncLen = 1024;
+    unsigned char tomEnc[1024];
+    rsa_encrypt_key_ex(&message[0], message.size(), tomEnc, &tomEncLen, NULL, 0,
+                       (prng_state*)no_prng_desc, prng_indx, getHashIndex(SHA1), LTC_PKCS_1_OAEP, &key);
+    unregister_prng(no_prng_desc);
+    no_prng_desc_free(no_prng_desc);
+    byte_vector encrypted = kernel.encryptOaep(&message[0], message.size(), SHA1, &seed[0]);
+    checkResult("encryptOaep", byte_vector(tomEnc, tomEnc + tomEncLen), encrypted);
+    checkResult("decryptOaep", message, kernel.decryptOaep(&encrypted[0], encrypted.size(), SHA1));
+    encrypted = kernel.encryptOaep(&message[0], message.size(), SHA256);
+    unsigned long tomDecLen = 1024;
+    unsigned char tomDec[1024];
+    int stat = 0;
+    rsa_decrypt_key_ex(&encrypted[0], encrypted.size(), tomDec, &tomDecLen, NULL, 0,
+                       getHashIndex(SHA256), LTC_PKCS_1_OAEP, &stat, &key);
+    checkResult("encryptOaep random seed", message, byte_vector(tomDec, tomDec + tomDecLen));
+    encrypted[5] ^= 1;
+    bool thrown = false;
+    try {
+        kernel.decryptOaep(&encrypted[0], encrypted.size(), SHA256);
+    } catch (const std::runtime_error& e) {
+        thrown = true;
+    }
+    checkResult("decryptOaep corrupted", true, thrown);
+
+    // blinding values are refreshed on the way, results must stay valid
+    for (int i = 0; i < 100; ++i) {
+        signature = kernel.signPss(&hash[0], SHA256, SHA1, &salt[0], salt.size());
+        stat = 0;
+        rsa_verify_hash_ex(&signature[0], signature.size(), &hash[0], hash.size(), getHashIndex(SHA256),
+                           LTC_PKCS_1_PSS, getHashIndex(SHA1), (int) salt.size(), &stat, &key);
+        if (stat != 1) {
+            checkResult("signPss many times", 1, stat);
+            break;
+        }
+    }
+
+    rsa_free(&key);
+    cout << "testRsaKernel()... done!" << endl << endl;
+}
+
 void testGenerateNewKeys() {
     cout << "testGenerateNewKeys()..." << endl;
 
@@ -623,6 +1128,74 @@ void testSymmetricKeys() {
     cout << "testSymmetricKeys()... done!" << endl << endl;
 }
 
+void testEtaEngine() {
+    cout << "testEtaEngine()..." << endl;
+
+    // AES-256 CTR, counter part of the nonce is zero so it matches "openssl enc -aes-256-ctr"
+    byte_vector key(32), iv(16, 0), plain(100);
+    for (int i = 0; i < 32; ++i)
+        key[i] = (unsigned char) i;
+    for (int i = 0; i < 12; ++i)
+        iv[i] = (unsigned char) (0xF0 + i);
+    for (int i = 0; i < 100; ++i)
+        plain[i] = (unsigned char) (i * 3);
+    byte_vector ctrEncrypted(plain.size());
+    CTRTransformerAES(key, iv).transform(plain.data(), ctrEncrypted.data(), plain.size());
+    checkResult("aes-256-ctr", string("o5mE4GntVdulhWmFmC4txkqyibGw8QUZ/aaaTBGhiNoJZSVpEFWgAeeMiRsKzeg7gHLPW6SY7T3+/Z0R"
+                                      "7YRoutzT0E2MTGNMQIMQkvPeGWI7r/GNiosShULdYM9JfPa6LxhU7Q=="), base64_encode(ctrEncrypted));
+
+    // RFC 4231, test case 2
+    string hmacKey = "Jefe", hmacData = "what do ya want for nothing?";
+    HmacSha256 hmac(hmacKey.data(), hmacKey.size());
+    hmac.update(hmacData.data(), hmacData.size());
+    checkResult("hmac-sha256", string("W9zBRr9gdU5qBCQmCJV1x1oAPwidJzmDnexYuWTsOEM="), base64_encode(hmac.finish()));
+
+    SymmetricKey symmetricKey;
+    for (size_t size: {0, 1, 15, 16, 17, 100, 4095, 4096, 4097, 100000}) {
+        byte_vector data(size);
+        for (auto& b: data)
+            b = (unsigned char) minstdRand();
+
+        // HMAC and byte-wise CTR go through different code than the block-wise engine
+        unsigned char tomcryptHmac[32];
+        unsigned long tomcryptHmacSize = sizeof(tomcryptHmac);
+        hmac_memory(find_hash("sha256"), key.data(), key.size(), data.data(), data.size(), tomcryptHmac, &tomcryptHmacSize);
+        HmacSha256 hmacChunked(key.data(), key.size());
+        for (size_t offset = 0; offset < size; offset += 1000)
+            hmacChunked.update(&data[offset], std::min((size_t) 1000, size - offset));
+        checkResult("hmac-sha256 size " + to_string(size), byte_vector(tomcryptHmac, tomcryptHmac + 32), hmacChunked.finish());
+
+        CTRTransformerAES byteTransformer(key, iv);
+        CTRTransformerAES blockTransformer(key, iv);
+        byte_vector byteEncrypted(size), blockEncrypted(size);
+        for (size_t i = 0; i < size; ++i)
+            byteEncrypted[i] = byteTransformer.transformByte(data[i]);
+        for (size_t offset = 0; offset < size; offset += 333)
+            blockTransformer.transform(&data[offset], &blockEncrypted[offset], std::min((size_t) 333, size - offset));
+        checkResult("ctr size " + to_string(size), byteEncrypted, blockEncrypted);
+
+        // EtA in place: data is placed after room for IV and decrypted back over it
+        byte_vector buffer(size + SymmetricKey::ETA_OVERHEAD);
+        memcpy(&buffer[SymmetricKey::ETA_IV_SIZE], data.data(), size);
+        symmetricKey.etaEncrypt(&buffer[SymmetricKey::ETA_IV_SIZE], size, buffer.data());
+        checkResult("etaDecrypt size " + to_string(size), data, symmetricKey.etaDecrypt(buffer));
+        size_t decryptedSize = symmetricKey.etaDecrypt(buffer.data(), buffer.size(), buffer.data());
+        checkResult("etaDecrypt in place size " + to_string(size), data, byte_vector(buffer.begin(), buffer.begin() + decryptedSize));
+
+        auto corrupted = symmetricKey.etaEncrypt(data);
+        corrupted[corrupted.size() / 2] ^= 1;
+        bool hmacFailed = false;
+        try {
+            symmetricKey.etaDecrypt(corrupted);
+        } catch (const std::invalid_argument& e) {
+            hmacFailed = true;
+        }
+        checkResult("etaDecrypt corrupted size " + to_string(size), true, hmacFailed);
+    }
+
+    cout << "testEtaEngine()... done!" << endl << endl;
+}
+
 void udpAdapterHelloWorld() {
     cout << "udpAdapterHelloWorld()..." << endl;
 
@@ -691,9 +1264,17 @@ void testCryptoAll() {
     testSafe58();
     testPackUnpackKeys();
     testAllHashTypes();
+    testSha3();
+    testStreebog();
     testKeysConcurrency();
+    testVerifyBatch();
+    testSignatureCache();
+    testPBKDF2();
+    testChaChaRandom();
+    testRsaKernel();
     testGenerateNewKeys();
     testSymmetricKeys();
+    testEtaEngine();
     test2048and4096keysCompatibility();
     test8192keys();
     for (int i = 0; i < 10; ++i)
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include "LedgerCache.h"
+
+namespace db {
+
+    size_t LedgerCache::KeyHash::operator()(const Key& key) const {
+        // digest is a hash already, its first bytes are good enough
+        size_t h = 0;
+        memcpy(&h, key.data, std::min(sizeof(h), (size_t) key.size));
+        return h;
+    }
+
+    LedgerCache::LedgerCache(size_t maxSize, long long ttlMillis) : ttl_(ttlMillis) {
+        maxShardSize_ = std::max((size_t) 1, (maxSize + SHARDS_COUNT - 1) / SHARDS_COUNT);
+    }
+
+    std::shared_ptr<LedgerCache> LedgerCache::shared(const std::string& name, size_t maxSize, long long ttlMillis) {
+        static std::mutex registryMutex;
+        static std::unordered_map<std::string, std::weak_ptr<LedgerCache>> registry;
+
+        std::lock_guard lock(registryMutex);
+        auto cache = registry[name].lock();
+        if (!cache) {
+            cache = std::make_shared<LedgerCache>(maxSize, ttlMillis);
+            registry[name] = cache;
+        }
+        return cache;
+    }
+
+    bool LedgerCache::makeKey(const void* digest, size_t digestSize, Key& key) {
+        if (digestSize == 0 || digestSize > MAX_DIGEST_SIZE)
+            return false;
+        key.size = (unsigned char) digestSize;
+        memcpy(key.data, digest, digestSize);
+        return true;
+    }
+
+    LedgerCache::Shard& LedgerCache::shardOf(const Key& key) {
+        // last byte, as first ones are taken by KeyHash
+        return shards_[key.data[key.size - 1] % SHARDS_COUNT];
+    }
+
+    LedgerCache::IdShard& LedgerCache::idShardOf(long long recordId) {
+        return idShards_[(unsigned long long) recordId % SHARDS_COUNT];
+    }
+
+    void LedgerCache::eraseEntry(Shard& shard, std::list<Entry>::iterator it) {
+        IdShard& idShard = idShardOf(it->record.recordId);
+        {
+            std::lock_guard lock(idShard.mutex);
+            auto idIt = idShard.map.find(it->record.recordId);
+            if (idIt != idShard.map.end() && idIt->second == it->key)
+                idShard.map.erase(idIt);
+        }
+        shard.map.erase(it->key);
+        shard.lru.erase(it);
+    }
+
+    bool LedgerCache::getByKey(const Key& key, LedgerRecord& record) {
+        Shard& shard = shardOf(key);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            ++misses_;
+            return false;
+        }
+        if (it->second->deadline < std::chrono::steady_clock::now()) {
+            eraseEntry(shard, it->second);
+            ++expirations_;
+            ++misses_;
+            return false;
+        }
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        record = it->second->record;
+        ++hits_;
+        return true;
+    }
+
+    bool LedgerCache::get(const void* digest, size_t digestSize, LedgerRecord& record) {
+        Key key;
+        if (!makeKey(digest, digestSize, key)) {
+            ++misses_;
+            return false;
+        }
+        return getByKey(key, record);
+    }
+
+    bool LedgerCache::getById(long long recordId, byte_vector& digest, LedgerRecord& record) {
+        Key key;
+        {
+            IdShard& idShard = idShardOf(recordId);
+            std::lock_guard lock(idShard.mutex);
+            auto it = idShard.map.find(recordId);
+            if (it == idShard.map.end()) {
+                ++misses_;
+                return false;
+            }
+            key = it->second;
+        }
+        // the record could be replaced after the index was unlocked
+        if (!getByKey(key, record))
+            return false;
+        if (record.recordId != recordId) {
+            --hits_;
+            ++misses_;
+            return false;
+        }
+        digest.assign(key.data, key.data + key.size);
+        return true;
+    }
+
+    void LedgerCache::put(const void* digest, size_t digestSize, const LedgerRecord& record) {
+        Key key;
+        if (!makeKey(digest, digestSize, key))
+            return;
+        Shard& shard = shardOf(key);
+        std::lock_guard lock(shard.mutex);
+        auto deadline = std::chrono::steady_clock::now() + ttl_;
+        auto it = shard.map.find(key);
+        if (it != shard.map.end()) {
+            if (it->second->record.recordId != record.recordId)
+                eraseEntry(shard, it->second);
+            else {
+                it->second->record = record;
+                it->second->deadline = deadline;
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                return;
+            }
+        }
+        shard.lru.push_front(Entry{key, record, deadline});
+        shard.map[key] = shard.lru.begin();
+        while (shard.lru.size() > maxShardSize_) {
+            eraseEntry(shard, std::prev(shard.lru.end()));
+            ++evictions_;
+        }
+        IdShard& idShard = idShardOf(record.recordId);
+        std::lock_guard idLock(idShard.mutex);
+        idShard.map[record.recordId] = key;
+    }
+
+    void LedgerCache::remove(const void* digest, size_t digestSize) {
+        Key key;
+        if (!makeKey(digest, digestSize, key))
+            return;
+        Shard& shard = shardOf(key);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it != shard.map.end())
+            eraseEntry(shard, it->second);
+    }
+
+    void LedgerCache::clear() {
+        for (auto& shard: shards_) {
+            std::lock_guard lock(shard.mutex);
+            for (auto it = shard.lru.begin(); it != shard.lru.end(); )
+                eraseEntry(shard, it++);
+        }
+    }
+
+    LedgerCacheStats LedgerCache::getStats() const {
+        LedgerCacheStats stats;
+        for (auto& shard: shards_) {
+            std::lock_guard lock(shard.mutex);
+            stats.size += shard.lru.size();
+        }
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.evictions = evictions_;
+        stats.expirations = expirations_;
+        return stats;
+    }
+
+};
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_LEDGERCACHE_H
+#define U8_LEDGERCACHE_H
+
+#include <string>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include "../tools/tools.h"
+
+namespace db {
+
+    /**
+     * Ledger row without the hash, packed as it is stored in the ledger table.
+     */
+    struct LedgerRecord {
+        long long recordId = 0;
+        int state = 0;
+        long long lockedById = 0;
+        // seconds since epoch
+        long long createdAt = 0;
+        long long expiresAt = 0;
+    };
+
+    struct LedgerCacheStats {
+        size_t size = 0;
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+        unsigned long long evictions = 0;
+        unsigned long long expirations = 0;
+    };
+
+    /**
+     * Bounded cache of ledger records, keyed by digest of the HashId and by record id. Records are kept in shards,
+     * each one with its own mutex and LRU list, so threads of different isolates hardly ever wait for each other.
+     * Records are evicted when a shard is full, least recently used first, and expire ttlMillis after they are put.
+     *
+     * Cache is thread safe. Isolates share it by getting it with shared() under the same name.
+     */
+    class LedgerCache {
+    public:
+        static const size_t SHARDS_COUNT = 16;
+
+        /**
+         * Longest digest that can be a key, the size of the HashId digest.
+         */
+        static const size_t MAX_DIGEST_SIZE = 96;
+
+        LedgerCache(size_t maxSize, long long ttlMillis);
+
+        LedgerCache(const LedgerCache&) = delete;
+
+        LedgerCache& operator=(const LedgerCache&) = delete;
+
+        /**
+         * Cache registered under the name, created with maxSize and ttlMillis if there was none. Cache lives while
+         * someone holds it.
+         */
+        static std::shared_ptr<LedgerCache> shared(const std::string& name, size_t maxSize, long long ttlMillis);
+
+        /**
+         * Copy the record with the digest to the record, if it is cached and not expired.
+         *
+         * @return true if found.
+         */
+        bool get(const void* digest, size_t digestSize, LedgerRecord& record);
+
+        /**
+         * As get(), by the record id. Digest of the found record is copied to the digest.
+         */
+        bool getById(long long recordId, byte_vector& digest, LedgerRecord& record);
+
+        /**
+         * Put or replace the record. Digests longer than MAX_DIGEST_SIZE are not cached.
+         */
+        void put(const void* digest, size_t digestSize, const LedgerRecord& record);
+
+        void remove(const void* digest, size_t digestSize);
+
+        void clear();
+
+        LedgerCacheStats getStats() const;
+
+    private:
+        struct Key {
+            unsigned char size = 0;
+            unsigned char data[MAX_DIGEST_SIZE];
+
+            bool operator==(const Key& other) const {
+                return size == other.size && memcmp(data, other.data, size) == 0;
+            }
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const;
+        };
+
+        struct Entry {
+            Key key;
+            LedgerRecord record;
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            // most recently used are at the front
+            std::list<Entry> lru;
+            std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> map;
+        };
+
+        struct IdShard {
+            std::mutex mutex;
+            std::unordered_map<long long, Key> map;
+        };
+
+        size_t maxShardSize_;
+        std::chrono::milliseconds ttl_;
+        mutable Shard shards_[SHARDS_COUNT];
+        // record id -> digest, locked after the shard of the digest, if both are needed
+        IdShard idShards_[SHARDS_COUNT];
+        std::atomic<unsigned long long> hits_ = 0;
+        std::atomic<unsigned long long> misses_ = 0;
+        std::atomic<unsigned long long> evictions_ = 0;
+        std::atomic<unsigned long long> expirations_ = 0;
+
+        static bool makeKey(const void* digest, size_t digestSize, Key& key);
+
+        Shard& shardOf(const Key& key);
+
+        IdShard& idShardOf(long long recordId);
+
+        bool getByKey(const Key& key, LedgerRecord& record);
+
+        // shard must be locked
+        void eraseEntry(Shard& shard, std::list<Entry>::iterator it);
+    };
+
+};
+
+#endif //U8_LEDGERCACHE_H
@@ -27,6 +27,7 @@
 
 #include "PGPool.h"
 #include "../tools/Semaphore.h"
+#include <sstream>
 
 
 namespace db {
@@ -57,6 +58,11 @@ namespace db {
         return PQresultStatus(pgRes_.get());
     }
 
+    std::string QueryResult::getSqlState() {
+        const char* s = PQresultErrorField(pgRes_.get(), PG_DIAG_SQLSTATE);
+        return s == nullptr ? "" : s;
+    }
+
     int QueryResult::getRowsCount() {
         return PQntuples(pgRes_.get());
     }
@@ -80,6 +86,18 @@ namespace db {
         return res;
     }
 
+    std::string_view QueryResult::getValueView(int rowNum, int colIndex) {
+        return std::string_view(PQgetvalue(pgRes_.get(), rowNum, colIndex), (size_t) PQgetlength(pgRes_.get(), rowNum, colIndex));
+    }
+
+    bool QueryResult::isNull(int rowNum, int colIndex) {
+        return PQgetisnull(pgRes_.get(), rowNum, colIndex) != 0;
+    }
+
+    Oid QueryResult::getColOid(int colIndex) {
+        return PQftype(pgRes_.get(), colIndex);
+    }
+
     byte_vector QueryResult::getValueByName(int rowNum, const std::string& colName) {
         int colIndex = PQfnumber(pgRes_.get(), colName.c_str());
         if (colIndex == -1)
@@ -113,6 +131,18 @@ namespace db {
         }
     }
 
+    int QueryResult::nextRows(int maxRows, int& rowsCount) {
+        int nRows = PQntuples(pgRes_.get());
+        if (maxRows == 0) {
+            rowsCount = nRows;
+            return 0;
+        }
+        int firstRow = nextRowIndex_;
+        rowsCount = min(nRows-nextRowIndex_, maxRows);
+        nextRowIndex_ += rowsCount;
+        return firstRow;
+    }
+
     std::vector<std::string> QueryResult::getColNames() {
         int nCols = PQnfields(pgRes_.get());
         std::vector<std::string> res(nCols);
@@ -129,211 +159,633 @@ namespace db {
         return res;
     }
 
-    short getInt16Value(const byte_vector& val) {
+    static std::string_view asView(const byte_vector& val) {
+        return std::string_view((const char*) val.data(), val.size());
+    }
+
+    short getInt16Value(std::string_view val) {
         auto sz = sizeof(short);
         if (val.size() != sz)
             throw std::invalid_argument(
                     "getInt16Value: wrong data size: " + std::to_string(val.size()) + " bytes received, required " + std::to_string(sz));
-        return be16toh(*(int *) &val[0]);
+        short res;
+        memcpy(&res, val.data(), sz);
+        return be16toh(res);
     }
 
-    int getIntValue(const byte_vector& val) {
+    int getIntValue(std::string_view val) {
         auto sz = sizeof(int);
         if (val.size() != sz)
             throw std::invalid_argument(
                     "getIntValue: wrong data size: " + std::to_string(val.size()) + " bytes received, required " + std::to_string(sz));
-        return be32toh(*(int *) &val[0]);
+        int res;
+        memcpy(&res, val.data(), sz);
+        return be32toh(res);
     }
 
-    long long getLongValue(const byte_vector& val) {
+    long long getLongValue(std::string_view val) {
         auto sz = sizeof(long long);
         if (val.size() < sz)
             throw std::invalid_argument(
                     "getLongValue: wrong data size: " + std::to_string(val.size()) + " bytes received, required " + std::to_string(sz));
-        return be64toh(*(long long*)&val[0]);
+        long long res;
+        memcpy(&res, val.data(), sz);
+        return be64toh(res);
     }
 
-    bool getBoolValue(const byte_vector& val) {
-        return *(bool*)&val[0];
+    bool getBoolValue(std::string_view val) {
+        return val.size() > 0 && val[0] != 0;
     }
 
-    double getDoubleValue(const byte_vector& val) {
+    double getDoubleValue(std::string_view val) {
         auto sz = sizeof(double);
         if (val.size() < sz)
             throw std::invalid_argument(
                     "getDoubleValue: wrong data size: " + std::to_string(val.size()) + " bytes received, required " + std::to_string(sz));
-        long long hval = be64toh(*((long long*)&val[0]));
-        return *((double*)&hval);
+        long long hval;
+        memcpy(&hval, val.data(), sz);
+        hval = be64toh(hval);
+        double res;
+        memcpy(&res, &hval, sz);
+        return res;
+    }
+
+    float getFloatValue(std::string_view val) {
+        auto sz = sizeof(float);
+        if (val.size() != sz)
+            throw std::invalid_argument(
+                    "getFloatValue: wrong data size: " + std::to_string(val.size()) + " bytes received, required " + std::to_string(sz));
+        int hval;
+        memcpy(&hval, val.data(), sz);
+        hval = be32toh(hval);
+        float res;
+        memcpy(&res, &hval, sz);
+        return res;
+    }
+
+    std::string getNumericValue(std::string_view val) {
+        // header of 4 int16: number of base 10000 digits, weight of the first digit, sign and display scale
+        if (val.size() < 8)
+            throw std::invalid_argument("getNumericValue: wrong data size: " + std::to_string(val.size()) + " bytes received");
+        int ndigits = (unsigned short) getInt16Value(val.substr(0, 2));
+        int weight = getInt16Value(val.substr(2, 2));
+        int sign = (unsigned short) getInt16Value(val.substr(4, 2));
+        int dscale = (unsigned short) getInt16Value(val.substr(6, 2));
+        if (sign == 0xC000)
+            return "NaN";
+        if (sign == 0xD000)
+            return "Infinity";
+        if (sign == 0xF000)
+            return "-Infinity";
+        if (val.size() != 8 + (size_t) ndigits * 2)
+            throw std::invalid_argument("getNumericValue: wrong data size: " + std::to_string(val.size()) +
+                                        " bytes received for " + std::to_string(ndigits) + " digits");
+        auto digit = [&](int i) {
+            return i >= 0 && i < ndigits ? (int) getInt16Value(val.substr(8 + (size_t) i * 2, 2)) : 0;
+        };
+
+        std::string res;
+        if (sign == 0x4000)
+            res += '-';
+        if (weight < 0) {
+            res += '0';
+        } else {
+            res += std::to_string(digit(0));
+            char buf[8];
+            for (int i = 1; i <= weight; ++i) {
+                snprintf(buf, sizeof(buf), "%04d", digit(i));
+                res += buf;
+            }
+        }
+        if (dscale > 0) {
+            res += '.';
+            std::string frac;
+            char buf[8];
+            for (int i = weight + 1; (int) frac.size() < dscale; ++i) {
+                snprintf(buf, sizeof(buf), "%04d", digit(i));
+                frac += buf;
+            }
+            res.append(frac, 0, (size_t) dscale);
+        }
+        return res;
+    }
+
+    short getInt16Value(const byte_vector& val) {
+        return getInt16Value(asView(val));
+    }
+
+    int getIntValue(const byte_vector& val) {
+        return getIntValue(asView(val));
+    }
+
+    long long getLongValue(const byte_vector& val) {
+        return getLongValue(asView(val));
+    }
+
+    bool getBoolValue(const byte_vector& val) {
+        return getBoolValue(asView(val));
+    }
+
+    double getDoubleValue(const byte_vector& val) {
+        return getDoubleValue(asView(val));
     }
 
     std::string getStringValue(const byte_vector& val) {
         return bytesToString(val);
     }
 
-    void BusyConnection::executeQueryArr(ExecuteSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::string& queryString0, std::vector<std::any>& params) {
-        worker_([=](){
-            std::string queryString = replacePlaceholders(queryString0);
-            const char *values[params.size()];
-            int lengths[params.size()];
-            int binaryFlags[params.size()];
-            vector<shared_ptr<byte_vector>> bytesHolder;
-            auto addByteVector = [&bytesHolder,&values,&lengths,&binaryFlags](int i, std::shared_ptr<byte_vector> ps) {
-                bytesHolder.push_back(ps);
-                byte_vector &bv = *ps;
-                values[i] = (char *) &bv[0];
-                lengths[i] = bv.size();
-                binaryFlags[i] = 1;
+    PGLoop::PGLoop() {
+        uv_loop_init(&loop_);
+        uv_async_init(&loop_, &wakeup_, onWakeup);
+        wakeup_.data = this;
+        thread_ = std::thread([this]() {
+            uv_run(&loop_, UV_RUN_DEFAULT);
+        });
+    }
+
+    PGLoop::~PGLoop() {
+        {
+            std::lock_guard guard(mutex_);
+            stopping_ = true;
+            uv_async_send(&wakeup_);
+        }
+        thread_.join();
+        uv_loop_close(&loop_);
+    }
+
+    void PGLoop::post(std::function<void()>&& task) {
+        std::lock_guard guard(mutex_);
+        if (stopped_)
+            return;
+        tasks_.emplace_back(std::move(task));
+        // under the mutex, so that loop thread can't close wakeup_ meanwhile
+        uv_async_send(&wakeup_);
+    }
+
+    void PGLoop::onWakeup(uv_async_t* handle) {
+        auto self = (PGLoop*) handle->data;
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard guard(self->mutex_);
+            tasks.swap(self->tasks_);
+        }
+        for (auto& task: tasks) {
+            try {
+                task();
+            } catch (const std::exception& e) {
+                cerr << "error in pg loop thread: " << e.what() << endl;
+            } catch (...) {
+                cerr << "unknown error in pg loop thread" << endl;
+            }
+        }
+        tasks.clear();
+        std::lock_guard guard(self->mutex_);
+        if (self->stopping_ && self->tasks_.empty()) {
+            self->stopped_ = true;
+            // connections are shut down by PGPool already, so there should be nothing but wakeup_ left
+            uv_walk(&self->loop_, [](uv_handle_t* h, void* arg) {
+                if (!uv_is_closing(h))
+                    uv_close(h, nullptr);
+            }, nullptr);
+        }
+    }
+
+    static void deletePollHandle(uv_handle_t* handle) {
+        delete (uv_poll_t*) handle;
+    }
+
+    static void deleteTimerHandle(uv_handle_t* handle) {
+        delete (uv_timer_t*) handle;
+    }
+
+    BusyConnection::BusyConnection(PGPool* new_parent, std::shared_ptr<PGconn> new_con, int newId)
+        : con_(new_con), parent_(new_parent), loop_(&new_parent->getLoop()), conId_(newId) {
+    }
+
+    BusyConnection::~BusyConnection() {
+        if (poll_ != nullptr) {
+            // handle is closed in the loop thread, and the socket is closed by PQfinish only after it
+            auto poll = poll_;
+            auto con = con_;
+            loop_->post([poll, con]() {
+                uv_close((uv_handle_t*) poll, deletePollHandle);
+            });
+        }
+    }
+
+    /**
+     * Query parameters in the form of PQsendQueryParams arguments. byte_vector and numbers go in binary form, strings
+     * in binary form too, or as text if stringsAsText is set (that's how js passes all values but binary ones).
+     */
+    struct EncodedParams {
+        // std::string keeps binary data as well, and text values must be zero terminated
+        std::vector<std::string> holder;
+        std::vector<const char*> values;
+        std::vector<int> lengths;
+        std::vector<int> binaryFlags;
+
+        EncodedParams(const std::vector<std::any>& params, bool stringsAsText)
+            : holder(params.size()), values(params.size(), nullptr), lengths(params.size(), 0), binaryFlags(params.size(), 1) {
+            auto setBinary = [this](int i, const void* data, size_t size) {
+                holder[i].assign((const char*) data, size);
             };
             for (int i = 0; i < params.size(); ++i) {
                 auto &val = params[i];
                 if (val.type() == typeid(byte_vector)) {
-                    auto ps = make_shared<byte_vector>(std::any_cast<byte_vector>(val));
-                    addByteVector(i, ps);
+                    auto& v = std::any_cast<const byte_vector&>(val);
+                    setBinary(i, v.data(), v.size());
                 } else if (val.type() == typeid(const char *)) {
-                    auto v = std::any_cast<const char *>(val);
-                    auto ps = make_shared<byte_vector>(v, v+strlen(v));
-                    addByteVector(i, ps);
+                    holder[i] = std::any_cast<const char *>(val);
+                    binaryFlags[i] = stringsAsText ? 0 : 1;
                 } else if (val.type() == typeid(std::string)) {
-                    auto v = std::any_cast<std::string>(val);
-                    auto ps = make_shared<byte_vector>(v.begin(), v.end());
-                    addByteVector(i, ps);
+                    holder[i] = std::any_cast<const std::string&>(val);
+                    binaryFlags[i] = stringsAsText ? 0 : 1;
                 } else if (val.type() == typeid(int)) {
                     auto v = std::any_cast<int>(val);
                     v = htobe32(v);
-                    addByteVector(i, make_shared<byte_vector>((char*)&v, ((char*)&v)+sizeof(int)));
+                    setBinary(i, &v, sizeof(int));
                 } else if (val.type() == typeid(long)) {
                     auto v = std::any_cast<long>(val);
                     v = htobe64(v);
-                    addByteVector(i, make_shared<byte_vector>((char*)&v, ((char*)&v)+sizeof(long)));
+                    setBinary(i, &v, sizeof(long));
                 } else if (val.type() == typeid(long long)) {
                     auto v = std::any_cast<long long>(val);
                     v = htobe64(v);
-                    addByteVector(i, make_shared<byte_vector>((char*)&v, ((char*)&v)+sizeof(long long)));
+                    setBinary(i, &v, sizeof(long long));
                 } else if (val.type() == typeid(bool)) {
                     auto v = std::any_cast<bool>(val);
-                    addByteVector(i, make_shared<byte_vector>((char*)&v, ((char*)&v)+sizeof(bool)));
+                    setBinary(i, &v, sizeof(bool));
                 } else if (val.type() == typeid(double)) {
                     auto v = std::any_cast<double>(val);
                     long long lv = htobe64(*(long long*)&v);
-                    v = *(double*)&lv;
-                    addByteVector(i, make_shared<byte_vector>((char*)&v, ((char*)&v)+sizeof(double)));
+                    setBinary(i, &lv, sizeof(double));
                 } else {
                     std::cerr << "PGPool.execParams error: wrong type: " << val.type().name() << std::endl;
+                    // passed as NULL
+                    continue;
                 }
+                values[i] = holder[i].c_str();
+                lengths[i] = (int) holder[i].size();
             }
-            if (0 == PQsendQueryParams(conPtr(), queryString.c_str(), params.size(), nullptr, values, lengths, binaryFlags, 1)) {
-                parent_->checkAndResetAllConnections();
-                onError("PGPool connection is broken (PQsendQueryParams)");
-                return;
-            }
-            if (0 != PQflush(conPtr())) {
-                parent_->checkAndResetAllConnections();
-                onError("PGPool connection is broken (PQflush)");
-                return;
+        }
+
+        int size() const {return (int) values.size();}
+    };
+
+    bool BusyConnection::sendStatement(PGconn* con, const BatchStatement& statement, bool stringsAsText) {
+        EncodedParams ep(statement.params, stringsAsText);
+        auto it = prepared_.find(statement.queryString);
+        if (it != prepared_.end() && !it->second.name.empty()) {
+            ++parent_->preparedStats_.hits;
+            return 0 != PQsendQueryPrepared(con, it->second.name.c_str(), ep.size(), ep.values.data(), ep.lengths.data(), ep.binaryFlags.data(), 1);
+        }
+        ++parent_->preparedStats_.misses;
+        std::string queryString = replacePlaceholders(statement.queryString);
+        return 0 != PQsendQueryParams(con, queryString.c_str(), ep.size(), nullptr, ep.values.data(), ep.lengths.data(), ep.binaryFlags.data(), 1);
+    }
+
+    bool BusyConnection::sendCommand(Command& command) {
+        PGconn* con = conPtr();
+        if (command.send)
+            return command.send(con);
+#ifdef LIBPQ_HAS_PIPELINING
+        if (command.pipelineSize > 0) {
+            if (0 == PQenterPipelineMode(con))
+                return false;
+            for (auto& st: command.statements)
+                if (!sendStatement(con, st, command.stringsAsText))
+                    return false;
+            return 0 != PQpipelineSync(con);
+        }
+#endif
+        if (!sendStatement(con, command.statements[0], command.stringsAsText))
+            return false;
+        if (command.rowsBatchSize > 0)
+            PQsetSingleRowMode(con);
+        return true;
+    }
+
+    bool BusyConnection::prepareStatements(const Command& command) {
+        std::vector<std::string> toPrepare;
+        for (auto& st: command.statements) {
+            auto it = prepared_.find(st.queryString);
+            if (it != prepared_.end()) {
+                preparedLru_.splice(preparedLru_.begin(), preparedLru_, it->second.lruPos);
+            } else {
+                preparedLru_.push_front(st.queryString);
+                it = prepared_.emplace(st.queryString, PreparedStatement{"", 0, preparedLru_.begin()}).first;
             }
-            QueryResultsArr results;
-            while (true) {
-                pg_result *r = PQgetResult(conPtr());
-                if (r == nullptr)
-                    break;
-                results.push_back(QueryResult(this->parent_, r));
+            auto& ps = it->second;
+            // statements used once are not worth a round trip to prepare them
+            if (ps.name.empty() && !ps.isPreparing && ++ps.uses >= PREPARE_THRESHOLD) {
+                ps.isPreparing = true;
+                toPrepare.push_back(st.queryString);
             }
-            if (PQstatus(conPtr()) == CONNECTION_BAD) {
-                parent_->checkAndResetAllConnections();
-                onError("PGPool connection is broken (PQgetResult)");
+        }
+        while (prepared_.size() > PREPARED_STATEMENTS_CACHE_SIZE) {
+            auto it = prepared_.find(preparedLru_.back());
+            if (!it->second.name.empty())
+                toDeallocate_.push_back(it->second.name);
+            prepared_.erase(it);
+            preparedLru_.pop_back();
+            ++parent_->preparedStats_.evictions;
+        }
+        // commands are pushed in front of the queue, so they go in reverse order
+        bool isQueued = false;
+        for (auto it = toPrepare.rbegin(); it != toPrepare.rend(); ++it) {
+            std::string key = *it;
+            std::string name = "u8_" + std::to_string(++preparedCounter_);
+            Command prepare;
+            prepare.sendName = "PQsendPrepare";
+            prepare.send = [key, name](PGconn* con) {
+                return 0 != PQsendPrepare(con, name.c_str(), replacePlaceholders(key).c_str(), 0, nullptr);
+            };
+            prepare.complete = [this, key, name](QueryResultsArr& results, const char* brokenAt) {
+                bool isOk = brokenAt == nullptr && results.size() == 1 && !results[0].isError();
+                auto it = prepared_.find(key);
+                if (it == prepared_.end() || !it->second.isPreparing) {
+                    // evicted or reset meanwhile
+                    if (isOk)
+                        toDeallocate_.push_back(name);
+                    return;
+                }
+                it->second.isPreparing = false;
+                if (isOk) {
+                    it->second.name = name;
+                    ++parent_->preparedStats_.prepared;
+                } else {
+                    // the statement goes unprepared and reports its error itself, next attempt is after some more uses
+                    it->second.uses = 0;
+                }
+            };
+            commands_.push_front(std::move(prepare));
+            isQueued = true;
+        }
+        if (!toDeallocate_.empty()) {
+            std::string sql;
+            for (auto& name: toDeallocate_)
+                sql += "DEALLOCATE " + name + ";";
+            toDeallocate_.clear();
+            Command deallocate;
+            deallocate.sendName = "PQsendQuery";
+            deallocate.send = [sql](PGconn* con) {
+                return 0 != PQsendQuery(con, sql.c_str());
+            };
+            deallocate.complete = [](QueryResultsArr& results, const char* brokenAt) {};
+            commands_.push_front(std::move(deallocate));
+            isQueued = true;
+        }
+        return isQueued;
+    }
+
+    void BusyConnection::checkPreparedResults(const Command& command, QueryResultsArr& results) {
+        for (size_t i = 0; i < results.size() && i < command.statements.size(); ++i) {
+            // not pipelined statement has the only result, or single row results and the status after them
+            auto& result = command.pipelineSize > 0 ? results[i] : results.back();
+            if (!result.isError())
+                continue;
+            std::string sqlState = result.getSqlState();
+            if (sqlState == "26000") {
+                // prepared statements are deallocated by somebody else, e.g. with DISCARD ALL
+                clearPrepared();
                 return;
             }
-            if (results.size() == 0) {
-                onError("PGPool.executeQuery error: your sql query returns no result, use executeUpdate instead.");
-                return;
+            if (sqlState == "0A000") {
+                // "cached plan must not change result type" after the table is altered
+                auto it = prepared_.find(command.statements[i].queryString);
+                if (it != prepared_.end()) {
+                    if (!it->second.name.empty())
+                        toDeallocate_.push_back(it->second.name);
+                    preparedLru_.erase(it->second.lruPos);
+                    prepared_.erase(it);
+                }
             }
-            if (results.size() > 1) {
-                onError("PGPool.executeQuery error: your sql query returns "+std::to_string(results.size())+" results, bun only 1 is supported.");
+        }
+    }
+
+    void BusyConnection::clearPrepared() {
+        prepared_.clear();
+        preparedLru_.clear();
+        toDeallocate_.clear();
+    }
+
+    void BusyConnection::executeQueryArr(ExecuteSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::string& queryString, std::vector<std::any>& params) {
+        Command command;
+        command.sendName = "PQsendQueryParams";
+        command.statements.push_back({queryString, params});
+        command.complete = [=](QueryResultsArr& results, const char* brokenAt) {
+            completeQuery(results, brokenAt, onSuccess, onError);
+        };
+        enqueue(std::move(command));
+    }
+
+    void BusyConnection::executeQueryArrStr(ExecuteSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::string& queryString, std::vector<std::any>& params) {
+        Command command;
+        command.sendName = "PQsendQueryParams";
+        command.statements.push_back({queryString, params});
+        command.stringsAsText = true;
+        command.complete = [=](QueryResultsArr& results, const char* brokenAt) {
+            completeQuery(results, brokenAt, onSuccess, onError);
+        };
+        enqueue(std::move(command));
+    }
+
+    void BusyConnection::executeQueryStream(RowsBatchCallback onRows, UpdateSuccessCallback onDone, ExecuteErrorCallback onError,
+                                            int batchSize, const std::string& queryString, std::vector<std::any>& params) {
+        std::function<bool(QueryResultsArr&)> rowsCallback = onRows;
+        enqueueStream([this, rowsCallback](QueryResultsArr& rows, int batchId) {
+            resumeStream(batchId, rowsCallback(rows));
+        }, onDone, onError, batchSize, queryString, params, false);
+    }
+
+    void BusyConnection::executeQueryStreamStr(RowsBatchCallback onRows, UpdateSuccessCallback onDone, ExecuteErrorCallback onError,
+                                               int batchSize, const std::string& queryString, std::vector<std::any>& params) {
+        std::function<bool(QueryResultsArr&)> rowsCallback = onRows;
+        enqueueStream([this, rowsCallback](QueryResultsArr& rows, int batchId) {
+            resumeStream(batchId, rowsCallback(rows));
+        }, onDone, onError, batchSize, queryString, params, true);
+    }
+
+    void BusyConnection::executeQueryStreamAsync(AsyncRowsBatchCallback onRows, UpdateSuccessCallback onDone, ExecuteErrorCallback onError,
+                                                 int batchSize, const std::string& queryString, std::vector<std::any>& params) {
+        enqueueStream(onRows, onDone, onError, batchSize, queryString, params, true);
+    }
+
+    void BusyConnection::resumeStream(int batchId, bool isNeeded) {
+        auto self = shared_from_this();
+        loop_->post([self, batchId, isNeeded]() {
+            // the batch could be the last one, or the connection is broken meanwhile
+            if (!self->isStreamPaused_ || batchId != self->streamBatchId_)
                 return;
+            self->isStreamPaused_ = false;
+            if (!isNeeded) {
+                *self->current_.isStreamStopped = true;
+                self->cancelQuery();
             }
-            if (results[0].isError()) {
-                onError("PGPool.executeQuery error: postgres error: " + std::string(results[0].getErrorText()));
+            if (!self->watch(UV_READABLE, onQuerySocket)) {
+                self->closePoll();
+                self->finishCommand("PQsocket");
+                self->processNext();
                 return;
             }
-            onSuccess(std::move(results[0]));
+            // rows that libpq has already received don't make the socket readable again
+            onQuerySocket(self->poll_, 0, UV_READABLE);
         });
     }
 
-    void BusyConnection::executeQueryArrStr(ExecuteSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::string& queryString0, std::vector<std::any>& params) {
-        worker_([=](){
-            std::string queryString = replacePlaceholders(queryString0);
-            const char *values[params.size()];
-            int lengths[params.size()];
-            int binaryFlags[params.size()];
-            vector<shared_ptr<byte_vector>> bytesHolder;
-            vector<shared_ptr<string>> stringHolder;
-            auto addByteVector = [&bytesHolder,&values,&lengths,&binaryFlags](int i, std::shared_ptr<byte_vector> ps) {
-                bytesHolder.push_back(ps);
-                byte_vector &bv = *ps;
-                values[i] = (char *) &bv[0];
-                lengths[i] = bv.size();
-                binaryFlags[i] = 1;
-            };
-            auto addString = [&stringHolder,&values,&lengths,&binaryFlags](int i, std::shared_ptr<string> ps) {
-                stringHolder.push_back(ps);
-                string &s = *ps;
-                values[i] = (char *) s.c_str();
-                lengths[i] = s.length();
-                binaryFlags[i] = 0;
-            };
-            for (int i = 0; i < params.size(); ++i) {
-                auto &val = params[i];
-                if (val.type() == typeid(byte_vector)) {
-                    auto ps = make_shared<byte_vector>(std::any_cast<byte_vector>(val));
-                    addByteVector(i, ps);
-                } else if (val.type() == typeid(const char *)) {
-                    auto v = std::any_cast<const char *>(val);
-                    auto ps = make_shared<string>(v, strlen(v));
-                    addString(i, ps);
-                } else if (val.type() == typeid(std::string)) {
-                    auto v = std::any_cast<std::string>(val);
-                    auto ps = make_shared<string>(v);
-                    addString(i, ps);
-                } else {
-                    std::cerr << "PGPool.execParams error: wrong type: " << val.type().name() << std::endl;
-                }
-            }
-            if (0 == PQsendQueryParams(conPtr(), queryString.c_str(), params.size(), nullptr, values, lengths, binaryFlags, 1)) {
-                parent_->checkAndResetAllConnections();
-                onError("PGPool connection is broken (PQsendQueryParams)");
-                return;
-            }
-            if (0 != PQflush(conPtr())) {
+    void BusyConnection::cancelQuery() {
+        PGcancel* cancel = PQgetCancel(conPtr());
+        if (cancel == nullptr)
+            return;
+        // PQcancel connects to the server and waits for it, so it is sent from another thread. The query ends
+        // with error then, and the next command isn't sent until the request is delivered, so that a late request
+        // can't cancel it instead.
+        isCancelling_ = true;
+        auto self = shared_from_this();
+        parent_->cancelThread_.execute([self, cancel]() {
+            char errorText[256];
+            if (0 == PQcancel(cancel, errorText, sizeof(errorText)))
+                cerr << "PGPool: PQcancel error: " << errorText << endl;
+            PQfreeCancel(cancel);
+            self->loop_->post([self]() {
+                self->isCancelling_ = false;
+                self->processNext();
+            });
+        });
+    }
+
+    void BusyConnection::enqueueStream(AsyncRowsBatchCallback onRows, UpdateSuccessCallback onDone, ExecuteErrorCallback onError,
+                                       int batchSize, const std::string& queryString, std::vector<std::any>& params, bool stringsAsText) {
+        auto isStopped = std::make_shared<bool>(false);
+        auto rowsCount = std::make_shared<int>(0);
+        Command command;
+        command.sendName = "PQsendQueryParams";
+        command.statements.push_back({queryString, params});
+        command.stringsAsText = stringsAsText;
+        command.rowsBatchSize = std::max(batchSize, 1);
+        command.isStreamStopped = isStopped;
+        command.onRowsBatch = [=](QueryResultsArr& rows) {
+            // rows that come before the cancelled query ends are dropped
+            if (*isStopped || rows.empty())
+                return false;
+            *rowsCount += (int) rows.size();
+            onRows(rows, ++streamBatchId_);
+            return true;
+        };
+        command.complete = [=](QueryResultsArr& results, const char* brokenAt) {
+            if (brokenAt != nullptr) {
                 parent_->checkAndResetAllConnections();
-                onError("PGPool connection is broken (PQflush)");
+                onError(std::string("PGPool connection is broken (") + brokenAt + ")");
                 return;
             }
-            QueryResultsArr results;
-            while (true) {
-                pg_result *r = PQgetResult(conPtr());
-                if (r == nullptr)
-                    break;
-                results.push_back(QueryResult(this->parent_, r));
-            }
-            if (PQstatus(conPtr()) == CONNECTION_BAD) {
-                parent_->checkAndResetAllConnections();
-                onError("PGPool connection is broken (PQgetResult)");
+            // the query is cancelled when the rest of rows are not needed, so it ends with error
+            if (*isStopped) {
+                onDone(*rowsCount);
                 return;
             }
-            if (results.size() == 0) {
-                onError("PGPool.executeQuery error: your sql query returns no result, use executeUpdate instead.");
+            if (results.empty()) {
+                onError("PGPool.executeQueryStream error: no result");
                 return;
             }
-            if (results.size() > 1) {
-                onError("PGPool.executeQuery error: your sql query returns "+std::to_string(results.size())+" results, bun only 1 is supported.");
+            // rows of the last batch are followed by the result with status of the whole query
+            if (results.back().isError()) {
+                onError("PGPool.executeQueryStream error: postgres error: " + std::string(results.back().getErrorText()));
                 return;
             }
-            if (results[0].isError()) {
-                onError("PGPool.executeQuery error: postgres error: " + std::string(results[0].getErrorText()));
+            // rows are all passed before the result with status, see onQuerySocket
+            onDone(*rowsCount);
+        };
+        enqueue(std::move(command));
+    }
+
+    void BusyConnection::executeBatch(BatchSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::vector<BatchStatement>& statements) {
+        enqueueBatch(onSuccess, onError, statements, false);
+    }
+
+    void BusyConnection::executeBatchStr(BatchSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::vector<BatchStatement>& statements) {
+        enqueueBatch(onSuccess, onError, statements, true);
+    }
+
+#ifdef LIBPQ_HAS_PIPELINING
+
+    void BusyConnection::enqueueBatch(BatchSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::vector<BatchStatement>& statements, bool stringsAsText) {
+        if (statements.empty()) {
+            QueryResultsArr results;
+            onSuccess(results);
+            return;
+        }
+        Command command;
+        command.sendName = "PQsendQueryParams";
+        command.statements = statements;
+        command.stringsAsText = stringsAsText;
+        command.pipelineSize = (int) statements.size();
+        command.complete = [=](QueryResultsArr& results, const char* brokenAt) {
+            if (brokenAt != nullptr) {
+                parent_->checkAndResetAllConnections();
+                onError(std::string("PGPool connection is broken (") + brokenAt + ")");
                 return;
             }
-            onSuccess(std::move(results[0]));
-        });
+            onSuccess(results);
+        };
+        enqueue(std::move(command));
+    }
+
+#else
+
+    void BusyConnection::enqueueBatch(BatchSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::vector<BatchStatement>& statements, bool stringsAsText) {
+        // libpq without pipeline mode: statements go one by one, results are collected for the last one
+        auto results = make_shared<QueryResultsArr>();
+        auto isBroken = make_shared<bool>(false);
+        if (statements.empty()) {
+            onSuccess(*results);
+            return;
+        }
+        for (size_t i = 0; i < statements.size(); ++i) {
+            bool isLast = i + 1 == statements.size();
+            Command command;
+            command.sendName = "PQsendQueryParams";
+            command.statements.push_back(statements[i]);
+            command.stringsAsText = stringsAsText;
+            command.complete = [=](QueryResultsArr& stResults, const char* brokenAt) {
+                if (*isBroken)
+                    return;
+                if (brokenAt != nullptr) {
+                    *isBroken = true;
+                    parent_->checkAndResetAllConnections();
+                    onError(std::string("PGPool connection is broken (") + brokenAt + ")");
+                    return;
+                }
+                for (auto& r: stResults)
+                    results->push_back(std::move(r));
+                if (isLast)
+                    onSuccess(*results);
+            };
+            enqueue(std::move(command));
+        }
+    }
+
+#endif
+
+    void BusyConnection::completeQuery(QueryResultsArr& results, const char* brokenAt,
+                                       ExecuteSuccessCallback onSuccess, ExecuteErrorCallback onError) {
+        if (brokenAt != nullptr) {
+            parent_->checkAndResetAllConnections();
+            onError(std::string("PGPool connection is broken (") + brokenAt + ")");
+            return;
+        }
+        if (results.size() == 0) {
+            onError("PGPool.executeQuery error: your sql query returns no result, use executeUpdate instead.");
+            return;
+        }
+        if (results.size() > 1) {
+            onError("PGPool.executeQuery error: your sql query returns "+std::to_string(results.size())+" results, bun only 1 is supported.");
+            return;
+        }
+        if (results[0].isError()) {
+            onError("PGPool.executeQuery error: postgres error: " + std::string(results[0].getErrorText()));
+            return;
+        }
+        onSuccess(std::move(results[0]));
     }
 
     void BusyConnection::executeUpdateArr(UpdateSuccessCallback onSuccess, UpdateErrorCallback onError, const std::string& queryString, std::vector<std::any>& params) {
@@ -354,110 +806,716 @@ namespace db {
         );
     }
 
-    void BusyConnection::exec(const std::string &query, QueryCallback callback) {
-        exec([callback, query, this](){
-            PQsendQuery(conPtr(), query.c_str());
-            PQflush(conPtr());
-            QueryResultsArr results;
-            while (true) {
-                pg_result *r = PQgetResult(conPtr());
-                if (r == nullptr)
-                    break;
-                results.push_back(QueryResult(this->parent_, r));
+    static std::string copyErrorText(const char* method, QueryResultsArr& results) {
+        if (results.size() != 1)
+            return std::string("PGPool.") + method + " error: unexpected number of results: " + std::to_string(results.size());
+        return std::string("PGPool.") + method + " error: postgres error: " + results[0].getErrorText();
+    }
+
+    static std::string columnsList(const std::vector<std::string>& columns) {
+        std::string res;
+        for (auto& column: columns)
+            res += (res.empty() ? "" : ",") + column;
+        return res;
+    }
+
+    void BusyConnection::copyIn(UpdateSuccessCallback onSuccess, UpdateErrorCallback onError, const std::string& table,
+                                const std::vector<std::string>& columns, const CopyRowSource& rowSource) {
+        // column types are needed to encode values, so the first command selects nothing from the table
+        std::string probeQuery = "SELECT " + columnsList(columns) + " FROM " + table + " LIMIT 0";
+        std::string copyQuery = "COPY " + table + " (" + columnsList(columns) + ") FROM STDIN (FORMAT binary)";
+        Command command;
+        command.sendName = "PQsendQuery";
+        command.send = [probeQuery](PGconn* con) {
+            return 0 != PQsendQuery(con, probeQuery.c_str());
+        };
+        command.complete = [=](QueryResultsArr& results, const char* brokenAt) {
+            if (brokenAt != nullptr) {
+                parent_->checkAndResetAllConnections();
+                onError(std::string("PGPool connection is broken (") + brokenAt + ")");
+                return;
             }
-            callback(results);
+            if (results.size() != 1 || results[0].isError()) {
+                onError(copyErrorText("copyIn", results));
+                return;
+            }
+            Command copy;
+            copy.sendName = "PQsendQuery";
+            copy.send = [copyQuery](PGconn* con) {
+                return 0 != PQsendQuery(con, copyQuery.c_str());
+            };
+            std::shared_ptr<CopyRowsEncoder> encoder;
+            try {
+                encoder = std::make_shared<CopyRowsEncoder>(results[0].getColTypes(), rowSource);
+            } catch (const std::exception& e) {
+                onError(std::string("PGPool.copyIn error: ") + e.what());
+                return;
+            }
+            // rows are encoded while they are sent, see writeCopyData
+            copy.copyEncoder = encoder;
+            copy.copyData = std::make_shared<byte_vector>();
+            copy.complete = [=](QueryResultsArr& results, const char* brokenAt) {
+                if (brokenAt != nullptr) {
+                    parent_->checkAndResetAllConnections();
+                    onError(std::string("PGPool connection is broken (") + brokenAt + ")");
+                    return;
+                }
+                // the copy is aborted with the encoding error, so it is reported instead of the server one
+                if (!encoder->getError().empty()) {
+                    onError("PGPool.copyIn error: " + encoder->getError());
+                    return;
+                }
+                if (results.size() != 1 || results[0].isError()) {
+                    onError(copyErrorText("copyIn", results));
+                    return;
+                }
+                onSuccess(results[0].getAffectedRows());
+            };
+            // goes before the commands queued meanwhile
+            commands_.push_front(std::move(copy));
+        };
+        enqueue(std::move(command));
+    }
+
+    void BusyConnection::copyIn(UpdateSuccessCallback onSuccess, UpdateErrorCallback onError, const std::string& table,
+                                const std::vector<std::string>& columns, std::vector<std::vector<std::any>>&& rows) {
+        auto source = std::make_shared<std::vector<std::vector<std::any>>>(std::move(rows));
+        auto next = std::make_shared<size_t>(0);
+        copyIn(onSuccess, onError, table, columns, [source, next](std::vector<std::any>& row) {
+            if (*next >= source->size())
+                return false;
+            row = std::move((*source)[(*next)++]);
+            return true;
         });
     }
 
+    void BusyConnection::copyOut(CopyOutSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::string& table,
+                                 const std::vector<std::string>& columns) {
+        // binary COPY has no column types, they are taken from an empty select
+        std::string probeQuery = "SELECT " + columnsList(columns) + " FROM " + table + " LIMIT 0";
+        std::string copyQuery = "COPY " + table + " (" + columnsList(columns) + ") TO STDOUT (FORMAT binary)";
+        Command command;
+        command.sendName = "PQsendQuery";
+        command.send = [probeQuery](PGconn* con) {
+            return 0 != PQsendQuery(con, probeQuery.c_str());
+        };
+        command.complete = [=](QueryResultsArr& results, const char* brokenAt) {
+            if (brokenAt != nullptr) {
+                parent_->checkAndResetAllConnections();
+                onError(std::string("PGPool connection is broken (") + brokenAt + ")");
+                return;
+            }
+            if (results.size() != 1 || results[0].isError()) {
+                onError(copyErrorText("copyOut", results));
+                return;
+            }
+            auto colTypes = results[0].getColTypes();
+            Command copy;
+            copy.sendName = "PQsendQuery";
+            copy.send = [copyQuery](PGconn* con) {
+                return 0 != PQsendQuery(con, copyQuery.c_str());
+            };
+            auto copyData = std::make_shared<byte_vector>();
+            copy.copyData = copyData;
+            copy.complete = [=](QueryResultsArr& results, const char* brokenAt) mutable {
+                if (brokenAt != nullptr) {
+                    parent_->checkAndResetAllConnections();
+                    onError(std::string("PGPool connection is broken (") + brokenAt + ")");
+                    return;
+                }
+                if (results.size() != 1 || results[0].isError()) {
+                    onError(copyErrorText("copyOut", results));
+                    return;
+                }
+                std::vector<std::vector<CopyValue>> rows;
+                try {
+                    rows = decodeCopyRows(*copyData);
+                } catch (const std::exception& e) {
+                    onError(std::string("PGPool.copyOut error: ") + e.what());
+                    return;
+                }
+                copyData.reset();
+                onSuccess(colTypes, rows);
+            };
+            commands_.push_front(std::move(copy));
+        };
+        enqueue(std::move(command));
+    }
+
+    void BusyConnection::exec(const std::string &query, QueryCallback callback) {
+        Command command;
+        command.sendName = "PQsendQuery";
+        command.send = [query](PGconn* con) {
+            return 0 != PQsendQuery(con, query.c_str());
+        };
+        command.complete = [callback](QueryResultsArr& results, const char* brokenAt) {
+            callback(results);
+        };
+        enqueue(std::move(command));
+    }
+
     void BusyConnection::release() {
         if (parent_ != nullptr)
             parent_->releaseConnection(getId());
     }
 
-    void BusyConnection::goResetCon() {
-        worker_([=]() {
-            bool isConOk = true;
-            if (0 == PQsendQuery(conPtr(), "SELECT 1;"))
-                isConOk = false;
-            if (isConOk) {
-                if (0 != PQflush(conPtr()))
-                    isConOk = false;
-            }
-            QueryResultsArr results;
-            if (isConOk) {
-                while (true) {
-                    pg_result *r = PQgetResult(conPtr());
-                    if (r == nullptr)
-                        break;
-                    results.push_back(QueryResult(this->parent_, r));
-                }
-            }
-            if (PQstatus(conPtr()) == CONNECTION_BAD)
-                isConOk = false;
-            if (!isConOk) {
-                this_thread::sleep_for(chrono::milliseconds(BROKEN_CONNECTION_RESET_DELAY_MILLIS));
-                PQreset(conPtr());
-            }
+    void BusyConnection::connect(std::function<void(bool isOk, const std::string& errText)>&& onConnected) {
+        auto self = shared_from_this();
+        loop_->post([self, onConnected{std::move(onConnected)}]() mutable {
+            self->onConnected_ = std::move(onConnected);
+            self->self_ = self;
+            self->state_ = State::CONNECTING;
+            if (PQstatus(self->conPtr()) == CONNECTION_BAD)
+                self->connectFinished(false);
+            else
+                // as libpq docs say, PQconnectStart behaves as if PQconnectPoll has returned PGRES_POLLING_WRITING
+                self->continueConnect(PGRES_POLLING_WRITING);
         });
     }
 
-    PGPool::PGPool(): poolControlThread_(1) {
+    void BusyConnection::goResetCon() {
+        Command command;
+        command.sendName = "PQsendQuery";
+        command.send = [](PGconn* con) {
+            return 0 != PQsendQuery(con, "SELECT 1;");
+        };
+        command.complete = [this](QueryResultsArr& results, const char* brokenAt) {
+            if (brokenAt != nullptr || PQstatus(conPtr()) == CONNECTION_BAD)
+                startReset();
+        };
+        enqueue(std::move(command));
     }
 
-    PGPool::PGPool(int poolSize, const std::string& connectString) : poolControlThread_(1) {
-        maxPoolSize_ = poolSize;
-        int curPoolSize = std::min(poolSize, stopSpawnConnectionsOnSize_);
-        conSpawner_ = [this,connectString](){
-            std::shared_ptr<PGconn> con;
-            con.reset(PQconnectdb(connectString.c_str()), &PQfinish);
-            return make_shared<BusyConnection>(this, con, nextConId_++);
-        };
-        for (int i = 0; i < curPoolSize; ++i) {
-            connPool_.push(conSpawner_());
+    void BusyConnection::shutdown() {
+        isShutdown_ = true;
+        closePoll();
+        if (resetTimer_ != nullptr) {
+            uv_close((uv_handle_t*) resetTimer_, deleteTimerHandle);
+            resetTimer_ = nullptr;
         }
-        loadOids();
+        // callers of dropped commands get an error rather than nothing
+        if (state_ == State::BUSY)
+            finishCommand("pool is closed");
+        state_ = State::IDLE;
+        failCommands("pool is closed");
+        // can be the last reference, so nothing is touched after it
+        auto self = std::move(self_);
     }
 
-    PGPool::PGPool(int poolSize, const std::string &host, int port, const std::string &dbname, const std::string &user,
-                   const std::string &pswd) : poolControlThread_(1) {
-        maxPoolSize_ = poolSize;
-        int curPoolSize = std::min(poolSize, stopSpawnConnectionsOnSize_);
-        conSpawner_ = [this,host,port,dbname,user,pswd](){
-            std::shared_ptr<PGconn> con;
-            con.reset(PQsetdbLogin(host.c_str(), std::to_string(port).c_str(), nullptr, nullptr, dbname.c_str(),
-                                   user.c_str(), pswd.c_str()), &PQfinish);
-            return make_shared<BusyConnection>(this, con, nextConId_++);
-        };
-        for (int i = 0; i < curPoolSize; ++i) {
-            connPool_.push(conSpawner_());
+    void BusyConnection::closeWhenIdle() {
+        // released connection could have statements to execute yet, it lives until it is done with them
+        isClosing_ = true;
+        if (state_ == State::IDLE && commands_.empty())
+            closePoll();
+    }
+
+    void BusyConnection::failCommands(const char* brokenAt) {
+        // complete callbacks could queue more commands, they fail too
+        while (!commands_.empty()) {
+            Command command = std::move(commands_.front());
+            commands_.pop_front();
+            QueryResultsArr results;
+            try {
+                command.complete(results, brokenAt);
+            } catch (const std::exception& e) {
+                cerr << "error in pg connection callback: " << e.what() << endl;
+            } catch (...) {
+                cerr << "unknown error in pg connection callback" << endl;
+            }
         }
-        loadOids();
     }
 
-    std::pair<bool,std::string> PGPool::connect(int poolSize, const std::string& connectString) {
-        if (poolSize < 1l)
-            return make_pair(false, "poolSize must be at least 1");
-        if (connPool_.size() > 0)
+    void BusyConnection::enqueue(Command&& command) {
+        auto self = shared_from_this();
+        loop_->post([self, command{std::move(command)}]() mutable {
+            self->commands_.emplace_back(std::move(command));
+            self->processNext();
+        });
+    }
+
+    void BusyConnection::processNext() {
+        if (isShutdown_) {
+            failCommands("pool is closed");
+            return;
+        }
+        while (state_ == State::IDLE && !isCancelling_ && !commands_.empty()) {
+            auto& front = commands_.front();
+            if (!front.statements.empty() && !front.isPrepareChecked) {
+                front.isPrepareChecked = true;
+                // statements worth preparing get PQsendPrepare commands in front of the queue
+                if (prepareStatements(front))
+                    continue;
+            }
+            current_ = std::move(commands_.front());
+            commands_.pop_front();
+            results_.clear();
+            pipelineEnds_ = 0;
+            copyPos_ = 0;
+            if (!sendCommand(current_)) {
+                closePoll();
+                finishCommand(current_.sendName);
+                continue;
+            }
+            state_ = State::BUSY;
+            self_ = shared_from_this();
+            flushing_ = true;
+            flush();
+        }
+        if (state_ == State::IDLE) {
+            if (isClosing_)
+                closePoll();
+            else
+                stopWatching();
+            // can be the last reference, so nothing is touched after it
+            auto self = std::move(self_);
+        }
+    }
+
+    void BusyConnection::finishCommand(const char* brokenAt) {
+        state_ = State::IDLE;
+        flushing_ = false;
+        isCopyingIn_ = false;
+        isStreamPaused_ = false;
+        Command command = std::move(current_);
+        QueryResultsArr results = std::move(results_);
+        results_.clear();
+        if (!command.statements.empty() && brokenAt == nullptr)
+            checkPreparedResults(command, results);
+        try {
+            command.complete(results, brokenAt);
+        } catch (const std::exception& e) {
+            cerr << "error in pg connection callback: " << e.what() << endl;
+        } catch (...) {
+            cerr << "unknown error in pg connection callback" << endl;
+        }
+    }
+
+    void BusyConnection::passRowsBatch() {
+        QueryResultsArr rows = std::move(results_);
+        results_.clear();
+        try {
+            isStreamPaused_ = current_.onRowsBatch(rows);
+        } catch (const std::exception& e) {
+            cerr << "error in pg connection callback: " << e.what() << endl;
+        } catch (...) {
+            cerr << "unknown error in pg connection callback" << endl;
+        }
+    }
+
+    void BusyConnection::flush() {
+        int res = PQflush(conPtr());
+        if (res == 0)
+            flushing_ = false;
+        if (res < 0 || !watch(flushing_ ? UV_READABLE | UV_WRITABLE : UV_READABLE, onQuerySocket)) {
+            closePoll();
+            finishCommand("PQflush");
+        }
+    }
+
+    static const size_t COPY_CHUNK_SIZE = 64 * 1024;
+
+    bool BusyConnection::writeCopyData() {
+        PGconn* con = conPtr();
+        auto& encoder = current_.copyEncoder;
+        auto& data = current_.copyData;
+        while (isCopyingIn_) {
+            if (flushing_) {
+                flush();
+                // the socket is watched for writing until libpq sends its buffer
+                if (flushing_ || state_ != State::BUSY)
+                    return false;
+            }
+            if (encoder && copyPos_ >= data->size() && !encoder->isDone()) {
+                // next rows are encoded only when the previous chunk is sent
+                data->clear();
+                copyPos_ = 0;
+                encoder->encode(*data, COPY_CHUNK_SIZE);
+            }
+            int res;
+            const char* sendName;
+            if (encoder && encoder->getError().empty() && copyPos_ < data->size()) {
+                // by chunks, so libpq doesn't copy all the data into its buffer at once
+                int size = (int) std::min(COPY_CHUNK_SIZE, data->size() - copyPos_);
+                res = PQputCopyData(con, (const char*) data->data() + copyPos_, size);
+                if (res > 0)
+                    copyPos_ += size;
+                sendName = "PQputCopyData";
+            } else {
+                const char* errorMessage = nullptr;
+                if (!encoder)
+                    errorMessage = "PGPool: no data for COPY FROM STDIN, use copyIn";
+                else if (!encoder->getError().empty())
+                    errorMessage = encoder->getError().c_str();
+                res = PQputCopyEnd(con, errorMessage);
+                if (res > 0)
+                    isCopyingIn_ = false;
+                sendName = "PQputCopyEnd";
+            }
+            if (res < 0) {
+                closePoll();
+                finishCommand(sendName);
+                return false;
+            }
+            // zero res means the buffer of libpq is full, the data go after it is flushed
+            flushing_ = true;
+        }
+        flush();
+        return state_ == State::BUSY;
+    }
+
+    bool BusyConnection::readCopyData() {
+        PGconn* con = conPtr();
+        while (true) {
+            char* buffer = nullptr;
+            int size = PQgetCopyData(con, &buffer, 1);
+            if (size == 0)
+                // waiting for the rest of data
+                return false;
+            if (size < 0)
+                // -1 is the end of data and -2 is an error, the result of the command follows in both cases
+                return true;
+            if (current_.copyData)
+                current_.copyData->insert(current_.copyData->end(), buffer, buffer + size);
+            PQfreemem(buffer);
+        }
+    }
+
+    void BusyConnection::onQuerySocket(uv_poll_t* handle, int status, int events) {
+        auto self = ((BusyConnection*) handle->data)->self_;
+        auto con = self->conPtr();
+        if (status < 0) {
+            self->closePoll();
+            self->finishCommand("PQsocket");
+            self->processNext();
+            return;
+        }
+        if ((events & UV_WRITABLE) && self->flushing_) {
+            self->flush();
+            if (self->state_ != State::BUSY) {
+                self->processNext();
+                return;
+            }
+        }
+        if (self->isCopyingIn_ && !self->flushing_ && !self->writeCopyData()) {
+            if (self->state_ != State::BUSY)
+                self->processNext();
+            return;
+        }
+        if (events & UV_READABLE) {
+            if (0 == PQconsumeInput(con)) {
+                self->closePoll();
+                self->finishCommand("PQconsumeInput");
+                self->processNext();
+                return;
+            }
+            // as libpq docs say, PQflush should be repeated after the socket becomes readable
+            if (self->flushing_) {
+                self->flush();
+                if (self->state_ != State::BUSY) {
+                    self->processNext();
+                    return;
+                }
+            }
+            while (0 == PQisBusy(con)) {
+                pg_result *r = PQgetResult(con);
+                bool isBroken = PQstatus(con) == CONNECTION_BAD;
+                int pipelineSize = self->current_.pipelineSize;
+                if (r == nullptr && pipelineSize > 0 && !isBroken && self->pipelineEnds_++ < pipelineSize)
+                    // end of results of one statement, the next one or PGRES_PIPELINE_SYNC follow
+                    continue;
+#ifdef LIBPQ_HAS_PIPELINING
+                if (r != nullptr && PQresultStatus(r) == PGRES_PIPELINE_SYNC) {
+                    PQclear(r);
+                    PQexitPipelineMode(con);
+                    r = nullptr;
+                }
+#endif
+                if (r != nullptr && PQresultStatus(r) == PGRES_COPY_IN) {
+                    // returned again and again until all the data is sent
+                    PQclear(r);
+                    self->isCopyingIn_ = true;
+                    if (!self->writeCopyData()) {
+                        if (self->state_ != State::BUSY)
+                            self->processNext();
+                        return;
+                    }
+                    continue;
+                }
+                if (r != nullptr && PQresultStatus(r) == PGRES_COPY_OUT) {
+                    PQclear(r);
+                    if (!self->readCopyData())
+                        return;
+                    continue;
+                }
+                if (r == nullptr) {
+                    if (isBroken)
+                        self->closePoll();
+                    self->finishCommand(isBroken ? "PQgetResult" : nullptr);
+                    self->processNext();
+                    return;
+                }
+                bool isSingleTuple = PQresultStatus(r) == PGRES_SINGLE_TUPLE;
+                // the last batch is passed before the query is finished, so onDone waits for it to be processed
+                bool isLastBatch = PQresultStatus(r) == PGRES_TUPLES_OK && self->current_.rowsBatchSize > 0 &&
+                                   !self->results_.empty();
+                if (isLastBatch)
+                    self->passRowsBatch();
+                self->results_.push_back(QueryResult(self->parent_, r));
+                if (isSingleTuple && (int) self->results_.size() >= self->current_.rowsBatchSize)
+                    self->passRowsBatch();
+                if (self->isStreamPaused_) {
+                    // the socket isn't read until the batch is processed, so the server waits for it too
+                    self->stopWatching();
+                    return;
+                }
+            }
+        }
+    }
+
+    void BusyConnection::continueConnect(PostgresPollingStatusType pollingStatus) {
+        switch (pollingStatus) {
+            case PGRES_POLLING_READING:
+                if (watch(UV_READABLE, onConnectSocket))
+                    return;
+                break;
+            case PGRES_POLLING_WRITING:
+                if (watch(UV_WRITABLE, onConnectSocket))
+                    return;
+                break;
+            case PGRES_POLLING_OK:
+                connectFinished(true);
+                return;
+            default:
+                break;
+        }
+        connectFinished(false);
+    }
+
+    void BusyConnection::onConnectSocket(uv_poll_t* handle, int status, int events) {
+        auto self = ((BusyConnection*) handle->data)->self_;
+        if (status < 0) {
+            self->connectFinished(false);
+            return;
+        }
+        // libpq may close the socket and open another one here, watch() checks it
+        if (self->state_ == State::RESETTING)
+            self->continueConnect(PQresetPoll(self->conPtr()));
+        else
+            self->continueConnect(PQconnectPoll(self->conPtr()));
+    }
+
+    void BusyConnection::connectFinished(bool isOk) {
+        bool isResetting = state_ == State::RESETTING;
+        // prepared statements belong to the server session, which is new now
+        clearPrepared();
+        if (isOk) {
+            stopWatching();
+            PQsetnonblocking(conPtr(), 1);
+            resetAttempts_ = 0;
+        } else {
+            closePoll();
+        }
+        state_ = State::IDLE;
+        if (onConnected_) {
+            auto onConnected = std::move(onConnected_);
+            onConnected_ = nullptr;
+            try {
+                onConnected(isOk, isOk ? std::string() : std::string(PQerrorMessage(conPtr())));
+            } catch (const std::exception& e) {
+                cerr << "error in pg connection callback: " << e.what() << endl;
+            }
+        }
+        // with nothing to fail, the next attempt is made without waiting for statements to find the connection broken
+        if (!isOk && isResetting && commands_.empty()) {
+            startReset();
+            return;
+        }
+        processNext();
+    }
+
+    void BusyConnection::startReset() {
+        if (isShutdown_)
+            return;
+        closePoll();
+        state_ = State::RESET_DELAY;
+        int delay = std::min(BROKEN_CONNECTION_RESET_MIN_DELAY_MILLIS << std::min(resetAttempts_, 16),
+                             BROKEN_CONNECTION_RESET_DELAY_MILLIS);
+        ++resetAttempts_;
+        ++parent_->poolStats_.resets;
+        self_ = shared_from_this();
+        resetTimer_ = new uv_timer_t;
+        uv_timer_init(loop_->getLoop(), resetTimer_);
+        resetTimer_->data = this;
+        uv_timer_start(resetTimer_, [](uv_timer_t* timer) {
+            auto self = ((BusyConnection*) timer->data)->self_;
+            uv_close((uv_handle_t*) timer, deleteTimerHandle);
+            self->resetTimer_ = nullptr;
+            self->state_ = State::RESETTING;
+            if (0 == PQresetStart(self->conPtr()))
+                self->connectFinished(false);
+            else
+                self->continueConnect(PGRES_POLLING_WRITING);
+        }, (uint64_t) delay, 0);
+    }
+
+    bool BusyConnection::watch(int events, uv_poll_cb callback) {
+        int fd = PQsocket(conPtr());
+        if (fd < 0)
+            return false;
+        if (poll_ != nullptr && pollFd_ != fd)
+            closePoll();
+        if (poll_ == nullptr) {
+            auto poll = new uv_poll_t;
+            if (uv_poll_init_socket(loop_->getLoop(), poll, fd) != 0) {
+                delete poll;
+                return false;
+            }
+            poll->data = this;
+            poll_ = poll;
+            pollFd_ = fd;
+        }
+        return 0 == uv_poll_start(poll_, events, callback);
+    }
+
+    void BusyConnection::stopWatching() {
+        if (poll_ != nullptr)
+            uv_poll_stop(poll_);
+    }
+
+    void BusyConnection::closePoll() {
+        // libuv forgets the socket here, so it should be called before libpq closes the socket or right after it
+        if (poll_ != nullptr) {
+            uv_close((uv_handle_t*) poll_, deletePollHandle);
+            poll_ = nullptr;
+            pollFd_ = -1;
+        }
+    }
+
+    PGPool::PGPool(): poolControlThread_(1), cancelThread_(1) {
+    }
+
+    PGPool::PGPool(int poolSize, const std::string& connectString) : poolControlThread_(1), cancelThread_(1) {
+        maxPoolSize_ = poolSize;
+        minPoolSize_ = std::min(poolSize, MIN_POOL_SIZE);
+        conSpawner_ = [this,connectString](){
+            std::shared_ptr<PGconn> con;
+            con.reset(PQconnectStart(connectString.c_str()), &PQfinish);
+            return make_shared<BusyConnection>(this, con, nextConId_++);
+        };
+        for (int i = 0; i < minPoolSize_; ++i) {
+            freeConnections_.push_back(FreeConnection{spawnConnection(), std::chrono::steady_clock::now()});
+        }
+        startMaintenance();
+        loadOids();
+    }
+
+    PGPool::PGPool(int poolSize, const std::string &host, int port, const std::string &dbname, const std::string &user,
+                   const std::string &pswd) : poolControlThread_(1), cancelThread_(1) {
+        maxPoolSize_ = poolSize;
+        minPoolSize_ = std::min(poolSize, MIN_POOL_SIZE);
+        conSpawner_ = [this,host,port,dbname,user,pswd](){
+            std::string portStr = std::to_string(port);
+            const char* keywords[] = {"host", "port", "dbname", "user", "password", nullptr};
+            const char* values[] = {host.c_str(), portStr.c_str(), dbname.c_str(), user.c_str(), pswd.c_str(), nullptr};
+            std::shared_ptr<PGconn> con;
+            con.reset(PQconnectStartParams(keywords, values, 0), &PQfinish);
+            return make_shared<BusyConnection>(this, con, nextConId_++);
+        };
+        for (int i = 0; i < minPoolSize_; ++i) {
+            freeConnections_.push_back(FreeConnection{spawnConnection(), std::chrono::steady_clock::now()});
+        }
+        startMaintenance();
+        loadOids();
+    }
+
+    PGPool::~PGPool() {
+        std::vector<std::shared_ptr<BusyConnection>> connections;
+        std::deque<Waiter> waiters;
+        {
+            std::lock_guard guard(poolMutex_);
+            isClosed_ = true;
+            for (auto& fc: freeConnections_)
+                connections.push_back(fc.con);
+            freeConnections_.clear();
+            for (auto& it: usedConnections_)
+                connections.push_back(it.second);
+            usedConnections_.clear();
+            waiters.swap(waiters_);
+        }
+        // statements of waiters fail in the loop thread before it stops
+        failWaiters(std::move(waiters));
+        // connections use the pool from the loop thread, so they are stopped while the pool is still alive
+        Semaphore sem;
+        loop_.post([this,connections,&sem]() {
+            if (maintenanceTimer_ != nullptr) {
+                uv_close((uv_handle_t*) maintenanceTimer_, deleteTimerHandle);
+                maintenanceTimer_ = nullptr;
+            }
+            if (groupCommitTimer_ != nullptr) {
+                uv_close((uv_handle_t*) groupCommitTimer_, deleteTimerHandle);
+                groupCommitTimer_ = nullptr;
+            }
+            if (replicasTimer_ != nullptr) {
+                uv_close((uv_handle_t*) replicasTimer_, deleteTimerHandle);
+                replicasTimer_ = nullptr;
+            }
+            for (auto& con: connections)
+                con->shutdown();
+            sem.notify();
+        });
+        sem.wait();
+        std::deque<GroupCommitCall> calls;
+        {
+            std::lock_guard guard(groupCommitMutex_);
+            calls.swap(groupCommitCalls_);
+        }
+        for (auto& call: calls)
+            call.onError("PGPool is closed");
+    }
+
+    std::shared_ptr<BusyConnection> PGPool::spawnConnection(std::function<void(bool, const std::string&)>&& onConnected) {
+        auto con = conSpawner_();
+        con->connect(std::move(onConnected));
+        return con;
+    }
+
+    std::pair<bool,std::string> PGPool::connect(int poolSize, const std::string& connectString) {
+        if (poolSize < 1l)
+            return make_pair(false, "poolSize must be at least 1");
+        if (totalConnections() > 0)
             return make_pair(false, "pgPool is already connected");
         maxPoolSize_ = poolSize;
-        int curPoolSize = std::min(poolSize, stopSpawnConnectionsOnSize_);
+        minPoolSize_ = std::min(poolSize, MIN_POOL_SIZE);
         conSpawner_ = [connectString,this](){
             std::shared_ptr<PGconn> con;
-            pg_conn* pCon = PQconnectdb(connectString.c_str());
-            if (PQstatus(pCon) == CONNECTION_OK) {
-                con.reset(pCon, &PQfinish);
-                auto bcon = make_shared<BusyConnection>(this, con, nextConId_++);
-                return bcon;
-            }
-            throw std::runtime_error(std::string(PQerrorMessage(pCon)));
+            con.reset(PQconnectStart(connectString.c_str()), &PQfinish);
+            return make_shared<BusyConnection>(this, con, nextConId_++);
         };
-        for (int i = 0; i < curPoolSize; ++i) {
-            try {
-                connPool_.push(conSpawner_());
-            } catch (const std::exception& e) {
-                return make_pair(false, std::string("unable to connect db: ")+e.what());
-            }
+        // connections are established concurrently in the loop thread
+        Semaphore sem;
+        std::mutex errMutex;
+        std::string connectError;
+        std::vector<std::shared_ptr<BusyConnection>> connections;
+        for (int i = 0; i < minPoolSize_; ++i) {
+            connections.push_back(spawnConnection([&sem,&errMutex,&connectError](bool isOk, const std::string& errText) {
+                if (!isOk) {
+                    std::lock_guard guard(errMutex);
+                    if (connectError.empty())
+                        connectError = errText;
+                }
+                sem.notify();
+            }));
         }
+        for (int i = 0; i < minPoolSize_; ++i)
+            sem.wait();
+        if (connectError.length() > 0)
+            return make_pair(false, std::string("unable to connect db: ") + connectError);
+        {
+            std::lock_guard guard(poolMutex_);
+            for (auto& con: connections)
+                freeConnections_.push_back(FreeConnection{con, std::chrono::steady_clock::now()});
+        }
+        startMaintenance();
         std::string err = loadOids();
         if (err.length() > 0l)
             return make_pair(false, err);
@@ -465,48 +1523,95 @@ namespace db {
     }
 
     void PGPool::withConnection(WithConnectionCallbackJs callback) {
-        poolControlThread_.execute([callback, this]() {
-            auto con = getUnusedConnection();
-            if (con != nullptr) {
-                callback(con);
-            } else {
-                //cerr << "PGPool warning: withConnection was called on closed pool" << endl;
-            }
-        });
+        acquire(AcquireCallback(callback));
     }
 
     void PGPool::withConnection(WithConnectionCallback callback) {
-        poolControlThread_.execute([callback, this]() {
-            auto con = getUnusedConnection();
+        acquire([callback](std::shared_ptr<BusyConnection> con) {
             callback(*con);
             con->release();
         });
     }
 
+    void PGPool::acquire(AcquireCallback&& callback) {
+        std::shared_ptr<BusyConnection> con;
+        {
+            std::lock_guard guard(poolMutex_);
+            if (isClosed_) {
+                // statements of the closed connection fail, so the caller gets an error instead of nothing
+                con = closedConnection();
+            // earlier waiters go first
+            } else if (waiters_.empty() && !freeConnections_.empty()) {
+                con = std::move(freeConnections_.front().con);
+                freeConnections_.pop_front();
+                usedConnections_[con->getId()] = con;
+                minFreeCount_ = std::min(minFreeCount_, (int) freeConnections_.size());
+            } else if (waiters_.empty() && (int) (usedConnections_.size() + freeConnections_.size()) + spawningCount_ < maxPoolSize_) {
+                // nothing is free, so one more connection is opened instead of waiting; statements wait for it to connect
+                ++spawningCount_;
+                minFreeCount_ = 0;
+            } else {
+                minFreeCount_ = 0;
+                waiters_.push_back(Waiter{std::move(callback), std::chrono::steady_clock::now()});
+                ++poolStats_.waits;
+                return;
+            }
+        }
+        if (con == nullptr) {
+            // PQconnectStart could resolve the host name, so it is called out of the lock
+            con = spawnConnection();
+            ++poolStats_.spawned;
+            std::lock_guard guard(poolMutex_);
+            --spawningCount_;
+            usedConnections_[con->getId()] = con;
+        }
+        ++poolStats_.acquisitions;
+        callback(con);
+    }
+
+    std::shared_ptr<BusyConnection> PGPool::closedConnection() {
+        auto con = std::make_shared<BusyConnection>(this, std::shared_ptr<PGconn>(), -1);
+        // nothing is started yet, so it is safe out of the loop thread
+        con->shutdown();
+        return con;
+    }
+
+    void PGPool::failWaiters(std::deque<Waiter>&& waiters) {
+        for (auto& waiter: waiters)
+            waiter.callback(closedConnection());
+    }
+
     size_t PGPool::totalConnections() {
         std::lock_guard guard(poolMutex_);
-        return connPool_.size() + usedConnections_.size();
+        return freeConnections_.size() + usedConnections_.size();
+    }
+
+    PreparedStatementsStats PGPool::getPreparedStatementsStats() {
+        return PreparedStatementsStats{preparedStats_.hits, preparedStats_.misses, preparedStats_.prepared, preparedStats_.evictions};
+    }
+
+    PoolStats PGPool::getPoolStats() {
+        PoolStats res;
+        {
+            std::lock_guard guard(poolMutex_);
+            res.total = (int) (freeConnections_.size() + usedConnections_.size());
+            res.inUse = (int) usedConnections_.size();
+            res.waiting = (int) waiters_.size();
+        }
+        res.acquisitions = poolStats_.acquisitions;
+        res.waits = poolStats_.waits;
+        res.waitMicrosTotal = poolStats_.waitMicrosTotal;
+        res.waitMicrosMax = poolStats_.waitMicrosMax;
+        res.spawned = poolStats_.spawned;
+        res.closed = poolStats_.closed;
+        res.resets = poolStats_.resets;
+        res.primaryReads = poolStats_.primaryReads;
+        return res;
     }
 
     size_t PGPool::availableConnections() {
         std::lock_guard guard(poolMutex_);
-        return connPool_.size();
-    }
-
-    std::shared_ptr<BusyConnection> PGPool::getUnusedConnection() {
-        std::unique_lock lock(poolMutex_);
-        while (connPool_.empty())
-            poolCV_.wait(lock);
-        auto con = connPool_.front();
-        if (con == nullptr)
-            return nullptr;
-        connPool_.pop();
-        usedConnections_[con->getId()] = con;
-        size_t totalConnsCount = connPool_.size() + usedConnections_.size();
-        if (connPool_.empty())
-            if (totalConnsCount < maxPoolSize_)
-                connPool_.push(conSpawner_());
-        return con;
+        return freeConnections_.size();
     }
 
     string PGPool::loadOids() {
@@ -533,41 +1638,683 @@ namespace db {
     }
 
     void PGPool::releaseConnection(std::shared_ptr<BusyConnection> con) {
-        std::lock_guard guard(poolMutex_);
-        connPool_.push(con);
-        usedConnections_.erase(con->getId());
-        poolCV_.notify_one();
+        releaseConnection(con->getId());
     }
 
     void PGPool::releaseConnection(int conId) {
-        std::lock_guard guard(poolMutex_);
-        connPool_.push(usedConnections_[conId]);
-        usedConnections_.erase(conId);
-        poolCV_.notify_one();
+        std::shared_ptr<BusyConnection> con;
+        Waiter waiter;
+        {
+            std::lock_guard guard(poolMutex_);
+            auto it = usedConnections_.find(conId);
+            // released twice, or the pool is closed
+            if (it == usedConnections_.end())
+                return;
+            if (waiters_.empty()) {
+                freeConnections_.push_back(FreeConnection{std::move(it->second), std::chrono::steady_clock::now()});
+                usedConnections_.erase(it);
+                return;
+            }
+            // passed to the waiter as is, stays used
+            con = it->second;
+            waiter = std::move(waiters_.front());
+            waiters_.pop_front();
+        }
+        long long waitMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - waiter.since).count();
+        poolStats_.waitMicrosTotal += waitMicros;
+        long long maxWait = poolStats_.waitMicrosMax;
+        while (waitMicros > maxWait && !poolStats_.waitMicrosMax.compare_exchange_weak(maxWait, waitMicros));
+        ++poolStats_.acquisitions;
+        poolControlThread_.execute([callback{std::move(waiter.callback)}, con]() {
+            callback(con);
+        });
     }
 
     void PGPool::checkAndResetAllConnections() {
-        std::vector<int> idsVec;
+        std::vector<std::shared_ptr<BusyConnection>> connections;
         {
             std::lock_guard guard(poolMutex_);
-            while (!connPool_.empty()) {
-                auto con = connPool_.front();
-                connPool_.pop();
-                usedConnections_[con->getId()] = con;
-                idsVec.push_back(con->getId());
+            for (auto& fc: freeConnections_)
+                connections.push_back(fc.con);
+            for (auto& it: usedConnections_)
+                connections.push_back(it.second);
+        }
+        for (auto& con: connections)
+            con->goResetCon();
+    }
+
+    void PGPool::startMaintenance() {
+        loop_.post([this]() {
+            if (maintenanceTimer_ != nullptr)
+                return;
+            maintenanceTimer_ = new uv_timer_t;
+            uv_timer_init(loop_.getLoop(), maintenanceTimer_);
+            maintenanceTimer_->data = this;
+            uv_timer_start(maintenanceTimer_, [](uv_timer_t* timer) {
+                ((PGPool*) timer->data)->maintain();
+            }, HEALTH_CHECK_INTERVAL_MILLIS, HEALTH_CHECK_INTERVAL_MILLIS);
+        });
+    }
+
+    void PGPool::maintain() {
+        auto now = std::chrono::steady_clock::now();
+        std::vector<std::shared_ptr<BusyConnection>> idle;
+        std::vector<std::shared_ptr<BusyConnection>> toCheck;
+        {
+            std::lock_guard guard(poolMutex_);
+            if (isClosed_)
+                return;
+            // connections that stayed free all the time since the last shrink are not needed
+            idleFreeCount_ = std::min(idleFreeCount_, minFreeCount_);
+            minFreeCount_ = (int) freeConnections_.size();
+            ++idleChecksCount_;
+            if (idleFreeCount_ == 0) {
+                idleChecksCount_ = 0;
+                idleFreeCount_ = INT_MAX;
+            } else if (idleChecksCount_ * HEALTH_CHECK_INTERVAL_MILLIS >= POOL_IDLE_TIMEOUT_MILLIS) {
+                int total = (int) (freeConnections_.size() + usedConnections_.size());
+                int count = std::min({idleFreeCount_, total - minPoolSize_, (int) freeConnections_.size()});
+                // ones that are free longest are closed
+                for (int i = 0; i < count; ++i) {
+                    idle.push_back(std::move(freeConnections_.front().con));
+                    freeConnections_.pop_front();
+                }
+                idleChecksCount_ = 0;
+                idleFreeCount_ = INT_MAX;
+                minFreeCount_ = (int) freeConnections_.size();
             }
-            for (auto& con: usedConnections_)
-                con.second->goResetCon();
+            for (auto& fc: freeConnections_)
+                if (now - fc.since >= std::chrono::milliseconds(HEALTH_CHECK_INTERVAL_MILLIS))
+                    toCheck.push_back(fc.con);
         }
-        for (auto it = idsVec.begin(); it != idsVec.end(); ++it)
-            releaseConnection(*it);
+        for (auto& con: idle)
+            con->closeWhenIdle();
+        poolStats_.closed += (long long) idle.size();
+        // broken ones are reset by the check
+        for (auto& con: toCheck)
+            con->goResetCon();
     }
 
     void PGPool::close() {
-        std::lock_guard guard(poolMutex_);
-        while (!connPool_.empty())
-            connPool_.pop();
-        usedConnections_.clear();
+        std::deque<Waiter> waiters;
+        {
+            std::lock_guard guard(poolMutex_);
+            isClosed_ = true;
+            freeConnections_.clear();
+            usedConnections_.clear();
+            waiters.swap(waiters_);
+        }
+        failWaiters(std::move(waiters));
+        std::lock_guard guard(replicasMutex_);
+        for (auto& replica: replicas_)
+            replica->pool->close();
+    }
+
+    std::pair<bool,std::string> PGPool::addReplica(int poolSize, const std::string& connectString) {
+        auto replica = std::make_unique<Replica>();
+        replica->pool = std::make_unique<PGPool>();
+        auto res = replica->pool->connect(poolSize, connectString);
+        if (!res.first)
+            return res;
+        {
+            std::lock_guard guard(replicasMutex_);
+            replicas_.push_back(std::move(replica));
+        }
+        loop_.post([this]() {
+            if (replicasTimer_ == nullptr) {
+                replicasTimer_ = new uv_timer_t;
+                uv_timer_init(loop_.getLoop(), replicasTimer_);
+                replicasTimer_->data = this;
+                uv_timer_start(replicasTimer_, [](uv_timer_t* timer) {
+                    ((PGPool*) timer->data)->checkReplicas();
+                }, REPLICA_CHECK_INTERVAL_MILLIS, REPLICA_CHECK_INTERVAL_MILLIS);
+            }
+            // new replica gets reads after its first check
+            checkReplicas();
+        });
+        return res;
+    }
+
+    void PGPool::checkReplicas() {
+        std::vector<Replica*> replicas;
+        {
+            std::lock_guard guard(replicasMutex_);
+            for (auto& replica: replicas_)
+                replicas.push_back(replica.get());
+        }
+        long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        for (auto replica: replicas) {
+            if (replica->isChecking) {
+                if (now - replica->checkStartedMillis < REPLICA_CHECK_TIMEOUT_MILLIS)
+                    continue;
+                // replica that doesn't answer is not healthy, and the hung check is forgotten
+                replica->isHealthy = false;
+                ++replica->failedChecks;
+            }
+            long long checkId = ++replica->checkId;
+            replica->isChecking = true;
+            replica->checkStartedMillis = now;
+            // results of a forgotten check are ignored
+            auto finishCheck = [replica,checkId](bool isHealthy, long long lagMillis) {
+                if (replica->checkId != checkId)
+                    return;
+                if (isHealthy)
+                    replica->lagMillis = lagMillis;
+                else
+                    ++replica->failedChecks;
+                replica->isHealthy = isHealthy;
+                replica->isChecking = false;
+            };
+            replica->pool->withConnection([finishCheck](std::shared_ptr<BusyConnection> con) {
+                // caught up replica has replayed all it has received, though its last replayed transaction is old
+                con->executeQuery([finishCheck,con](QueryResult&& qr) {
+                    con->release();
+                    try {
+                        finishCheck(true, getLongValue(qr.getValueByIndex(0, 0)));
+                    } catch (const std::exception& e) {
+                        finishCheck(false, 0);
+                    }
+                }, [finishCheck,con](const std::string& errText) {
+                    con->release();
+                    finishCheck(false, 0);
+                }, "SELECT CASE WHEN NOT pg_is_in_recovery() THEN 0 "
+                   "WHEN pg_last_wal_receive_lsn() = pg_last_wal_replay_lsn() THEN 0 "
+                   "ELSE COALESCE(EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()) * 1000, 0) END::bigint");
+            });
+        }
+    }
+
+    PGPool* PGPool::readPool(int maxStalenessMillis) {
+        if (maxStalenessMillis > 0) {
+            Replica* best = nullptr;
+            int bestFree = 0;
+            std::lock_guard guard(replicasMutex_);
+            for (auto& replica: replicas_) {
+                if (!replica->isHealthy || replica->lagMillis > maxStalenessMillis)
+                    continue;
+                // replica that can open more connections is as good as one with free ones; busy replicas are
+                // still preferred to the pool, so that reads don't take connections of writes. Equally free
+                // replicas take reads in turn.
+                auto stats = replica->pool->getPoolStats();
+                int free = replica->pool->maxPoolSize_ - stats.inUse - stats.waiting;
+                if (best == nullptr || free > bestFree || (free == bestFree && replica->reads < best->reads)) {
+                    best = replica.get();
+                    bestFree = free;
+                }
+            }
+            if (best != nullptr) {
+                ++best->reads;
+                return best->pool.get();
+            }
+        }
+        ++poolStats_.primaryReads;
+        return this;
+    }
+
+    void PGPool::withReadConnection(int maxStalenessMillis, WithConnectionCallback callback) {
+        readPool(maxStalenessMillis)->withConnection(callback);
+    }
+
+    void PGPool::withReadConnection(int maxStalenessMillis, WithConnectionCallbackJs callback) {
+        readPool(maxStalenessMillis)->withConnection(callback);
+    }
+
+    std::vector<ReplicaStats> PGPool::getReplicaStats() {
+        std::vector<ReplicaStats> res;
+        std::lock_guard guard(replicasMutex_);
+        for (auto& replica: replicas_) {
+            auto stats = replica->pool->getPoolStats();
+            res.push_back(ReplicaStats{replica->isHealthy, replica->lagMillis, stats.total, stats.inUse,
+                                       replica->reads, replica->failedChecks});
+        }
+        return res;
+    }
+
+    static int histogramBucket(long long value) {
+        int bucket = 0;
+        while (value > 1 && bucket < GROUP_COMMIT_HISTOGRAM_SIZE - 1) {
+            value >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    void PGPool::setGroupCommit(int windowMillis, int maxBatchSize) {
+        std::lock_guard guard(groupCommitMutex_);
+        groupCommitWindowMillis_ = std::max(windowMillis, 0);
+        groupCommitMaxBatchSize_ = std::max(maxBatchSize, 1);
+    }
+
+    GroupCommitStats PGPool::getGroupCommitStats() {
+        std::lock_guard guard(groupCommitMutex_);
+        return groupCommitStats_;
+    }
+
+    bool PGPool::hasPipelining() {
+#ifdef LIBPQ_HAS_PIPELINING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void PGPool::groupCommit(std::vector<BatchStatement>&& statements, GroupCommitSuccessCallback&& onSuccess,
+                             GroupCommitErrorCallback&& onError, bool stringsAsText) {
+        bool executeNow = false;
+        bool startTimer = false;
+        int windowMillis;
+        {
+            std::lock_guard guard(groupCommitMutex_);
+            groupCommitCalls_.push_back(GroupCommitCall{std::move(statements), std::move(onSuccess), std::move(onError),
+                                                        stringsAsText, std::chrono::steady_clock::now()});
+            bool isFull = (int) groupCommitCalls_.size() >= groupCommitMaxBatchSize_;
+            windowMillis = groupCommitWindowMillis_;
+            if (groupCommitState_ == GroupCommitState::IDLE && windowMillis > 0 && !isFull) {
+                groupCommitState_ = GroupCommitState::COLLECTING;
+                startTimer = true;
+            } else if (groupCommitState_ != GroupCommitState::EXECUTING && (windowMillis == 0 || isFull)) {
+                // window timer, if started, finds the batch executing and does nothing
+                groupCommitState_ = GroupCommitState::EXECUTING;
+                executeNow = true;
+            }
+        }
+        if (executeNow)
+            executeGroupCommit();
+        else if (startTimer)
+            loop_.post([this, windowMillis]() {
+                if (groupCommitTimer_ == nullptr) {
+                    groupCommitTimer_ = new uv_timer_t;
+                    uv_timer_init(loop_.getLoop(), groupCommitTimer_);
+                    groupCommitTimer_->data = this;
+                }
+                uv_timer_start(groupCommitTimer_, [](uv_timer_t* timer) {
+                    auto pool = (PGPool*) timer->data;
+                    {
+                        std::lock_guard guard(pool->groupCommitMutex_);
+                        if (pool->groupCommitState_ != GroupCommitState::COLLECTING)
+                            return;
+                        pool->groupCommitState_ = GroupCommitState::EXECUTING;
+                    }
+                    pool->executeGroupCommit();
+                }, (uint64_t) windowMillis, 0);
+            });
+    }
+
+    void PGPool::executeGroupCommit() {
+        auto batch = std::make_shared<std::vector<GroupCommitCall>>();
+        {
+            std::lock_guard guard(groupCommitMutex_);
+#ifdef LIBPQ_HAS_PIPELINING
+            int maxBatchSize = groupCommitMaxBatchSize_;
+#else
+            // statements are sent one by one and commit separately, so calls can't be grouped
+            int maxBatchSize = 1;
+#endif
+            // executeBatch passes all strings the same way
+            while (!groupCommitCalls_.empty() && (int) batch->size() < maxBatchSize &&
+                   (batch->empty() || groupCommitCalls_.front().stringsAsText == batch->front().stringsAsText)) {
+                batch->push_back(std::move(groupCommitCalls_.front()));
+                groupCommitCalls_.pop_front();
+            }
+            if (batch->empty()) {
+                groupCommitState_ = GroupCommitState::IDLE;
+                return;
+            }
+        }
+        bool isClosed;
+        {
+            std::lock_guard guard(poolMutex_);
+            isClosed = isClosed_;
+        }
+        if (isClosed) {
+            {
+                // nothing is going to be executed, so all queued calls fail
+                std::lock_guard guard(groupCommitMutex_);
+                for (auto& call: groupCommitCalls_)
+                    batch->push_back(std::move(call));
+                groupCommitCalls_.clear();
+                groupCommitStats_.failed += batch->size();
+                groupCommitState_ = GroupCommitState::IDLE;
+            }
+            for (auto& call: *batch)
+                call.onError("PGPool is closed");
+            return;
+        }
+        acquire([this, batch](std::shared_ptr<BusyConnection> con) {
+            std::vector<BatchStatement> statements;
+            for (auto& call: *batch)
+                statements.insert(statements.end(), call.statements.begin(), call.statements.end());
+            auto onSuccess = [this, batch, con](QueryResultsArr& results) {
+                // statements after the failed one are not executed, and have empty error texts
+                size_t failedIndex = 0;
+                while (failedIndex < results.size() && !results[failedIndex].isError())
+                    ++failedIndex;
+                bool isCommitted = failedIndex >= results.size();
+                std::vector<GroupCommitCall> done;
+                std::vector<GroupCommitCall> retry;
+                auto now = std::chrono::steady_clock::now();
+                {
+                    std::lock_guard guard(groupCommitMutex_);
+                    ++groupCommitStats_.batches;
+                    ++groupCommitStats_.batchSizes[histogramBucket((long long) batch->size())];
+                    size_t first = 0;
+                    for (auto& call: *batch) {
+                        size_t last = first + call.statements.size();
+                        if (isCommitted) {
+                            ++groupCommitStats_.committed;
+                            ++groupCommitStats_.latencyMicros[histogramBucket(
+                                    std::chrono::duration_cast<std::chrono::microseconds>(now - call.since).count())];
+                            done.push_back(std::move(call));
+                        } else if (failedIndex >= first && failedIndex < last) {
+                            ++groupCommitStats_.failed;
+                            done.push_back(std::move(call));
+                        } else {
+                            ++groupCommitStats_.retries;
+                            retry.push_back(std::move(call));
+                        }
+                        first = last;
+                    }
+                    // calls to retry were the first in the queue, so they go first again
+                    for (auto it = retry.rbegin(); it != retry.rend(); ++it)
+                        groupCommitCalls_.push_front(std::move(*it));
+                }
+                size_t first = 0;
+                for (auto& call: done) {
+                    if (isCommitted) {
+                        QueryResultsArr callResults;
+                        for (size_t i = first; i < first + call.statements.size(); ++i)
+                            callResults.push_back(std::move(results[i]));
+                        first += call.statements.size();
+                        call.onSuccess(callResults);
+                    } else
+                        call.onError(results[failedIndex].getErrorText());
+                }
+                releaseConnection(con);
+                finishGroupCommit();
+            };
+            auto onError = [this, batch, con](const std::string& errText) {
+                // connection is broken, and it is unknown whether the batch is committed
+                {
+                    std::lock_guard guard(groupCommitMutex_);
+                    ++groupCommitStats_.batches;
+                    ++groupCommitStats_.batchSizes[histogramBucket((long long) batch->size())];
+                    groupCommitStats_.failed += batch->size();
+                }
+                for (auto& call: *batch)
+                    call.onError(errText);
+                releaseConnection(con);
+                finishGroupCommit();
+            };
+            if (batch->front().stringsAsText)
+                con->executeBatchStr(onSuccess, onError, statements);
+            else
+                con->executeBatch(onSuccess, onError, statements);
+        });
+    }
+
+    void PGPool::finishGroupCommit() {
+        {
+            std::lock_guard guard(groupCommitMutex_);
+            if (groupCommitCalls_.empty()) {
+                groupCommitState_ = GroupCommitState::IDLE;
+                return;
+            }
+        }
+        // calls came while the batch was executing, they have waited enough
+        executeGroupCommit();
+    }
+
+    static const unsigned char COPY_SIGNATURE[11] = {'P', 'G', 'C', 'O', 'P', 'Y', '\n', 0xFF, '\r', '\n', 0};
+
+    static void putBigEndian(byte_vector& out, uint64_t value, int size) {
+        for (int i = size - 1; i >= 0; --i)
+            out.push_back((unsigned char) (value >> (i * 8)));
+    }
+
+    static uint64_t getBigEndian(const byte_vector& data, size_t& pos, int size) {
+        if (data.size() - pos < (size_t) size)
+            throw std::invalid_argument("decodeCopyRows: unexpected end of data");
+        uint64_t res = 0;
+        for (int i = 0; i < size; ++i)
+            res = (res << 8) | data[pos++];
+        return res;
+    }
+
+    static long long parseLong(const std::string& s) {
+        try {
+            size_t size = 0;
+            long long res = std::stoll(s, &size);
+            if (size == s.size())
+                return res;
+        } catch (const std::logic_error&) {
+        }
+        throw std::invalid_argument("not an integer: '" + s + "'");
+    }
+
+    static double parseDouble(const std::string& s) {
+        try {
+            size_t size = 0;
+            double res = std::stod(s, &size);
+            if (size == s.size())
+                return res;
+        } catch (const std::logic_error&) {
+        }
+        throw std::invalid_argument("not a number: '" + s + "'");
+    }
+
+    static long long copyValueToLong(const std::any& val) {
+        if (val.type() == typeid(int))
+            return std::any_cast<int>(val);
+        if (val.type() == typeid(long))
+            return std::any_cast<long>(val);
+        if (val.type() == typeid(long long))
+            return std::any_cast<long long>(val);
+        if (val.type() == typeid(short))
+            return std::any_cast<short>(val);
+        if (val.type() == typeid(bool))
+            return std::any_cast<bool>(val) ? 1 : 0;
+        if (val.type() == typeid(double))
+            return (long long) std::any_cast<double>(val);
+        if (val.type() == typeid(std::string))
+            return parseLong(std::any_cast<const std::string&>(val));
+        if (val.type() == typeid(const char *))
+            return parseLong(std::any_cast<const char *>(val));
+        throw std::invalid_argument(std::string("wrong type for integer column: ") + val.type().name());
+    }
+
+    static double copyValueToDouble(const std::any& val) {
+        if (val.type() == typeid(double))
+            return std::any_cast<double>(val);
+        if (val.type() == typeid(float))
+            return std::any_cast<float>(val);
+        if (val.type() == typeid(std::string))
+            return parseDouble(std::any_cast<const std::string&>(val));
+        if (val.type() == typeid(const char *))
+            return parseDouble(std::any_cast<const char *>(val));
+        return (double) copyValueToLong(val);
+    }
+
+    static std::string copyValueToString(const std::any& val) {
+        if (val.type() == typeid(std::string))
+            return std::any_cast<const std::string&>(val);
+        if (val.type() == typeid(const char *))
+            return std::any_cast<const char *>(val);
+        if (val.type() == typeid(byte_vector)) {
+            auto& v = std::any_cast<const byte_vector&>(val);
+            return std::string(v.begin(), v.end());
+        }
+        if (val.type() == typeid(double)) {
+            std::ostringstream ss;
+            ss.precision(17);
+            ss << std::any_cast<double>(val);
+            return ss.str();
+        }
+        return std::to_string(copyValueToLong(val));
+    }
+
+    // binary formats of COPY values
+    enum class CopyType {INT2, INT4, INT8, FLOAT4, FLOAT8, BOOL, BYTES};
+
+    static CopyType copyTypeOf(const std::string& colType) {
+        static const std::unordered_map<std::string, CopyType> types {
+            {"int2", CopyType::INT2}, {"int4", CopyType::INT4}, {"oid", CopyType::INT4}, {"int8", CopyType::INT8},
+            {"float4", CopyType::FLOAT4}, {"float8", CopyType::FLOAT8}, {"bool", CopyType::BOOL},
+            // binary form of text types is the text itself
+            {"bytea", CopyType::BYTES}, {"text", CopyType::BYTES}, {"varchar", CopyType::BYTES},
+            {"bpchar", CopyType::BYTES}, {"name", CopyType::BYTES}, {"json", CopyType::BYTES}
+        };
+        auto it = types.find(colType);
+        if (it == types.end())
+            throw std::invalid_argument("column type is not supported: " + colType);
+        return it->second;
+    }
+
+    static void encodeCopyValue(byte_vector& out, CopyType type, const std::any& val) {
+        if (!val.has_value()) {
+            // NULL
+            putBigEndian(out, (uint32_t) -1, 4);
+            return;
+        }
+        switch (type) {
+            case CopyType::INT2:
+                putBigEndian(out, 2, 4);
+                putBigEndian(out, (uint16_t) copyValueToLong(val), 2);
+                break;
+            case CopyType::INT4:
+                putBigEndian(out, 4, 4);
+                putBigEndian(out, (uint32_t) copyValueToLong(val), 4);
+                break;
+            case CopyType::INT8:
+                putBigEndian(out, 8, 4);
+                putBigEndian(out, (uint64_t) copyValueToLong(val), 8);
+                break;
+            case CopyType::FLOAT4: {
+                float v = (float) copyValueToDouble(val);
+                putBigEndian(out, 4, 4);
+                putBigEndian(out, *(uint32_t*) &v, 4);
+                break;
+            }
+            case CopyType::FLOAT8: {
+                double v = copyValueToDouble(val);
+                putBigEndian(out, 8, 4);
+                putBigEndian(out, *(uint64_t*) &v, 8);
+                break;
+            }
+            case CopyType::BOOL: {
+                bool v;
+                if (val.type() == typeid(std::string) || val.type() == typeid(const char *)) {
+                    auto s = copyValueToString(val);
+                    v = s == "true" || s == "t" || s == "1";
+                } else {
+                    v = copyValueToLong(val) != 0;
+                }
+                putBigEndian(out, 1, 4);
+                out.push_back(v ? 1 : 0);
+                break;
+            }
+            case CopyType::BYTES:
+                if (val.type() == typeid(byte_vector)) {
+                    auto& v = std::any_cast<const byte_vector&>(val);
+                    putBigEndian(out, v.size(), 4);
+                    out.insert(out.end(), v.begin(), v.end());
+                } else if (val.type() == typeid(std::string)) {
+                    auto& v = std::any_cast<const std::string&>(val);
+                    putBigEndian(out, v.size(), 4);
+                    out.insert(out.end(), v.begin(), v.end());
+                } else {
+                    auto v = copyValueToString(val);
+                    putBigEndian(out, v.size(), 4);
+                    out.insert(out.end(), v.begin(), v.end());
+                }
+                break;
+        }
+    }
+
+    CopyRowsEncoder::CopyRowsEncoder(const std::vector<std::string>& colTypes, CopyRowSource rowSource):
+            rowSource_(std::move(rowSource)) {
+        for (auto& colType: colTypes)
+            types_.push_back(copyTypeOf(colType));
+        row_.reserve(types_.size());
+    }
+
+    bool CopyRowsEncoder::encode(byte_vector& out, size_t minSize) {
+        if (isDone_)
+            return error_.empty();
+        if (!isStarted_) {
+            isStarted_ = true;
+            out.insert(out.end(), COPY_SIGNATURE, COPY_SIGNATURE + sizeof(COPY_SIGNATURE));
+            // flags and header extension length
+            putBigEndian(out, 0, 4);
+            putBigEndian(out, 0, 4);
+        }
+        while (out.size() < minSize) {
+            row_.clear();
+            if (!rowSource_(row_)) {
+                putBigEndian(out, (uint16_t) -1, 2);
+                isDone_ = true;
+                break;
+            }
+            if (row_.size() != types_.size()) {
+                error_ = "row " + std::to_string(rowsCount_) + " has " + std::to_string(row_.size()) +
+                         " values, expected " + std::to_string(types_.size());
+                isDone_ = true;
+                return false;
+            }
+            putBigEndian(out, types_.size(), 2);
+            for (size_t i = 0; i < row_.size(); ++i) {
+                try {
+                    encodeCopyValue(out, types_[i], row_[i]);
+                } catch (const std::invalid_argument& e) {
+                    error_ = "row " + std::to_string(rowsCount_) + ", column " + std::to_string(i) + ": " + e.what();
+                    isDone_ = true;
+                    return false;
+                }
+            }
+            ++rowsCount_;
+        }
+        return true;
+    }
+
+    byte_vector encodeCopyRows(const std::vector<std::string>& colTypes, const CopyRowSource& rowSource, int& rowsCount) {
+        CopyRowsEncoder encoder(colTypes, rowSource);
+        byte_vector out;
+        if (!encoder.encode(out, SIZE_MAX))
+            throw std::invalid_argument(encoder.getError());
+        rowsCount = encoder.getRowsCount();
+        return out;
+    }
+
+    std::vector<std::vector<CopyValue>> decodeCopyRows(const byte_vector& data) {
+        if (data.size() < sizeof(COPY_SIGNATURE) || memcmp(data.data(), COPY_SIGNATURE, sizeof(COPY_SIGNATURE)) != 0)
+            throw std::invalid_argument("decodeCopyRows: wrong signature");
+        size_t pos = sizeof(COPY_SIGNATURE);
+        // flags
+        getBigEndian(data, pos, 4);
+        uint32_t extensionSize = (uint32_t) getBigEndian(data, pos, 4);
+        if (data.size() - pos < extensionSize)
+            throw std::invalid_argument("decodeCopyRows: unexpected end of data");
+        pos += extensionSize;
+        std::vector<std::vector<CopyValue>> rows;
+        while (true) {
+            auto colsCount = (int16_t) getBigEndian(data, pos, 2);
+            if (colsCount < 0)
+                break;
+            // NULL values stay std::nullopt, so they differ from empty strings and bytea
+            std::vector<CopyValue> row(colsCount);
+            for (auto& value: row) {
+                auto size = (int32_t) getBigEndian(data, pos, 4);
+                if (size < 0)
+                    continue;
+                if (data.size() - pos < (size_t) size)
+                    throw std::invalid_argument("decodeCopyRows: unexpected end of data");
+                value.emplace(data.begin() + pos, data.begin() + pos + size);
+                pos += size;
+            }
+            rows.emplace_back(std::move(row));
+        }
+        return rows;
     }
 
     std::string replacePlaceholders(const std::string& s) {
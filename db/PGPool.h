@@ -7,10 +7,19 @@
 
 #include <functional>
 #include <postgresql/libpq-fe.h>
+#include <uv.h>
 #include <queue>
+#include <deque>
+#include <list>
 #include <any>
+#include <optional>
+#include <string_view>
 #include <string.h>
 #include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <climits>
 #include "../crypto/base64.h"
 #include "../tools/tools.h"
 #include "../tools/ThreadPool.h"
@@ -19,10 +28,69 @@
 namespace db {
 
     /**
-     * Each broken connection tries to reconnect to db server after this delay time.
+     * Broken connection tries to reconnect to db server after this delay first. The delay doubles with every
+     * failed attempt, up to BROKEN_CONNECTION_RESET_DELAY_MILLIS.
+     */
+    const int BROKEN_CONNECTION_RESET_MIN_DELAY_MILLIS = 100;
+
+    /**
+     * Max delay between attempts of a broken connection to reconnect to db server.
      */
     const int BROKEN_CONNECTION_RESET_DELAY_MILLIS = 5000;
 
+    /**
+     * Pool opens this number of connections on start (or less, if its max size is less), and never shrinks below it.
+     */
+    const int MIN_POOL_SIZE = 4;
+
+    /**
+     * If some connections stay free during this time, that many are closed, while the pool has more than
+     * MIN_POOL_SIZE ones.
+     */
+    const int POOL_IDLE_TIMEOUT_MILLIS = 60000;
+
+    /**
+     * Free connections not used for this time are checked with a query, broken ones are reset. Pool does
+     * the checks and closes idle connections with this period.
+     */
+    const int HEALTH_CHECK_INTERVAL_MILLIS = 10000;
+
+    /**
+     * Each connection keeps up to this number of server-side prepared statements, least recently used are deallocated.
+     */
+    const size_t PREPARED_STATEMENTS_CACHE_SIZE = 256;
+
+    /**
+     * Statement is prepared on the connection when it is executed this number of times, so queries executed once
+     * don't cost an extra PQsendPrepare.
+     */
+    const int PREPARE_THRESHOLD = 2;
+
+    /**
+     * PGPool::groupCommit() collects statements of callers for this time before it commits them together.
+     */
+    const int GROUP_COMMIT_WINDOW_MILLIS = 2;
+
+    /**
+     * Max number of groupCommit() calls committed in one transaction.
+     */
+    const int GROUP_COMMIT_MAX_BATCH_SIZE = 256;
+
+    /**
+     * Pool checks lag and health of its replicas with this period.
+     */
+    const int REPLICA_CHECK_INTERVAL_MILLIS = 1000;
+
+    /**
+     * Replica that has not answered the check in this time is not healthy, and it is checked again.
+     */
+    const int REPLICA_CHECK_TIMEOUT_MILLIS = 5000;
+
+    /**
+     * Number of buckets in histograms of GroupCommitStats, bucket i counts values in [2^i, 2^(i+1)).
+     */
+    const int GROUP_COMMIT_HISTOGRAM_SIZE = 24;
+
     class PGPool;
 
     /**
@@ -36,9 +104,27 @@ namespace db {
         bool isError();
         char* getErrorText();
         int getErrorCode();
+
+        /**
+         * Return SQLSTATE code of the error, e.g. "23505", or empty string.
+         */
+        std::string getSqlState();
         byte_vector getValueByIndex(int rowNum, int colIndex);
         byte_vector getValueByName(int rowNum, const std::string& colName);
 
+        /**
+         * Value without copying, as a view over the memory of the result. It is valid while this QueryResult
+         * (or another one moved from it) exists. NULL is an empty view, check isNull() to tell it from empty value.
+         */
+        std::string_view getValueView(int rowNum, int colIndex);
+
+        bool isNull(int rowNum, int colIndex);
+
+        /**
+         * Return type OID of the column.
+         */
+        Oid getColOid(int colIndex);
+
         /**
          * Get vector of rows. Each row is a vector of byte_vector with binary representation of resulting value.
          * If there are less rows than requested, returns all remaining rows. Return empty array when there are
@@ -46,6 +132,12 @@ namespace db {
          */
         std::vector<std::vector<byte_vector>> getRows(int maxRows = 0);
 
+        /**
+         * Same as getRows(maxRows), but rows are not copied: returns index of the first row, and number of rows in
+         * rowsCount, to be read with getValueView.
+         */
+        int nextRows(int maxRows, int& rowsCount);
+
         /**
          * Return total number of rows in the set (does not change when {#getRows} calls)
          */
@@ -84,6 +176,22 @@ namespace db {
     double getDoubleValue(const byte_vector& val);
     std::string getStringValue(const byte_vector& val);
 
+    /**
+     * Same for values from QueryResult::getValueView.
+     */
+    short getInt16Value(std::string_view val);
+    int getIntValue(std::string_view val);
+    long long getLongValue(std::string_view val);
+    bool getBoolValue(std::string_view val);
+    double getDoubleValue(std::string_view val);
+    float getFloatValue(std::string_view val);
+
+    /**
+     * Decimal string of the numeric value in binary format, e.g. "-12.3400"; "NaN", "Infinity" and "-Infinity"
+     * for special values. Digits of the scale are kept, as postgres prints them.
+     */
+    std::string getNumericValue(std::string_view val);
+
     class BusyConnection;
 
     typedef std::vector<QueryResult> QueryResultsArr;
@@ -94,22 +202,173 @@ namespace db {
     typedef const std::function<void(const std::string& errText)>& ExecuteErrorCallback;
     typedef const std::function<void(int affectedRows)>& UpdateSuccessCallback;
     typedef const std::function<void(const std::string& errText)>& UpdateErrorCallback;
+    typedef const std::function<void(QueryResultsArr& results)>& BatchSuccessCallback;
+    typedef std::function<bool(std::vector<std::any>& row)> CopyRowSource;
+    typedef std::function<void(QueryResultsArr& results)> GroupCommitSuccessCallback;
+    typedef std::function<void(const std::string& errText)> GroupCommitErrorCallback;
+    typedef const std::function<bool(QueryResultsArr& rows)>& RowsBatchCallback;
+    typedef const std::function<void(QueryResultsArr& rows, int batchId)>& AsyncRowsBatchCallback;
+    // value of a COPY row, NULL has no value
+    typedef std::optional<byte_vector> CopyValue;
+    typedef const std::function<void(std::vector<std::string>& colTypes, std::vector<std::vector<CopyValue>>& rows)>& CopyOutSuccessCallback;
+
+    /**
+     * One statement of BusyConnection::executeBatch.
+     */
+    struct BatchStatement {
+        std::string queryString;
+        std::vector<std::any> params;
+    };
+
+    /**
+     * State and counters of the pool connections.
+     */
+    struct PoolStats {
+        int total;
+        int inUse;
+        // withConnection callbacks waiting for a free connection
+        int waiting;
+        // connections passed to withConnection callbacks
+        long long acquisitions;
+        // acquisitions that waited for a free connection, and their total and max time of waiting
+        long long waits;
+        long long waitMicrosTotal;
+        long long waitMicrosMax;
+        // connections opened after the start, and closed as idle ones
+        long long spawned;
+        long long closed;
+        // attempts to reconnect broken connections
+        long long resets;
+        // withReadConnection callbacks that got a connection of the pool, as no replica could serve them
+        long long primaryReads;
+    };
+
+    /**
+     * State of a replica of PGPool, see PGPool::addReplica().
+     */
+    struct ReplicaStats {
+        // the last check has succeeded
+        bool isHealthy;
+        // replication lag measured by the last successful check
+        long long lagMillis;
+        int total;
+        int inUse;
+        // withReadConnection callbacks served by the replica
+        long long reads;
+        long long failedChecks;
+    };
+
+    /**
+     * Counters of prepared statements caches of all pool connections.
+     */
+    struct PreparedStatementsStats {
+        // statements executed with PQsendQueryPrepared
+        long long hits;
+        // statements sent with sql text
+        long long misses;
+        long long prepared;
+        long long evictions;
+    };
+
+    /**
+     * Counters and histograms of PGPool::groupCommit().
+     */
+    struct GroupCommitStats {
+        // groupCommit() calls that are committed and failed
+        long long committed;
+        long long failed;
+        // transactions executed, and calls executed once more, as other call of their batch failed
+        long long batches;
+        long long retries;
+        // bucket i counts batches of [2^i, 2^(i+1)) calls
+        std::vector<long long> batchSizes;
+        // bucket i counts calls completed in [2^i, 2^(i+1)) microseconds since groupCommit()
+        std::vector<long long> latencyMicros;
+    };
+
+    // binary format of a COPY value, defined with the encoder
+    enum class CopyType;
+
+    /**
+     * Encodes rows in postgres binary COPY format by chunks, as they are taken from the row source.
+     */
+    class CopyRowsEncoder : Noncopyable, Nonmovable {
+    public:
+        /**
+         * Throws std::invalid_argument if a column type is not supported, /see {BusyConnection::copyIn}.
+         */
+        CopyRowsEncoder(const std::vector<std::string>& colTypes, CopyRowSource rowSource);
+
+        /**
+         * Appends rows to out until it has minSize bytes or there are no more rows, then the trailer is appended.
+         * @return false if a value can't be converted to its column type, getError() tells why.
+         */
+        bool encode(byte_vector& out, size_t minSize);
+
+        bool isDone() const { return isDone_; }
+        const std::string& getError() const { return error_; }
+        int getRowsCount() const { return rowsCount_; }
+
+    private:
+        std::vector<CopyType> types_;
+        CopyRowSource rowSource_;
+        std::vector<std::any> row_;
+        bool isStarted_ = false;
+        bool isDone_ = false;
+        std::string error_;
+        int rowsCount_ = 0;
+    };
+
+    /**
+     * Thread with libuv loop that drives all connections of the PGPool. Connections are in non-blocking mode and wait
+     * for their sockets with uv_poll_t, so the pool of any size costs one thread. Tasks posted from other threads wake
+     * the loop with uv_async_t.
+     */
+    class PGLoop : Noncopyable, Nonmovable {
+    public:
+        PGLoop();
+        ~PGLoop();
+
+        /**
+         * Execute task in the loop thread. Tasks are executed in the order they were posted.
+         */
+        void post(std::function<void()>&& task);
+
+        uv_loop_t* getLoop() {return &loop_;}
+
+    private:
+        static void onWakeup(uv_async_t* handle);
+
+        uv_loop_t loop_;
+        uv_async_t wakeup_;
+        std::mutex mutex_;
+        std::vector<std::function<void()>> tasks_;
+        bool stopping_ = false;
+        bool stopped_ = false;
+        std::thread thread_;
+    };
 
     /**
      * Automatically release connection back to the pool.
+     *
+     * Statements are queued and executed one by one in the PGLoop thread of the pool; result callbacks are called
+     * from that thread too, so they should not block.
      */
-    class BusyConnection: Nonmovable, Noncopyable {
+    class BusyConnection: public std::enable_shared_from_this<BusyConnection>, Nonmovable, Noncopyable {
     public:
 
         /**
          * For js bindings.
          */
-        BusyConnection(): parent_(nullptr), worker_(1) {}
+        BusyConnection(): parent_(nullptr), loop_(nullptr), conId_(0) {}
 
         /**
-         * By design it should be used from PGPool only.
+         * By design it should be used from PGPool only. new_con should be started with PQconnectStart,
+         * see {connect}.
          */
-        BusyConnection(PGPool* new_parent, std::shared_ptr<PGconn> new_con, int newId): parent_(new_parent), con_(new_con), worker_(1), conId_(newId) {}
+        BusyConnection(PGPool* new_parent, std::shared_ptr<PGconn> new_con, int newId);
+
+        ~BusyConnection();
 
         /**
          * Accessor for libpq PGconn*
@@ -164,6 +423,87 @@ namespace db {
          */
         void executeUpdateArrStr(UpdateSuccessCallback onSuccess, UpdateErrorCallback onError, const std::string& queryString, std::vector<std::any>& params);
 
+        /**
+         * Execute several parameterized statements in one network round trip, using libpq pipeline mode.
+         * Statements run in one implicit transaction (unless a transaction is open already), so after the first
+         * failed statement the rest are not executed and have PGRES_PIPELINE_ABORTED results.
+         * @param onSuccess callback that is called with one {QueryResult} per statement, check it with isError().
+         * @param onError callback that is called with error text if the connection is broken.
+         * @param statements sql statements with '?' placeholders and their parameters, /see {executeQuery}
+         */
+        void executeBatch(BatchSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::vector<BatchStatement>& statements);
+
+        /**
+         * Query parameters passes through vector<any>; byte_vector in binary mode, all other types as text; /see {executeBatch}
+         */
+        void executeBatchStr(BatchSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::vector<BatchStatement>& statements);
+
+        /**
+         * Execute the query in libpq single row mode and pass rows by batches as soon as they are received, so
+         * the whole result of a big query is never kept in memory.
+         * @param onRows callback that is called with up to batchSize rows, each {QueryResult} of the batch has one
+         * row. Read cells with getValueView() to avoid copying. Returns false if the rest of rows are not needed,
+         * the query is cancelled then and onDone is called. Called from the PGLoop thread.
+         * @param onDone callback that is called after the last batch with number of rows passed to onRows.
+         * @param onError callback that is called with error text, some batches could be passed before it.
+         * @param queryString the SQL statement with '?' placeholders, /see {executeQuery}
+         */
+        void executeQueryStream(RowsBatchCallback onRows, UpdateSuccessCallback onDone, ExecuteErrorCallback onError,
+                                int batchSize, const std::string& queryString, std::vector<std::any>& params);
+
+        /**
+         * Query parameters passes through vector<any>; byte_vector in binary mode, all other types as text; /see {executeQueryStream}
+         */
+        void executeQueryStreamStr(RowsBatchCallback onRows, UpdateSuccessCallback onDone, ExecuteErrorCallback onError,
+                                   int batchSize, const std::string& queryString, std::vector<std::any>& params);
+
+        /**
+         * Stream with backpressure, for rows processed in another thread: after each batch the connection stops
+         * reading rows, so the server waits too, until resumeStream() is called with the batch id.
+         * Query parameters are passed as in executeQueryStreamStr; /see {executeQueryStream}
+         * @param onRows callback that is called with the rows and id of the batch. onDone is called after
+         * resumeStream() of the last batch too.
+         */
+        void executeQueryStreamAsync(AsyncRowsBatchCallback onRows, UpdateSuccessCallback onDone, ExecuteErrorCallback onError,
+                                     int batchSize, const std::string& queryString, std::vector<std::any>& params);
+
+        /**
+         * Continue the stream after the batch of executeQueryStreamAsync is processed. Can be called from any thread.
+         * @param isNeeded false if the rest of rows are not needed, the query is cancelled then.
+         */
+        void resumeStream(int batchId, bool isNeeded);
+
+        /**
+         * Bulk insert with COPY FROM STDIN in binary format, much faster than INSERT statements for many rows.
+         * Values are encoded by the column types, so e.g. int or numeric string can go to bigint column; empty
+         * std::any is NULL. Supported types are int2, int4, int8, float4, float8, bool, bytea and text ones.
+         * @param onSuccess callback that is called with number of inserted rows.
+         * @param onError callback that is called with error text, nothing is inserted then.
+         * @param table table name, as it is written in sql.
+         * @param columns column names, all values of the row go in this order.
+         * @param rowSource fills the row and returns true, or returns false when there are no more rows.
+         * Called from the PGLoop thread, while the rows are sent, so all of them are never encoded at once.
+         */
+        void copyIn(UpdateSuccessCallback onSuccess, UpdateErrorCallback onError, const std::string& table,
+                    const std::vector<std::string>& columns, const CopyRowSource& rowSource);
+
+        /**
+         * Rows are passed at once; /see {copyIn}
+         */
+        void copyIn(UpdateSuccessCallback onSuccess, UpdateErrorCallback onError, const std::string& table,
+                    const std::vector<std::string>& columns, std::vector<std::vector<std::any>>&& rows);
+
+        /**
+         * Bulk export with COPY TO STDOUT in binary format.
+         * @param onSuccess callback that is called with type names of the columns and all the rows, values are
+         * in the same binary form as {QueryResult::getRows} returns, NULL values are std::nullopt.
+         * @param onError callback that is called with error text.
+         * @param table table name, as it is written in sql.
+         * @param columns column names to export.
+         */
+        void copyOut(CopyOutSuccessCallback onSuccess, ExecuteErrorCallback onError, const std::string& table,
+                     const std::vector<std::string>& columns);
+
         /**
          * Executes string sql command. All query parameters should be inside string.
          * You can concatenate several sql commands in one string. Callback receives vector<QueryResult> parameter,
@@ -181,10 +521,26 @@ namespace db {
 
         int getId() {return conId_;}
 
-        void exec(std::function<void()> f) {worker_(f);}
+        /**
+         * Drive PQconnectPoll in the loop thread. Statements queued before the connection is established wait for it.
+         * @param onConnected is called from the loop thread with the connection status and error text, can be empty.
+         */
+        void connect(std::function<void(bool isOk, const std::string& errText)>&& onConnected);
 
         void goResetCon();
 
+        /**
+         * Stop waiting for socket and timer, called from the loop thread only. Queued statements, and ones queued
+         * later, fail with the "pool is closed" error.
+         */
+        void shutdown();
+
+        /**
+         * Stop waiting for socket once the connection has executed all queued statements, called from the loop
+         * thread only. Pool drops the connection, and it lives until it is done.
+         */
+        void closeWhenIdle();
+
     private:
 
         void prepareParams(std::vector<std::any>& params) {
@@ -201,11 +557,118 @@ namespace db {
             prepareParams(params, args...);
         }
 
+    private:
+
+        enum class State {IDLE, CONNECTING, BUSY, RESET_DELAY, RESETTING};
+
+        struct Command {
+            // libpq function that sends the command, for error messages
+            const char* sendName = nullptr;
+            std::function<bool(PGconn*)> send;
+            // called with all results of the command; brokenAt is the name of failed libpq call, if connection is broken
+            std::function<void(QueryResultsArr& results, const char* brokenAt)> complete;
+            // number of statements sent in pipeline mode, 0 if the command is not pipelined
+            int pipelineSize = 0;
+            // parameterized statements, sent with sendCommand if there is no send function
+            std::vector<BatchStatement> statements;
+            bool stringsAsText = false;
+            bool isPrepareChecked = false;
+            // encodes rows of COPY FROM STDIN, chunk by chunk into copyData
+            std::shared_ptr<CopyRowsEncoder> copyEncoder;
+            // chunk of COPY FROM STDIN being sent, or buffer for data of COPY TO STDOUT
+            std::shared_ptr<byte_vector> copyData;
+            // command in single row mode gets rows by batches of this size, before its complete
+            int rowsBatchSize = 0;
+            // returns true if the connection should wait for resumeStream before reading more rows
+            std::function<bool(QueryResultsArr& rows)> onRowsBatch;
+            // set when the rest of rows of the stream are not needed, and its query is cancelled
+            std::shared_ptr<bool> isStreamStopped;
+        };
+
+        struct PreparedStatement {
+            // name of the server-side statement, empty until it is prepared
+            std::string name;
+            int uses = 0;
+            std::list<std::string>::iterator lruPos;
+            bool isPreparing = false;
+        };
+
+        // pass the command to the loop thread, where it is executed after the previously queued ones
+        void enqueue(Command&& command);
+        void enqueueBatch(BatchSuccessCallback onSuccess, ExecuteErrorCallback onError,
+                          const std::vector<BatchStatement>& statements, bool stringsAsText);
+
+        // all methods below are called from the loop thread
+
+        void processNext();
+        bool sendCommand(Command& command);
+        bool sendStatement(PGconn* con, const BatchStatement& statement, bool stringsAsText);
+        bool prepareStatements(const Command& command);
+        void checkPreparedResults(const Command& command, QueryResultsArr& results);
+        void clearPrepared();
+        void finishCommand(const char* brokenAt);
+        // complete queued commands as they are on a broken connection
+        void failCommands(const char* brokenAt);
+        void passRowsBatch();
+        void cancelQuery();
+        void enqueueStream(AsyncRowsBatchCallback onRows, UpdateSuccessCallback onDone, ExecuteErrorCallback onError,
+                           int batchSize, const std::string& queryString, std::vector<std::any>& params, bool stringsAsText);
+        void flush();
+        bool writeCopyData();
+        bool readCopyData();
+        void continueConnect(PostgresPollingStatusType pollingStatus);
+        void connectFinished(bool isOk);
+        void startReset();
+        void completeQuery(QueryResultsArr& results, const char* brokenAt,
+                           ExecuteSuccessCallback onSuccess, ExecuteErrorCallback onError);
+
+        bool watch(int events, uv_poll_cb callback);
+        void stopWatching();
+        void closePoll();
+
+        static void onConnectSocket(uv_poll_t* handle, int status, int events);
+        static void onQuerySocket(uv_poll_t* handle, int status, int events);
+
     private:
         std::shared_ptr<PGconn> con_;
         PGPool* parent_;
-        FixedThreadPool worker_;
+        PGLoop* loop_;
         int conId_;
+
+        // members below are used in the loop thread only
+
+        State state_ = State::IDLE;
+        std::deque<Command> commands_;
+        Command current_;
+        QueryResultsArr results_;
+        // statements of the pipelined command whose results are received completely
+        int pipelineEnds_ = 0;
+        // PQflush has not sent all the data yet
+        bool flushing_ = false;
+        // current command sends data of COPY FROM STDIN, copyPos_ is the size of copyData chunk sent so far
+        bool isCopyingIn_ = false;
+        size_t copyPos_ = 0;
+        // the stream waits for resumeStream of the batch with this id
+        bool isStreamPaused_ = false;
+        int streamBatchId_ = 0;
+        // cancel request is being sent, next commands wait for it
+        bool isCancelling_ = false;
+        uv_poll_t* poll_ = nullptr;
+        int pollFd_ = -1;
+        uv_timer_t* resetTimer_ = nullptr;
+        std::function<void(bool, const std::string&)> onConnected_;
+        // keeps the connection alive while it waits for socket or timer events
+        std::shared_ptr<BusyConnection> self_;
+        // prepared statements by sql text, most recently used are in front of the list
+        std::unordered_map<std::string, PreparedStatement> prepared_;
+        std::list<std::string> preparedLru_;
+        std::vector<std::string> toDeallocate_;
+        int preparedCounter_ = 0;
+        // failed reconnects in a row, the delay before the next one grows with it
+        int resetAttempts_ = 0;
+        // shutdown() and closeWhenIdle() are called
+        bool isShutdown_ = false;
+        bool isClosing_ = false;
     };
 
     /**
@@ -222,6 +685,8 @@ namespace db {
         PGPool(int poolSize, const std::string &host, int port, const std::string &dbname, const std::string &user,
                const std::string &pswd);
 
+        ~PGPool();
+
         /**
          * For js bindings.
          * @return pair with error status and error text. If res.first is true, then db connected correctly. Else see res.second for error text.
@@ -230,7 +695,8 @@ namespace db {
 
         /**
          * Get connection from the pool, pass it to the callback and return it to the pool.
-         * The call itself never blocks while the callback could be called in some moment in future.
+         * The call itself never waits for a connection: if there is a free one, the callback is called right away
+         * in the calling thread, else it is queued and called from the pool thread, when some connection is released.
          * <p>
          * Releases automatically.
          * @param callback shared_ptr<db::PGPool::BusyConnection>
@@ -243,6 +709,34 @@ namespace db {
          */
         void withConnection(WithConnectionCallbackJs callback);
 
+        /**
+         * Add a read replica of the database, with its own connections. Pool checks replicas every
+         * REPLICA_CHECK_INTERVAL_MILLIS, and passes them withReadConnection callbacks while they answer and their
+         * replication lag is small enough. Any connection string that accepts reads will do: a server that is not
+         * in recovery has zero lag.
+         * @return pair with error status and error text, as connect().
+         */
+        std::pair<bool,std::string> addReplica(int poolSize, const std::string& connectString);
+
+        /**
+         * Get connection for read only statements, that could see data up to maxStalenessMillis old, and pass it
+         * to the callback. Connection is taken from the healthy replica with lag within maxStalenessMillis that has
+         * most free connections, or from the pool itself if there is none, or if maxStalenessMillis is 0.
+         * <p>
+         * Releases automatically.
+         */
+        void withReadConnection(int maxStalenessMillis, WithConnectionCallback callback);
+
+        /**
+         * Need to be released by connection.release()
+         */
+        void withReadConnection(int maxStalenessMillis, WithConnectionCallbackJs callback);
+
+        /**
+         * Return states of replicas, in order they were added.
+         */
+        std::vector<ReplicaStats> getReplicaStats();
+
         /**
          * Return number of connections in the pool.
          */
@@ -253,6 +747,46 @@ namespace db {
          */
         size_t availableConnections();
 
+        /**
+         * Return prepared statements cache counters, summed for all connections.
+         */
+        PreparedStatementsStats getPreparedStatementsStats();
+
+        /**
+         * Return connections count and counters of waiting for them.
+         */
+        PoolStats getPoolStats();
+
+        /**
+         * Execute statements in one transaction with statements of other groupCommit() calls, so that many
+         * callers pay for one commit. Calls are collected for the group commit window, or until there are max batch
+         * size of them, and their statements go in one pipeline (see BusyConnection::executeBatch). While a batch
+         * is executing, next calls are collected and go right after it.
+         * <p>
+         * If a statement fails, its call gets onError, and other calls of the batch are executed again without it.
+         * Statements should not depend on each other's results: they are sent at once.
+         * @param statements sql statements with '?' placeholders and their parameters, /see {executeQuery}
+         * @param onSuccess callback that is called with one {QueryResult} per statement, after the commit.
+         * @param onError callback that is called with error text.
+         * @param stringsAsText pass string parameters as text, /see {executeBatchStr}
+         */
+        void groupCommit(std::vector<BatchStatement>&& statements, GroupCommitSuccessCallback&& onSuccess,
+                         GroupCommitErrorCallback&& onError, bool stringsAsText = false);
+
+        /**
+         * Set the group commit window and max number of groupCommit() calls in one transaction.
+         * Zero window commits calls that come while no batch is executing right away.
+         */
+        void setGroupCommit(int windowMillis, int maxBatchSize);
+
+        GroupCommitStats getGroupCommitStats();
+
+        /**
+         * True if libpq supports pipeline mode. Without it groupCommit() executes calls one by one, each in its own
+         * transaction, on one connection of the pool, so it is slower than executing them on separate connections.
+         */
+        static bool hasPipelining();
+
         /**
          * Uses from class BusyConnection.
          */
@@ -268,6 +802,11 @@ namespace db {
          */
         string getType(int oid) {return pgTypes_[oid];};
 
+        /**
+         * Uses from class BusyConnection.
+         */
+        PGLoop& getLoop() {return loop_;}
+
         /**
          * Calls automatically from BusyConnection in error cases.
          */
@@ -279,22 +818,134 @@ namespace db {
         void close();
 
     private:
-        std::shared_ptr<BusyConnection> getUnusedConnection();
+        typedef std::function<void(std::shared_ptr<BusyConnection>)> AcquireCallback;
+        typedef std::chrono::steady_clock::time_point TimePoint;
+
+        void acquire(AcquireCallback&& callback);
+        std::shared_ptr<BusyConnection> spawnConnection(std::function<void(bool, const std::string&)>&& onConnected = nullptr);
+        // connection whose statements fail at once, it is passed to callbacks that come when the pool is closed
+        std::shared_ptr<BusyConnection> closedConnection();
         std::string loadOids();
+        void startMaintenance();
+        // close idle connections and check free ones, called from the loop thread
+        void maintain();
+        // take next batch of group commit calls and execute it
+        void executeGroupCommit();
+        void finishGroupCommit();
+        // pool to take a read connection from, this one if no replica fits
+        PGPool* readPool(int maxStalenessMillis);
+        // measure lag of all replicas, called from the loop thread
+        void checkReplicas();
 
     private:
+        struct FreeConnection {
+            std::shared_ptr<BusyConnection> con;
+            TimePoint since;
+        };
+
+        struct Waiter {
+            AcquireCallback callback;
+            TimePoint since;
+        };
+
+        // pass the closed connection to the waiters
+        void failWaiters(std::deque<Waiter>&& waiters);
+
+        struct GroupCommitCall {
+            std::vector<BatchStatement> statements;
+            GroupCommitSuccessCallback onSuccess;
+            GroupCommitErrorCallback onError;
+            bool stringsAsText;
+            TimePoint since;
+        };
+
+        struct Replica {
+            std::atomic<bool> isHealthy{false};
+            std::atomic<long long> lagMillis{0};
+            std::atomic<long long> reads{0};
+            std::atomic<long long> failedChecks{0};
+            // a check is in progress, so the next one is skipped until the check timeout
+            std::atomic<bool> isChecking{false};
+            std::atomic<long long> checkStartedMillis{0};
+            // id of the last started check
+            std::atomic<long long> checkId{0};
+            // declared last to be stopped first
+            std::unique_ptr<PGPool> pool;
+        };
+
+        enum class GroupCommitState {
+            IDLE,
+            // window timer is started
+            COLLECTING,
+            // batch is executing
+            EXECUTING
+        };
+
+        // declared first to be destroyed after all the connections
+        PGLoop loop_;
         std::atomic<int> nextConId_ = 1;
         int maxPoolSize_ = 1;
-        int stopSpawnConnectionsOnSize_ = 4;
+        int minPoolSize_ = MIN_POOL_SIZE;
         std::function<std::shared_ptr<BusyConnection>()> conSpawner_;
-        std::queue<std::shared_ptr<BusyConnection>> connPool_;
+        // fields below are guarded by poolMutex_
         std::mutex poolMutex_;
-        std::condition_variable poolCV_;
-        FixedThreadPool poolControlThread_;
-        //std::atomic<size_t> usedConnectionsCount_;
+        // taken from the front and released to the back, so that statements queued by callbacks that release
+        // the connection right away are spread over connections
+        std::deque<FreeConnection> freeConnections_;
+        std::deque<Waiter> waiters_;
         std::unordered_map<int, std::shared_ptr<BusyConnection>> usedConnections_;
+        // connections being opened for acquire(), not in usedConnections_ yet
+        int spawningCount_ = 0;
+        bool isClosed_ = false;
+        // min number of free connections since the last maintain(), and since the last shrink
+        int minFreeCount_ = 0;
+        int idleFreeCount_ = INT_MAX;
+        int idleChecksCount_ = 0;
+        // calls callbacks of waiters, so that release() doesn't call them in its thread
+        FixedThreadPool poolControlThread_;
+        // sends cancel requests of streams, that are not needed anymore
+        FixedThreadPool cancelThread_;
+        // used in the loop thread only
+        uv_timer_t* maintenanceTimer_ = nullptr;
         std::unordered_map<int, string> pgTypes_;
 
+        struct {
+            std::atomic<long long> acquisitions{0};
+            std::atomic<long long> waits{0};
+            std::atomic<long long> waitMicrosTotal{0};
+            std::atomic<long long> waitMicrosMax{0};
+            std::atomic<long long> spawned{0};
+            std::atomic<long long> closed{0};
+            std::atomic<long long> resets{0};
+            std::atomic<long long> primaryReads{0};
+        } poolStats_;
+
+        // fields below are guarded by replicasMutex_
+        std::mutex replicasMutex_;
+        std::vector<std::unique_ptr<Replica>> replicas_;
+        // used in the loop thread only
+        uv_timer_t* replicasTimer_ = nullptr;
+
+        // fields below are guarded by groupCommitMutex_
+        std::mutex groupCommitMutex_;
+        std::deque<GroupCommitCall> groupCommitCalls_;
+        GroupCommitState groupCommitState_ = GroupCommitState::IDLE;
+        int groupCommitWindowMillis_ = GROUP_COMMIT_WINDOW_MILLIS;
+        int groupCommitMaxBatchSize_ = GROUP_COMMIT_MAX_BATCH_SIZE;
+        GroupCommitStats groupCommitStats_ {0, 0, 0, 0,
+                                            std::vector<long long>(GROUP_COMMIT_HISTOGRAM_SIZE),
+                                            std::vector<long long>(GROUP_COMMIT_HISTOGRAM_SIZE)};
+        // used in the loop thread only
+        uv_timer_t* groupCommitTimer_ = nullptr;
+
+        struct {
+            std::atomic<long long> hits{0};
+            std::atomic<long long> misses{0};
+            std::atomic<long long> prepared{0};
+            std::atomic<long long> evictions{0};
+        } preparedStats_;
+
+        friend class BusyConnection;
     };
 
     /**
@@ -310,6 +961,18 @@ namespace db {
 
     std::string replacePlaceholders(const std::string& s);
 
+    /**
+     * Encode rows in postgres binary COPY format, for columns of the given types, /see {BusyConnection::copyIn}.
+     * Throws std::invalid_argument if a value can't be converted to the column type.
+     * @param rowsCount is set to the number of encoded rows.
+     */
+    byte_vector encodeCopyRows(const std::vector<std::string>& colTypes, const CopyRowSource& rowSource, int& rowsCount);
+
+    /**
+     * Decode rows of postgres binary COPY format. Throws std::invalid_argument if data is malformed.
+     */
+    std::vector<std::vector<CopyValue>> decodeCopyRows(const byte_vector& data);
+
 }
 
 #endif //U8_PGPOOL_H
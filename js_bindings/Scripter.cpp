@@ -273,6 +273,7 @@ void Scripter::initializeInternal() {
         JsInitQueryResult(*this, global);
         JsInitBusyConnection(*this, global);
         JsInitPGPool(*this, global);
+        JsInitLedgerCache(*this, global);
         JsInitNetwork(*this, global);
         JsInitResearchBindings(*this, global);
         JsInitBossBindings(*this, global);
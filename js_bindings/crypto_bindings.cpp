@@ -15,6 +15,8 @@
 #include "../crypto/HashId.h"
 #include "../crypto/SymmetricKey.h"
 #include "../crypto/PBKDF2.h"
+#include "../crypto/SignatureCache.h"
+#include "../AsyncIO/IOFile.h"
 #include "../serialization/BossSerializer.h"
 #include "../types/UBinder.h"
 #include "../types/UDateTime.h"
@@ -554,6 +556,30 @@ static void hashIdGetBase64String(const FunctionCallbackInfo<Value> &args) {
     });
 }
 
+static byte_vector copyTypedArray(const Local<Value> &value) {
+    if (!value->IsTypedArray())
+        throw std::invalid_argument("typed array required");
+    auto array = Local<TypedArray>::Cast(value);
+    byte_vector result(array->ByteLength());
+    array->CopyContents(result.data(), result.size());
+    return result;
+}
+
+static PublicKey *publicKeyOf(ArgsContext &ac, const Local<Value> &value) {
+    if (!value->IsObject() || !ac.scripter->publicKeyTpl.Get(ac.isolate)->HasInstance(value))
+        throw std::invalid_argument("public key required");
+    return unwrap<PublicKey>(Local<Object>::Cast(value));
+}
+
+static Local<Array> argumentAsArray(ArgsContext &ac, int index, uint32_t length) {
+    if (!ac.args[index]->IsArray())
+        throw std::invalid_argument("array required");
+    auto array = Local<Array>::Cast(ac.args[index]);
+    if (array->Length() != length)
+        throw std::invalid_argument("arrays of the same length required");
+    return array;
+}
+
 static void hashIdOf(const FunctionCallbackInfo<Value> &args) {
     Scripter::unwrapArgs(args, [](ArgsContext &ac) {
         if (ac.args.Length() == 2) {
@@ -572,6 +598,94 @@ static void hashIdOf(const FunctionCallbackInfo<Value> &args) {
     });
 }
 
+static void hashIdOfMany(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        // __ofMany(dataArray, onReady)
+        if (ac.args.Length() == 2 && ac.args[0]->IsArray()) {
+            uint32_t count = Local<Array>::Cast(ac.args[0])->Length();
+            auto data = argumentAsArray(ac, 0, count);
+            auto inputs = make_shared<vector<byte_vector>>(count);
+            for (uint32_t i = 0; i < count; ++i)
+                (*inputs)[i] = copyTypedArray(data->Get(ac.context, i).ToLocalChecked());
+
+            auto onReady = ac.asFunction(1);
+            auto se = ac.scripter;
+            runAsync([=]() {
+                vector<HashId::Span> spans(count);
+                for (uint32_t i = 0; i < count; ++i)
+                    spans[i] = {(*inputs)[i].data(), (*inputs)[i].size()};
+                auto ids = make_shared<vector<HashId>>(HashId::ofMany(spans));
+                onReady->lockedContext([=](Local<Context> &cxt) {
+                    auto isolate = cxt->GetIsolate();
+                    Local<Array> array = Array::New(isolate, (int) ids->size());
+                    for (size_t i = 0; i < ids->size(); ++i)
+                        auto unused = array->Set(cxt, (uint32_t) i,
+                                                 wrap(se->hashIdTpl, isolate, new HashId((*ids)[i]), true));
+                    onReady->invoke(array);
+                });
+            });
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
+static void hashIdOfFile(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        // __ofFile(ioFile, chunkSize, onReady)
+        if (ac.args.Length() == 3) {
+            auto tpl = ac.scripter->FileTemplate.Get(ac.isolate);
+            if (!ac.args[0]->IsObject() || !tpl->HasInstance(ac.args[0])) {
+                ac.throwError("required IOFile argument");
+                return;
+            }
+            auto file = unwrap<asyncio::IOFile>(ac.as<Object>(0));
+            int chunkSize = ac.asInt(1);
+            if (chunkSize <= 0) {
+                ac.throwError("illegal chunk size");
+                return;
+            }
+            auto onReady = ac.asFunction(2);
+            auto se = ac.scripter;
+            HashId::ofFile(*file, [=](shared_ptr<HashId> hashId, ssize_t result) {
+                onReady->lockedContext([=](Local<Context> &cxt) {
+                    auto isolate = cxt->GetIsolate();
+                    Local<Value> res[2] = {Undefined(isolate), Integer::New(isolate, (int) result)};
+                    if (hashId)
+                        res[0] = wrap(se->hashIdTpl, isolate, new HashId(*hashId), true);
+                    onReady->invoke(2, res);
+                });
+            }, (size_t) chunkSize);
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
+static void hashIdBuilderUpdate(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 1 && ac.args[0]->IsTypedArray()) {
+            auto builder = unwrap<HashId::Builder>(ac.args.This());
+            auto chunk = ac.as<TypedArray>(0);
+            builder->update((unsigned char *) chunk->Buffer()->GetContents().Data() + chunk->ByteOffset(),
+                            chunk->ByteLength());
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
+static void hashIdBuilderFinish(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 0) {
+            auto builder = unwrap<HashId::Builder>(ac.args.This());
+            ac.setReturnValue(wrap(ac.scripter->hashIdTpl, ac.isolate, new HashId(builder->finish()), true));
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
 Local<FunctionTemplate> initPrivateKey(Scripter& scripter, Isolate *isolate) {
     Local<FunctionTemplate> tpl = bindCppClass<PrivateKey>(
             isolate,
@@ -725,12 +839,25 @@ Local<FunctionTemplate> initHashId(Scripter& scripter, Isolate *isolate) {
     prototype->Set(isolate, "__getBase64String", FunctionTemplate::New(isolate, hashIdGetBase64String));
 
     tpl->Set(isolate, "__of", FunctionTemplate::New(isolate, hashIdOf));
+    tpl->Set(isolate, "__ofMany", FunctionTemplate::New(isolate, hashIdOfMany));
+    tpl->Set(isolate, "__ofFile", FunctionTemplate::New(isolate, hashIdOfFile));
 
     scripter.hashIdTpl.Reset(isolate, tpl);
     return tpl;
 }
 
 
+/*
+ * constructor: new HashIdBuilder()
+ */
+Local<FunctionTemplate> initHashIdBuilder(Isolate *isolate) {
+    Local<FunctionTemplate> tpl = bindCppClass<HashId::Builder>(isolate, "HashIdBuilderImpl");
+    auto prototype = tpl->PrototypeTemplate();
+    prototype->Set(isolate, "__update", FunctionTemplate::New(isolate, hashIdBuilderUpdate));
+    prototype->Set(isolate, "__finish", FunctionTemplate::New(isolate, hashIdBuilderFinish));
+    return tpl;
+}
+
 static void symmetricKeyEncrypt(const FunctionCallbackInfo<Value> &args) {
     Scripter::unwrapArgs(args, [](ArgsContext &ac) {
         if (ac.args.Length() == 1 && ac.args[0]->IsTypedArray()) {
@@ -987,6 +1114,102 @@ static void pbkdf2(const FunctionCallbackInfo<Value> &args) {
     });
 }
 
+static void verifyBatch(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        // __verifyBatch(keys, signatures, data, hashTypes, onReady)
+        if (ac.args.Length() == 5 && ac.args[0]->IsArray()) {
+            uint32_t count = Local<Array>::Cast(ac.args[0])->Length();
+            auto keys = argumentAsArray(ac, 0, count);
+            auto signatures = argumentAsArray(ac, 1, count);
+            auto data = argumentAsArray(ac, 2, count);
+            auto hashTypes = argumentAsArray(ac, 3, count);
+
+            auto pubKeys = make_shared<vector<PublicKey *>>(count);
+            auto sigs = make_shared<vector<byte_vector>>(count);
+            auto bodies = make_shared<vector<byte_vector>>(count);
+            auto types = make_shared<vector<HashType>>(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                (*pubKeys)[i] = publicKeyOf(ac, keys->Get(ac.context, i).ToLocalChecked());
+                (*sigs)[i] = copyTypedArray(signatures->Get(ac.context, i).ToLocalChecked());
+                (*bodies)[i] = copyTypedArray(data->Get(ac.context, i).ToLocalChecked());
+                (*types)[i] = (HashType) hashTypes->Get(ac.context, i).ToLocalChecked()->Int32Value(ac.context).FromJust();
+            }
+
+            auto onReady = ac.asFunction(4);
+            runAsync([=]() {
+                vector<PublicKey::SignatureToVerify> toVerify(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    auto& sig = (*sigs)[i];
+                    auto& body = (*bodies)[i];
+                    toVerify[i] = {(*pubKeys)[i], sig.data(), sig.size(), body.data(), body.size(), (*types)[i]};
+                }
+                auto results = PublicKey::verifyBatch(toVerify);
+                onReady->lockedContext([=](Local<Context> &cxt) {
+                    auto isolate = cxt->GetIsolate();
+                    Local<Array> array = Array::New(isolate, (int) results.size());
+                    for (size_t i = 0; i < results.size(); ++i)
+                        auto unused = array->Set(cxt, (uint32_t) i, Boolean::New(isolate, results[i]));
+                    onReady->invoke(array);
+                });
+            });
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
+/**
+ * Check extended signature of the data. Returns UBinder to construct JS ExtendedSignature from, or null object if
+ * the signature is not valid. Throws if the signature can't be unpacked. RSA checks go through PublicKey::verify,
+ * so an extended signature seen before costs only hashing and unpacking.
+ */
+static UObject verifyExtendedSignature(const PublicKey *pubKey, const void *sig, size_t sigSize,
+                                       const void *data, size_t dataSize) {
+    UBytes sigUBytes((const unsigned char *) sig, (unsigned int) sigSize);
+    UObject src = BossSerializer::deserialize(sigUBytes);
+    const UBinder& srcBinder = UBinder::asInstance(src);
+    byte_vector srcExts = UBytes::asInstance(srcBinder.get("exts")).get();
+    byte_vector srcSign = UBytes::asInstance(srcBinder.get("sign")).get();
+    bool isSignValid = pubKey->verify(srcSign, srcExts, HashType::SHA512);
+    bool isSign2Valid = true;
+    if (srcBinder.find(string("sign2")) != srcBinder.end()) {
+        byte_vector srcSign2 = UBytes::asInstance(srcBinder.get("sign2")).get();
+        isSign2Valid = pubKey->verify(srcSign2, srcExts, HashType::SHA3_256);
+    }
+    bool isSign3Valid = true;
+    if (srcBinder.find(string("sign3")) != srcBinder.end()) {
+        byte_vector srcSign3 = UBytes::asInstance(srcBinder.get("sign3")).get();
+        isSign3Valid = pubKey->verify(srcSign3, srcExts, HashType::SHA3_384);
+    }
+    if (!isSignValid || !isSign2Valid || !isSign3Valid)
+        return UObject();
+
+    UBinder es;
+    UObject bo = BossSerializer::deserialize(UBytes(move(srcExts)));
+    const UBinder& b = UBinder::asInstance(bo);
+    es.set("keyId", UBytes::asInstance(b.get("key")));
+    es.set("createdAt", UDateTime::asInstance(b.get("created_at")));
+    es.set("signature", sigUBytes);
+    if (b.find(string("pub_key")) != b.end()) {
+        PublicKey publicKey(UBytes::asInstance(b.get("pub_key")).get());
+        es.set("publicKey", UPublicKey(publicKey));
+    } else {
+        es.set("publicKey", UObject());
+    }
+    byte_vector hash = UBytes::asInstance(b.get("sha512")).get();
+    byte_vector dataHash = crypto::Digest(crypto::HashType::SHA512, (void *) data, dataSize).getDigest();
+    bool isHashValid = (hash == dataHash);
+    bool isHash2Valid = true;
+    if (b.find(string("sha3_384")) != b.end()) {
+        byte_vector hash1 = UBytes::asInstance(b.get("sha3_384")).get();
+        byte_vector dataHash1 = crypto::Digest(crypto::HashType::SHA3_384, (void *) data, dataSize).getDigest();
+        isHash2Valid = (hash1 == dataHash1);
+    }
+    if (!isHashValid || !isHash2Valid)
+        return UObject();
+    return es;
+}
+
 static void JsVerifyExtendedSignature(const FunctionCallbackInfo<Value> &args) {
     Scripter::unwrapArgs(args, [](ArgsContext &ac) {
         if (ac.args.Length() == 4) {
@@ -994,66 +1217,16 @@ static void JsVerifyExtendedSignature(const FunctionCallbackInfo<Value> &args) {
             auto sig = ac.asBuffer(1);
             auto data = ac.asBuffer(2);
             auto onComplete = ac.asFunction(3);
-            auto se = ac.scripter;
-            runAsync([pubKey,sig,data,onComplete,se](){
+            runAsync([pubKey,sig,data,onComplete](){
+                UObject es;
                 try {
-                    byte_vector bvSig(sig->size());
-                    memcpy(&bvSig[0], sig->data(), sig->size());
-                    UBytes sigUBytes = UBytes(move(bvSig));
-                    UObject src = BossSerializer::deserialize(sigUBytes);
-                    UBinder srcBinder = UBinder::asInstance(src);
-                    byte_vector srcExts = UBytes::asInstance(srcBinder.get("exts")).get();
-                    byte_vector srcSign = UBytes::asInstance(srcBinder.get("sign")).get();
-                    bool isSignValid = pubKey->verify(srcSign, srcExts, HashType::SHA512);
-                    bool isSign2Valid = true;
-                    if (srcBinder.find(string("sign2")) != srcBinder.end()) {
-                        byte_vector srcSign2 = UBytes::asInstance(srcBinder.get("sign2")).get();
-                        isSign2Valid = pubKey->verify(srcSign2, srcExts, HashType::SHA3_256);
-                    }
-                    bool isSign3Valid = true;
-                    if (srcBinder.find(string("sign3")) != srcBinder.end()) {
-                        byte_vector srcSign3 = UBytes::asInstance(srcBinder.get("sign3")).get();
-                        isSign3Valid = pubKey->verify(srcSign3, srcExts, HashType::SHA3_384);
-                    }
-                    if (isSignValid && isSign2Valid && isSign3Valid) {
-                        UBinder es;
-                        UObject bo = BossSerializer::deserialize(UBytes(move(srcExts)));
-                        UBinder b = UBinder::asInstance(bo);
-                        es.set("keyId", UBytes::asInstance(b.get("key")));
-                        es.set("createdAt", UDateTime::asInstance(b.get("created_at")));
-                        es.set("signature", sigUBytes);
-                        if (b.find(string("pub_key")) != b.end()) {
-                            PublicKey publicKey(UBytes::asInstance(b.get("pub_key")).get());
-                            es.set("publicKey", UPublicKey(publicKey));
-                        } else {
-                            es.set("publicKey", UObject());
-                        }
-                        byte_vector hash = UBytes::asInstance(b.get("sha512")).get();
-                        byte_vector dataHash = crypto::Digest(crypto::HashType::SHA512, data->data(),
-                                                              data->size()).getDigest();
-                        bool isHashValid = (hash == dataHash);
-                        bool isHash2Valid = true;
-                        if (b.find(string("sha3_384")) != b.end()) {
-                            byte_vector hash1 = UBytes::asInstance(b.get("sha3_384")).get();
-                            byte_vector dataHash1 = crypto::Digest(crypto::HashType::SHA3_384, data->data(),
-                                                                  data->size()).getDigest();
-                            isHash2Valid = (hash1 == dataHash1);
-                        }
-                        bool isAllOk = isHashValid && isHash2Valid;
-                        onComplete->lockedContext([isAllOk, es, onComplete, se](Local<Context> cxt) {
-                            if (isAllOk) {
-                                onComplete->invoke(es.serializeToV8(cxt, onComplete->scripter_sp()));
-                            } else {
-                                onComplete->invoke(UObject().serializeToV8(cxt, onComplete->scripter_sp()));
-                            }
-                        });
-                    }
+                    es = verifyExtendedSignature(pubKey, sig->data(), sig->size(), data->data(), data->size());
                 } catch (const std::exception& e) {
                     cerr << "JsVerifyExtendedSignature error: " << e.what() << endl;
-                    onComplete->lockedContext([onComplete, se](Local<Context> cxt) {
-                        onComplete->invoke(UObject().serializeToV8(cxt, onComplete->scripter_sp()));
-                    });
                 }
+                onComplete->lockedContext([es, onComplete](Local<Context> cxt) {
+                    onComplete->invoke(es.serializeToV8(cxt, onComplete->scripter_sp()));
+                });
             });
             return;
         }
@@ -1061,6 +1234,65 @@ static void JsVerifyExtendedSignature(const FunctionCallbackInfo<Value> &args) {
     });
 }
 
+static void JsVerifyExtendedSignatures(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        // __verify_extendedSignatures(keys, signatures, data, onComplete)
+        if (ac.args.Length() == 4 && ac.args[0]->IsArray()) {
+            uint32_t count = Local<Array>::Cast(ac.args[0])->Length();
+            auto keys = argumentAsArray(ac, 0, count);
+            auto signatures = argumentAsArray(ac, 1, count);
+
+            auto pubKeys = make_shared<vector<PublicKey *>>(count);
+            auto sigs = make_shared<vector<byte_vector>>(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                (*pubKeys)[i] = publicKeyOf(ac, keys->Get(ac.context, i).ToLocalChecked());
+                (*sigs)[i] = copyTypedArray(signatures->Get(ac.context, i).ToLocalChecked());
+            }
+            auto data = ac.asBuffer(2);
+            auto onComplete = ac.asFunction(3);
+
+            runAsync([=]() {
+                auto results = make_shared<vector<UObject>>(count);
+                parallelFor(count, [&](size_t i) {
+                    auto& sig = (*sigs)[i];
+                    try {
+                        (*results)[i] = verifyExtendedSignature((*pubKeys)[i], sig.data(), sig.size(),
+                                                                data->data(), data->size());
+                    } catch (const std::exception& e) {
+                        cerr << "JsVerifyExtendedSignatures error: " << e.what() << endl;
+                    }
+                });
+                onComplete->lockedContext([results, onComplete](Local<Context> cxt) {
+                    auto isolate = cxt->GetIsolate();
+                    Local<Array> array = Array::New(isolate, (int) results->size());
+                    for (size_t i = 0; i < results->size(); ++i)
+                        auto unused = array->Set(cxt, (uint32_t) i, (*results)[i].serializeToV8(cxt, onComplete->scripter_sp()));
+                    onComplete->invoke(array);
+                });
+            });
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
+static void signatureCacheStats(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 0) {
+            auto stats = SignatureCache::instance().stats();
+            UBinder res;
+            res.set("hits", (int64_t) stats.hits);
+            res.set("misses", (int64_t) stats.misses);
+            res.set("evictions", (int64_t) stats.evictions);
+            res.set("size", (int64_t) stats.size);
+            res.set("capacity", (int64_t) stats.capacity);
+            ac.setReturnValue(res.serializeToV8(ac.context, ac.scripter->shared_from_this()));
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
 void JsInitCrypto(Scripter& scripter, const Local<ObjectTemplate> &global) {
     Isolate *isolate = scripter.isolate();
 
@@ -1074,11 +1306,14 @@ void JsInitCrypto(Scripter& scripter, const Local<ObjectTemplate> &global) {
     // endo of critical order
     crypto->Set(isolate, "version", String::NewFromUtf8(isolate, "0.0.1").ToLocalChecked());
     crypto->Set(isolate, "HashIdImpl", initHashId(scripter, isolate));
+    crypto->Set(isolate, "HashIdBuilderImpl", initHashIdBuilder(isolate));
     crypto->Set(isolate, "__digest", FunctionTemplate::New(isolate, digest));
     crypto->Set(isolate, "DigestImpl", initDigestImpl(scripter, isolate));
     crypto->Set(isolate, "__generateSecurePseudoRandomBytes", FunctionTemplate::New(isolate, generateSecurePseudoRandomBytes));
     crypto->Set(isolate, "__calcHmac", FunctionTemplate::New(isolate, calcHmac));
     crypto->Set(isolate, "__pbkdf2", FunctionTemplate::New(isolate, pbkdf2));
+    crypto->Set(isolate, "__verifyBatch", FunctionTemplate::New(isolate, verifyBatch));
+    crypto->Set(isolate, "__signatureCacheStats", FunctionTemplate::New(isolate, signatureCacheStats));
 
     global->Set(isolate, "crypto", crypto);
 
@@ -1086,6 +1321,7 @@ void JsInitCrypto(Scripter& scripter, const Local<ObjectTemplate> &global) {
     global->Set(isolate, "btoa", FunctionTemplate::New(isolate, JsB2A));
 
     global->Set(isolate, "__verify_extendedSignature", FunctionTemplate::New(isolate, JsVerifyExtendedSignature));
+    global->Set(isolate, "__verify_extendedSignatures", FunctionTemplate::New(isolate, JsVerifyExtendedSignatures));
 }
 
 v8::Local<v8::Value> wrapHashId(shared_ptr<Scripter> scripter, crypto::HashId* hashId) {
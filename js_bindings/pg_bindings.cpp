@@ -5,6 +5,28 @@
 #include "pg_bindings.h"
 #include "binding_tools.h"
 #include "../db/PGPool.h"
+#include "../db/LedgerCache.h"
+#include "../types/UBinder.h"
+#include "../types/UArray.h"
+#include "../types/UInt.h"
+
+// Uint8Array values are passed as binary, all others as strings
+static vector<any> paramsFromJs(ArgsContext &ac, Local<Value> value) {
+    vector<any> params;
+    auto arr = v8::Handle<v8::Array>::Cast(value);
+    for (size_t i = 0, count = arr->Length(); i < count; ++i) {
+        auto item = arr->Get(ac.context, i).ToLocalChecked();
+        if (item->IsTypedArray()) {
+            auto contents = v8::Handle<v8::Uint8Array>::Cast(item)->Buffer()->GetContents();
+            byte_vector bv(contents.ByteLength());
+            memcpy(&bv[0], contents.Data(), contents.ByteLength());
+            params.push_back(bv);
+        } else {
+            params.push_back(ac.scripter->getString(item));
+        }
+    }
+    return params;
+}
 
 // PGPool methods
 
@@ -39,6 +61,59 @@ void JsPGPoolWithConnection(const FunctionCallbackInfo<Value> &args) {
     });
 }
 
+void JsPGPoolAddReplica(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 2) {
+            auto pool = unwrap<db::PGPool>(ac.args.This());
+            pair<bool, string> result = pool->addReplica(ac.asInt(0), ac.asString(1));
+            string s("");
+            if (!result.first)
+                s = result.second;
+            ac.setReturnValue(ac.v8String(s));
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsPGPoolWithReadConnection(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 2) {
+            auto pool = unwrap<db::PGPool>(ac.args.This());
+            auto onReady = ac.asFunction(1);
+            pool->withReadConnection(ac.asInt(0), [=](shared_ptr<db::BusyConnection> conn) {
+                onReady->lockedContext([=](Local<Context> &cxt){
+                    onReady->invoke(wrap(onReady->scripter()->BusyConnectionTemplate, onReady->isolate(), conn.get()));
+                });
+            });
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsPGPoolReplicaStats(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 0) {
+            auto pool = unwrap<db::PGPool>(ac.args.This());
+            UArray res;
+            for (auto& stats: pool->getReplicaStats()) {
+                UBinder replica;
+                replica.set("isHealthy", stats.isHealthy);
+                replica.set("lagMillis", (int64_t) stats.lagMillis);
+                replica.set("total", stats.total);
+                replica.set("inUse", stats.inUse);
+                replica.set("reads", (int64_t) stats.reads);
+                replica.set("failedChecks", (int64_t) stats.failedChecks);
+                res.push_back(replica);
+            }
+            ac.setReturnValue(res.serializeToV8(ac.context, ac.scripter->shared_from_this()));
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
 void JsPGPoolTotalConnections(const FunctionCallbackInfo<Value> &args) {
     Scripter::unwrapArgs(args, [](ArgsContext &ac) {
         if (ac.args.Length() == 0) {
@@ -63,6 +138,134 @@ void JsPGPoolAvailableConnections(const FunctionCallbackInfo<Value> &args) {
     });
 }
 
+void JsPGPoolPreparedStatementsStats(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 0) {
+            auto pool = unwrap<db::PGPool>(ac.args.This());
+            auto stats = pool->getPreparedStatementsStats();
+            UBinder res;
+            res.set("hits", (int64_t) stats.hits);
+            res.set("misses", (int64_t) stats.misses);
+            res.set("prepared", (int64_t) stats.prepared);
+            res.set("evictions", (int64_t) stats.evictions);
+            ac.setReturnValue(res.serializeToV8(ac.context, ac.scripter->shared_from_this()));
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsPGPoolPoolStats(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 0) {
+            auto pool = unwrap<db::PGPool>(ac.args.This());
+            auto stats = pool->getPoolStats();
+            UBinder res;
+            res.set("total", stats.total);
+            res.set("inUse", stats.inUse);
+            res.set("waiting", stats.waiting);
+            res.set("acquisitions", (int64_t) stats.acquisitions);
+            res.set("waits", (int64_t) stats.waits);
+            res.set("waitMicrosTotal", (int64_t) stats.waitMicrosTotal);
+            res.set("waitMicrosMax", (int64_t) stats.waitMicrosMax);
+            res.set("spawned", (int64_t) stats.spawned);
+            res.set("closed", (int64_t) stats.closed);
+            res.set("resets", (int64_t) stats.resets);
+            res.set("primaryReads", (int64_t) stats.primaryReads);
+            ac.setReturnValue(res.serializeToV8(ac.context, ac.scripter->shared_from_this()));
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsPGPoolGroupCommit(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 3) {
+            auto onSuccess = ac.asFunction(0);
+            auto onError = ac.asFunction(1);
+
+            // statements are [sql, params] pairs
+            vector<db::BatchStatement> statements;
+            auto arr = v8::Handle<v8::Array>::Cast(ac.args[2]);
+            for (size_t i = 0, count = arr->Length(); i < count; ++i) {
+                auto pair = v8::Handle<v8::Array>::Cast(arr->Get(ac.context, i).ToLocalChecked());
+                db::BatchStatement st;
+                st.queryString = ac.scripter->getString(pair->Get(ac.context, 0));
+                st.params = paramsFromJs(ac, pair->Get(ac.context, 1).ToLocalChecked());
+                statements.emplace_back(std::move(st));
+            }
+
+            auto pool = unwrap<db::PGPool>(ac.args.This());
+            pool->groupCommit(std::move(statements), [=](db::QueryResultsArr &qra) {
+                // statements of group commit are updates, so only their affected rows are passed
+                auto affectedRows = make_shared<vector<int>>();
+                for (auto &qr : qra)
+                    affectedRows->push_back(qr.getAffectedRows());
+                onSuccess->lockedContext([=](Local<Context> &cxt) {
+                    Isolate* isolate = cxt->GetIsolate();
+                    Local<Array> jsResults = Array::New(isolate, affectedRows->size());
+                    for (size_t i = 0; i < affectedRows->size(); ++i)
+                        auto unused = jsResults->Set(cxt, (uint32_t) i, Integer::New(isolate, (*affectedRows)[i]));
+                    onSuccess->invoke(jsResults);
+                });
+            }, [=](const string &err) {
+                onError->lockedContext([=](Local<Context> &cxt){
+                    onError->invoke(onError->scripter()->v8String("PGPool.groupCommit error: postgres error: " + err));
+                });
+            }, true);
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsPGPoolSetGroupCommit(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 2) {
+            auto pool = unwrap<db::PGPool>(ac.args.This());
+            pool->setGroupCommit(ac.asInt(0), ac.asInt(1));
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsPGPoolGroupCommitStats(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 0) {
+            auto pool = unwrap<db::PGPool>(ac.args.This());
+            auto stats = pool->getGroupCommitStats();
+            UBinder res;
+            res.set("committed", (int64_t) stats.committed);
+            res.set("failed", (int64_t) stats.failed);
+            res.set("batches", (int64_t) stats.batches);
+            res.set("retries", (int64_t) stats.retries);
+            UArray batchSizes;
+            for (auto count: stats.batchSizes)
+                batchSizes.push_back(UInt((int64_t) count));
+            res.set("batchSizes", batchSizes);
+            UArray latencyMicros;
+            for (auto count: stats.latencyMicros)
+                latencyMicros.push_back(UInt((int64_t) count));
+            res.set("latencyMicros", latencyMicros);
+            ac.setReturnValue(res.serializeToV8(ac.context, ac.scripter->shared_from_this()));
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsPGPoolHasPipelining(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 0) {
+            ac.setReturnValue(db::PGPool::hasPipelining());
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
 void JsPGPoolClose(const FunctionCallbackInfo<Value> &args) {
     Scripter::unwrapArgs(args, [](ArgsContext &ac) {
         if (ac.args.Length() == 0) {
@@ -83,18 +286,7 @@ void JsBusyConnectionExecuteQuery(const FunctionCallbackInfo<Value> &args) {
             auto onError = ac.asFunction(1);
             auto queryString = ac.asString(2);
 
-            vector<any> params;
-            auto arr = v8::Handle<v8::Array>::Cast(ac.args[3]);
-            for (size_t i = 0, count = arr->Length(); i < count; ++i) {
-                if (arr->Get(ac.context, i).ToLocalChecked()->IsTypedArray()) {
-                    auto contents = v8::Handle<v8::Uint8Array>::Cast(arr->Get(ac.context,i).ToLocalChecked())->Buffer()->GetContents();
-                    byte_vector bv(contents.ByteLength());
-                    memcpy(&bv[0], contents.Data(), contents.ByteLength());
-                    params.push_back(bv);
-                } else {
-                    params.push_back(ac.scripter->getString(arr->Get(ac.context,i)));
-                }
-            }
+            auto params = paramsFromJs(ac, ac.args[3]);
 
             auto con = unwrap<db::BusyConnection>(ac.args.This());
 
@@ -122,18 +314,7 @@ void JsBusyConnectionExecuteUpdate(const FunctionCallbackInfo<Value> &args) {
             auto onError = ac.asFunction(1);
             auto queryString = ac.asString(2);
 
-            vector<any> params;
-            auto arr = v8::Handle<v8::Array>::Cast(ac.args[3]);
-            for (size_t i = 0, count = arr->Length(); i < count; ++i) {
-                if (arr->Get(ac.context,i).ToLocalChecked()->IsTypedArray()) {
-                    auto contents = v8::Handle<v8::Uint8Array>::Cast(arr->Get(ac.context,i).ToLocalChecked())->Buffer()->GetContents();
-                    byte_vector bv(contents.ByteLength());
-                    memcpy(&bv[0], contents.Data(), contents.ByteLength());
-                    params.push_back(bv);
-                } else {
-                    params.push_back(ac.scripter->getString(arr->Get(ac.context,i)));
-                }
-            }
+            auto params = paramsFromJs(ac, ac.args[3]);
 
             auto con = unwrap<db::BusyConnection>(ac.args.This());
 
@@ -153,6 +334,67 @@ void JsBusyConnectionExecuteUpdate(const FunctionCallbackInfo<Value> &args) {
     });
 }
 
+void JsBusyConnectionExecuteBatch(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 3) {
+            auto onSuccess = ac.asFunction(0);
+            auto onError = ac.asFunction(1);
+
+            // statements are [sql, params] pairs
+            vector<db::BatchStatement> statements;
+            auto arr = v8::Handle<v8::Array>::Cast(ac.args[2]);
+            for (size_t i = 0, count = arr->Length(); i < count; ++i) {
+                auto pair = v8::Handle<v8::Array>::Cast(arr->Get(ac.context, i).ToLocalChecked());
+                db::BatchStatement st;
+                st.queryString = ac.scripter->getString(pair->Get(ac.context, 0));
+                st.params = paramsFromJs(ac, pair->Get(ac.context, 1).ToLocalChecked());
+                statements.emplace_back(std::move(st));
+            }
+
+            auto con = unwrap<db::BusyConnection>(ac.args.This());
+
+            con->executeBatchStr([=](db::QueryResultsArr &qra) {
+                // successful results are wrapped, failed ones are passed as error texts
+                auto results = make_shared<vector<db::QueryResult*>>();
+                auto errors = make_shared<vector<string>>();
+                for (auto &qr : qra) {
+                    if (qr.isError()) {
+                        string errText = qr.getErrorText();
+                        if (errText.empty())
+                            errText = "statement is not executed: an earlier statement of the batch has failed";
+                        errors->push_back("PGPool.executeBatch error: postgres error: " + errText);
+                        results->push_back(nullptr);
+                    } else {
+                        auto pqr = new db::QueryResult();
+                        pqr->moveFrom(std::move(qr));
+                        errors->emplace_back();
+                        results->push_back(pqr);
+                    }
+                }
+                onSuccess->lockedContext([=](Local<Context> &cxt) {
+                    Isolate* isolate = cxt->GetIsolate();
+                    Local<Array> jsResults = Array::New(isolate, results->size());
+                    for (size_t i = 0; i < results->size(); ++i) {
+                        Local<Value> item;
+                        if ((*results)[i] != nullptr)
+                            item = wrap(onSuccess->scripter()->QueryResultTemplate, isolate, (*results)[i]);
+                        else
+                            item = onSuccess->scripter()->v8String((*errors)[i]);
+                        auto unused = jsResults->Set(cxt, (uint32_t) i, item);
+                    }
+                    onSuccess->invoke(jsResults);
+                });
+            }, [=](const string &err) {
+                onError->lockedContext([=](Local<Context> &cxt){
+                    onError->invoke(onError->scripter()->v8String(err));
+                });
+            }, statements);
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
 void JsBusyConnectionExec(const FunctionCallbackInfo<Value> &args) {
     Scripter::unwrapArgs(args, [](ArgsContext &ac) {
         if (ac.args.Length() == 3) {
@@ -188,6 +430,384 @@ void JsBusyConnectionExec(const FunctionCallbackInfo<Value> &args) {
     });
 }
 
+static Local<String> v8String(Isolate* isolate, const string& s) {
+    return String::NewFromUtf8(isolate, s.c_str()).ToLocalChecked();
+}
+
+// Cells are decoded from the binary result format straight into JS values, from the memory of the result.
+// Decoders get isolate only, as they are used in callbacks from the PGLoop thread too.
+typedef Local<Value> (*PgDecoder)(Isolate* isolate, std::string_view data);
+
+// milliseconds between 1970-01-01 and 2000-01-01, the epoch of postgres dates and timestamps
+static const double PG_EPOCH_MILLIS = 946684800000.0;
+
+static Local<Value> decodeInt2(Isolate* isolate, std::string_view data) {
+    return Integer::New(isolate, db::getInt16Value(data));
+}
+
+static Local<Value> decodeInt4(Isolate* isolate, std::string_view data) {
+    return Integer::New(isolate, db::getIntValue(data));
+}
+
+static Local<Value> decodeOid(Isolate* isolate, std::string_view data) {
+    return Integer::NewFromUnsigned(isolate, (uint32_t) db::getIntValue(data));
+}
+
+static Local<Value> decodeInt8(Isolate* isolate, std::string_view data) {
+    return BigInt::New(isolate, db::getLongValue(data));
+}
+
+static Local<Value> decodeFloat4(Isolate* isolate, std::string_view data) {
+    return Number::New(isolate, db::getFloatValue(data));
+}
+
+static Local<Value> decodeFloat8(Isolate* isolate, std::string_view data) {
+    return Number::New(isolate, db::getDoubleValue(data));
+}
+
+static Local<Value> decodeBool(Isolate* isolate, std::string_view data) {
+    return v8::Boolean::New(isolate, db::getBoolValue(data));
+}
+
+static Local<Value> decodeText(Isolate* isolate, std::string_view data) {
+    return String::NewFromUtf8(isolate, data.data(), NewStringType::kNormal, (int) data.size()).ToLocalChecked();
+}
+
+static Local<Value> decodeBytea(Isolate* isolate, std::string_view data) {
+    auto ab = ArrayBuffer::New(isolate, data.size());
+    memcpy(ab->GetContents().Data(), data.data(), data.size());
+    return Uint8Array::New(ab, 0, data.size());
+}
+
+// numeric could be wider than double, so it is passed as a decimal string
+static Local<Value> decodeNumeric(Isolate* isolate, std::string_view data) {
+    return v8String(isolate, db::getNumericValue(data));
+}
+
+static Local<Value> decodeTimestamp(Isolate* isolate, std::string_view data) {
+    double millis = PG_EPOCH_MILLIS + (double) db::getLongValue(data) / 1000;
+    return Date::New(isolate->GetCurrentContext(), millis).ToLocalChecked();
+}
+
+static Local<Value> decodeDate(Isolate* isolate, std::string_view data) {
+    double millis = PG_EPOCH_MILLIS + (double) db::getIntValue(data) * 86400000.0;
+    return Date::New(isolate->GetCurrentContext(), millis).ToLocalChecked();
+}
+
+static Local<Value> decodeArray(Isolate* isolate, std::string_view data);
+
+struct PgTypeDecoder {
+    Oid oid;
+    const char* name;
+    PgDecoder decode;
+};
+
+static const PgTypeDecoder pgTypeDecoders[] = {
+    {16, "bool", decodeBool},
+    {17, "bytea", decodeBytea},
+    {19, "name", decodeText},
+    {20, "int8", decodeInt8},
+    {21, "int2", decodeInt2},
+    {23, "int4", decodeInt4},
+    {25, "text", decodeText},
+    {26, "oid", decodeOid},
+    {114, "json", decodeText},
+    {700, "float4", decodeFloat4},
+    {701, "float8", decodeFloat8},
+    {1042, "bpchar", decodeText},
+    {1043, "varchar", decodeText},
+    {1082, "date", decodeDate},
+    {1114, "timestamp", decodeTimestamp},
+    {1184, "timestamptz", decodeTimestamp},
+    {1700, "numeric", decodeNumeric},
+    {1000, "_bool", decodeArray},
+    {1001, "_bytea", decodeArray},
+    {1005, "_int2", decodeArray},
+    {1007, "_int4", decodeArray},
+    {1009, "_text", decodeArray},
+    {1015, "_varchar", decodeArray},
+    {1016, "_int8", decodeArray},
+    {1021, "_float4", decodeArray},
+    {1022, "_float8", decodeArray},
+    {1115, "_timestamp", decodeArray},
+    {1185, "_timestamptz", decodeArray},
+    {1231, "_numeric", decodeArray},
+};
+
+static PgDecoder pgDecoderFor(Oid oid) {
+    for (auto& td: pgTypeDecoders)
+        if (td.oid == oid)
+            return td.decode;
+    return nullptr;
+}
+
+static PgDecoder pgDecoderFor(const string& typeName) {
+    for (auto& td: pgTypeDecoders)
+        if (typeName == td.name)
+            return td.decode;
+    return nullptr;
+}
+
+// binary array: number of dimensions, flags, element type, then size and lower bound of every dimension,
+// then elements, each with its size or -1 for NULL
+static Local<Value> decodeArray(Isolate* isolate, std::string_view data) {
+    if (data.size() < 12)
+        throw std::invalid_argument("wrong array size: " + std::to_string(data.size()));
+    int ndim = db::getIntValue(data.substr(0, 4));
+    Oid elemOid = (Oid) db::getIntValue(data.substr(8, 4));
+    if (ndim == 0)
+        return Array::New(isolate, 0);
+    PgDecoder decodeElement = pgDecoderFor(elemOid);
+    if (decodeElement == nullptr || decodeElement == decodeArray)
+        throw std::invalid_argument("array of unsupported type " + std::to_string(elemOid));
+    if (ndim < 0 || data.size() < 12 + (size_t) ndim * 8)
+        throw std::invalid_argument("wrong array dimensions: " + std::to_string(ndim));
+    vector<int> dims((size_t) ndim);
+    for (int i = 0; i < ndim; ++i)
+        dims[i] = db::getIntValue(data.substr(12 + (size_t) i * 8, 4));
+    size_t pos = 12 + (size_t) ndim * 8;
+
+    Local<Context> cxt = isolate->GetCurrentContext();
+    // multidimensional arrays become nested JS arrays
+    std::function<Local<Array>(int)> decodeDim = [&](int dim) {
+        Local<Array> res = Array::New(isolate, dims[dim]);
+        for (int i = 0; i < dims[dim]; ++i) {
+            Local<Value> item;
+            if (dim + 1 < ndim) {
+                item = decodeDim(dim + 1);
+            } else {
+                if (data.size() < pos + 4)
+                    throw std::invalid_argument("array data is truncated");
+                int size = db::getIntValue(data.substr(pos, 4));
+                pos += 4;
+                if (size < 0) {
+                    item = v8::Null(isolate);
+                } else {
+                    if (data.size() < pos + size)
+                        throw std::invalid_argument("array data is truncated");
+                    item = decodeElement(isolate, data.substr(pos, (size_t) size));
+                    pos += size;
+                }
+            }
+            auto unused = res->Set(cxt, (uint32_t) i, item);
+        }
+        return res;
+    };
+    return decodeDim(0);
+}
+
+/**
+ * Decoders of all columns of a result, resolved once before its rows are read.
+ */
+class PgColumnDecoders {
+public:
+    explicit PgColumnDecoders(db::QueryResult& qr) {
+        int colsCount = qr.getColsCount();
+        decoders.resize((size_t) colsCount);
+        bool isAllResolved = true;
+        for (int i = 0; i < colsCount; ++i) {
+            decoders[i] = pgDecoderFor(qr.getColOid(i));
+            isAllResolved = isAllResolved && decoders[i] != nullptr;
+        }
+        // names are needed only to tell which type is not supported
+        if (!isAllResolved)
+            typeNames = qr.getColTypes();
+    }
+
+    explicit PgColumnDecoders(const vector<string>& colTypes) : typeNames(colTypes) {
+        for (auto& t: colTypes)
+            decoders.push_back(pgDecoderFor(t));
+    }
+
+    size_t size() const {
+        return decoders.size();
+    }
+
+    // data of a non-NULL cell
+    Local<Value> decode(Isolate* isolate, size_t col, std::string_view data) const {
+        if (decoders[col] == nullptr)
+            return v8String(isolate, "pg type error: " + typeNames[col] + " is not bound");
+        try {
+            return decoders[col](isolate, data);
+        } catch (const std::exception& e) {
+            return v8String(isolate, std::string("conversion error: ") + e.what());
+        }
+    }
+
+    Local<Value> decode(Isolate* isolate, db::QueryResult& qr, int row, size_t col) const {
+        if (qr.isNull(row, (int) col))
+            return v8::Null(isolate);
+        return decode(isolate, col, qr.getValueView(row, (int) col));
+    }
+
+private:
+    vector<PgDecoder> decoders;
+    vector<string> typeNames;
+};
+
+// values keep their JS types, copyIn converts them to the column types; null and undefined are NULL
+static any copyValueFromJs(ArgsContext &ac, Local<Value> item) {
+    if (item->IsNull() || item->IsUndefined())
+        return any();
+    if (item->IsTypedArray()) {
+        auto contents = v8::Handle<v8::Uint8Array>::Cast(item)->Buffer()->GetContents();
+        byte_vector bv(contents.ByteLength());
+        memcpy(&bv[0], contents.Data(), contents.ByteLength());
+        return bv;
+    }
+    if (item->IsNumber())
+        return item->NumberValue(ac.context).FromJust();
+    if (item->IsBigInt())
+        return (long long) item.As<BigInt>()->Int64Value();
+    if (item->IsBoolean())
+        return item->BooleanValue(ac.isolate);
+    return ac.scripter->getString(item);
+}
+
+static vector<string> columnsFromJs(ArgsContext &ac, Local<Value> value) {
+    vector<string> columns;
+    auto arr = v8::Handle<v8::Array>::Cast(value);
+    for (size_t i = 0, count = arr->Length(); i < count; ++i)
+        columns.push_back(ac.scripter->getString(arr->Get(ac.context, i)));
+    return columns;
+}
+
+void JsBusyConnectionCopyIn(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 5) {
+            auto onSuccess = ac.asFunction(0);
+            auto onError = ac.asFunction(1);
+            auto table = ac.asString(2);
+            auto columns = columnsFromJs(ac, ac.args[3]);
+
+            vector<vector<any>> rows;
+            auto arr = v8::Handle<v8::Array>::Cast(ac.args[4]);
+            rows.reserve(arr->Length());
+            for (size_t i = 0, count = arr->Length(); i < count; ++i) {
+                auto jsRow = v8::Handle<v8::Array>::Cast(arr->Get(ac.context, i).ToLocalChecked());
+                vector<any> row;
+                row.reserve(jsRow->Length());
+                for (size_t j = 0, colsCount = jsRow->Length(); j < colsCount; ++j)
+                    row.emplace_back(copyValueFromJs(ac, jsRow->Get(ac.context, j).ToLocalChecked()));
+                rows.emplace_back(std::move(row));
+            }
+
+            auto con = unwrap<db::BusyConnection>(ac.args.This());
+
+            con->copyIn([=](int rowsCount) {
+                onSuccess->lockedContext([=](Local<Context> &cxt){
+                    onSuccess->invoke(Number::New(cxt->GetIsolate(), rowsCount));
+                });
+            }, [=](const string &err) {
+                onError->lockedContext([=](Local<Context> &cxt){
+                    onError->invoke(onError->scripter()->v8String(err));
+                });
+            }, table, columns, std::move(rows));
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsBusyConnectionCopyOut(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 4) {
+            auto onSuccess = ac.asFunction(0);
+            auto onError = ac.asFunction(1);
+            auto table = ac.asString(2);
+            auto columns = columnsFromJs(ac, ac.args[3]);
+
+            auto con = unwrap<db::BusyConnection>(ac.args.This());
+
+            con->copyOut([=](vector<string>& colTypes, vector<vector<db::CopyValue>>& rows) {
+                auto decoders = make_shared<PgColumnDecoders>(colTypes);
+                auto data = make_shared<vector<vector<db::CopyValue>>>(std::move(rows));
+                onSuccess->lockedContext([=](Local<Context> &cxt){
+                    Isolate* isolate = cxt->GetIsolate();
+                    Local<Array> jsRows = Array::New(isolate, data->size());
+                    vector<Local<Value>> values(decoders->size());
+                    for (size_t i = 0; i < data->size(); ++i) {
+                        auto& row = (*data)[i];
+                        // empty values are decoded too, only NULL has no value
+                        for (size_t j = 0; j < values.size(); ++j)
+                            values[j] = j >= row.size() || !row[j] ? (Local<Value>) v8::Null(isolate) :
+                                decoders->decode(isolate, j, std::string_view((const char*) row[j]->data(), row[j]->size()));
+                        auto unused = jsRows->Set(cxt, (uint32_t) i, Array::New(isolate, values.data(), values.size()));
+                    }
+                    onSuccess->invoke(jsRows);
+                });
+            }, [=](const string &err) {
+                onError->lockedContext([=](Local<Context> &cxt){
+                    onError->invoke(onError->scripter()->v8String(err));
+                });
+            }, table, columns);
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsBusyConnectionExecuteQueryStream(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 6) {
+            auto onRows = ac.asFunction(0);
+            auto onDone = ac.asFunction(1);
+            auto onError = ac.asFunction(2);
+            auto batchSize = ac.asInt(3);
+            auto queryString = ac.asString(4);
+
+            auto params = paramsFromJs(ac, ac.args[5]);
+
+            auto con = unwrap<db::BusyConnection>(ac.args.This());
+
+            // the connection waits until JS processes the batch and calls _resumeStream with its id
+            con->executeQueryStreamAsync([=](db::QueryResultsArr &qra, int batchId) {
+                // results are converted in the JS thread straight from their memory
+                auto batch = make_shared<db::QueryResultsArr>(std::move(qra));
+                onRows->lockedContext([=](Local<Context> &cxt) {
+                    Isolate* isolate = cxt->GetIsolate();
+                    // all rows of the stream have the same columns
+                    PgColumnDecoders decoders((*batch)[0]);
+                    Local<Array> jsRows = Array::New(isolate, batch->size());
+                    vector<Local<Value>> values(decoders.size());
+                    for (size_t i = 0; i < batch->size(); ++i) {
+                        auto& qr = (*batch)[i];
+                        for (size_t j = 0; j < values.size(); ++j)
+                            values[j] = decoders.decode(isolate, qr, 0, j);
+                        auto unused = jsRows->Set(cxt, (uint32_t) i, Array::New(isolate, values.data(), values.size()));
+                    }
+                    Local<Value> res[2] = {jsRows, Integer::New(isolate, batchId)};
+                    onRows->invoke(2, res);
+                });
+            }, [=](int rowsCount) {
+                onDone->lockedContext([=](Local<Context> &cxt){
+                    onDone->invoke(Number::New(cxt->GetIsolate(), rowsCount));
+                });
+            }, [=](const string &err) {
+                onError->lockedContext([=](Local<Context> &cxt){
+                    onError->invoke(onError->scripter()->v8String(err));
+                });
+            }, batchSize, queryString, params);
+
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsBusyConnectionResumeStream(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 2) {
+            auto batchId = ac.asInt(0);
+            auto isNeeded = ac.args[1]->BooleanValue(ac.isolate);
+            auto con = unwrap<db::BusyConnection>(ac.args.This());
+            con->resumeStream(batchId, isNeeded);
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
 void JsBusyConnectionRelease(const FunctionCallbackInfo<Value> &args) {
     Scripter::unwrapArgs(args, [](ArgsContext &ac) {
         if (ac.args.Length() == 0) {
@@ -212,8 +832,17 @@ void JsInitPGPool(Scripter& scripter, const Local<ObjectTemplate> &global) {
     prototype->Set(isolate, "version", String::NewFromUtf8(isolate, "0.0.1").ToLocalChecked());
     prototype->Set(isolate, "_connect", FunctionTemplate::New(isolate, JsPGPoolConnect));
     prototype->Set(isolate, "_withConnection", FunctionTemplate::New(isolate, JsPGPoolWithConnection));
+    prototype->Set(isolate, "_addReplica", FunctionTemplate::New(isolate, JsPGPoolAddReplica));
+    prototype->Set(isolate, "_withReadConnection", FunctionTemplate::New(isolate, JsPGPoolWithReadConnection));
+    prototype->Set(isolate, "_replicaStats", FunctionTemplate::New(isolate, JsPGPoolReplicaStats));
     prototype->Set(isolate, "_totalConnections", FunctionTemplate::New(isolate, JsPGPoolTotalConnections));
     prototype->Set(isolate, "_availableConnections", FunctionTemplate::New(isolate, JsPGPoolAvailableConnections));
+    prototype->Set(isolate, "_preparedStatementsStats", FunctionTemplate::New(isolate, JsPGPoolPreparedStatementsStats));
+    prototype->Set(isolate, "_poolStats", FunctionTemplate::New(isolate, JsPGPoolPoolStats));
+    prototype->Set(isolate, "_groupCommit", FunctionTemplate::New(isolate, JsPGPoolGroupCommit));
+    prototype->Set(isolate, "_setGroupCommit", FunctionTemplate::New(isolate, JsPGPoolSetGroupCommit));
+    prototype->Set(isolate, "_groupCommitStats", FunctionTemplate::New(isolate, JsPGPoolGroupCommitStats));
+    prototype->Set(isolate, "_hasPipelining", FunctionTemplate::New(isolate, JsPGPoolHasPipelining));
     prototype->Set(isolate, "_close", FunctionTemplate::New(isolate, JsPGPoolClose));
 
     // register it into global namespace
@@ -232,6 +861,11 @@ void JsInitBusyConnection(Scripter& scripter, const Local<ObjectTemplate> &globa
     prototype->Set(isolate, "version", String::NewFromUtf8(isolate, "0.0.1").ToLocalChecked());
     prototype->Set(isolate, "_executeQuery", FunctionTemplate::New(isolate, JsBusyConnectionExecuteQuery));
     prototype->Set(isolate, "_executeUpdate", FunctionTemplate::New(isolate, JsBusyConnectionExecuteUpdate));
+    prototype->Set(isolate, "_executeBatch", FunctionTemplate::New(isolate, JsBusyConnectionExecuteBatch));
+    prototype->Set(isolate, "_executeQueryStream", FunctionTemplate::New(isolate, JsBusyConnectionExecuteQueryStream));
+    prototype->Set(isolate, "_resumeStream", FunctionTemplate::New(isolate, JsBusyConnectionResumeStream));
+    prototype->Set(isolate, "_copyIn", FunctionTemplate::New(isolate, JsBusyConnectionCopyIn));
+    prototype->Set(isolate, "_copyOut", FunctionTemplate::New(isolate, JsBusyConnectionCopyOut));
     prototype->Set(isolate, "_exec", FunctionTemplate::New(isolate, JsBusyConnectionExec));
     prototype->Set(isolate, "_release", FunctionTemplate::New(isolate, JsBusyConnectionRelease));
 
@@ -310,67 +944,85 @@ void JsQueryResultGetColTypes(const FunctionCallbackInfo<Value> &args) {
     });
 }
 
-static unordered_map<string, std::function<Local<Value>(ArgsContext &ac, const byte_vector&)>> Converter
-{
-    {"int4", [](ArgsContext &ac, const byte_vector& bv){
-        return Number::New(ac.isolate, db::getIntValue(bv));
-    }},
-    {"int8", [](ArgsContext &ac, const byte_vector& bv){
-        return BigInt::New(ac.isolate, db::getLongValue(bv));
-    }},
-    {"text", [](ArgsContext &ac, const byte_vector& bv){
-        return ac.v8String(db::getStringValue(bv));
-    }},
-    {"bytea", [](ArgsContext &ac, const byte_vector& bv){
-        return ac.toBinary(bv);
-    }},
-    {"float8", [](ArgsContext &ac, const byte_vector& bv){
-        return Number::New(ac.isolate, db::getDoubleValue(bv));
-    }},
-    {"bool", [](ArgsContext &ac, const byte_vector& bv){
-        return v8::Boolean::New(ac.isolate, db::getBoolValue(bv));
-    }},
-    {"name", [](ArgsContext &ac, const byte_vector& bv){
-        return ac.v8String(db::getStringValue(bv));
-    }},
-};
+void JsQueryResultGetRows(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 1) {
+            auto maxRows = ac.asInt(0);
+            auto pqr = unwrap<db::QueryResult>(ac.args.This());
+            int rowsCount;
+            int firstRow = pqr->nextRows(maxRows, rowsCount);
 
-Local<Value> getJsValueFromPgResult(ArgsContext &ac, const byte_vector& data, const string& pgType) {
-    try {
-        if (data.size() == 0)
-            return v8::Null(ac.isolate);
-        else if (Converter.find(pgType) != Converter.end())
-            return Converter[pgType](ac, data);
-    } catch (const std::exception& e) {
-        return ac.v8String(std::string("conversion error: ") + e.what());
+            // flat array, rows are split by the driver
+            PgColumnDecoders decoders(*pqr);
+            size_t colsCount = decoders.size();
+            vector<Local<Value>> res((size_t) rowsCount * colsCount);
+            for (int iRow = 0; iRow < rowsCount; ++iRow)
+                for (size_t iCol = 0; iCol < colsCount; ++iCol)
+                    res[iRow * colsCount + iCol] = decoders.decode(ac.isolate, *pqr, firstRow + iRow, iCol);
+            ac.setReturnValue(Array::New(ac.isolate, res.data(), res.size()));
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+template<typename T, typename A>
+static Local<A> typedColumn(Isolate* isolate, db::QueryResult& qr, int col, const std::function<T(std::string_view)>& read) {
+    int rowsCount = qr.getRowsCount();
+    auto ab = ArrayBuffer::New(isolate, rowsCount * sizeof(T));
+    T* data = (T*) ab->GetContents().Data();
+    for (int i = 0; i < rowsCount; ++i) {
+        if (qr.isNull(i, col))
+            throw std::invalid_argument("column has NULL in row " + std::to_string(i));
+        data[i] = read(qr.getValueView(i, col));
     }
-    return ac.v8String("pg type error: " + pgType + " is not bound");
+    return A::New(ab, 0, rowsCount);
 }
 
-void JsQueryResultGetRows(const FunctionCallbackInfo<Value> &args) {
+void JsQueryResultGetColumn(const FunctionCallbackInfo<Value> &args) {
     Scripter::unwrapArgs(args, [](ArgsContext &ac) {
         if (ac.args.Length() == 1) {
-            auto maxRows = ac.asInt(0);
+            auto col = ac.asInt(0);
             auto pqr = unwrap<db::QueryResult>(ac.args.This());
-            auto rows = pqr->getRows(maxRows);
-
-            if (rows.size() == 0) {
-                Local<Value> res[0];
-                Local<Array> result = Array::New(ac.args.GetIsolate(), res, rows.size());
-                ac.setReturnValue(result);
-            } else {
-                auto colTypes = pqr->getColTypes();
-                auto colsCount = rows[0].size();
-                Local<Value> res[rows.size() * colsCount];
-                for (int iRow = 0; iRow < rows.size(); ++iRow) {
-                    for (int iCol = 0; iCol < colsCount; ++iCol) {
-                        res[iRow * colsCount + iCol] = getJsValueFromPgResult(ac, rows[iRow][iCol], colTypes[iCol]);
-                    }
+            if (col < 0 || col >= pqr->getColsCount()) {
+                ac.throwError("column index is out of range: " + std::to_string(col));
+                return;
+            }
+            try {
+                switch (pqr->getColOid(col)) {
+                    case 21:
+                        ac.setReturnValue(typedColumn<int, Int32Array>(ac.isolate, *pqr, col, [](std::string_view v) {
+                            return (int) db::getInt16Value(v);
+                        }));
+                        return;
+                    case 23:
+                        ac.setReturnValue(typedColumn<int, Int32Array>(ac.isolate, *pqr, col, [](std::string_view v) {
+                            return db::getIntValue(v);
+                        }));
+                        return;
+                    case 20:
+                        ac.setReturnValue(typedColumn<int64_t, BigInt64Array>(ac.isolate, *pqr, col, [](std::string_view v) {
+                            return (int64_t) db::getLongValue(v);
+                        }));
+                        return;
+                    case 700:
+                        ac.setReturnValue(typedColumn<double, Float64Array>(ac.isolate, *pqr, col, [](std::string_view v) {
+                            return (double) db::getFloatValue(v);
+                        }));
+                        return;
+                    case 701:
+                        ac.setReturnValue(typedColumn<double, Float64Array>(ac.isolate, *pqr, col, [](std::string_view v) {
+                            return db::getDoubleValue(v);
+                        }));
+                        return;
+                    default:
+                        ac.throwError("column type " + pqr->getColTypes()[col] + " has no typed array");
+                        return;
                 }
-                Local<Array> result = Array::New(ac.args.GetIsolate(), res, rows.size() * colsCount);
-                ac.setReturnValue(result);
+            } catch (const std::exception& e) {
+                ac.throwError(e.what());
+                return;
             }
-            return;
         }
         ac.throwError("invalid number of arguments");
     });
@@ -402,9 +1054,154 @@ void JsInitQueryResult(Scripter& scripter, const Local<ObjectTemplate> &global)
     prototype->Set(isolate, "_getColNames", FunctionTemplate::New(isolate, JsQueryResultGetColNames));
     prototype->Set(isolate, "_getColTypes", FunctionTemplate::New(isolate, JsQueryResultGetColTypes));
     prototype->Set(isolate, "_getRows", FunctionTemplate::New(isolate, JsQueryResultGetRows));
+    prototype->Set(isolate, "_getColumn", FunctionTemplate::New(isolate, JsQueryResultGetColumn));
     prototype->Set(isolate, "_release", FunctionTemplate::New(isolate, JsQueryResultRelease));
 
     // register it into global namespace
     scripter.QueryResultTemplate.Reset(isolate, tpl);
     global->Set(isolate, "QueryResult", tpl);
 }
+
+// LedgerCache methods, rows are arrays as selected from the ledger table:
+// [id, hash, state, locked_by_id, created_at, expires_at]
+
+typedef shared_ptr<db::LedgerCache> LedgerCacheRef;
+
+static Local<Value> ledgerCacheRow(ArgsContext &ac, const void *digest, size_t digestSize, const db::LedgerRecord &record) {
+    Local<Value> values[] = {
+            Number::New(ac.isolate, (double) record.recordId),
+            ac.toBinary(digest, digestSize),
+            Integer::New(ac.isolate, record.state),
+            Number::New(ac.isolate, (double) record.lockedById),
+            Number::New(ac.isolate, (double) record.createdAt),
+            Number::New(ac.isolate, (double) record.expiresAt)
+    };
+    return Array::New(ac.isolate, values, 6);
+}
+
+void JsLedgerCacheGet(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 1 && ac.args[0]->IsTypedArray()) {
+            auto cache = unwrap<LedgerCacheRef>(ac.args.This());
+            auto digest = ac.as<TypedArray>(0);
+            auto data = (unsigned char *) digest->Buffer()->GetContents().Data() + digest->ByteOffset();
+            db::LedgerRecord record;
+            if ((*cache)->get(data, digest->ByteLength(), record))
+                ac.setReturnValue(ledgerCacheRow(ac, data, digest->ByteLength(), record));
+            else
+                ac.args.GetReturnValue().SetNull();
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
+void JsLedgerCacheGetById(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 1) {
+            auto cache = unwrap<LedgerCacheRef>(ac.args.This());
+            byte_vector digest;
+            db::LedgerRecord record;
+            if ((*cache)->getById(ac.asLong(0), digest, record))
+                ac.setReturnValue(ledgerCacheRow(ac, digest.data(), digest.size(), record));
+            else
+                ac.args.GetReturnValue().SetNull();
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsLedgerCachePut(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 6 && ac.args[0]->IsTypedArray()) {
+            auto cache = unwrap<LedgerCacheRef>(ac.args.This());
+            auto digest = ac.as<TypedArray>(0);
+            auto data = (unsigned char *) digest->Buffer()->GetContents().Data() + digest->ByteOffset();
+            db::LedgerRecord record;
+            record.recordId = ac.asLong(1);
+            record.state = ac.asInt(2);
+            record.lockedById = ac.asLong(3);
+            record.createdAt = ac.asLong(4);
+            record.expiresAt = ac.asLong(5);
+            (*cache)->put(data, digest->ByteLength(), record);
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
+void JsLedgerCacheRemove(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 1 && ac.args[0]->IsTypedArray()) {
+            auto cache = unwrap<LedgerCacheRef>(ac.args.This());
+            auto digest = ac.as<TypedArray>(0);
+            auto data = (unsigned char *) digest->Buffer()->GetContents().Data() + digest->ByteOffset();
+            (*cache)->remove(data, digest->ByteLength());
+            return;
+        }
+        ac.throwError("invalid arguments");
+    });
+}
+
+void JsLedgerCacheClear(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 0) {
+            auto cache = unwrap<LedgerCacheRef>(ac.args.This());
+            (*cache)->clear();
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsLedgerCacheStats(const FunctionCallbackInfo<Value> &args) {
+    Scripter::unwrapArgs(args, [](ArgsContext &ac) {
+        if (ac.args.Length() == 0) {
+            auto cache = unwrap<LedgerCacheRef>(ac.args.This());
+            auto stats = (*cache)->getStats();
+            UBinder res;
+            res.set("size", (int64_t) stats.size);
+            res.set("hits", (int64_t) stats.hits);
+            res.set("misses", (int64_t) stats.misses);
+            res.set("evictions", (int64_t) stats.evictions);
+            res.set("expirations", (int64_t) stats.expirations);
+            ac.setReturnValue(res.serializeToV8(ac.context, ac.scripter->shared_from_this()));
+            return;
+        }
+        ac.throwError("invalid number of arguments");
+    });
+}
+
+void JsInitLedgerCache(Scripter& scripter, const Local<ObjectTemplate> &global) {
+    Isolate *isolate = scripter.isolate();
+
+    // new LedgerCache(name, maxSize, ttlMillis): caches of the same name are shared by all isolates
+    Local<FunctionTemplate> tpl = bindCppClass<LedgerCacheRef>(
+            isolate,
+            "LedgerCache",
+            [](const FunctionCallbackInfo<Value> &args) -> LedgerCacheRef * {
+                auto isolate = args.GetIsolate();
+                if (args.Length() == 3) {
+                    auto context = isolate->GetCurrentContext();
+                    String::Utf8Value name(isolate, args[0]);
+                    auto maxSize = args[1]->IntegerValue(context).FromJust();
+                    auto ttlMillis = args[2]->IntegerValue(context).FromJust();
+                    if (maxSize > 0 && ttlMillis > 0)
+                        return new LedgerCacheRef(db::LedgerCache::shared(*name, (size_t) maxSize, ttlMillis));
+                }
+                isolate->ThrowException(
+                        Exception::TypeError(String::NewFromUtf8(isolate, "bad constructor arguments").ToLocalChecked()));
+                return nullptr;
+            });
+
+    auto prototype = tpl->PrototypeTemplate();
+    prototype->Set(isolate, "_get", FunctionTemplate::New(isolate, JsLedgerCacheGet));
+    prototype->Set(isolate, "_getById", FunctionTemplate::New(isolate, JsLedgerCacheGetById));
+    prototype->Set(isolate, "_put", FunctionTemplate::New(isolate, JsLedgerCachePut));
+    prototype->Set(isolate, "_remove", FunctionTemplate::New(isolate, JsLedgerCacheRemove));
+    prototype->Set(isolate, "_clear", FunctionTemplate::New(isolate, JsLedgerCacheClear));
+    prototype->Set(isolate, "_stats", FunctionTemplate::New(isolate, JsLedgerCacheStats));
+
+    global->Set(isolate, "LedgerCache", tpl);
+}
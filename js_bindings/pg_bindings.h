@@ -13,5 +13,6 @@ using namespace std;
 void JsInitPGPool(Scripter& scripter, const Local<ObjectTemplate> &global);
 void JsInitBusyConnection(Scripter& scripter, const Local<ObjectTemplate> &global);
 void JsInitQueryResult(Scripter& scripter, const Local<ObjectTemplate> &global);
+void JsInitLedgerCache(Scripter& scripter, const Local<ObjectTemplate> &global);
 
 #endif //U8_PG_BINDINGS_H
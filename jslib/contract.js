@@ -1909,6 +1909,8 @@ class Contract extends bs.BiSerializable {
         Object.values(this.state.roles).forEach(extractKeys);
 
         // verify signatures
+        let signatureKeys = [];
+        let signatures = [];
         for (let signature of  data.signatures) {
 
             let key = await ExtendedSignature.extractPublicKey(signature);
@@ -1921,14 +1923,19 @@ class Contract extends bs.BiSerializable {
                 if (isQuantise)
                     this.quantiser.addWorkCost(key.bitStrength === 2048 ? QuantiserProcesses.PRICE_CHECK_2048_SIG : QuantiserProcesses.PRICE_CHECK_4096_SIG);
 
-                let es = await ExtendedSignature.verify(key, signature, contractBytes);
-                if (es != null) {
-                    this.sealedByKeys.set(key, es);
-                } else
-                    this.errors.push(new ErrorRecord(Errors.BAD_SIGNATURE, "keytag:" + key, "the signature is broken"));
+                signatureKeys.push(key);
+                signatures.push(signature);
             }
         }
 
+        let results = await ExtendedSignature.verifyBatch(signatureKeys, signatures, contractBytes);
+        for (let i = 0; i < results.length; i++) {
+            if (results[i] != null)
+                this.sealedByKeys.set(signatureKeys[i], results[i]);
+            else
+                this.errors.push(new ErrorRecord(Errors.BAD_SIGNATURE, "keytag:" + signatureKeys[i], "the signature is broken"));
+        }
+
         this.isNeedVerifySealedKeys = false;
     }
 
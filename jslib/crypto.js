@@ -290,6 +290,55 @@ const HashId = crypto.HashId = class extends crypto.HashIdImpl {
         });
     }
 
+    /**
+     * Calculate HashIds of many data items at once, in parallel. Much faster than calling of_async for each
+     * of many small items.
+     *
+     * @param {Array<Uint8Array|string>} dataArray items to calculate hashIds of
+     * @returns {Promise<Array<crypto.HashId>>} hashIds in the same order
+     */
+    static ofMany(dataArray) {
+        return new Promise((resolve, reject) => {
+            let items = dataArray.map(data => typeof (data) == 'string' ? utf8Encode(data) : data);
+            crypto.HashIdImpl.__ofMany(items, (res) => {
+                for (let id of res)
+                    id.__proto__ = crypto.HashId.prototype;
+                resolve(res);
+            });
+        });
+    }
+
+    /**
+     * Calculate HashId of a file contents without loading it to memory. File is read in chunks in the background,
+     * hashing each chunk while the next one is being read.
+     *
+     * @param {string} path of the file to read
+     * @param {number} chunkSize size of the read buffers, 1Mb by default
+     * @returns {Promise<crypto.HashId>}
+     */
+    static ofFile(path, chunkSize = 1024 * 1024) {
+        return new Promise((resolve, reject) => {
+            let handle = new IOFile();
+            let fail = (code) => reject(new Error(`${IOFile.getErrorText(code)} (${code})`));
+            handle.open(path, 'r', 0, code => {
+                if (code < 0) {
+                    fail(code);
+                    return;
+                }
+                crypto.HashIdImpl.__ofFile(handle, chunkSize, (res, code) => {
+                    handle._close_raw(() => {
+                        if (code < 0)
+                            fail(code);
+                        else {
+                            res.__proto__ = crypto.HashId.prototype;
+                            resolve(res);
+                        }
+                    });
+                });
+            });
+        });
+    }
+
     /**
      * Construct HashId with pre-calculated digest.
      *
@@ -346,6 +395,72 @@ const HashId = crypto.HashId = class extends crypto.HashIdImpl {
     }
 };
 
+/**
+ * Calculates HashId of data that comes in parts, e.g. read from a stream, without concatenating it. The result is
+ * the same as {@link crypto.HashId.of} of all the parts joined together.
+ *
+ * @type {crypto.HashId.Builder}
+ */
+crypto.HashId.Builder = class extends crypto.HashIdBuilderImpl {
+    /**
+     * Add next part of the data.
+     *
+     * @param {Uint8Array|string} data
+     * @returns {crypto.HashId.Builder} this builder
+     */
+    update(data) {
+        if (typeof (data) == 'string')
+            data = utf8Encode(data);
+        this.__update(data);
+        return this;
+    }
+
+    /**
+     * Calculate HashId of all the data added. The builder can not be used after it.
+     *
+     * @returns {crypto.HashId}
+     */
+    finish() {
+        let res = this.__finish();
+        res.__proto__ = crypto.HashId.prototype;
+        return res;
+    }
+};
+
+/**
+ * Verify many signatures at once. Hashing and RSA checks of different signatures run in parallel, and the result
+ * comes in a single callback, which is much faster than awaiting {@link crypto.PublicKey#verify} one by one.
+ *
+ * @param {Array<{key: crypto.PublicKey, signature: Uint8Array, data: Uint8Array|string, hashType: number}>} items
+ *        signatures to verify, hashType defaults to crypto.SHA3_256 as in {@link crypto.PublicKey#verify}
+ * @returns {Promise<Array<boolean>>} verification results in the order of items
+ */
+crypto.verifyBatch = async (items) => {
+    let keys = [], signatures = [], data = [], hashTypes = [];
+    for (let item of items) {
+        let itemData = typeof (item.data) == 'string' ? utf8Encode(item.data) : item.data;
+        if (!(itemData instanceof Uint8Array))
+            throw new Error("Wrong data type: " + typeof (itemData));
+        if (!(item.key instanceof crypto.PublicKeyImpl))
+            throw new Error("Wrong key type: " + typeof (item.key));
+        keys.push(item.key);
+        signatures.push(item.signature);
+        data.push(itemData);
+        hashTypes.push(item.hashType === undefined ? crypto.SHA3_256 : item.hashType);
+    }
+    if (keys.length === 0)
+        return [];
+    return new Promise(resolve => crypto.__verifyBatch(keys, signatures, data, hashTypes, resolve));
+};
+
+/**
+ * Statistics of the cache of valid signatures shared by all the keys: once a signature is verified, checking it
+ * again skips RSA operations.
+ *
+ * @returns {{hits: number, misses: number, evictions: number, size: number, capacity: number}}
+ */
+crypto.signatureCacheStats = () => crypto.__signatureCacheStats();
+
 crypto.getRandomValues = (typedArray) => {
     let view = new Uint8Array(typedArray.buffer);
     let rndBinary = crypto.__generateSecurePseudoRandomBytes(view.length);
@@ -361,20 +476,26 @@ Object.freeze(crypto.PublicKeyImpl);
 Object.freeze(crypto.KeyAddress);
 Object.freeze(crypto.SymmetricKeyImpl);
 Object.freeze(crypto.HashIdImpl);
+Object.freeze(crypto.HashIdBuilderImpl);
 Object.freeze(crypto.__digest);
 Object.freeze(crypto.DigestImpl);
 Object.freeze(crypto.__generateSecurePseudoRandomBytes);
 Object.freeze(crypto.__calcHmac);
 Object.freeze(crypto.__pbkdf2);
+Object.freeze(crypto.__verifyBatch);
+Object.freeze(crypto.__signatureCacheStats);
 Object.freeze(crypto.Exception);
 Object.freeze(crypto.PrivateKey);
 Object.freeze(crypto.PublicKey);
 Object.freeze(crypto.SymmetricKey);
 Object.freeze(crypto.digest);
+Object.freeze(crypto.HashId.Builder);
 Object.freeze(crypto.HashId);
 Object.freeze(crypto.equals);
 Object.freeze(crypto.stringId);
 Object.freeze(crypto.getRandomValues);
+Object.freeze(crypto.verifyBatch);
+Object.freeze(crypto.signatureCacheStats);
 Object.freeze(crypto);
 
 module.exports = {KeyAddress, HashId, PublicKey, PrivateKey, SymmetricKey};
\ No newline at end of file
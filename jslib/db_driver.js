@@ -61,6 +61,17 @@ class SqlDriverPool {
         throw new DatabaseError("not implemented");
     }
 
+    /**
+     * Driver could implement. As withConnection, for read only statements that can see data up to maxStalenessMillis
+     * old, so that they could be served by a replica. Drivers without replicas read from the pool itself.
+     *
+     * @param maxStalenessMillis allowed replication lag.
+     * @param callback as of withConnection.
+     */
+    withReadConnection(maxStalenessMillis, callback) {
+        this.withConnection(callback);
+    }
+
     /**
      * Driver implements. Return number of connections in the pool.
      *
@@ -79,6 +90,26 @@ class SqlDriverPool {
         return 0;
     }
 
+    /**
+     * Driver implements. Execute statements in one transaction shared with other concurrent groupCommit calls.
+     *
+     * @param statements array of {sql, params}.
+     * @return {Promise<Array<number>>} affected rows of every statement, resolved after the commit.
+     */
+    groupCommit(statements) {
+        return Promise.reject(new DatabaseError("not implemented"));
+    }
+
+    /**
+     * Driver implements. Return true if groupCommit sends statements of concurrent calls together, so that it is
+     * faster than executing them separately.
+     *
+     * @return {boolean}
+     */
+    hasPipelining() {
+        return false;
+    }
+
     /**
      * Releases all connections to database.
      */
@@ -140,6 +171,55 @@ class SqlDriverConnection {
         throw new DatabaseError("not implemented");
     }
 
+    /**
+     * Execute several parameterized statements at once, saving network round trips.
+     *
+     * @param statements array of {sql, params}, where sql has '?' placeholders for params.
+     * @param callback called with an array of results, one per statement: {SqlDriverResultSet} or {DatabaseError}.
+     */
+    executeBatch(statements, callback) {
+        throw new DatabaseError("not implemented");
+    }
+
+    /**
+     * Insert many rows at once, faster than INSERT statements.
+     *
+     * @param onSuccess callback that is called with number of inserted rows.
+     * @param onError callback that is called with {DatabaseError}.
+     * @param table table name.
+     * @param columns array of column names.
+     * @param rows array of rows, each is an array of values in the order of columns.
+     */
+    copyIn(onSuccess, onError, table, columns, rows) {
+        throw new DatabaseError("not implemented");
+    }
+
+    /**
+     * Read all rows of the table at once.
+     *
+     * @param onSuccess callback that is called with array of rows, each is an array of values in the order of columns.
+     * @param onError callback that is called with {DatabaseError}.
+     * @param table table name.
+     * @param columns array of column names.
+     */
+    copyOut(onSuccess, onError, table, columns) {
+        throw new DatabaseError("not implemented");
+    }
+
+    /**
+     * Execute query and receive its rows by batches as they come, not waiting for the whole result.
+     *
+     * @param onRows callback that is called with array of up to batchSize rows.
+     * @param onDone callback that is called with total number of rows after the last batch.
+     * @param onError callback that is called with {DatabaseError}.
+     * @param batchSize max number of rows in one batch.
+     * @param queryString query with '?' placeholders for params.
+     * @param params values for placeholders.
+     */
+    streamQuery(onRows, onDone, onError, batchSize, queryString, ...params) {
+        throw new DatabaseError("not implemented");
+    }
+
     /**
      * Each connection received with withConnection() pool method, should be released.
      */
@@ -200,6 +280,15 @@ class SqlDriverResultSet {
         throw new DatabaseError("not implemented");
     }
 
+    /**
+     * Return all values of a numeric column as a typed array.
+     *
+     * @param colIndex 0-based index of the column.
+     */
+    getColumn(colIndex) {
+        throw new DatabaseError("not implemented");
+    }
+
     /**
      * Optinally close the resultset. If not called explicitly, driver
      */
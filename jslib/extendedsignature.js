@@ -118,6 +118,25 @@ class ExtendedSignature {
         }));
     }
 
+    /**
+     * Verify extended signatures of the same data made with the given keys, all in one call.
+     *
+     * @param {Array<crypto.PublicKey>} keys - key for each signature.
+     * @param {Array<Uint8Array>} signatures - packed extended signatures.
+     * @param {Uint8Array} data - signed data.
+     * @return {Promise<Array<ExtendedSignature|null>>} ExtendedSignature or null if it is not valid, for each signature.
+     */
+    static async verifyBatch(keys, signatures, data) {
+        if (keys.length === 0)
+            return [];
+        return new Promise(resolve => __verify_extendedSignatures(keys, signatures, data, (results) => {
+            for (let res of results)
+                if (res != null)
+                    res.__proto__ = ExtendedSignature.prototype;
+            resolve(results);
+        }));
+    }
+
     static async extractPublicKey(signature) {
         try {
             return new crypto.PublicKey((await Boss.load((await Boss.load(signature)).exts)).pub_key);
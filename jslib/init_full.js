@@ -184,9 +184,11 @@ function freezeGlobals() {
     Object.freeze(global.atob);
     Object.freeze(global.btoa);
     Object.freeze(global.__verify_extendedSignature);
+    Object.freeze(global.__verify_extendedSignatures);
     Object.freeze(global.QueryResult);
     Object.freeze(global.BusyConnection);
     Object.freeze(global.PGPool);
+    Object.freeze(global.LedgerCache);
     Object.freeze(global.HttpServerRequestBuf);
     Object.freeze(global.HttpServerSecureRequestBuf);
     Object.freeze(global.network.NodeInfoImpl);
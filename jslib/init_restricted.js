@@ -146,6 +146,7 @@ function freezeGlobals() {
     Object.freeze(global.atob);
     Object.freeze(global.btoa);
     Object.freeze(global.__verify_extendedSignature);
+    Object.freeze(global.__verify_extendedSignatures);
     Object.freeze(global.__boss_asyncDump);
     Object.freeze(global.__boss_asyncLoad);
     Object.freeze(global.__boss_addPrototype);
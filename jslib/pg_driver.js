@@ -30,6 +30,44 @@ class PgDriverPool extends db.SqlDriverPool {
         });
     }
 
+    /**
+     * Add a read replica of the database, with its own poolSize connections. Pool checks health and replication lag
+     * of replicas every second, and passes them withReadConnection callbacks.
+     *
+     * @param connectionString of the replica.
+     * @param poolSize max number of connections to the replica.
+     * @throws {db.DatabaseError} if the replica could not be connected.
+     */
+    addReplica(connectionString, poolSize = 16) {
+        let res = this.pool._addReplica(poolSize, connectionString);
+        if (res !== "")
+            throw new db.DatabaseError(res);
+    }
+
+    /**
+     * As withConnection, for read only statements that can see data up to maxStalenessMillis old. Connection is taken
+     * from the least busy healthy replica that lags no more than maxStalenessMillis, or from the pool itself if there
+     * is none.
+     *
+     * @param maxStalenessMillis allowed replication lag, 0 always reads from the pool itself.
+     * @param callback as of withConnection.
+     */
+    withReadConnection(maxStalenessMillis, callback) {
+        this.pool._withReadConnection(maxStalenessMillis, async (con)=>{
+            await callback(new PgDriverConnection(con,this));
+        });
+    }
+
+    /**
+     * States of replicas, in order they were added.
+     *
+     * @return {Array<{isHealthy: boolean, lagMillis: number, total: number, inUse: number, reads: number,
+     * failedChecks: number}>} reads counts withReadConnection callbacks served by the replica.
+     */
+    replicaStats() {
+        return this.pool._replicaStats();
+    }
+
     totalConnections() {
         return this.pool._totalConnections();
     }
@@ -38,6 +76,82 @@ class PgDriverPool extends db.SqlDriverPool {
         return this.pool._availableConnections();
     }
 
+    /**
+     * Counters of server-side prepared statements, that connections create for queries executed more than once.
+     *
+     * @return {{hits: number, misses: number, prepared: number, evictions: number}} hits are statements executed
+     * by name of the prepared one, misses are statements sent with sql text.
+     */
+    preparedStatementsStats() {
+        return this.pool._preparedStatementsStats();
+    }
+
+    /**
+     * State of the pool connections and counters of waiting for them.
+     *
+     * @return {{total: number, inUse: number, waiting: number, acquisitions: number, waits: number,
+     * waitMicrosTotal: number, waitMicrosMax: number, spawned: number, closed: number, resets: number,
+     * primaryReads: number}}
+     * waiting is the number of withConnection callbacks waiting for a free connection now; waits counts ones that
+     * have waited. spawned and closed count connections opened under load and closed as idle ones, resets counts
+     * reconnect attempts of broken connections. primaryReads counts withReadConnection callbacks that no replica
+     * could serve.
+     */
+    poolStats() {
+        return this.pool._poolStats();
+    }
+
+    /**
+     * Execute statements in one transaction together with statements of other groupCommit calls, so that
+     * concurrent callers share one commit. Calls are collected for the group commit window, see setGroupCommit.
+     * If a statement fails, only its call is rejected, other calls of the batch are executed again without it.
+     *
+     * @param statements array of {sql, params}, where sql has '?' placeholders for params. Statements are sent
+     *        at once, so they should not depend on each other's results.
+     * @return {Promise<Array<number>>} affected rows of every statement, resolved after the commit.
+     */
+    groupCommit(statements) {
+        return new Promise((resolve, reject) => {
+            if (this.isClosed) {
+                reject(new db.DatabaseError("pool is closed"));
+                return;
+            }
+            this.pool._groupCommit(resolve, errText => reject(new db.DatabaseError(errText)),
+                statements.map(st => [st.sql, st.params != null ? st.params : []]));
+        });
+    }
+
+    /**
+     * Set how long groupCommit collects calls before it commits them, and max number of calls in one transaction.
+     *
+     * @param windowMillis collecting time, 0 commits calls right away unless a batch is executing.
+     * @param maxBatchSize max number of calls in one transaction, a batch of this size is committed at once.
+     */
+    setGroupCommit(windowMillis, maxBatchSize) {
+        this.pool._setGroupCommit(windowMillis, maxBatchSize);
+    }
+
+    /**
+     * Counters and histograms of groupCommit.
+     *
+     * @return {{committed: number, failed: number, batches: number, retries: number, batchSizes: Array<number>,
+     * latencyMicros: Array<number>}} retries counts calls executed once more as other call of their batch has failed.
+     * Histogram bucket i counts batches of [2^i, 2^(i+1)) calls, and calls committed in [2^i, 2^(i+1)) microseconds.
+     */
+    groupCommitStats() {
+        return this.pool._groupCommitStats();
+    }
+
+    /**
+     * Without pipelining groupCommit executes calls one by one on one connection, so it pays off only when this
+     * returns true.
+     *
+     * @return {boolean} true if statements of a groupCommit batch are sent in one pipeline.
+     */
+    hasPipelining() {
+        return this.pool._hasPipelining();
+    }
+
     close() {
         this.isClosed = true;
         this.pool._close();
@@ -117,6 +231,109 @@ class PgDriverConnection extends db.SqlDriverConnection {
         }, queryString, params);
     }
 
+    /**
+     * Execute several parameterized statements in one network round trip (libpq pipeline mode).
+     * Statements run in one implicit transaction, unless a transaction is open already: after the first failed
+     * statement the rest are not executed.
+     *
+     * @param statements array of {sql, params}, where sql has '?' placeholders for params.
+     * @param callback called with an array of results, one per statement: {PgDriverResultSet} for succeeded
+     *        statement and {db.DatabaseError} for failed one. If the connection is broken, all results are errors.
+     */
+    executeBatch(statements, callback) {
+        if (this.pool.isClosed)
+            return;
+        this.con._executeBatch(async (qrs) => {
+            let results = qrs.map(qr => typeof qr === "string" ? new db.DatabaseError(qr) : new PgDriverResultSet(qr));
+            try {
+                await callback(results);
+            } finally {
+                qrs.forEach(qr => {
+                    if (typeof qr !== "string")
+                        qr._release();
+                });
+            }
+        }, async (errText) => {
+            await callback(statements.map(() => new db.DatabaseError(errText)));
+        }, statements.map(st => [st.sql, st.params != null ? st.params : []]));
+    }
+
+    /**
+     * Execute query and receive its rows by batches as they come from the server, so big results are never
+     * held in memory at once.
+     *
+     * @param onRows callback that is called with array of up to batchSize rows, each row is an array of values.
+     *        Batches come in order, next batch is not read from the server until the previous one is processed.
+     *        Return false to stop the stream: the query is cancelled and onDone is called with number of rows
+     *        passed so far. If it throws, the stream is stopped as well and onError is called with the error.
+     * @param onDone callback that is called with total number of rows after the last batch.
+     * @param onError callback that is called with {db.DatabaseError} or the error thrown by onRows, batches passed
+     *        before it stay valid.
+     * @param batchSize max number of rows in one batch.
+     * @param queryString query with '?' placeholders for params.
+     * @param params values for placeholders.
+     */
+    streamQuery(onRows, onDone, onError, batchSize, queryString, ...params) {
+        if (this.pool.isClosed)
+            return;
+        let rowsError = null;
+        this.con._executeQueryStream(async (rows, batchId) => {
+            let isNeeded = false;
+            try {
+                isNeeded = (await onRows(rows)) !== false;
+            } catch (e) {
+                rowsError = e;
+            }
+            this.con._resumeStream(batchId, isNeeded);
+        }, async (rowsCount) => {
+            // called after the last batch is processed
+            if (rowsError != null)
+                await onError(rowsError);
+            else
+                await onDone(rowsCount);
+        }, async (errText) => {
+            await onError(new db.DatabaseError(errText));
+        }, batchSize, queryString, params);
+    }
+
+    /**
+     * Bulk insert with binary COPY, much faster than INSERT statements for many rows.
+     *
+     * @param onSuccess callback that is called with number of inserted rows.
+     * @param onError callback that is called with {db.DatabaseError}, nothing is inserted then.
+     * @param table table name.
+     * @param columns array of column names.
+     * @param rows array of rows, each is an array of values in the order of columns. Values are converted
+     *        to the column types, null and undefined are NULL.
+     */
+    copyIn(onSuccess, onError, table, columns, rows) {
+        if (this.pool.isClosed)
+            return;
+        this.con._copyIn(async (rowsCount) => {
+            await onSuccess(rowsCount);
+        }, async (errText) => {
+            await onError(new db.DatabaseError(errText));
+        }, table, columns, rows);
+    }
+
+    /**
+     * Bulk export with binary COPY.
+     *
+     * @param onSuccess callback that is called with array of rows, each is an array of values in the order of columns.
+     * @param onError callback that is called with {db.DatabaseError}.
+     * @param table table name.
+     * @param columns array of column names.
+     */
+    copyOut(onSuccess, onError, table, columns) {
+        if (this.pool.isClosed)
+            return;
+        this.con._copyOut(async (rows) => {
+            await onSuccess(rows);
+        }, async (errText) => {
+            await onError(new db.DatabaseError(errText));
+        }, table, columns);
+    }
+
     /**
      * Can execute multiple sql queries separated by semicolon.
      * Don't accepts query parameters.
@@ -197,6 +414,18 @@ class PgDriverResultSet extends db.SqlDriverResultSet {
         return res;
     }
 
+    /**
+     * All values of a numeric column at once, as a typed array: Int32Array for int2 and int4, BigInt64Array
+     * for int8, Float64Array for float4 and float8. Much faster than reading rows for big results.
+     * Does not depend on getRows() calls.
+     *
+     * @param colIndex 0-based index of the column.
+     * @throws {Error} if the column has another type or NULL values.
+     */
+    getColumn(colIndex) {
+        return this.qr._getColumn(colIndex);
+    }
+
     close() {
         throw new db.DatabaseError("PgDriverResultSet closes automatically. Don't call close() manually.");
     }
@@ -377,11 +377,27 @@ function convertToDate(data) {
         throw "can't convert " + JSON.stringify(data) + " to Date";
 }
 
+/**
+ * Random bytes from the secure generator of the native side, which keeps a buffered ChaCha20 stream per thread,
+ * so even small calls are cheap.
+ *
+ * @param {number} count of bytes
+ * @returns {Uint8Array}
+ */
 function randomBytes(count) {
-    var result  = new Uint8Array(count);
-    for(var i = 0;  i < count; ++i) {
-        result[i] = Math.floor(Math.random() * 256);
-    }
+    // native generator gives at most 1Mb at once
+    const maxChunk = 1024 * 1024;
+    if (typeof crypto === 'undefined' || crypto.__generateSecurePseudoRandomBytes === undefined) {
+        let result = new Uint8Array(count);
+        for (let i = 0; i < count; ++i)
+            result[i] = Math.floor(Math.random() * 256);
+        return result;
+    }
+    if (count > 0 && count <= maxChunk)
+        return crypto.__generateSecurePseudoRandomBytes(count);
+    let result = new Uint8Array(count);
+    for (let offset = 0; offset < count; offset += maxChunk)
+        result.set(crypto.__generateSecurePseudoRandomBytes(Math.min(maxChunk, count - offset)), offset);
     return result;
 }
 
@@ -115,8 +115,11 @@ class TransactionPack {
 
         let missingIds = new t.GenericSet();
         let allDeps = [];
-        for(let subitemBinary of data.subItems) {
-            let deps = await ContractDependencies(subitemBinary);
+        // "Array" items are [boss.loaded object, binary], see ContractDependencies
+        let subItemIds = await crypto.HashId.ofMany(data.subItems.map(
+            binary => binary.constructor.name === "Array" ? binary[1] : binary));
+        for(let i = 0; i < data.subItems.length; i++) {
+            let deps = await ContractDependencies(data.subItems[i], subItemIds[i]);
             allDeps.push(deps);
             missingIds.add(deps.id);
         }
@@ -281,19 +284,19 @@ class TransactionPack {
 }
 
 
-async function ContractDependencies(binary) {
+async function ContractDependencies(binary, id = null) {
     let res = {};
 
     let data;
     if (binary.constructor.name === "Array") {
         // binary[0] contains boss.loaded object, binary[1] contains binary
         // its for nestedLoadMap mode, do not used now
-        res.id = await crypto.HashId.of_async(binary[1]);
+        res.id = id != null ? id : await crypto.HashId.of_async(binary[1]);
         res.binary = binary;//[1];
         res.dependencies = new t.GenericSet();
         data = binary[0];
     } else {
-        res.id = await crypto.HashId.of_async(binary);
+        res.id = id != null ? id : await crypto.HashId.of_async(binary);
         res.binary = binary;
         res.dependencies = new t.GenericSet();
         data = await Boss.load(binary);
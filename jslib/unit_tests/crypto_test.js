@@ -106,6 +106,52 @@ unit.test("HashId", () => {
     assert(z.equals(x));
 });
 
+unit.test("HashId.ofMany", async () => {
+    let items = ["hello, world", t.randomBytes(10), t.randomBytes(200000)];
+    let ids = await crypto.HashId.ofMany(items);
+    assert(ids.length === items.length);
+    for (let i = 0; i < items.length; ++i) {
+        assert(ids[i] instanceof crypto.HashId);
+        assert(ids[i].equals(crypto.HashId.of(items[i])));
+    }
+    assert((await crypto.HashId.ofMany([])).length === 0);
+});
+
+unit.test("HashId.Builder", async () => {
+    let data = t.randomBytes(300000);
+    let builder = new crypto.HashId.Builder();
+    for (let from = 0, size = 1; from < data.length; from += size, size = size * 7 + 1)
+        builder.update(data.slice(from, from + size));
+    let x = builder.finish();
+    assert(x instanceof crypto.HashId);
+    assert(x.equals(crypto.HashId.of(data)));
+    await expect.throws(Error, () => builder.finish());
+
+    let y = new crypto.HashId.Builder().update("hello, ").update("world").finish();
+    assert(y.equals(crypto.HashId.of("hello, world")));
+
+    // views of a bigger buffer are hashed by their own bytes
+    builder = new crypto.HashId.Builder();
+    for (let from = 0; from < data.length; from += 1000)
+        builder.update(data.subarray(from, from + 1000));
+    assert(builder.finish().equals(crypto.HashId.of(data)));
+});
+
+unit.test("HashId.ofFile", async () => {
+    let path = io.getTmpDirPath() + "/u8_hashIdOfFile.bin";
+    let data = t.randomBytes(3000000);
+    await io.filePutContents(path, data);
+    for (let chunkSize of [4096, 65536, undefined]) {
+        let x = await crypto.HashId.ofFile(path, chunkSize);
+        assert(x instanceof crypto.HashId);
+        assert(x.equals(crypto.HashId.of(data)));
+    }
+    let ap = new io.AsyncProcessor();
+    IOFile.remove(path, code => ap.process(code, true));
+    await ap.promise;
+    await expect.throws(Error, () => crypto.HashId.ofFile(path));
+});
+
 unit.test("ExtendedSignature cpp", async () => {
     let privKey = tk.TestKeys.getKey();
     let pubKey = privKey.publicKey;
@@ -135,6 +181,54 @@ unit.test("ExtendedSignature cpp", async () => {
     }
 });
 
+unit.test("signature cache", async () => {
+    let privKey = tk.TestKeys.getKey();
+    let data = t.randomBytes(1000);
+    let sig = await ExtendedSignature.sign(privKey, data);
+    let es = await ExtendedSignature.cppVerify(privKey.publicKey, sig, data);
+    let before = crypto.signatureCacheStats();
+    assert(before.size > 0 && before.size <= before.capacity);
+    let esAgain = await ExtendedSignature.cppVerify(privKey.publicKey, sig, data);
+    assert(esAgain.equals(es));
+    assert(crypto.signatureCacheStats().hits >= before.hits + 2);
+    assert(await ExtendedSignature.cppVerify(privKey.publicKey, sig, t.randomBytes(1000)) === null);
+});
+
+unit.test("verifyBatch", async () => {
+    let privKey = tk.TestKeys.getKey();
+    let otherKey = tk.TestKeys.getKey();
+    let items = [];
+    let signatures = [];
+    let expected = [];
+    for (let i = 0; i < 20; ++i) {
+        let data = t.randomBytes(1000 + i);
+        let hashType = i % 2 === 0 ? crypto.SHA3_256 : crypto.SHA512;
+        let sig = await privKey.sign(data, hashType);
+        let valid = i % 3 !== 0;
+        items.push({key: valid ? privKey.publicKey : otherKey.publicKey, signature: sig, data: data, hashType: hashType});
+        expected.push(valid);
+        signatures.push(await ExtendedSignature.sign(privKey, data));
+    }
+    items.push({key: privKey.publicKey, signature: await privKey.sign("string data"), data: "string data"});
+    expected.push(true);
+
+    let results = await crypto.verifyBatch(items);
+    assert(equalArrays(results, expected));
+    assert((await crypto.verifyBatch([])).length === 0);
+    await expect.throws(Error, () => crypto.verifyBatch([{key: undefined, signature: items[0].signature, data: "x"}]));
+    await expect.throws(Error, () => crypto.verifyBatch([{key: privKey, signature: items[0].signature, data: "x"}]));
+
+    let data = t.randomBytes(10000);
+    let esSignatures = [await ExtendedSignature.sign(privKey, data), signatures[0], await ExtendedSignature.sign(otherKey, data)];
+    let esKeys = [privKey.publicKey, privKey.publicKey, otherKey.publicKey];
+    let esResults = await ExtendedSignature.verifyBatch(esKeys, esSignatures, data);
+    assert(esResults.length === 3);
+    assert(esResults[0].equals(await ExtendedSignature.cppVerify(privKey.publicKey, esSignatures[0], data)));
+    assert(esResults[1] === null);
+    assert(esResults[2] instanceof ExtendedSignature);
+    await expect.throws(Error, () => ExtendedSignature.verifyBatch([privKey], [esSignatures[0]], data));
+});
+
 unit.test("RSA 8192 keys", async () => {
     let pk8192 = new crypto.PrivateKey(atob("JgAcAQABxAAC+b9BLJKfUM+09ZNeu8Ie0pEglBBbIxK496MMq3F3M+sEGyYMR374rLj/cmX9VjxdTRetfJleXca2JQL4TZ4xj8b1ZL904PMIWwUx5uKmZ1BWmVxyvQBrpQGtIY1lql75pFk4ZAn4ciayMoKuudcjsFZ37miN+WlF9ihaKbECGudd+Aw+peExV/sOemMZ1TRUiPBZ4MJgtgTJH/NWbRptXdnPznT7TEOFyESSUYMM210RbWmR84QI9PQ5FDpICkj6D5yEQqBoQbEJXbrsKRohB04WpGVbiEBs1PAjc9I/J53+k4moUwsGrlZ7HHbs0nl0UnhXUw4CnKRoR/t2+wO82y2GJqzxsbwHO3kmVGESD14zLxvX7fXCG2cAlzOdWq66L2sIHmFFZGf6AJ4Bf+RAy3iEyPuUgSUvxaG6ZxeTfcJR4OttRB17OXfD/EKJgvvo53rc21O2xC1JaGt212c5cW0z6kzU/yOT8RrjOt11FWQbX6S0DIizQjv7gpBqQ5njIuO9aP53vyJKH+7DF0E5ykXJSVKkzEzhzoynzjQz0oz8S/Ze/cZYw1OTZCNxLmYelYbgbjNinLWkoT4go98eO2mxQSncvW5a+t8jAF+uK9tTCjJNqcpgGYw6/+JlrG5A5djdx8s5PIUPsAZ5xPPJWSy3XnlFkKc+PiNu6ER4LzfEAALaY/v9hiHOexy3OU4agoKn2ByTStfec9R0Zs7IPRqw7cVdPL2TlrWgGKKkZrX31xi6CXxz6e1SmKvsE3xEtnbw+nvcBjNOXBI6U1oGk4G9iNELIypclcmgD7pPyzhenNoRI71LRxihyuNhQt0IILhKwR65iRBmhqtNXU8lvraoxnfM3NZgrVoNOSCzTXC4eq9u7BzcQl8K00tmaDEeZLlJGIFRHFaYbp+PMAeMXr3zw+dwDBUiuOiHkh6edu1rWEVPHGTvkvssF8JohM+sSbNc8l043tgUIEK/sWGyJzCPl3yTnTAlVz6K8dAn70oxLaPzimGIoc0fVNEvo/InezG40OBzaxcFd2L7aCRYV+NnoEnZSWL7KcN/fObj6BF1n9JrQ/MJGyUWCUtIq7kKcCEA6iJq1mge5DX2O1SHELHvSKe3VdQPEDlCA4KgHl3C7cUrD2W1ujJtnLghcKqO9uA1U4gVsWrYtSq40Kb9k64oyMh5b9nmIAhD/DIitqrEkQIheAVBRWbgAikoMRQ7GST0FD2CYNMm9rF96pRunMW1sima3FXfrI4cNX2oppaKSQO7wtWa2CRYqul5hNijPveh9+cGZ1hDWogv5pYYrIV1LKekHo8vkSMyH9WysMb6MlUODrLK+1sbfF10Pns/+XACXLXKxMpkKtWKUPp+VSVlTQ=="));
     let pub8192 = new crypto.PublicKey(pk8192);
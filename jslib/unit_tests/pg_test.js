@@ -1019,6 +1019,386 @@ unit.test("pg_test: spawn connections dynamically", async () => {
     pool.close();
 });
 
+unit.test("pg_test: executeBatch", async () => {
+    await recreateTestTable();
+    let pool = createPool(4);
+
+    let statements = [];
+    for (let i = 0; i < 10; ++i)
+        statements.push({sql: "INSERT INTO table1(hash,state,locked_by_id,created_at,expires_at) VALUES (?,?,0,?,?) RETURNING id;",
+            params: [crypto.HashId.of(randomBytes(16)).digest, i, 5, 6]});
+    statements.push({sql: "SELECT count(*) FROM table1 WHERE state < ?;", params: [5]});
+
+    let results = await new Promise(resolve => pool.withConnection(con => {
+        con.executeBatch(statements, res => {
+            assert(res.length === statements.length);
+            for (let i = 0; i < 10; ++i)
+                assert(res[i].getRows(1)[0][0] === i + 1);
+            assert(res[10].getRows(1)[0][0] === 5n);
+            con.release();
+            resolve(res);
+        });
+    }));
+    assert(results.length === 11);
+
+    // failed statement aborts the rest of the batch
+    results = await new Promise(resolve => pool.withConnection(con => {
+        con.executeBatch([
+            {sql: "UPDATE table1 SET state=? WHERE id=?;", params: [100, 1]},
+            {sql: "SELECT no_such_column FROM table1;"},
+            {sql: "UPDATE table1 SET state=? WHERE id=?;", params: [100, 2]}
+        ], res => {
+            con.release();
+            resolve(res);
+        });
+    }));
+    assert(results.length === 3);
+    assert(results[0].getAffectedRows() === 1);
+    assert(results[1].message.indexOf("no_such_column") !== -1);
+    assert(results[2].message.indexOf("not executed") !== -1);
+
+    results = await new Promise(resolve => pool.withConnection(con => {
+        con.executeBatch([{sql: "SELECT count(*) FROM table1 WHERE state = ?;", params: [100]}], res => {
+            con.release();
+            resolve(res);
+        });
+    }));
+    // the first update is rolled back with the whole batch
+    assert(results[0].getRows(1)[0][0] === 0n);
+
+    pool.close();
+});
+
+unit.test("pg_test: repeated queries use prepared statements", async () => {
+    let pool = createPool(1);
+    let before = pool.preparedStatementsStats();
+    for (let i = 0; i < 10; ++i) {
+        let value = await new Promise((resolve, reject) => pool.withConnection(con => {
+            con.executeQuery(r => {
+                    con.release();
+                    resolve(r.getRows(1)[0][0]);
+                },
+                e => {
+                    con.release();
+                    reject(e);
+                }, "SELECT ?::integer;", i);
+        }));
+        assert(value === i);
+    }
+    let after = pool.preparedStatementsStats();
+    assert(after.prepared === before.prepared + 1);
+    assert(after.hits === before.hits + 9);
+    pool.close();
+});
+
+unit.test("pg_test: pool stats", async () => {
+    let pool = createPool(2);
+    let before = pool.poolStats();
+
+    // 10 concurrent queries on 2 connections wait for each other
+    let promises = [];
+    for (let i = 0; i < 10; ++i)
+        promises.push(new Promise((resolve, reject) => pool.withConnection(con => {
+            con.executeQuery(qr => {
+                con.release();
+                resolve();
+            }, e => {
+                con.release();
+                reject(e);
+            }, "SELECT 1 FROM pg_sleep(0.05)");
+        })));
+    await Promise.all(promises);
+
+    let after = pool.poolStats();
+    assert(after.total === 2);
+    assert(after.inUse === 0 && after.waiting === 0);
+    assert(Number(after.acquisitions - before.acquisitions) === 10);
+    assert(Number(after.waits - before.waits) >= 1);
+
+    pool.close();
+});
+
+unit.test("pg_test: groupCommit", async () => {
+    await recreateTestTable();
+    let pool = createPool(2);
+    pool.setGroupCommit(20, 100);
+    let before = pool.groupCommitStats();
+
+    let calls = [];
+    for (let i = 0; i < 20; ++i) {
+        let statements = [{sql: "INSERT INTO table2(text_val, double_val) VALUES (?, ?)", params: ["gc " + i, i]}];
+        if (i === 7)
+            statements.push({sql: "SELECT no_such_column FROM table2", params: []});
+        calls.push(pool.groupCommit(statements).then(affected => affected, e => e));
+    }
+    let results = await Promise.all(calls);
+    for (let i = 0; i < 20; ++i) {
+        if (i === 7)
+            assert(results[i] instanceof Error);
+        else
+            assert(results[i].length === 1 && results[i][0] === 1);
+    }
+
+    // the failed call is rolled back, others are committed
+    let count = await new Promise((resolve, reject) => pool.withConnection(con => {
+        con.executeQuery(qr => {
+            let res = Number(qr.getRows(1)[0][0]);
+            con.release();
+            resolve(res);
+        }, e => {
+            con.release();
+            reject(e);
+        }, "SELECT count(*) FROM table2 WHERE text_val LIKE 'gc %'");
+    }));
+    assert(count === 19);
+
+    let after = pool.groupCommitStats();
+    assert(Number(after.committed - before.committed) === 19);
+    assert(Number(after.failed - before.failed) === 1);
+    assert(Number(after.batches - before.batches) < 20);
+    assert(after.batchSizes.length === after.latencyMicros.length);
+
+    pool.close();
+});
+
+unit.test("pg_test: withReadConnection", async () => {
+    let pool = createPool(2);
+    let readOne = (maxStalenessMillis) => new Promise((resolve, reject) => pool.withReadConnection(maxStalenessMillis, con => {
+        con.executeQuery(qr => {
+            let res = Number(qr.getRows(1)[0][0]);
+            con.release();
+            resolve(res);
+        }, e => {
+            con.release();
+            reject(e);
+        }, "SELECT 1");
+    }));
+
+    // the same database is a replica with zero lag
+    pool.addReplica("host=localhost port=5432 dbname=unit_tests", 2);
+    for (let i = 0; i < 50 && !pool.replicaStats()[0].isHealthy; ++i)
+        await sleep(20);
+    let replicas = pool.replicaStats();
+    assert(replicas.length === 1);
+    assert(replicas[0].isHealthy && Number(replicas[0].lagMillis) === 0);
+
+    let promises = [];
+    for (let i = 0; i < 10; ++i)
+        promises.push(readOne(1000));
+    promises.push(readOne(0));
+    assert((await Promise.all(promises)).every(v => v === 1));
+
+    assert(Number(pool.replicaStats()[0].reads) === 10);
+    assert(Number(pool.poolStats().primaryReads) === 1);
+
+    let failed = false;
+    try {
+        pool.addReplica("host=localhost port=5432 dbname=unit_tests", 0);
+    } catch (e) {
+        failed = e instanceof Error;
+    }
+    assert(failed);
+
+    pool.close();
+});
+
+unit.test("pg_test: copyIn and copyOut", async () => {
+    await recreateTestTable();
+    let pool = createPool(2);
+
+    let rows = [];
+    // empty strings must come back as they are, not as NULL
+    for (let i = 0; i < 1000; ++i)
+        rows.push([i % 5 === 0 ? "" : `text ${i}`, i / 4, i % 3 === 0 ? null : i % 2 === 0]);
+    let count = await new Promise((resolve, reject) => pool.withConnection(con => {
+        con.copyIn(n => {
+            con.release();
+            resolve(n);
+        }, e => {
+            con.release();
+            reject(e);
+        }, "table2", ["text_val", "double_val", "boolean_val"], rows);
+    }));
+    assert(count === rows.length);
+
+    let copied = await new Promise((resolve, reject) => pool.withConnection(con => {
+        con.copyOut(res => {
+            con.release();
+            resolve(res);
+        }, e => {
+            con.release();
+            reject(e);
+        }, "table2", ["text_val", "double_val", "boolean_val"]);
+    }));
+    assert(copied.length === rows.length);
+    for (let i = 0; i < rows.length; ++i)
+        for (let j = 0; j < 3; ++j)
+            assert(copied[i][j] === rows[i][j]);
+
+    // wrong value fails the whole copy
+    let error = await new Promise(resolve => pool.withConnection(con => {
+        con.copyIn(n => {
+            con.release();
+            resolve(null);
+        }, e => {
+            con.release();
+            resolve(e);
+        }, "table2", ["text_val", "double_val"], [["a", "not a number"]]);
+    }));
+    assert(error.message.indexOf("not a number") !== -1);
+
+    pool.close();
+});
+
+unit.test("pg_test: streamQuery", async () => {
+    let pool = createPool(2);
+
+    let batches = 0;
+    let sum = 0;
+    let count = await new Promise((resolve, reject) => pool.withConnection(con => {
+        con.streamQuery(rows => {
+            assert(rows.length > 0 && rows.length <= 100);
+            for (let row of rows)
+                sum += row[0];
+            ++batches;
+        }, n => {
+            con.release();
+            resolve(n);
+        }, e => {
+            con.release();
+            reject(e);
+        }, 100, "SELECT generate_series(1, ?)", 1000);
+    }));
+    assert(count === 1000);
+    assert(batches === 10);
+    assert(sum === 1000 * 1001 / 2);
+
+    let error = await new Promise(resolve => pool.withConnection(con => {
+        con.streamQuery(rows => {}, n => {
+            con.release();
+            resolve(null);
+        }, e => {
+            con.release();
+            resolve(e);
+        }, 100, "SELECT * FROM missing_table");
+    }));
+    assert(error instanceof Error);
+
+    // onDone waits for the last batch to be processed
+    let processed = 0;
+    count = await new Promise((resolve, reject) => pool.withConnection(con => {
+        con.streamQuery(async (rows) => {
+            await sleep(10);
+            processed += rows.length;
+        }, n => {
+            con.release();
+            resolve(n === processed ? n : -1);
+        }, e => {
+            con.release();
+            reject(e);
+        }, 100, "SELECT generate_series(1, ?)", 250);
+    }));
+    assert(count === 250);
+
+    // error thrown by onRows stops the stream and goes to onError
+    error = await new Promise(resolve => pool.withConnection(con => {
+        con.streamQuery(async (rows) => {
+            throw new Error("onRows failed");
+        }, n => {
+            con.release();
+            resolve(null);
+        }, e => {
+            con.release();
+            resolve(e);
+        }, 100, "SELECT generate_series(1, ?)", 10000000);
+    }));
+    assert(error instanceof Error && error.message === "onRows failed");
+
+    // returning false stops the stream and cancels the query, connection stays usable
+    batches = 0;
+    count = await new Promise((resolve, reject) => pool.withConnection(con => {
+        con.streamQuery(async (rows) => {
+            await sleep(10);
+            return ++batches < 3;
+        }, n => {
+            con.release();
+            resolve(n);
+        }, e => {
+            con.release();
+            reject(e);
+        }, 100, "SELECT generate_series(1, ?)", 10000000);
+    }));
+    assert(batches === 3);
+    assert(count === 300);
+
+    let qr = await new Promise((resolve, reject) => pool.withConnection(con => {
+        con.executeQuery(qr => {
+            con.release();
+            resolve(qr);
+        }, e => {
+            con.release();
+            reject(e);
+        }, "SELECT 1");
+    }));
+    assert(qr.getRowsCount() === 1);
+
+    pool.close();
+});
+
+unit.test("pg_test: column types", async () => {
+    let pool = createPool(1);
+
+    let row = await new Promise((resolve, reject) => pool.withConnection(con => {
+        con.executeQuery(qr => {
+            con.release();
+            resolve(qr.getRows(0)[0]);
+        }, e => {
+            con.release();
+            reject(e);
+        }, "SELECT 7::int2, 1.5::float4, '-12.3400'::numeric, '2020-01-02 03:04:05.678'::timestamp, " +
+            "'2020-01-02'::date, ARRAY[[1,2],[3,NULL]]::int4[], ARRAY['a','b']::text[], '{}'::int8[], " +
+            "''::text, NULL::text, ''::bytea");
+    }));
+    assert(row[0] === 7);
+    assert(row[1] === 1.5);
+    assert(row[2] === "-12.3400");
+    assert(row[3] instanceof Date && row[3].getTime() === Date.UTC(2020, 0, 2, 3, 4, 5, 678));
+    assert(row[4] instanceof Date && row[4].getTime() === Date.UTC(2020, 0, 2));
+    assert(JSON.stringify(row[5]) === "[[1,2],[3,null]]");
+    assert(JSON.stringify(row[6]) === '["a","b"]');
+    assert(row[7].length === 0);
+    // empty values are not NULL
+    assert(row[8] === "");
+    assert(row[9] === null);
+    assert(row[10] instanceof Uint8Array && row[10].length === 0);
+
+    let error = null;
+    let [ints, longs, doubles] = await new Promise((resolve, reject) => pool.withConnection(con => {
+        con.executeQuery(qr => {
+            con.release();
+            try {
+                qr.getColumn(3);
+            } catch (e) {
+                error = e;
+            }
+            resolve([qr.getColumn(0), qr.getColumn(1), qr.getColumn(2)]);
+        }, e => {
+            con.release();
+            reject(e);
+        }, "SELECT i, i::int8 * 1000000000000, i / 4.0::float8, i::text FROM generate_series(1, 1000) AS i");
+    }));
+    assert(ints instanceof Int32Array && ints.length === 1000);
+    assert(longs instanceof BigInt64Array && doubles instanceof Float64Array);
+    for (let i = 0; i < 1000; ++i) {
+        assert(ints[i] === i + 1);
+        assert(longs[i] === BigInt(i + 1) * 1000000000000n);
+        assert(doubles[i] === (i + 1) / 4);
+    }
+    assert(error != null);
+
+    pool.close();
+});
+
 /*unit.test("pg_test: check pg connections restore, needs to run it manually", async () => {
     // For success testing, restart pg daemon manually several times during this test running.
     // If all requests completed, the test should finish.
@@ -36,16 +36,27 @@ class LedgerException extends Error {
  */
 class Ledger {
 
-    constructor(connectionString) {
+    /**
+     * @param {string} connectionString - Connection string of the ledger database.
+     * @param {Array<string>} replicaConnectionStrings - Connection strings of its read replicas. Optional.
+     */
+    constructor(connectionString, replicaConnectionStrings = []) {
         this.MAX_CONNECTIONS = 64;
-
-        this.cachedRecords = new t.GenericMap();
-        this.cachedRecordsById = new t.GenericMap();
+        this.MAX_REPLICA_CONNECTIONS = 32;
+        // lag of replicas that is allowed for reads of API endpoints, see withReadConnection
+        this.READ_STALENESS_MILLIS = 1000;
+        this.CACHE_SIZE = 100000;
+        this.CACHE_TTL_MILLIS = 300000;
+
+        // native cache of packed records, shared by ledgers of the same database in all isolates
+        this.cache = new LedgerCache(connectionString, this.CACHE_SIZE, this.CACHE_TTL_MILLIS);
         this.useCache = true;
 
         this.bufParams = {
             findOrCreate_insert: {enabled: true, bufSize: 200, delayMillis: 40, buf: new Map(), bufInProc: new Map(), ts: new Date().getTime()},
             findOrCreate_select: {enabled: true, bufSize: 400, delayMillis: 40, buf: new Map(), ts: new Date().getTime()},
+            // save and destroy out of transactions share commits
+            groupCommit: {enabled: true, windowMillis: 2, maxBatchSize: 256}
         };
 
         this.mapSave = new t.GenericMap();
@@ -59,6 +70,16 @@ class Ledger {
         //db.connect is synchronous inside
         db.connect(connectionString, (pool) => {
             this.dbPool_ = pool;
+            // without pipelining group commit runs all calls one by one, slower than separate connections
+            if (!this.dbPool_.hasPipelining())
+                this.bufParams.groupCommit.enabled = false;
+            this.dbPool_.setGroupCommit(this.bufParams.groupCommit.windowMillis, this.bufParams.groupCommit.maxBatchSize);
+            try {
+                for (let replica of replicaConnectionStrings)
+                    this.dbPool_.addReplica(replica, this.MAX_REPLICA_CONNECTIONS);
+            } catch (e) {
+                throw new LedgerException("addReplica: " + e);
+            }
         }, (e) => {
             throw new LedgerException("connect.onError: " + e);
         }, this.MAX_CONNECTIONS);
@@ -71,31 +92,52 @@ class Ledger {
     // Cache methods
     getFromCache(itemId) {
         if (this.useCache) {
-            let record = this.cachedRecords.get(itemId);
-            if (record == null)
+            let row = this.cache._get(itemId.digest);
+            if (row == null)
                 return null;
             else
-                return record;
+                return StateRecord.initFrom(this, row);
         } else
             return null;
     }
 
     getFromCacheById(recordId) {
         if (this.useCache) {
-            let record = this.cachedRecordsById.get(recordId);
-            if (record == null)
+            let row = this.cache._getById(recordId);
+            if (row == null)
                 return null;
             else
-                return record;
+                return StateRecord.initFrom(this, row);
         } else
             return null;
     }
 
     putToCache(record) {
-        if (this.useCache) {
-            this.cachedRecords.set(record.id, record);
-            this.cachedRecordsById.set(record.recordId, record);
-        }
+        // packed records always have expiration time
+        if (this.useCache && record.expiresAt != null)
+            this.cache._put(record.id.digest, record.recordId, record.state.ordinal, record.lockedByRecordId,
+                Math.floor(record.createdAt.getTime() / 1000), Math.floor(record.expiresAt.getTime() / 1000));
+    }
+
+    removeFromCache(record) {
+        this.cache._remove(record.id.digest);
+    }
+
+    /**
+     * Drop all cached records. The cache is shared with other ledgers of the same database, so they lose their
+     * records too.
+     */
+    clearCache() {
+        this.cache._clear();
+    }
+
+    /**
+     * Cache statistics: size, hits, misses, evictions and expirations.
+     *
+     * @return {Object} statistics.
+     */
+    cacheStats() {
+        return this.cache._stats();
     }
 
 
@@ -132,6 +174,23 @@ class Ledger {
         });
     }
 
+    /**
+     * Pass a connection for read only queries to the block and release it when the promise the block returns is
+     * settled. The connection is taken from a replica that lags no more than maxStalenessMillis, or from the ledger
+     * database, see SqlDriverPool.withReadConnection.
+     *
+     * @param {function(db.SqlDriverConnection): Promise} block - Block to execute.
+     * @param {number} maxStalenessMillis - Allowed replication lag.
+     * @return {Promise} what the block returns.
+     */
+    withReadConnection(block, maxStalenessMillis = this.READ_STALENESS_MILLIS) {
+        return new Promise((resolve, reject) => {
+            this.dbPool_.withReadConnection(maxStalenessMillis, con => {
+                block(con).then(resolve, reject).finally(() => con.release());
+            });
+        });
+    }
+
     simpleQuery(sql, processValue, connection = undefined, ...params) {
         return new Promise((resolve, reject) => {
             let query = con => {
@@ -169,9 +228,11 @@ class Ledger {
      * Get the record by its ID.
      *
      * @param {HashId} itemId - ItemId to retrieve.
+     * @param {number} maxStalenessMillis - Allowed replication lag if the record could be read from a replica. By
+     *        default it is read from the ledger database, as approvals need the actual state.
      * @return {Promise<StateRecord|null>} record or null if not found.
      */
-    getRecord(itemId) {
+    getRecord(itemId, maxStalenessMillis = 0) {
         return new Promise(async(resolve, reject) => {
             let cached = this.getFromCache(itemId);
             if (cached != null) {
@@ -182,7 +243,7 @@ class Ledger {
                     resolve(cached);
 
             } else
-                this.dbPool_.withConnection(con => {
+                this.dbPool_.withReadConnection(maxStalenessMillis, con => {
                     con.executeQuery(async(qr) => {
                             let row = qr.getRows(1)[0];
                             con.release();
@@ -194,7 +255,9 @@ class Ledger {
                                     await record.destroy();
                                     resolve(null);
                                 } else {
-                                    this.putToCache(record);
+                                    // cache is read by approvals, so stale records are not put there
+                                    if (maxStalenessMillis <= 0)
+                                        this.putToCache(record);
                                     resolve(record);
                                 }
                             } else
@@ -247,6 +310,11 @@ class Ledger {
      * @return {Promise<StateRecord>} found or created {@link StateRecord}.
      */
     findOrCreate(itemId, newState = ItemState.PENDING, locked_by_id = 0) {
+        // cached record exists, so there is nothing to insert
+        let cached = this.getFromCache(itemId);
+        if (cached != null && !cached.isExpired())
+            return Promise.resolve(cached);
+
         return this.findOrCreate_buffered_insert(itemId, newState, locked_by_id).then((inserted_id) => {
             return this.findOrCreate_buffered_select(itemId, inserted_id);
         }).catch(reason => {
@@ -542,6 +610,7 @@ class Ledger {
                             if (record.recordId === inserted_id)
                                 record.isJustCreated = true;
                             con.release();
+                            this.putToCache(record);
                             resolve(record);
                         }, e => {
                             con.release();
@@ -589,6 +658,8 @@ class Ledger {
                             let resolversArr = bufItem[1];
                             for (let k = 0; k < resolversArr.length; ++k) {
                                 let sr = StateRecord.initFrom(this, rows[j]);
+                                if (k === 0)
+                                    this.putToCache(sr);
                                 if (sr.recordId === bufItem[3])
                                     sr.isJustCreated = true;
                                 resolversArr[k](sr); // call resolver
@@ -622,7 +693,12 @@ class Ledger {
      * @return true if it is.
      */
     async isApproved(itemId) {
-        let r = await this.getRecord(id);
+        // cached row is enough, without making a record: [id, hash, state, locked_by_id, created_at, expires_at]
+        let row = this.useCache ? this.cache._get(itemId.digest) : null;
+        if (row != null && row[5] * 1000 >= new Date().getTime())
+            return ItemState.byOrdinal.get(row[2]).isApproved;
+
+        let r = await this.getRecord(itemId);
         return r != null && r.state.isApproved;
     }
 
@@ -651,8 +727,13 @@ class Ledger {
         if (record.recordId === 0)
             throw new ex.IllegalStateError("can't destroy record without recordId");
 
-        this.cachedRecords.delete(record.id);
-        this.cachedRecordsById.delete(record.recordId);
+        this.removeFromCache(record);
+
+        if (connection == null && this.bufParams.groupCommit.enabled)
+            return this.dbPool_.groupCommit([
+                {sql: "DELETE FROM items WHERE id = ?;", params: [record.recordId]},
+                {sql: "DELETE FROM ledger WHERE id = ?;", params: [record.recordId]}
+            ]).then(() => {});
 
         return this.simpleUpdate("DELETE FROM items WHERE id = ?;", connection, record.recordId)
             .then(() => {
@@ -726,13 +807,21 @@ class Ledger {
             return record;
         }
 
-        return this.simpleUpdate("update ledger set state=?, created_at=?, expires_at=?, locked_by_id=? where id=?",
-            connection,
+        let params = [
             record.state.ordinal,
             Math.floor(record.createdAt.getTime() / 1000),
             Math.floor(record.expiresAt.getTime() / 1000),
             record.lockedByRecordId,
-            record.recordId);
+            record.recordId
+        ];
+
+        if (connection == null && this.bufParams.groupCommit.enabled)
+            return this.dbPool_.groupCommit([
+                {sql: "update ledger set state=?, created_at=?, expires_at=?, locked_by_id=? where id=?", params: params}
+            ]).then(() => {});
+
+        return this.simpleUpdate("update ledger set state=?, created_at=?, expires_at=?, locked_by_id=? where id=?",
+            connection, ...params);
     }
 
     /**
@@ -953,7 +1042,7 @@ class Ledger {
      */
     getPayments(fromDate) {
         return new Promise((resolve, reject) => {
-            this.dbPool_.withConnection(con => {
+            this.dbPool_.withReadConnection(this.READ_STALENESS_MILLIS, con => {
                 con.executeQuery(qr => {
                         let payments = new Map();
                         let count = qr.getRowsCount();
@@ -1422,28 +1511,27 @@ class Ledger {
     findUnfinished() {
         return new Promise(async(resolve, reject) => {
             this.dbPool_.withConnection(con => {
-                con.executeQuery(async(qr) => {
-                        let map = new t.GenericMap();
-                        let count = qr.getRowsCount();
-                        while (count > 0) {
-                            let rows;
-                            if (count > 1024) {
-                                rows = qr.getRows(1024);
-                                count -= 1024;
-                            } else {
-                                rows = qr.getRows(count);
-                                count = 0;
+                let map = new t.GenericMap();
+                let expired = [];
+                // rows come by batches, not loaded into memory all at once
+                con.streamQuery(rows => {
+                        for (let i = 0; i < rows.length; i++)
+                            if (rows[i] != null) {
+                                let record = StateRecord.initFrom(this, rows[i]);
+
+                                if (record.isExpired())
+                                    expired.push(record);
+                                else
+                                    map.set(record.id, record);
                             }
-
-                            for (let i = 0; i < rows.length; i++)
-                                if (rows[i] != null) {
-                                    let record = StateRecord.initFrom(this, rows[i]);
-
-                                    if (record.isExpired())
-                                        await record.destroy();
-                                    else
-                                        map.set(record.id, record);
-                                }
+                    }, async() => {
+                        try {
+                            for (let record of expired)
+                                await record.destroy();
+                        } catch (e) {
+                            con.release();
+                            reject(e);
+                            return;
                         }
 
                         con.release();
@@ -1452,6 +1540,7 @@ class Ledger {
                         con.release();
                         reject(e);
                     },
+                    1024,
                     "select * from sr_find_unfinished()"
                 );
             });
@@ -1496,9 +1585,11 @@ class Ledger {
      * @return {Promise<Uint8Array>} packed Contract
      */
     getKeptItem(itemId) {
-        return this.simpleQuery("select * from kept_items, ledger where ledger.hash = ? and ledger.id = kept_items.ledger_id limit 1",
+        return this.withReadConnection(con => this.simpleQuery(
+            "select * from kept_items, ledger where ledger.hash = ? and ledger.id = kept_items.ledger_id limit 1",
             null,
-            itemId.digest);
+            con,
+            itemId.digest));
     }
 
     getKeptBy(field, id, tags, limit, offset, sortBy, sortOrder) {
@@ -2228,10 +2319,10 @@ class Ledger {
      * @return {Promise<Uint8Array>} packed transaction with contract.
      */
     getContractInStorage(contractId) {
-        return this.simpleQuery("SELECT bin_data FROM contract_binary WHERE hash_id=?",
+        return this.withReadConnection(con => this.simpleQuery("SELECT bin_data FROM contract_binary WHERE hash_id=?",
             null,
-            null,
-            contractId.digest);
+            con,
+            contractId.digest));
     }
 
     /**
@@ -2243,7 +2334,7 @@ class Ledger {
      */
     getContractsInStorageByOrigin(slotId, originId) {
         return new Promise(async(resolve, reject) => {
-            this.dbPool_.withConnection(con => {
+            this.dbPool_.withReadConnection(this.READ_STALENESS_MILLIS, con => {
                 con.executeQuery(async(qr) => {
                         let res = [];
                         let count = qr.getRowsCount();
@@ -2582,9 +2673,9 @@ class Ledger {
      * @return {Promise<NNameRecord>} UNS name record.
      */
     getNameByAddress(address) {
-        return this.getNameBy(
+        return this.withReadConnection(con => this.getNameBy(
             "WHERE name_storage.id=(SELECT name_storage_id FROM name_entry WHERE short_addr=? OR long_addr=? LIMIT 1)",
-            address, address);
+            con, address, address));
     }
 
     /**
@@ -2595,7 +2686,8 @@ class Ledger {
      * @return {Promise<NNameRecord>} UNS name record.
      */
     getNameByOrigin(origin) {
-        return this.getNameBy("WHERE name_storage.id=(SELECT name_storage_id FROM name_entry WHERE origin=?)", origin);
+        return this.withReadConnection(con => this.getNameBy(
+            "WHERE name_storage.id=(SELECT name_storage_id FROM name_entry WHERE origin=?)", con, origin));
     }
 
     /**
@@ -153,7 +153,7 @@ class Main {
             }
         }
 
-        this.ledger = new Ledger(t.getOrThrow(settings, "database"));
+        this.ledger = new Ledger(t.getOrThrow(settings, "database"), t.getOrDefault(settings, "database_replicas", []));
         await this.ledger.init();
         this.logger.log("ledger constructed");
 
@@ -293,6 +293,73 @@ unit.test("ledger_test: cache test", async () => {
     await ledger.close();
 });
 
+unit.test("ledger_test: native cache", async () => {
+    let ledger = await createTestLedger();
+
+    let hash = HashId.of(randomBytes(64));
+    let record = await ledger.findOrCreate(hash);
+    assert(!await ledger.isApproved(hash));
+
+    await record.approve();
+    assert(await ledger.isApproved(hash));
+
+    // answered from the cache, without insert
+    let stats = ledger.cacheStats();
+    let found = await ledger.findOrCreate(hash);
+    assertSameRecords(record, found);
+    assert(!found.isJustCreated);
+    assert(found !== record);
+    assert(ledger.cacheStats().hits === stats.hits + 1);
+
+    // cache of the same database is shared
+    let cache = new LedgerCache("host=localhost port=5432 dbname=unit_tests", ledger.CACHE_SIZE, ledger.CACHE_TTL_MILLIS);
+    let row = cache._getById(record.recordId);
+    assert(row != null);
+    assert(row[0] === record.recordId);
+    assert(HashId.withDigest(row[1]).equals(hash));
+    assert(row[2] === ItemState.APPROVED.ordinal);
+
+    await record.destroy();
+    assert(cache._get(hash.digest) == null);
+    assert(!await ledger.isApproved(hash));
+
+    // other ledger of the database keeps the cache
+    record = await ledger.findOrCreate(HashId.of(randomBytes(64)));
+    await ledger.getRecord(record.id);
+    let other = await createTestLedger();
+    assert(other.getFromCache(record.id) != null);
+    other.clearCache();
+    assert(ledger.getFromCache(record.id) == null);
+    await other.close();
+
+    await ledger.close();
+});
+
+unit.test("ledger_test: reads from replica", async () => {
+    // the same database is a replica with zero lag
+    let ledger = new Ledger("host=localhost port=5432 dbname=unit_tests", ["host=localhost port=5432 dbname=unit_tests"]);
+    await ledger.init();
+    for (let i = 0; i < 50 && !ledger.dbPool_.replicaStats()[0].isHealthy; ++i)
+        await sleep(20);
+
+    let record = await ledger.findOrCreate(HashId.of(randomBytes(64)));
+    await record.approve();
+    ledger.removeFromCache(record);
+
+    // stale read doesn't get to the cache
+    let found = await ledger.getRecord(record.id, ledger.READ_STALENESS_MILLIS);
+    assertSameRecords(record, found);
+    assert(ledger.getFromCache(record.id) == null);
+    assert(Number(ledger.dbPool_.replicaStats()[0].reads) === 1);
+
+    found = await ledger.getRecord(record.id);
+    assertSameRecords(record, found);
+    assert(ledger.getFromCache(record.id) != null);
+    assert(Number(ledger.dbPool_.replicaStats()[0].reads) === 1);
+
+    await ledger.close();
+});
+
 unit.test("ledger_test: checkLockOwner", async () => {
     let ledger = await createTestLedger();
 
@@ -10,6 +10,7 @@
 #include "../crypto/base64.h"
 #include "../crypto/PrivateKey.h"
 #include "../crypto/PublicKey.h"
+#include "../crypto/cryptoCommon.h"
 #include "../types/UBinder.h"
 #include "../serialization/BossSerializer.h"
 #include "../crypto/base64.h"
@@ -19,6 +20,7 @@
 using namespace crypto;
 
 const char *U8_PUBLIC_KEY = "HggcAQABxAABuc8tZdvfwUY550JXjg6GkVszQsy5lrao6LX5BpmVCPRq8xBlhqNnZmPz+sv+bFlGHPhydqV1xkSzBxGi+JqPYE+q0NQ9MJ3YVOzd/MRVW+dn7oZ8uUcWp81j/Wmn4mGVHP9bFhaqiu1JpnkJS6We5923IMrGrhxHDdstFFbs0KVHfgX1ekKKZSkXqNOHFb1VcvIyHrWyL4ZBqVlhqoQB7uMz68MlVznCzdF1HVWtwfuTLzVKXLlMNXGRYLaMqsBKH2U9esN6wXbvSfiMRRKKyiHMfYO4Ohg8ZAnnOfUwCqR48LbxY/W6w0aJ+uy4ohA9jKbT+JEp+vv3bM3KV8jt1w==";
+static const size_t MODULE_READ_CHUNK_SIZE = 64 * 1024;
 extern const char *U8COREMODULE_NAME;
 extern const char *U8COREMODULE_FULLNAME;
 
@@ -215,26 +217,32 @@ bool U8Module::checkModuleSignature(Scripter* se, const std::string &signer) {
             fseek(f, 0, SEEK_SET);
 
             auto dataLen = moduleLen - lenSignData - sizeof(unsigned short);
-            void *data = malloc(dataLen);
-            auto readed = fread(data, 1, dataLen, f);
-            if (readed != dataLen) {
-                printf("Failed reading module data\n");
 
-                fclose(f);
-                free(data);
-                return false;
+            // hash module data in chunks, without reading the whole module to memory
+            Digest dataDigest(HashType::SHA3_512);
+            byte_vector chunk(MODULE_READ_CHUNK_SIZE);
+            for (size_t left = dataLen; left > 0;) {
+                auto readed = fread(chunk.data(), 1, std::min(left, chunk.size()), f);
+                if (readed == 0) {
+                    printf("Failed reading module data\n");
+
+                    fclose(f);
+                    return false;
+                }
+                dataDigest.update(chunk.data(), readed);
+                left -= readed;
             }
+            dataDigest.doFinal();
 
             fseek(f, dataLen + sizeof(unsigned short), SEEK_SET);
 
             // read signature
             void *signData = malloc((unsigned short) lenSignData);
-            readed = fread(signData, 1, (unsigned short) lenSignData, f);
+            auto readed = fread(signData, 1, (unsigned short) lenSignData, f);
             if (readed != lenSignData) {
                 printf("Failed reading signature\n");
 
                 fclose(f);
-                free(data);
                 free(signData);
                 return false;
             }
@@ -249,7 +257,7 @@ bool U8Module::checkModuleSignature(Scripter* se, const std::string &signer) {
             auto publicKey = new PublicKey(key.data(), key.size());
 
             // verify signature
-            bool res = publicKey->verify(sign.data(), sign.size(), data, dataLen, HashType::SHA3_512);
+            bool res = publicKey->verifyDigest(sign.data(), sign.size(), dataDigest.getDigest(), HashType::SHA3_512);
 
             // check public key
             if (!signer.empty()) {
@@ -266,7 +274,6 @@ bool U8Module::checkModuleSignature(Scripter* se, const std::string &signer) {
 
             fclose(f);
 
-            free(data);
             free(signData);
 
             if (!initRequireRoots()) {
@@ -8,6 +8,7 @@
 #include "../tools/Semaphore.h"
 #include "../tools/AutoThreadPool.h"
 #include "../crypto/base64.h"
+#include "../crypto/ChaChaRandom.h"
 
 namespace network {
 
@@ -18,7 +19,7 @@ std::shared_ptr<HttpClientWorkerAsync> HttpClient::worker_;
 const std::string idChars = "0123456789_abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
 string randomString(int length) {
     byte_vector randomBytes(length);
-    sprng_read(&randomBytes[0], length, NULL);
+    crypto::randomBytes(&randomBytes[0], length);
     std::string res;
     for (int i = 0; i < length; ++i)
         res += idChars[randomBytes[i]%idChars.size()];
@@ -303,7 +304,7 @@ void HttpClient::start(const crypto::PrivateKey& clientKey, const crypto::Public
         if (!(*error).empty())
             throw std::runtime_error("HttpClient error while starting secure connection(b) ("+rootUrl_+"): " + *error);
         byte_vector client_nonce(47);
-        sprng_read(&client_nonce[0], client_nonce.size(), NULL);
+        crypto::randomBytes(&client_nonce[0], client_nonce.size());
         byte_vector client_nonce_copy = client_nonce;
         byte_vector data = BossSerializer::serialize(UBinder::of(
                 "client_nonce", UBytes(std::move(client_nonce_copy)),
@@ -8,6 +8,7 @@
 #include "../types/UObject.h"
 #include "../serialization/BossSerializer.h"
 #include "../crypto/base64.h"
+#include "../crypto/ChaChaRandom.h"
 #include "../crypto/PublicKey.h"
 
 namespace network {
@@ -245,7 +246,7 @@ void HttpServer::initSecureProtocol(const crypto::PrivateKey& nodePrivateKey) {
             std::lock_guard lock(session->connectMutex);
             if (session->serverNonce.size() == 0) {
                 session->serverNonce.resize(48);
-                sprng_read(&session->serverNonce[0], session->serverNonce.size(), NULL);
+                crypto::randomBytes(&session->serverNonce[0], session->serverNonce.size());
             }
             byte_vector serverNonceCopy = session->serverNonce;
             UBinder ans = UBinder::of(
@@ -10,6 +10,7 @@
 #include "../AsyncIO/AsyncIO.h"
 #include "../crypto/base64.h"
 #include "../crypto/SymmetricKey.h"
+#include "../crypto/ChaChaRandom.h"
 #include "../types/UArray.h"
 #include "../serialization/BossSerializer.h"
 
@@ -152,7 +153,7 @@ namespace network {
         if (sessionReader.protectFromDuples(packet.getPacketId())) {
             if (sessionReader.nextLocalNonceGenerationTime < getCurrentTimeMillis()) {
                 sessionReader.localNonce.resize(64);
-                sprng_read(&sessionReader.localNonce[0], 64, NULL);
+                crypto::randomBytes(&sessionReader.localNonce[0], 64);
                 sessionReader.nextLocalNonceGenerationTime = getCurrentTimeMillis() + HANDSHAKE_TIMEOUT_MILLIS;
             }
             sessionReader.handshake_keyReqPart1.resize(0);
@@ -393,7 +394,7 @@ namespace network {
     byte_vector UDPAdapter::preparePayloadForSession(const crypto::SymmetricKey& sessionKey, const byte_vector& payload) {
         byte_vector payloadWithRandomChunk(payload.size() + 2);
         memcpy(&payloadWithRandomChunk[0], &payload[0], payload.size());
-        sprng_read(&payloadWithRandomChunk[payload.size()], 2, NULL);
+        crypto::randomBytes(&payloadWithRandomChunk[payload.size()], 2);
         auto encryptedPayload = sessionKey.etaEncrypt(payloadWithRandomChunk);
         encryptedPayload.resize(encryptedPayload.size() + 4);
         crc32_state ctx;
@@ -523,7 +524,7 @@ namespace network {
     void UDPAdapter::sendHello(Session& session) {
         writeLog("send hello to ", session.remoteNodeInfo.getNumber());
         byte_vector helloNonce(64);
-        sprng_read(&helloNonce[0], 64, NULL);
+        crypto::randomBytes(&helloNonce[0], 64);
         auto encryptedPayload = session.remoteNodeInfo.getPublicKey().encrypt(helloNonce);
         Packet helloPacket(getNextPacketId(), ownNodeInfo_.getNumber(), session.remoteNodeInfo.getNumber(), PacketTypes::HELLO, encryptedPayload);
         sendPacket(session.remoteNodeInfo, helloPacket.makeByteArray());
@@ -550,7 +551,7 @@ namespace network {
     void UDPAdapter::sendKeyReq(Session& session) {
         writeLog("send key_req to ", session.remoteNodeInfo.getNumber());
         session.localNonce.resize(64);
-        sprng_read(&session.localNonce[0], 64, NULL);
+        crypto::randomBytes(&session.localNonce[0], 64);
 
         byte_vector packed = bossDumpArray(UArray({
             UBytesFromByteVector(session.localNonce),
@@ -596,7 +597,7 @@ namespace network {
     void UDPAdapter::sendSessionAck(Session& session) {
         writeLog("send session_ack to ", session.remoteNodeInfo.getNumber());
         byte_vector someRandomPayload(32);
-        sprng_read(&someRandomPayload[0], 32, NULL);
+        crypto::randomBytes(&someRandomPayload[0], 32);
         Packet packet(getNextPacketId(), ownNodeInfo_.getNumber(), session.remoteNodeInfo.getNumber(), PacketTypes::SESSION_ACK, session.sessionKey.etaEncrypt(someRandomPayload));
         sendPacket(session.remoteNodeInfo, packet.makeByteArray());
     }
@@ -616,7 +617,7 @@ namespace network {
             const NodeInfo &dest = netConfig_.getInfo(nodeId);
             writeLog("send nack to ", nodeId);
             byte_vector randomSeed(64);
-            sprng_read(&randomSeed[0], 64, NULL);
+            crypto::randomBytes(&randomSeed[0], 64);
             byte_vector data = bossDumpArray(UArray({UInt(packetId), UBytesFromByteVector(randomSeed)}));
             byte_vector sign = ownPrivateKey_.sign(data, crypto::HashType::SHA512);
             byte_vector payload = bossDumpArray(UArray({UBytesFromByteVector(data), UBytesFromByteVector(sign)}));
@@ -4,6 +4,7 @@
 
 #include "UDPAdapterPrivate.h"
 #include "UDPAdapter.h"
+#include "../crypto/ChaChaRandom.h"
 #include "../serialization/BossSerializer.h"
 #include "../types/UArray.h"
 
@@ -141,7 +142,7 @@ namespace network {
 
     Session::Session(const NodeInfo& newRemoteNodeInfo): Retransmitter(newRemoteNodeInfo) {
         localNonce.resize(64);
-        sprng_read(&localNonce[0], 64, NULL);
+        crypto::randomBytes(&localNonce[0], 64);
         state = SessionState::STATE_HANDSHAKE;
         handshakeStep = HandshakeState::HANDSHAKE_STEP_INIT;
         handshakeExpiresAt = getCurrentTimeMillis() - UDPAdapter::HANDSHAKE_TIMEOUT_MILLIS;
@@ -17,40 +17,88 @@
 #include "../types/complex/UPublicKey.h"
 #include "../types/complex/UPrivateKey.h"
 #include "../types/complex/USerializationError.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <shared_mutex>
+#include <unordered_map>
+
+// Complex types by type tag and by "__type"
+struct BaseSerializer::Registry {
+    // entries are never freed, so serialization can use them without the lock while types are re-registered
+    std::deque<std::pair<UType, ComplexType>> entries;
+    std::array<std::atomic<const ComplexType*>, 256> byTag {};
+    std::unordered_map<std::string, const ComplexType*> byName;
+    std::shared_mutex mutex;
+
+    template <typename T> void add(const std::string& typeName) {
+        add(T().type(), ComplexType {typeName, &decomposeObject<T>, &composeObject<T>});
+    }
 
-// Serialization object templates
-template <typename T> UObject BaseSerializer::serializeObject(T o, std::string typeName) {
-    UBinder result = o.decompose();
-    result.set("__type", typeName);
+    void add(UType tag, const ComplexType& complexType) {
+        std::unique_lock lock(mutex);
+        const ComplexType* entry = &entries.emplace_back(tag, complexType).second;
+        byName[complexType.name] = entry;
+        byTag[(uint8_t) tag] = entry;
+    }
 
-    return result;
+    void remove(const std::string& typeName) {
+        std::unique_lock lock(mutex);
+        auto it = byName.find(typeName);
+        if (it == byName.end())
+            return;
+        const ComplexType* removed = it->second;
+        byName.erase(it);
+        // the tag goes back to the latest name still registered for it
+        for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry) {
+            if (&entry->second != removed)
+                continue;
+            auto& slot = byTag[(uint8_t) entry->first];
+            if (slot != removed)
+                break;
+            const ComplexType* previous = nullptr;
+            for (auto other = entries.rbegin(); other != entries.rend() && previous == nullptr; ++other) {
+                auto named = byName.find(other->second.name);
+                if (other->first == entry->first && named != byName.end() && named->second == &other->second)
+                    previous = &other->second;
+            }
+            slot = previous;
+            break;
+        }
+    }
 
-    //throw std::invalid_argument(std::string("Undefined serialize method for type: ") + typeid(o).name());
-}
+    const ComplexType* find(UType tag) const {
+        return byTag[(uint8_t) tag];
+    }
 
-template <typename T> T BaseSerializer::deserializeObject(const UBinder& data) {
-    T complex;
-    complex.compose(data);
+    const ComplexType* find(const std::string& typeName) {
+        std::shared_lock lock(mutex);
+        auto it = byName.find(typeName);
+        return it != byName.end() ? it->second : nullptr;
+    }
 
-    return complex;
+    Registry() {
+        add<TestComplexObject>("TestComplexObject");
+        add<UHashId>("HashId");
+        add<UKeyAddress>("KeyAddress");
+        add<UPublicKey>("RSAPublicKey");
+        add<UPrivateKey>("RSAPrivateKey");
+        add<USerializationError>("USerializationError");
+    }
+};
 
-    //throw std::invalid_argument(std::string("Undefined deserialize method for type: ") + typeid(T).name());
+BaseSerializer::Registry& BaseSerializer::registry() {
+    static Registry registry;
+    return registry;
 }
 
-// Template specializations
-/*template <> UObject BaseSerializer::serializeObject(TestComplexObject& o) {
-    UBinder result = o.compose();
-    result.set("__type", "TestComplexObject");
-
-    return result;
+void BaseSerializer::registerComplexType(UType tag, const ComplexType& complexType) {
+    registry().add(tag, complexType);
 }
 
-template <> TestComplexObject BaseSerializer::deserializeObject(const UBinder& data) {
-    TestComplexObject complex;
-    complex.decompose(data);
-
-    return complex;
-}*/
+void BaseSerializer::unregisterComplexType(const std::string& typeName) {
+    registry().remove(typeName);
+}
 
 UObject BaseSerializer::skipBaseTypes(const UObject& o) {
 
@@ -71,29 +119,15 @@ UObject BaseSerializer::skipBaseTypes(const UObject& o) {
     return nullObject;
 }
 
-// Macros for serialize complex types
-#define serializeComplex(className, typeName) \
-    if (className::isInstance(o)) \
-        return serializeObject<className&>(className::asInstance((UObject&) o), typeName);
-
-// Macros for deserialize complex types
-#define deserializeComplex(className, typeName) \
-    if (type == typeName) \
-        return deserializeObject<className>(binder);
-
-// Macros for all complex types serialization/deserialization
-#define complexTypes(functionName) \
-    functionName(TestComplexObject, "TestComplexObject"); \
-    functionName(UHashId, "HashId"); \
-    functionName(UKeyAddress, "KeyAddress"); \
-    functionName(UPublicKey, "RSAPublicKey"); \
-    functionName(UPrivateKey, "RSAPrivateKey"); \
-    functionName(USerializationError, "USerializationError");
-    // TODO: add other complex types
-
 UObject BaseSerializer::serialize(const UObject& o) {
+    bool intact;
+    return serialize(o, intact);
+}
+
+UObject BaseSerializer::serialize(const UObject& o, bool& intact) {
 
     // Skip null and base types
+    intact = true;
     if (o.isNull())
         return o;
 
@@ -104,27 +138,61 @@ UObject BaseSerializer::serialize(const UObject& o) {
     // Binder
     if (UBinder::isInstance(o)) {
         const UBinder& binder = UBinder::asInstance(o);
-        UBinder result;
 
-        std::transform(binder.cbegin(), binder.cend(), result.endInserter(), [](UBinder::value_type const& value) {
-            return UBinder::value_type(value.first, serialize(value.second));
-        });
+        // Unmodified unpacked binder is returned as is, to be packed from its packed form. Its leaves could be
+        // changed only through the binder itself, so only nested containers need to be checked.
+        intact = !binder.packedForm().empty();
+        std::vector<UObject> values(binder.size());
+        size_t i = 0;
+        for (auto it = binder.cbegin(); it != binder.cend(); it++, i++)
+            if (!intact || UBinder::isInstance(it->second) || UArray::isInstance(it->second)) {
+                bool valueIntact;
+                values[i] = serialize(it->second, valueIntact);
+                intact = intact && valueIntact;
+            }
+
+        if (intact)
+            return o;
+
+        UBinder result;
+        result.reserve(binder.size());
+        i = 0;
+        for (auto it = binder.cbegin(); it != binder.cend(); it++, i++)
+            result.insert(UBinder::value_type(it->first, values[i].isNull() ? serialize(it->second) : values[i]));
         return result;
     }
 
     // Array
     if (UArray::isInstance(o)) {
         const UArray& array = UArray::asInstance(o);
-        UArray result;
 
-        std::transform(array.cbegin(), array.cend(), result.endInserter(), [](UArray::value_type const& value) {
-            return UArray::value_type(serialize(value));
-        });
+        intact = !array.packedForm().empty();
+        std::vector<UObject> values(array.size());
+        for (size_t i = 0; i < array.size(); i++)
+            if (!intact || UBinder::isInstance(array[i]) || UArray::isInstance(array[i])) {
+                bool valueIntact;
+                values[i] = serialize(array[i], valueIntact);
+                intact = intact && valueIntact;
+            }
+
+        if (intact)
+            return o;
+
+        UArray result;
+        result.reserve(array.size());
+        for (size_t i = 0; i < array.size(); i++)
+            result.push_back(values[i].isNull() ? serialize(array[i]) : values[i]);
         return result;
     }
 
     // Complex types
-    complexTypes(serializeComplex)
+    intact = false;
+    const ComplexType* complexType = registry().find(o.type());
+    if (complexType != nullptr) {
+        UBinder result = complexType->decompose(o);
+        result.set("__type", complexType->name);
+        return result;
+    }
 
     throw std::invalid_argument(std::string("Invalid object type for serialization: ") + typeid(o).name());
 }
@@ -147,6 +215,7 @@ UObject BaseSerializer::deserialize(const UObject& o) {
         std::transform(array.cbegin(), array.cend(), result.endInserter(), [](UArray::value_type const& value) {
             return UArray::value_type(deserialize(value));
         });
+        result.setPackedForm(array.packedForm());
         return result;
     }
 
@@ -166,15 +235,19 @@ UObject BaseSerializer::deserialize(const UObject& o) {
 
         if (type.empty()) {
             UBinder result;
+            result.reserve(binder.size());
 
             std::transform(binder.cbegin(), binder.cend(), result.endInserter(), [](UBinder::value_type const& value) {
                 return UBinder::value_type(value.first, deserialize(value.second));
             });
+            result.setPackedForm(binder.packedForm());
             return result;
         }
 
         // Complex types
-        complexTypes(deserializeComplex)
+        const ComplexType* complexType = registry().find(type);
+        if (complexType != nullptr)
+            return complexType->compose(binder);
 
         return binder;
     }
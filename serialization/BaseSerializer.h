@@ -17,12 +17,58 @@ class BaseSerializer {
     static UObject serialize(const UObject& o);
     static UObject deserialize(const UObject& o);
 
+    /**
+     * Complex type serialized as binder with "__type" field, registered with registerComplexType().
+     */
+    struct ComplexType {
+        std::string name;
+        UBinder (*decompose)(const UObject& o);
+        UObject (*compose)(const UBinder& data);
+    };
+
+    /**
+     * Register complex type for serialization. Types are looked up by UObject type tag when serializing and by
+     * "__type" (or "__t") value when deserializing.
+     *
+     * T should have default constructor, isInstance(), asInstance(), UBinder decompose() and
+     * compose(const UBinder& data), like UHashId has. Registration is thread safe, but serialization running
+     * meanwhile may still use the previous type.
+     *
+     * @param typeName is value of "__type" field
+     */
+    template <typename T> static void registerComplexType(const std::string& typeName) {
+        registerComplexType(T().type(), ComplexType {typeName, &decomposeObject<T>, &composeObject<T>});
+    }
+
+    static void registerComplexType(UType tag, const ComplexType& complexType);
+
+    /**
+     * Remove the type registered with the given "__type" value, e.g. one registered by a test.
+     * Binders of this type are deserialized as binders then.
+     */
+    static void unregisterComplexType(const std::string& typeName);
+
 protected:
-    template <typename T> static UObject serializeObject(T o, std::string typeName);
-    template <typename T> static T deserializeObject(const UBinder& data);
+    template <typename T> static UBinder decomposeObject(const UObject& o) {
+        return T::asInstance((UObject&) o).decompose();
+    }
+
+    template <typename T> static UObject composeObject(const UBinder& data) {
+        T complex;
+        complex.compose(data);
+        return complex;
+    }
 
 private:
+    struct Registry;
+    static Registry& registry();
+
     static UObject skipBaseTypes(const UObject& o);
+
+    /**
+     * Serialize object and tell whether it is an unmodified unpacked tree, returned as is with its packed form.
+     */
+    static UObject serialize(const UObject& o, bool& intact);
 };
 
 
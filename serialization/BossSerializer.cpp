@@ -5,6 +5,9 @@
 #include <cassert>
 #include <cstring>
 #include <sstream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "../types/UBool.h"
 #include "../types/UDateTime.h"
 #include "../types/UDouble.h"
@@ -12,6 +15,117 @@
 #include "../types/UArray.h"
 #include "BossSerializer.h"
 
+// Number of significant bits of value, 0 for 0
+static inline unsigned int bitLength(unsigned long value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return value == 0 ? 0 : (unsigned int) (sizeof(unsigned long) * 8 - __builtin_clzl(value));
+#else
+    unsigned int bits = 0;
+    while (value != 0) {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+#endif
+}
+
+// Store n lower bytes of value, least significant first
+static inline void storeLittleEndian(unsigned char* dest, unsigned long value, unsigned int n) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(dest, &value, n);
+#else
+    for (unsigned int i = 0; i < n; i++, value >>= 8)
+        dest[i] = (unsigned char) value;
+#endif
+}
+
+static inline unsigned long loadLittleEndian(const unsigned char* src, unsigned int n) {
+    unsigned long value = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&value, src, n);
+#else
+    for (unsigned int i = 0; i < n; i++)
+        value |= (unsigned long) src[i] << (i * 8);
+#endif
+    return value;
+}
+
+// Packed form of the container can be copied only if none of its nested containers is changed since unpacking.
+// A nested container changed through another handle drops only its own packed form, not the ones of its parents.
+static bool isPackedIntact(const UObject& o) {
+    if (UArray::isInstance(o)) {
+        const UArray& array = UArray::asInstance(o);
+        if (array.packedForm().empty())
+            return false;
+        for (auto it = array.cbegin(); it != array.cend(); it++)
+            if (!isPackedIntact(*it))
+                return false;
+    } else if (UBinder::isInstance(o)) {
+        const UBinder& binder = UBinder::asInstance(o);
+        if (binder.packedForm().empty())
+            return false;
+        for (auto it = binder.cbegin(); it != binder.cend(); it++)
+            if (!isPackedIntact(it->second))
+                return false;
+    }
+    return true;
+}
+
+bool BossSerializer::isValidUtf8(const unsigned char* data, size_t size) {
+    size_t i = 0;
+    while (i < size) {
+        // skip ASCII by blocks
+#ifdef __SSE2__
+        while (i + 16 <= size && _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) (data + i))) == 0)
+            i += 16;
+#endif
+        while (i + 8 <= size) {
+            uint64_t block;
+            memcpy(&block, data + i, 8);
+            if (block & 0x8080808080808080ULL)
+                break;
+            i += 8;
+        }
+        while (i < size && data[i] < 0x80)
+            i++;
+        if (i >= size)
+            break;
+
+        unsigned char c = data[i];
+        unsigned int tail;
+        uint32_t code;
+        if (c >= 0xC2 && c <= 0xDF) {
+            tail = 1;
+            code = c & 0x1F;
+        } else if ((c & 0xF0) == 0xE0) {
+            tail = 2;
+            code = c & 0x0F;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            tail = 3;
+            code = c & 0x07;
+        } else
+            return false;
+
+        if (size - i <= tail)
+            return false;
+        for (unsigned int k = 1; k <= tail; k++) {
+            unsigned char cc = data[i + k];
+            if ((cc & 0xC0) != 0x80)
+                return false;
+            code = (code << 6) | (cc & 0x3F);
+        }
+
+        // overlong forms, surrogates and out of range code points
+        if (tail == 2 && (code < 0x800 || (code >= 0xD800 && code <= 0xDFFF)))
+            return false;
+        if (tail == 3 && (code < 0x10000 || code > 0x10FFFF))
+            return false;
+
+        i += tail + 1;
+    }
+    return true;
+}
+
 UBytes BossSerializer::serialize(const UObject& o) {
 
     Writer writer;
@@ -42,6 +156,7 @@ BossSerializer::Writer::Writer(bool treeMode)
 
 void BossSerializer::Writer::setStreamMode() {
         cache.clear();
+        cacheCount = 0;
         treeMode = false;
         writeHeader(TYPE_EXTRA, XT_STREAM_MODE);
 }
@@ -78,14 +193,8 @@ void BossSerializer::Writer::put(const UObject& o) {
         else if (d == 1.0)
             writeHeader(TYPE_EXTRA, XT_DONE);
         else {
-            unsigned char dbuf[8];
-            if (buf.capacity() < buf.size() + 9)
-                buf.reserve(buf.size()*2 + 9);
-
             writeHeader(TYPE_EXTRA, XT_DOUBLE);
-            memcpy(dbuf, &d, 8);
-
-            std::copy(dbuf, dbuf + 8, std::back_inserter(buf));
+            memcpy(grow(8), &d, 8);
         }
 
     } else if (UBool::isInstance(o)) {
@@ -94,9 +203,6 @@ void BossSerializer::Writer::put(const UObject& o) {
     } else if (UDateTime::isInstance(o)) {
         TimePoint time = UDateTime::asInstance(o).get();
 
-        if (buf.capacity() < buf.size() + 6)
-            buf.reserve(buf.size()*2 + 6);
-
         writeHeader(TYPE_EXTRA, XT_TIME);
         writeEncoded((unsigned long) time.time_since_epoch().count() / std::chrono::high_resolution_clock::period::den);
 
@@ -107,30 +213,25 @@ void BossSerializer::Writer::put(const UObject& o) {
             const std::vector<unsigned char>& bb = bytes.get();
 
             writeHeader(TYPE_BIN, bb.size());
-            if (buf.capacity() < buf.size() + bb.size())
-                buf.reserve(buf.size()*2 + bb.size());
-
-            std::copy(bb.data(), bb.data() + bb.size(), std::back_inserter(buf));
+            buf.insert(buf.end(), bb.begin(), bb.end());
         }
 
     } else if (UString::isInstance(o)) {
         UString str = UString::asInstance(o);
 
         if (!tryWriteReference(str)) {
-            const char* data = str.get().data();
-            unsigned long size = str.get().size();
+            const std::string& text = str.get();
 
-            writeHeader(TYPE_TEXT, size);
-            if (buf.capacity() < buf.size() + size)
-                buf.reserve(buf.size()*2 + size);
-
-            std::copy(data, data + size, std::back_inserter(buf));
+            writeHeader(TYPE_TEXT, text.size());
+            buf.insert(buf.end(), text.begin(), text.end());
         }
 
     } else if (UArray::isInstance(o)) {
-        UArray array = UArray::asInstance(o);
+        const UArray& array = UArray::asInstance(o);
 
-        if (!tryWriteReference(array)) {
+        if (isPackedIntact(array))
+            writePacked(CT_ARRAY, array.packedForm());
+        else if (!tryWriteReference(array)) {
             writeHeader(TYPE_LIST, array.size());
 
             for (unsigned long i = 0; i < array.size(); i++)
@@ -138,9 +239,11 @@ void BossSerializer::Writer::put(const UObject& o) {
         }
 
     } else if (UBinder::isInstance(o)) {
-        UBinder binder = UBinder::asInstance(o);
+        const UBinder& binder = UBinder::asInstance(o);
 
-        if (!tryWriteReference(binder)) {
+        if (isPackedIntact(binder))
+            writePacked(CT_BINDER, binder.packedForm());
+        else if (!tryWriteReference(binder)) {
             writeHeader(TYPE_DICT, binder.size());
 
             for (auto it = binder.cbegin(); it != binder.cend(); it++) {
@@ -159,12 +262,13 @@ UBytes BossSerializer::Writer::getBytes() {
 }
 
 unsigned int BossSerializer::Writer::sizeInBytes(unsigned long value) {
-    unsigned int cnt = 1;
-    while (value > 255) {
-        cnt++;
-        value >>= 8;
-    }
-    return cnt;
+    return value == 0 ? 1 : (bitLength(value) + 7) / 8;
+}
+
+unsigned char* BossSerializer::Writer::grow(size_t n) {
+    size_t offset = buf.size();
+    buf.resize(offset + n);
+    return buf.data() + offset;
 }
 
 void BossSerializer::Writer::writeHeader(unsigned int code, unsigned long value) {
@@ -174,29 +278,21 @@ void BossSerializer::Writer::writeHeader(unsigned int code, unsigned long value)
     if (value < 23)
         buf.push_back((unsigned char) (code | ((int) value << 3)));
     else {
-        if (buf.capacity() < buf.size() + 9)
-            buf.reserve(buf.size()*2 + 9);
-
+        // unsigned long always fits 8 bytes, so the length is in the header byte itself
         unsigned int n = sizeInBytes(value);
-        if (n < 9) {
-            buf.push_back((unsigned char) (code | ((n + 22) << 3)));
-        } else {
-            buf.push_back((unsigned char) (code | 0xF8));
-            writeEncoded(n);
-        }
-        while (n-- > 0) {
-            buf.push_back((unsigned char) (value & 0xFF));
-            value >>= 8;
-        }
+        unsigned char* dest = grow(n + 1);
+        dest[0] = (unsigned char) (code | ((n + 22) << 3));
+        storeLittleEndian(dest + 1, value, n);
     }
 }
 
 void BossSerializer::Writer::writeEncoded(unsigned long value) {
-    while (value > 0x7f) {
-        buf.push_back((unsigned char) (value & 0x7F));
-        value >>= 7;
-    }
-    buf.push_back((unsigned char) (value | 0x80));
+    // 7 bits per byte, the last byte is marked with the high bit
+    unsigned int n = value == 0 ? 1 : (bitLength(value) + 6) / 7;
+    unsigned char* dest = grow(n);
+    for (unsigned int i = 0; i < n - 1; i++, value >>= 7)
+        dest[i] = (unsigned char) (value & 0x7F);
+    dest[n - 1] = (unsigned char) (value | 0x80);
 }
 
 bool BossSerializer::Writer::tryWriteReference(cachedObject &obj) {
@@ -208,11 +304,25 @@ bool BossSerializer::Writer::tryWriteReference(cachedObject &obj) {
 
     // Cache put depends on the streamMode
     if (treeMode)
-        cache[obj] = cache.size() + 1;
+        cache[obj] = ++cacheCount;
 
     return false;
 }
 
+void BossSerializer::Writer::writePacked(CACHE_TYPES type, const PackedForm& packed) {
+    if (treeMode || !cache.empty()) {
+        cachedObject obj(type, binary(packed.data, packed.data + packed.size));
+        if (tryWriteReference(obj))
+            return;
+    }
+
+    buf.insert(buf.end(), packed.data, packed.data + packed.size);
+
+    // Reader caches all objects of the slice, so skip their numbers (container itself is already counted)
+    if (treeMode)
+        cacheCount += packed.objects - 1;
+}
+
 bool BossSerializer::Writer::tryWriteReference(UBytes bytes) {
     if (!treeMode && cache.empty())
         return false;
@@ -266,11 +376,12 @@ bool BossSerializer::Writer::tryWriteReference(UBinder binder) {
 }
 
 BossSerializer::Reader::Reader(const UBytes& data)
-: treeMode(true), bin(data.get().data()), size(data.get().size()) {}
+: source(data), treeMode(true), bin(data.get().data()), size(data.get().size()) {}
 
 void BossSerializer::Reader::setStreamMode() {
     cache.clear();
     treeMode = false;
+    referencesRead++;
 }
 
 UObject BossSerializer::Reader::readObject() {
@@ -285,6 +396,10 @@ UObject BossSerializer::Reader::readObject() {
 
 UObject BossSerializer::Reader::get() {
 
+    unsigned int start = pos;
+    unsigned long objectsBefore = objectsRead;
+    unsigned long referencesBefore = referencesRead;
+
     Header h = readHeader();
 
     switch (h.code) {
@@ -295,7 +410,7 @@ UObject BossSerializer::Reader::get() {
             return h.getInt(true);
 
         case TYPE_BIN: {
-            if (pos + h.value > size)
+            if (h.value > size - pos)
                 throw std::invalid_argument(std::string("BOSS deserialize error: overflow reading binary data"));
 
             UBytes bb = h.value > 0 ? UBytes(&bin[pos], (unsigned int) h.value) : UBytes(nullptr, 0);
@@ -305,11 +420,13 @@ UObject BossSerializer::Reader::get() {
         }
 
         case TYPE_TEXT: {
-            if (pos + h.value > size)
+            if (h.value > size - pos)
                 throw std::invalid_argument(std::string("BOSS deserialize error: overflow reading string"));
 
-            std::string s(&bin[pos], &bin[pos] + h.value);
-            UString str(s);
+            if (!isValidUtf8(&bin[pos], h.value))
+                throw std::invalid_argument(std::string("BOSS deserialize error: invalid UTF-8 string"));
+
+            UString str(std::string((const char*) &bin[pos], h.value));
             cacheObject(str);
             pos += h.value;
             return str;
@@ -326,11 +443,20 @@ UObject BossSerializer::Reader::get() {
 
             recursive.pop_back();
 
+            if (referencesRead == referencesBefore)
+                array.setPackedForm(PackedForm(source, &bin[start], pos - start, objectsRead - objectsBefore));
+
             return array;
         }
 
-        case TYPE_DICT:
-            return readBinder(h);
+        case TYPE_DICT: {
+            UObject binder = readBinder(h);
+
+            if (referencesRead == referencesBefore)
+                UBinder::asInstance(binder).setPackedForm(PackedForm(source, &bin[start], pos - start, objectsRead - objectsBefore));
+
+            return binder;
+        }
 
         case TYPE_CREF: {
             if (h.value != 0 && h.value > cache.size())
@@ -340,6 +466,10 @@ UObject BossSerializer::Reader::get() {
                 if (i == h.value)
                     throw std::invalid_argument(std::string("BOSS deserialize error: recursive reference"));
 
+            // slice with a reference can't be reused elsewhere, see PackedForm
+            if (h.value != 0)
+                referencesRead++;
+
             return h.value == 0 ? nullObject : cache[h.value - 1];
         }
 
@@ -352,6 +482,8 @@ UObject BossSerializer::Reader::get() {
 
 UObject BossSerializer::Reader::readBinder(Header h) {
     UBinder binder;
+    // every entry takes at least 2 bytes (key and value headers), so don't trust bigger counts
+    binder.reserve(std::min(h.value, (unsigned long) (size - pos) / 2));
     cacheObject(binder);
 
     recursive.push_back(cache.size());
@@ -393,28 +525,34 @@ unsigned char BossSerializer::Reader::readByte() {
 }
 
 unsigned long BossSerializer::Reader::readEncodedLong() {
-    unsigned long value = 0;
-    int shift = 0;
+    // 64 bits take at most 10 bytes of 7 bits
+    const unsigned int maxLength = 10;
+    unsigned int available = std::min(size - pos, maxLength);
+    const unsigned char* src = &bin[pos];
 
-    while (true) {
-        int n = readByte();
-        value |= ((long) n & 0x7F) << shift;
-        if ((n & 0x80) != 0)
+    unsigned long value = 0;
+    for (unsigned int i = 0; i < available; i++) {
+        value |= ((unsigned long) src[i] & 0x7F) << (7 * i);
+        if ((src[i] & 0x80) != 0) {
+            pos += i + 1;
             return value;
-        shift += 7;
+        }
     }
+
+    if (available < maxLength)
+        throw std::invalid_argument(std::string("BOSS deserialize error: overflow parsing header"));
+    throw std::invalid_argument(std::string("BOSS deserialize error: invalid encoded long"));
 }
 
 unsigned long BossSerializer::Reader::readLong(unsigned long length) {
     if (length > 8)
         throw std::invalid_argument(std::string("BOSS deserialize error: invalid long length"));
 
-    unsigned long res = 0;
-    int n = 0;
-    while (length-- > 0) {
-        res |= (((long) readByte()) << n);
-        n += 8;
-    }
+    if (pos + length > size)
+        throw std::invalid_argument(std::string("BOSS deserialize error: overflow parsing header"));
+
+    unsigned long res = loadLittleEndian(&bin[pos], (unsigned int) length);
+    pos += length;
 
     return res;
 }
@@ -462,6 +600,7 @@ UObject BossSerializer::Reader::parseExtra(int code) {
 }
 
 void BossSerializer::Reader::cacheObject(UObject obj) {
+    objectsRead++;
     if (treeMode)
         cache.push_back(obj);
 }
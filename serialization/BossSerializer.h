@@ -74,6 +74,17 @@ class BossSerializer : public BaseSerializer {
      */
     static UObject deserialize(const UBytes& data);
 
+    /**
+     * Check that data is well-formed UTF-8: no overlong forms, surrogates or code points above U+10FFFF.
+     * ASCII runs are checked by blocks. Used to validate TEXT when unpacking.
+     *
+     * @param data is string bytes
+     * @param size is number of bytes
+     *
+     * @return true if data is valid UTF-8
+     */
+    static bool isValidUtf8(const unsigned char* data, size_t size);
+
 private:
     class Header {
     public:
@@ -123,6 +134,7 @@ class BossSerializer : public BaseSerializer {
 
     private:
         cacheMap cache;
+        unsigned long cacheCount = 0;
         binary buf;
 
         bool treeMode;
@@ -133,6 +145,9 @@ class BossSerializer : public BaseSerializer {
 
         static unsigned int sizeInBytes(unsigned long value);
 
+        // append n bytes to buf and return pointer to them
+        unsigned char* grow(size_t n);
+
         void writeHeader(unsigned int code, unsigned long value);
         void writeEncoded(unsigned long value);
 
@@ -141,6 +156,8 @@ class BossSerializer : public BaseSerializer {
         bool tryWriteReference(UString str);
         bool tryWriteReference(UArray array);
         bool tryWriteReference(UBinder binder);
+
+        void writePacked(CACHE_TYPES type, const PackedForm& packed);
     };
 
     /**
@@ -163,12 +180,17 @@ class BossSerializer : public BaseSerializer {
         UObject readObject();
 
     private:
+        UBytes source;
         std::vector<UObject> cache;
         const unsigned char* bin;
         const unsigned int size;
         unsigned int pos = 0;
         std::vector<unsigned long> recursive;
 
+        // counters to find subtrees without references to the rest of data, whose bytes could be reused
+        unsigned long objectsRead = 0;
+        unsigned long referencesRead = 0;
+
         bool treeMode;
 
         void setStreamMode();
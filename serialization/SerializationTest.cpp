@@ -33,6 +33,10 @@ void allSerializationTests() {
     testBoss();
     testBossStreamMode();
     testUHashId();
+    testUTypes();
+    testUBinder();
+    testBossPackedForm();
+    testComplexTypes();
 }
 
 void testBaseSerialization() {
@@ -400,3 +404,189 @@ void testUHashId() {
 
     printf("testUHashId()...done\n\n");
 }
+
+void testUTypes() {
+    printf("testUTypes()...\n");
+
+    ASSERT(UObject().isNull());
+    ASSERT(nullObject.type() == UType::Null);
+    ASSERT(UInt(-1).type() == UType::Int);
+    ASSERT(UDouble(-1).type() == UType::Double);
+    ASSERT(UBool(false).type() == UType::Bool);
+    ASSERT(UString("").type() == UType::String);
+    ASSERT(UBytes(nullptr, 0).type() == UType::Bytes);
+    ASSERT(UArray().type() == UType::Array);
+    ASSERT(UBinder().type() == UType::Binder);
+    ASSERT(TestComplexObject().type() == UType::TestComplexObject);
+
+    // scalars are stored inline and keep their values through copies
+    UObject i = UInt(INT64_MIN);
+    UObject d = UDouble(-0.5);
+    UObject b = UBool(true);
+    TimePoint now = std::chrono::high_resolution_clock::now();
+    UObject t = UDateTime(now);
+    ASSERT(UInt::asInstance(i).get() == INT64_MIN);
+    ASSERT(UDouble::asInstance(d).get() == -0.5);
+    ASSERT(UBool::asInstance(b).get());
+    ASSERT(UDateTime::asInstance(t).get() == now);
+
+    ASSERT(!UInt::isInstance(d));
+    ASSERT(!UDouble::isInstance(i));
+    ASSERT(!UInt::isInstance(t));
+    ASSERT(!UBinder::isInstance(nullObject));
+
+    bool thrown = false;
+    try {
+        UString::asInstance(i);
+    } catch (const std::invalid_argument& e) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+
+    printf("testUTypes()...done\n\n");
+}
+
+void testUBinder() {
+    printf("testUBinder()...\n");
+
+    // keys are kept sorted whatever the insertion order
+    UBinder binder;
+    binder.set("c", 3);
+    binder.set("a", 1);
+    binder.set("b", 2);
+    binder.set("ab", 12);
+    binder.set("b", 22);
+    ASSERT(binder.size() == 4);
+    std::vector<std::string> keys;
+    for (auto& it: binder)
+        keys.push_back(it.first);
+    ASSERT(keys == std::vector<std::string>({"a", "ab", "b", "c"}));
+    ASSERT(binder.getInt("b") == 22);
+    ASSERT(binder.count("ab") == 1);
+    ASSERT(binder.count("aa") == 0);
+    ASSERT(binder.find("d") == binder.end());
+    ASSERT(binder.lower_bound("aa")->first == "ab");
+    ASSERT(binder.upper_bound("ab")->first == "b");
+    ASSERT(!binder.insert(UBinder::value_type("a", UInt(0))).second);
+    // entries are sorted by keys, so keys can't be changed in place
+    static_assert(!std::is_assignable<decltype((binder.begin()->first)), UKey>::value, "binder key is assignable");
+    ASSERT(binder.getInt("a") == 1);
+
+    UBinder init = {{"z", UInt(1)}, {"y", UInt(2)}, {"z", UInt(3)}};
+    ASSERT(init.size() == 2);
+    ASSERT(init.begin()->first == "y");
+    ASSERT(init.getInt("z") == 1);
+
+    auto filtered = binder.filter([](const std::string& key, const UObject& value) { return key.size() == 1; });
+    ASSERT(filtered.size() == 3);
+    ASSERT(filtered.count("ab") == 0);
+
+    // short keys are interned, so equal keys of different binders share one string
+    UKey k1("state"), k2(std::string("state"));
+    ASSERT(k1.isInterned() && k2.isInterned());
+    ASSERT(&k1.str() == &k2.str());
+    UKey longKey(std::string(1000, 'k'));
+    ASSERT(!longKey.isInterned());
+    ASSERT(longKey == std::string(1000, 'k'));
+
+    // packed form doesn't depend on insertion order
+    UBinder reversed;
+    for (auto it = binder.rbegin(); it != binder.rend(); it++)
+        reversed.set(it->first, it->second);
+    ASSERT(BossSerializer::serialize(reversed).get() == BossSerializer::serialize(binder).get());
+    UBinder unpacked = UBinder::asInstance(BossSerializer::deserialize(BossSerializer::serialize(binder)));
+    ASSERT(unpacked.size() == 4);
+    ASSERT(unpacked.getInt("ab") == 12);
+    ASSERT(unpacked.begin()->first.isInterned());
+
+    printf("testUBinder()...done\n\n");
+}
+
+void testBossPackedForm() {
+    printf("testBossPackedForm()...\n");
+
+    // {"list": [{"b": 1, "a": 2}, "s"], "n": 5} with keys of inner dict not sorted, as packed by js
+    std::vector<unsigned char> src = {0x17, 0x23, 'l', 'i', 's', 't', 0x16, 0x17, 0x0B, 'b', 0x08, 0x0B, 'a', 0x10,
+                                      0x0B, 's', 0x0B, 'n', 0x28};
+    UBytes packed(src.data(), (unsigned int) src.size());
+
+    UObject obj = BossSerializer::deserialize(packed);
+    UBinder& root = UBinder::asInstance(obj);
+    ASSERT(!root.packedForm().empty());
+    ASSERT(root.packedForm().objects == 8);
+    ASSERT(BossSerializer::serialize(root).get() == src);
+
+    // unmodified subtrees are copied as is after their parent is changed
+    root.set("n", 6);
+    ASSERT(root.packedForm().empty());
+    const UArray& list = UArray::asInstance(root.get("list"));
+    ASSERT(!list.packedForm().empty());
+    std::vector<unsigned char> res = BossSerializer::serialize(root).get();
+    ASSERT(res.size() == src.size());
+    ASSERT(std::equal(src.begin() + 2, src.end() - 1, res.begin() + 2));
+    ASSERT(res.back() == 0x30);
+
+    // and references after the copied slice still point to right objects
+    root.set("x", "qq");
+    root.set("y", "qq");
+    UBinder unpacked = UBinder::asInstance(BossSerializer::deserialize(BossSerializer::serialize(root)));
+    ASSERT(unpacked.getString("x") == "qq");
+    ASSERT(unpacked.getString("y") == "qq");
+    ASSERT(UString::asInstance(UArray::asInstance(unpacked.get("list"))[1]).get() == "s");
+    ASSERT(UBinder::asInstance(UArray::asInstance(unpacked.get("list"))[0]).getInt("b") == 1);
+
+    // modification of nested container invalidates packed form of all containers above it
+    UObject obj2 = BossSerializer::deserialize(packed);
+    const UBinder& root2 = UBinder::asInstance((const UObject&) obj2);
+    UArray list2 = UArray::asInstance(root2.get("list"));
+    list2.push_back(UInt(7));
+    ASSERT(!root2.packedForm().empty());
+    UBinder unpacked2 = UBinder::asInstance(BossSerializer::deserialize(BossSerializer::serialize(root2)));
+    ASSERT(UArray::asInstance(unpacked2.get("list")).size() == 3);
+
+    // reads through non-const handles keep packed forms
+    UObject obj4 = BossSerializer::deserialize(packed);
+    UBinder& root4 = UBinder::asInstance(obj4);
+    UArray& list4 = root4.getArray("list");
+    ASSERT(list4[0].type() == UType::Binder && list4.front().type() == UType::Binder && list4.begin() != list4.end());
+    ASSERT(root4.find("n") != root4.end());
+    ASSERT(!root4.packedForm().empty() && !list4.packedForm().empty());
+    ASSERT(BossSerializer::serialize(root4).get() == src);
+
+    // subtree with references to other objects has no packed form
+    UObject obj3 = BossSerializer::deserialize(BossSerializer::serialize(
+            UBinder::of("a", UBinder::of("k1", "v", "k2", "v"), "b", UBinder::of("k", "w"))));
+    const UBinder& withRefs = UBinder::asInstance(obj3);
+    ASSERT(withRefs.packedForm().empty());
+    ASSERT(withRefs.getBinder("a").packedForm().empty());
+    ASSERT(!withRefs.getBinder("b").packedForm().empty());
+
+    printf("testBossPackedForm()...done\n\n");
+}
+
+void testComplexTypes() {
+    printf("testComplexTypes()...\n");
+
+    UObject obj = BaseSerializer::serialize(UBinder::of("t", TestComplexObject("name", 7)));
+    const UBinder& packed = UBinder::asInstance(obj).getBinder("t");
+    ASSERT(packed.getString("__type") == "TestComplexObject");
+
+    // types are also found by "__t"
+    UBinder alias = UBinder::of("__t", "TestComplexObject", "name", "alias", "amount", 3);
+    UObject des = BaseSerializer::deserialize(alias);
+    ASSERT(TestComplexObject::isInstance(des));
+    ASSERT(TestComplexObject::asInstance(des).getName() == "alias");
+
+    // registered type could be renamed
+    BaseSerializer::registerComplexType<TestComplexObject>("TestComplexObject2");
+    UObject obj2 = BaseSerializer::serialize(TestComplexObject("name", 7));
+    ASSERT(UBinder::asInstance(obj2).getString("__type") == "TestComplexObject2");
+    ASSERT(TestComplexObject::isInstance(BaseSerializer::deserialize(obj2)));
+    // registry is global, so the test type is removed not to leak into other tests
+    BaseSerializer::registerComplexType<TestComplexObject>("TestComplexObject");
+    BaseSerializer::unregisterComplexType("TestComplexObject2");
+    ASSERT(!TestComplexObject::isInstance(BaseSerializer::deserialize(obj2)));
+    ASSERT(UBinder::asInstance(BaseSerializer::serialize(TestComplexObject("name", 7))).getString("__type") == "TestComplexObject");
+
+    printf("testComplexTypes()...done\n\n");
+}
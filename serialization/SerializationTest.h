@@ -12,5 +12,9 @@ void testBoss();
 void testBossStreamMode();
 void testUHashId();
 void testUListRole();
+void testUTypes();
+void testUBinder();
+void testBossPackedForm();
+void testComplexTypes();
 
 #endif //U8_SERIALIZATIONTEST_H
@@ -186,3 +186,37 @@ TEST_CASE("AutoThreadPool") {
     }
 
 }
+
+TEST_CASE("parallelFor") {
+    SECTION("calls each index once") {
+        for (size_t count: {0, 1, 7, 1000}) {
+            vector<atomic<int>> calls(count);
+            parallelFor(count, [&](size_t i) { ++calls[i]; });
+            for (auto& c: calls)
+                REQUIRE(c == 1);
+        }
+    }
+
+    SECTION("rethrows errors after all calls") {
+        atomic<int> calls = 0;
+        REQUIRE_THROWS_AS(parallelFor(100, [&](size_t i) {
+            ++calls;
+            if (i == 50)
+                throw runtime_error("test");
+        }), runtime_error);
+        REQUIRE(calls == 100);
+    }
+
+    SECTION("nested in pool tasks") {
+        const int TASKS = 4 * thread::hardware_concurrency();
+        Latch<int> latch(TASKS);
+        atomic<long> sum = 0;
+        for (int t = 0; t < TASKS; ++t)
+            runAsync([&]() {
+                parallelFor(100, [&](size_t i) { sum += i; });
+                latch.countDown();
+            });
+        latch.wait();
+        REQUIRE(sum == TASKS * 4950L);
+    }
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include <chrono>
+#include "catch2.h"
+#include "../serialization/BossSerializer.h"
+#include "../types/UArray.h"
+#include "../types/UBool.h"
+#include "../types/UDouble.h"
+#include "../types/UDateTime.h"
+#include "../tools/tools.h"
+
+using namespace std;
+
+static const vector<string> CONTRACT_SAMPLES = {
+        "../test/testcontract.unicon", "../test/U_200_11.unicon", "../test/listrole.unicon", "../test/mdp1.unicon",
+        "../test/revoke.unicon", "../test/sc.unicon", "../test/sjc.unicon", "../test/sjc2.unicon"
+};
+
+static UBinder makeSyntheticSample(int size) {
+    UBinder binder;
+    UArray ints, strings, blobs;
+    for (int i = 0; i < size; ++i) {
+        ints.push_back(UInt(((int64_t) 1 << (i % 63)) * (i % 2 ? -1 : 1)));
+        strings.push_back(UString("item_" + to_string(i) + (i % 5 ? "" : " строка ✓")));
+        blobs.push_back(UBytes(byte_vector((size_t) (i % 300), (unsigned char) i)));
+    }
+    binder.set("ints", ints);
+    binder.set("strings", strings);
+    binder.set("blobs", blobs);
+    binder.set("double", UDouble(0.125));
+    return binder;
+}
+
+// drops packed forms of all containers, so the tree is packed as if it was built anew
+static void dropPackedForms(UObject& obj) {
+    if (UBinder::isInstance(obj)) {
+        auto& binder = UBinder::asInstance(obj);
+        binder.setPackedForm(PackedForm());
+        for (auto& it: binder)
+            dropPackedForms(it.second);
+    } else if (UArray::isInstance(obj)) {
+        auto& array = UArray::asInstance(obj);
+        array.setPackedForm(PackedForm());
+        for (auto& item: array)
+            dropPackedForms(item);
+    }
+}
+
+// compares trees of plain values, binders are compared regardless of the order their keys were packed in
+static bool isSameTree(const UObject& a, const UObject& b) {
+    if (a.type() != b.type())
+        return false;
+    if (UInt::isInstance(a))
+        return UInt::asInstance(a).get() == UInt::asInstance(b).get();
+    if (UDouble::isInstance(a))
+        return UDouble::asInstance(a).get() == UDouble::asInstance(b).get();
+    if (UBool::isInstance(a))
+        return UBool::asInstance(a).get() == UBool::asInstance(b).get();
+    if (UDateTime::isInstance(a))
+        return UDateTime::asInstance(a).get() == UDateTime::asInstance(b).get();
+    if (UString::isInstance(a))
+        return UString::asInstance(a).get() == UString::asInstance(b).get();
+    if (UBytes::isInstance(a))
+        return UBytes::asInstance(a).get() == UBytes::asInstance(b).get();
+    if (UArray::isInstance(a)) {
+        auto& aa = UArray::asInstance(a);
+        auto& bb = UArray::asInstance(b);
+        if (aa.size() != bb.size())
+            return false;
+        for (size_t i = 0; i < aa.size(); ++i)
+            if (!isSameTree(aa[i], bb[i]))
+                return false;
+        return true;
+    }
+    if (UBinder::isInstance(a)) {
+        auto& aa = UBinder::asInstance(a);
+        auto& bb = UBinder::asInstance(b);
+        if (aa.size() != bb.size())
+            return false;
+        for (auto it = aa.cbegin(); it != aa.cend(); it++) {
+            auto found = bb.find(it->first.str());
+            if (found == bb.cend() || !isSameTree(it->second, found->second))
+                return false;
+        }
+        return true;
+    }
+    return a.isNull();
+}
+
+TEST_CASE("boss_codecs") {
+    SECTION("headers and longs") {
+        vector<int64_t> values = {0, 1, 22, 23, 24, 255, 256, 65535, 65536, 0x7FFFFFFF, 0x100000000LL,
+                                  0xFFFFFFFFFFFFFLL, INT64_MAX, -1, -22, -23, -256, -0x100000000LL, INT64_MIN + 1};
+        for (auto v: values) {
+            UObject res = BossSerializer::deserialize(BossSerializer::serialize(UArray({UInt(v)})));
+            REQUIRE(UInt::asInstance(UArray::asInstance(res)[0]).get() == v);
+        }
+
+        // header of 23 is 1 extra byte, of 256 is 2 extra bytes
+        REQUIRE(BossSerializer::serialize(UInt(22)).get().size() == 1);
+        REQUIRE(BossSerializer::serialize(UInt(23)).get().size() == 2);
+        REQUIRE(BossSerializer::serialize(UInt(256)).get().size() == 3);
+        REQUIRE(BossSerializer::serialize(UInt(INT64_MAX)).get().size() == 9);
+    }
+
+    SECTION("encoded longs") {
+        for (int64_t seconds: {0LL, 127LL, 128LL, 1600000000LL, 1LL << 32}) {
+            TimePoint tp((std::chrono::high_resolution_clock::duration) std::chrono::seconds(seconds));
+            UObject res = BossSerializer::deserialize(BossSerializer::serialize(UArray({UDateTime(tp)})));
+            REQUIRE(UDateTime::asInstance(UArray::asInstance(res)[0]).get() == tp);
+        }
+
+        // encoded long longer than 10 bytes
+        byte_vector bad = {0x79, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x80};
+        REQUIRE_THROWS_AS(BossSerializer::deserialize(UBytes(std::move(bad))), std::invalid_argument);
+    }
+
+    SECTION("utf-8") {
+        auto check = [](const string& s) {
+            return BossSerializer::isValidUtf8((const unsigned char*) s.data(), s.size());
+        };
+        REQUIRE(check(""));
+        REQUIRE(check("plain ascii string which is longer than sixteen bytes"));
+        REQUIRE(check("Новая строка!!! №13579; ---=== NEW_DATA"));
+        REQUIRE(check("\xF0\x9F\x98\x80 and \xE2\x9C\x93"));
+        REQUIRE(!check("ascii prefix longer than block \x80"));
+        REQUIRE(!check("\xC0\xAF"));
+        REQUIRE(!check("\xED\xA0\x80"));
+        REQUIRE(!check("\xF4\x90\x80\x80"));
+        REQUIRE(!check("truncated \xE2\x9C"));
+
+        byte_vector packed = {0x1B, 'a', 0xFF, 'b'};
+        REQUIRE_THROWS_AS(BossSerializer::deserialize(UBytes(std::move(packed))), std::invalid_argument);
+    }
+
+    SECTION("contract samples") {
+        for (auto& fileName: CONTRACT_SAMPLES) {
+            byte_vector src = getFileContentsBin(fileName);
+            REQUIRE(!src.empty());
+            UBytes srcBytes(src.data(), (unsigned int) src.size());
+
+            // unchanged tree is packed back from its packed form
+            REQUIRE(BossSerializer::serialize(BossSerializer::deserialize(srcBytes)).get() == src);
+
+            // the same tree encoded anew has the same content, though other packers could order keys differently
+            UObject fresh = BossSerializer::deserialize(srcBytes);
+            dropPackedForms(fresh);
+            byte_vector packed = BossSerializer::serialize(fresh).get();
+            REQUIRE(packed.size() == src.size());
+
+            UObject orig = BossSerializer::deserialize(srcBytes);
+            UObject repacked = BossSerializer::deserialize(UBytes(packed.data(), (unsigned int) packed.size()));
+            dropPackedForms(orig);
+            dropPackedForms(repacked);
+            REQUIRE(isSameTree(BaseSerializer::serialize(orig), BaseSerializer::serialize(repacked)));
+        }
+    }
+}
+
+TEST_CASE("boss_bench", "[!hide]") {
+    const int ITERATIONS = 200;
+
+    auto bench = [](const string& name, const byte_vector& packed, int iterations) {
+        UBytes src(packed.data(), (unsigned int) packed.size());
+        UObject obj = BossSerializer::deserialize(src);
+
+        // unchanged tree is packed by copying its packed form, so the packer is timed on a tree without them
+        UObject fresh = BossSerializer::deserialize(src);
+        dropPackedForms(fresh);
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            BossSerializer::deserialize(src);
+        auto t1 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            BossSerializer::serialize(fresh);
+        auto t2 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            BossSerializer::serialize(obj);
+        auto t3 = std::chrono::steady_clock::now();
+
+        double mb = double(packed.size()) * iterations / 1024 / 1024;
+        double unpackSec = std::chrono::duration<double>(t1 - t0).count();
+        double packSec = std::chrono::duration<double>(t2 - t1).count();
+        double repackSec = std::chrono::duration<double>(t3 - t2).count();
+        printf("%-32s %8zu bytes: unpack %8.2f MB/s, pack %8.2f MB/s, repack unchanged %8.2f MB/s\n", name.data(),
+               packed.size(), mb / unpackSec, mb / packSec, mb / repackSec);
+    };
+
+    for (int size: {100, 10000})
+        bench("synthetic_" + to_string(size), BossSerializer::serialize(makeSyntheticSample(size)).get(),
+              ITERATIONS * 1000 / size + 1);
+
+    for (auto& fileName: CONTRACT_SAMPLES)
+        bench(fileName, getFileContentsBin(fileName), ITERATIONS);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include <chrono>
+#include "catch2.h"
+#include "../crypto/cryptoCommon.h"
+#include "../crypto/SymmetricKey.h"
+#include "../crypto/Sha3.h"
+#include "../crypto/Streebog.h"
+#include "../crypto/ChaChaRandom.h"
+#include "../crypto/gost3411-2012.h"
+
+using namespace std;
+using namespace crypto;
+
+TEST_CASE("symmetric_key_bench", "[!hide]") {
+    initCrypto();
+    SymmetricKey key;
+
+    for (size_t size: {64, 1500, 65536, 16 * 1024 * 1024}) {
+        int iterations = int(2000000000 / (size + 10000)) + 1;
+        byte_vector buffer(size + SymmetricKey::ETA_OVERHEAD);
+        byte_vector output(size);
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            key.etaEncrypt(&buffer[SymmetricKey::ETA_IV_SIZE], size, buffer.data());
+        auto t1 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            key.etaDecrypt(buffer.data(), buffer.size(), output.data());
+        auto t2 = std::chrono::steady_clock::now();
+
+        double mb = double(size) * iterations / 1024 / 1024;
+        printf("etaEncrypt/etaDecrypt %9zu bytes: encrypt %8.2f MB/s, decrypt %8.2f MB/s\n", size,
+               mb / std::chrono::duration<double>(t1 - t0).count(), mb / std::chrono::duration<double>(t2 - t1).count());
+    }
+}
+
+TEST_CASE("sha3_bench", "[!hide]") {
+    initCrypto();
+
+    for (size_t size: {100, 1000, 65536}) {
+        const size_t count = 8;
+        int iterations = int(500000000 / (size * count + 1000)) + 1;
+        vector<byte_vector> inputs(count, byte_vector(size, 0x5A));
+        vector<byte_vector> outputs(count, byte_vector(32));
+        vector<const void *> data;
+        vector<size_t> sizes;
+        vector<unsigned char *> out;
+        for (size_t i = 0; i < count; ++i) {
+            data.push_back(inputs[i].data());
+            sizes.push_back(size);
+            out.push_back(outputs[i].data());
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            for (size_t j = 0; j < count; ++j)
+                Sha3::digest(256, data[j], size, out[j]);
+        auto t1 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            Sha3::digestMany(256, count, data.data(), sizes.data(), out.data());
+        auto t2 = std::chrono::steady_clock::now();
+
+        double mb = double(size) * count * iterations / 1024 / 1024;
+        printf("sha3-256 %9zu bytes x%zu: digest %8.2f MB/s, digestMany %8.2f MB/s\n", size, count,
+               mb / std::chrono::duration<double>(t1 - t0).count(), mb / std::chrono::duration<double>(t2 - t1).count());
+    }
+}
+
+TEST_CASE("streebog_bench", "[!hide]") {
+    for (size_t size: {100, 1000, 1024 * 1024}) {
+        int iterations = int(100000000 / (size + 1000)) + 1;
+        byte_vector data(size, 0x5A);
+        unsigned char out[32];
+        size_t len = 0;
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            gost3411_2012_get_digest(256, data.data(), size, out, &len);
+        auto t1 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            Streebog::digest(256, data.data(), size, out);
+        auto t2 = std::chrono::steady_clock::now();
+
+        double mb = double(size) * iterations / 1024 / 1024;
+        printf("streebog-256 %9zu bytes: gost3411-2012.h %8.2f MB/s, Streebog %8.2f MB/s\n", size,
+               mb / std::chrono::duration<double>(t1 - t0).count(), mb / std::chrono::duration<double>(t2 - t1).count());
+    }
+}
+
+TEST_CASE("random_bench", "[!hide]") {
+    initCrypto();
+
+    for (size_t size: {16, 64, 1024}) {
+        int iterations = int(50000000 / (size + 1000)) + 1;
+        byte_vector buffer(size);
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            sprng_read(buffer.data(), size, nullptr);
+        auto t1 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            randomBytes(buffer.data(), size);
+        auto t2 = std::chrono::steady_clock::now();
+
+        printf("random %5zu bytes: sprng_read %8.1f ns, randomBytes %8.1f ns\n", size,
+               std::chrono::duration<double, std::nano>(t1 - t0).count() / iterations,
+               std::chrono::duration<double, std::nano>(t2 - t1).count() / iterations);
+    }
+}
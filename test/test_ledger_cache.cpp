@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "catch2.h"
+#include "../db/LedgerCache.h"
+
+using namespace std;
+
+static byte_vector testDigest(int i) {
+    byte_vector digest(db::LedgerCache::MAX_DIGEST_SIZE);
+    for (size_t k = 0; k < digest.size(); ++k)
+        digest[k] = (unsigned char) (((unsigned) i * 2654435761u) >> (8 * (k % 4))) ^ (unsigned char) k;
+    return digest;
+}
+
+static db::LedgerRecord testRecord(int i) {
+    db::LedgerRecord record;
+    record.recordId = i + 1;
+    record.state = i % 10;
+    record.lockedById = i / 2;
+    record.createdAt = 1500000000 + i;
+    record.expiresAt = 1600000000 + i;
+    return record;
+}
+
+TEST_CASE("LedgerCache") {
+    SECTION("get, getById and remove") {
+        db::LedgerCache cache(1000, 60000);
+        for (int i = 0; i < 100; ++i) {
+            auto digest = testDigest(i);
+            cache.put(digest.data(), digest.size(), testRecord(i));
+        }
+        for (int i = 0; i < 100; ++i) {
+            auto digest = testDigest(i);
+            db::LedgerRecord record;
+            REQUIRE(cache.get(digest.data(), digest.size(), record));
+            REQUIRE(record.recordId == i + 1);
+            REQUIRE(record.state == i % 10);
+            REQUIRE(record.lockedById == i / 2);
+            REQUIRE(record.createdAt == 1500000000 + i);
+            REQUIRE(record.expiresAt == 1600000000 + i);
+
+            byte_vector found;
+            REQUIRE(cache.getById(i + 1, found, record));
+            REQUIRE(found == digest);
+            REQUIRE(record.recordId == i + 1);
+        }
+        auto stats = cache.getStats();
+        REQUIRE(stats.size == 100);
+        REQUIRE(stats.hits == 200);
+        REQUIRE(stats.misses == 0);
+
+        auto digest = testDigest(7);
+        cache.remove(digest.data(), digest.size());
+        db::LedgerRecord record;
+        byte_vector found;
+        REQUIRE(!cache.get(digest.data(), digest.size(), record));
+        REQUIRE(!cache.getById(8, found, record));
+        REQUIRE(cache.getStats().size == 99);
+
+        // replaced record is found by new id only
+        digest = testDigest(8);
+        auto replacement = testRecord(1000);
+        cache.put(digest.data(), digest.size(), replacement);
+        REQUIRE(!cache.getById(9, found, record));
+        REQUIRE(cache.getById(1001, found, record));
+        REQUIRE(found == digest);
+
+        cache.clear();
+        REQUIRE(cache.getStats().size == 0);
+        REQUIRE(!cache.getById(1001, found, record));
+    }
+
+    SECTION("evicts least recently used") {
+        db::LedgerCache cache(db::LedgerCache::SHARDS_COUNT * 10, 60000);
+        for (int i = 0; i < 10000; ++i) {
+            auto digest = testDigest(i);
+            cache.put(digest.data(), digest.size(), testRecord(i));
+            // the first one is always used, so never evicted
+            auto first = testDigest(0);
+            db::LedgerRecord record;
+            REQUIRE(cache.get(first.data(), first.size(), record));
+        }
+        auto stats = cache.getStats();
+        REQUIRE(stats.size <= db::LedgerCache::SHARDS_COUNT * 10);
+        REQUIRE(stats.evictions == 10000 - stats.size);
+        byte_vector found;
+        db::LedgerRecord record;
+        REQUIRE(!cache.getById(2, found, record));
+        REQUIRE(cache.getById(10000, found, record));
+    }
+
+    SECTION("expires records") {
+        db::LedgerCache cache(100, 50);
+        auto digest = testDigest(1);
+        cache.put(digest.data(), digest.size(), testRecord(1));
+        db::LedgerRecord record;
+        REQUIRE(cache.get(digest.data(), digest.size(), record));
+        this_thread::sleep_for(100ms);
+        REQUIRE(!cache.get(digest.data(), digest.size(), record));
+        auto stats = cache.getStats();
+        REQUIRE(stats.size == 0);
+        REQUIRE(stats.expirations == 1);
+    }
+
+    SECTION("shared by name") {
+        auto c1 = db::LedgerCache::shared("test_ledger_cache", 100, 60000);
+        auto c2 = db::LedgerCache::shared("test_ledger_cache", 100, 60000);
+        auto c3 = db::LedgerCache::shared("test_ledger_cache_other", 100, 60000);
+        REQUIRE(c1 == c2);
+        REQUIRE(c1 != c3);
+    }
+
+    SECTION("concurrent access") {
+        db::LedgerCache cache(5000, 60000);
+        vector<thread> threads;
+        atomic<int> errors(0);
+        for (int t = 0; t < 8; ++t)
+            threads.emplace_back([&cache, &errors, t]() {
+                for (int i = 0; i < 20000; ++i) {
+                    int n = (i * 7 + t) % 10000;
+                    auto digest = testDigest(n);
+                    db::LedgerRecord record;
+                    byte_vector found;
+                    if (i % 3 == 0)
+                        cache.put(digest.data(), digest.size(), testRecord(n));
+                    else if (i % 3 == 1) {
+                        if (cache.get(digest.data(), digest.size(), record) && record.recordId != n + 1)
+                            ++errors;
+                    } else if (cache.getById(n + 1, found, record) && found != digest)
+                        ++errors;
+                    if (i % 1000 == 999)
+                        cache.remove(digest.data(), digest.size());
+                }
+            });
+        for (auto& t: threads)
+            t.join();
+        REQUIRE(errors == 0);
+        REQUIRE(cache.getStats().size <= 5000 + db::LedgerCache::SHARDS_COUNT);
+    }
+}
@@ -625,6 +625,506 @@ TEST_CASE("PGPool") {
             sem.wait();
     }
 
+    SECTION("callbacks wait for released connections") {
+        Semaphore sem;
+        std::mutex heldMutex;
+        vector<shared_ptr<db::BusyConnection>> held;
+        for (int i = 0; i < 4; ++i) {
+            pgPool.withConnection([&sem,&heldMutex,&held](shared_ptr<db::BusyConnection> con) {
+                std::lock_guard guard(heldMutex);
+                held.push_back(con);
+                sem.notify();
+            });
+        }
+        for (int i = 0; i < 4; ++i)
+            sem.wait();
+        auto before = pgPool.getPoolStats();
+        REQUIRE(before.inUse == 4);
+
+        atomic<int> servedCounter(0);
+        for (int i = 0; i < 3; ++i) {
+            pgPool.withConnection([&sem,&servedCounter](db::BusyConnection &con) {
+                ++servedCounter;
+                sem.notify();
+            });
+        }
+        REQUIRE(pgPool.getPoolStats().waiting == 3);
+        REQUIRE(servedCounter == 0);
+
+        // one released connection serves all waiters in turn
+        held[0]->release();
+        for (int i = 0; i < 3; ++i)
+            sem.wait();
+        REQUIRE(servedCounter == 3);
+        for (int i = 1; i < 4; ++i)
+            held[i]->release();
+
+        auto after = pgPool.getPoolStats();
+        REQUIRE(after.waiting == 0);
+        REQUIRE(after.inUse == 0);
+        REQUIRE(after.waits - before.waits == 3);
+        REQUIRE(after.acquisitions - before.acquisitions == 3);
+        REQUIRE(after.waitMicrosMax > 0);
+    }
+
+    SECTION("closed pool fails waiters and new callbacks") {
+        Semaphore sem;
+        std::mutex heldMutex;
+        vector<shared_ptr<db::BusyConnection>> held;
+        for (int i = 0; i < 4; ++i) {
+            pgPool.withConnection([&sem,&heldMutex,&held](shared_ptr<db::BusyConnection> con) {
+                std::lock_guard guard(heldMutex);
+                held.push_back(con);
+                sem.notify();
+            });
+        }
+        for (int i = 0; i < 4; ++i)
+            sem.wait();
+
+        atomic<int> failedCounter(0);
+        auto select = [&sem,&failedCounter](db::BusyConnection& con) {
+            con.executeQuery([&sem](db::QueryResult&& qr) {
+                sem.notify();
+            }, [&sem,&failedCounter](const string& errText) {
+                ++failedCounter;
+                sem.notify();
+            }, "SELECT 1");
+        };
+        pgPool.withConnection(select);
+        REQUIRE(pgPool.getPoolStats().waiting == 1);
+        pgPool.groupCommit({{"UPDATE table1 SET state=1 WHERE id=0", {}}}, [&sem](db::QueryResultsArr& results) {
+            sem.notify();
+        }, [&sem,&failedCounter](const string& errText) {
+            ++failedCounter;
+            sem.notify();
+        });
+
+        pgPool.close();
+        pgPool.withConnection(select);
+        for (int i = 0; i < 3; ++i)
+            sem.wait();
+        REQUIRE(failedCounter == 3);
+        for (auto& con: held)
+            con->release();
+    }
+
+    SECTION("slow queries run concurrently on one loop thread") {
+        Semaphore sem;
+        atomic<int> readyCounter(0);
+        long long t0 = getCurrentTimeMillis();
+        for (int i = 0; i < 4; ++i) {
+            pgPool.withConnection([&sem,&readyCounter](shared_ptr<db::BusyConnection> con) {
+                con->executeQuery([&sem,&readyCounter,con](db::QueryResult &&qr) {
+                    ++readyCounter;
+                    con->release();
+                    sem.notify();
+                }, [&sem,con](const string &errText) {
+                    con->release();
+                    sem.notify();
+                }, "SELECT 1 FROM pg_sleep(0.5);");
+            });
+        }
+        for (int i = 0; i < 4; ++i)
+            sem.wait();
+        long long dt = getCurrentTimeMillis() - t0;
+        cout << "4 x pg_sleep(0.5): " << dt << " ms" << endl;
+        REQUIRE(readyCounter == 4);
+        REQUIRE(dt < 1500);
+    }
+
+    SECTION("executeBatch") {
+        Semaphore sem;
+        vector<db::BatchStatement> statements;
+        for (int i = 0; i < 10; ++i)
+            statements.push_back({"INSERT INTO table1(hash,state,locked_by_id,created_at,expires_at) VALUES (?,?,0,?,?) RETURNING id;",
+                                  {HashId::createRandom().getDigest(), i, (int)getCurrentTimeMillis() / 1000, getCurrentTimeMillis() / 1000l + 31536000l}});
+        statements.push_back({"SELECT count(*) FROM table1 WHERE state<?;", {5}});
+        pgPool.withConnection([&sem,&statements](db::BusyConnection& con) {
+            con.executeBatch([&sem](db::QueryResultsArr& results) {
+                REQUIRE(results.size() == 11);
+                for (int i = 0; i < 10; ++i)
+                    REQUIRE(db::getIntValue(results[i].getValueByIndex(0, 0)) == i + 1);
+                REQUIRE(db::getLongValue(results[10].getValueByIndex(0, 0)) == 5);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, statements);
+        });
+        sem.wait();
+
+        // the failed statement aborts the batch
+        pgPool.withConnection([&sem](db::BusyConnection& con) {
+            con.executeBatch([&sem](db::QueryResultsArr& results) {
+                REQUIRE(results.size() == 3);
+                REQUIRE(!results[0].isError());
+                REQUIRE(results[1].isError());
+                REQUIRE(results[2].getErrorCode() == PGRES_PIPELINE_ABORTED);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, {{"UPDATE table1 SET state=? WHERE id=?", {100, 1}},
+                {"SELECT no_such_column FROM table1", {}},
+                {"UPDATE table1 SET state=? WHERE id=?", {100, 2}}});
+        });
+        sem.wait();
+    }
+
+    SECTION("groupCommit") {
+        Semaphore sem;
+        vector<db::BatchStatement> statements;
+        for (int i = 0; i < 10; ++i)
+            statements.push_back({"INSERT INTO table1(hash,state,locked_by_id,created_at,expires_at) VALUES (?,?,0,?,?);",
+                                  {HashId::createRandom().getDigest(), i, (int)getCurrentTimeMillis() / 1000, getCurrentTimeMillis() / 1000l + 31536000l}});
+        pgPool.withConnection([&sem,&statements](db::BusyConnection& con) {
+            con.executeBatch([&sem](db::QueryResultsArr& results) {
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, statements);
+        });
+        sem.wait();
+
+        auto before = pgPool.getGroupCommitStats();
+        pgPool.setGroupCommit(50, 100);
+        atomic<int> committedCounter(0);
+        atomic<int> failedCounter(0);
+        // calls of one window go in one transaction, the failed one doesn't affect others
+        for (int i = 0; i < 10; ++i) {
+            vector<db::BatchStatement> call;
+            call.push_back({"UPDATE table1 SET locked_by_id=? WHERE id=?", {100 + i, i + 1}});
+            if (i == 5)
+                call.push_back({"SELECT no_such_column FROM table1", {}});
+            pgPool.groupCommit(std::move(call), [&sem,&committedCounter](db::QueryResultsArr& results) {
+                if (results.size() == 1 && results[0].getAffectedRows() == 1)
+                    ++committedCounter;
+                sem.notify();
+            }, [&sem,&failedCounter](const string& errText) {
+                ++failedCounter;
+                sem.notify();
+            });
+        }
+        for (int i = 0; i < 10; ++i)
+            sem.wait();
+        REQUIRE(committedCounter == 9);
+        REQUIRE(failedCounter == 1);
+
+        pgPool.withConnection([&sem](db::BusyConnection& con) {
+            con.executeQuery([&sem](db::QueryResult&& qr) {
+                REQUIRE(db::getLongValue(qr.getValueByIndex(0, 0)) == 9);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, "SELECT count(*) FROM table1 WHERE locked_by_id >= 100");
+        });
+        sem.wait();
+
+        auto after = pgPool.getGroupCommitStats();
+        REQUIRE(after.committed - before.committed == 9);
+        REQUIRE(after.failed - before.failed == 1);
+        // the first batch fails, and the rest are committed together
+        REQUIRE(after.batches - before.batches == 2);
+        REQUIRE(after.retries - before.retries == 9);
+        REQUIRE(after.batchSizes[3] - before.batchSizes[3] == 2);
+    }
+
+    SECTION("withReadConnection") {
+        Semaphore sem;
+        auto readSelect = [&sem](db::BusyConnection& con) {
+            con.executeQuery([&sem](db::QueryResult&& qr) {
+                REQUIRE(db::getIntValue(qr.getValueByIndex(0, 0)) == 1);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, "SELECT 1");
+        };
+
+        // without replicas reads go to the pool itself
+        pgPool.withReadConnection(1000, readSelect);
+        sem.wait();
+        REQUIRE(pgPool.getPoolStats().primaryReads == 1);
+
+        // the same database is a replica with zero lag
+        REQUIRE(pgPool.addReplica(2, "host=localhost port=5432 dbname=unit_tests").first);
+        REQUIRE(!pgPool.addReplica(0, "host=localhost port=5432 dbname=unit_tests").first);
+        for (int i = 0; i < 50 && !pgPool.getReplicaStats()[0].isHealthy; ++i)
+            this_thread::sleep_for(20ms);
+        auto replicas = pgPool.getReplicaStats();
+        REQUIRE(replicas.size() == 1);
+        REQUIRE(replicas[0].isHealthy);
+        REQUIRE(replicas[0].lagMillis == 0);
+
+        for (int i = 0; i < 10; ++i)
+            pgPool.withReadConnection(1000, readSelect);
+        pgPool.withReadConnection(1000, [&sem](shared_ptr<db::BusyConnection> con) {
+            con->executeQuery([&sem,con](db::QueryResult&& qr) {
+                con->release();
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, "SELECT 1");
+        });
+        // stale reads are not allowed, so the pool itself serves it
+        pgPool.withReadConnection(0, readSelect);
+        for (int i = 0; i < 12; ++i)
+            sem.wait();
+        REQUIRE(pgPool.getReplicaStats()[0].reads == 11);
+        REQUIRE(pgPool.getReplicaStats()[0].failedChecks == 0);
+        REQUIRE(pgPool.getPoolStats().primaryReads == 2);
+    }
+
+    SECTION("repeated statements are prepared") {
+        Semaphore sem;
+        auto before = pgPool.getPreparedStatementsStats();
+        for (int i = 0; i < 20; ++i) {
+            pgPool.withConnection([&sem,i](db::BusyConnection& con) {
+                con.executeQuery([&sem,i](db::QueryResult&& qr) {
+                    REQUIRE(db::getIntValue(qr.getValueByIndex(0, 0)) == i);
+                    sem.notify();
+                }, [](const string& errText) {
+                    throw std::runtime_error(errText);
+                }, "SELECT ?::integer;", i);
+            });
+            sem.wait();
+        }
+        auto after = pgPool.getPreparedStatementsStats();
+        // each connection sends the text until the statement is prepared on it
+        REQUIRE(after.prepared > before.prepared);
+        REQUIRE(after.hits - before.hits >= 20 - (long long) pgPool.totalConnections() * db::PREPARE_THRESHOLD);
+
+        // deallocated behind the cache: the statement fails once and is sent as text after it
+        pgPool.withConnection([&sem](db::BusyConnection& con) {
+            con.exec("DEALLOCATE ALL;", [&sem](db::QueryResultsArr& qra) {
+                sem.notify();
+            });
+            con.executeQuery([](db::QueryResult&& qr) {
+            }, [](const string& errText) {
+            }, "SELECT ?::integer;", 1);
+            con.executeQuery([&sem](db::QueryResult&& qr) {
+                REQUIRE(db::getIntValue(qr.getValueByIndex(0, 0)) == 2);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, "SELECT ?::integer;", 2);
+        });
+        sem.wait();
+        sem.wait();
+    }
+
+    SECTION("copyIn and copyOut") {
+        Semaphore sem;
+        const int ROWS_COUNT = 10000;
+        vector<byte_vector> hashes;
+        vector<vector<any>> rows;
+        for (int i = 0; i < ROWS_COUNT; ++i) {
+            hashes.push_back(HashId::createRandom().getDigest());
+            // numbers of any type and numeric strings are converted to the column types
+            rows.push_back({hashes.back(), i, string("0"), (int)getCurrentTimeMillis() / 1000,
+                            i % 2 ? any(getCurrentTimeMillis() / 1000l + i) : any()});
+        }
+        auto t0 = getCurrentTimeMillis();
+        pgPool.withConnection([&sem,&rows,ROWS_COUNT](db::BusyConnection& con) {
+            con.copyIn([&sem,ROWS_COUNT](int rowsCount) {
+                REQUIRE(rowsCount == ROWS_COUNT);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, "table1", {"hash", "state", "locked_by_id", "created_at", "expires_at"}, std::move(rows));
+        });
+        sem.wait();
+        cout << "copyIn " << ROWS_COUNT << " rows: " << getCurrentTimeMillis() - t0 << " ms" << endl;
+
+        pgPool.withConnection([&sem,&hashes,ROWS_COUNT](db::BusyConnection& con) {
+            con.copyOut([&sem,&hashes,ROWS_COUNT](vector<string>& colTypes, vector<vector<db::CopyValue>>& rows) {
+                REQUIRE(colTypes == vector<string>{"bytea", "int4", "int8"});
+                REQUIRE(rows.size() == ROWS_COUNT);
+                for (int i = 0; i < ROWS_COUNT; ++i) {
+                    REQUIRE(rows[i][0] == hashes[i]);
+                    REQUIRE(db::getIntValue(*rows[i][1]) == i);
+                    REQUIRE(rows[i][2].has_value() == (i % 2 == 1));
+                }
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, "table1", {"hash", "state", "expires_at"});
+        });
+        sem.wait();
+
+        // wrong value fails the whole copy
+        pgPool.withConnection([&sem](db::BusyConnection& con) {
+            con.copyIn([](int rowsCount) {
+                throw std::runtime_error("copyIn should fail");
+            }, [&sem](const string& errText) {
+                REQUIRE(errText.find("not an integer") != string::npos);
+                sem.notify();
+            }, "table1", {"hash", "state", "created_at"}, vector<vector<any>>{{byte_vector(16), string("x"), 1}});
+        });
+        sem.wait();
+    }
+
+    SECTION("executeQueryStream") {
+        Semaphore sem;
+        const int ROWS_COUNT = 10000;
+        const int BATCH_SIZE = 256;
+        int batchesCount = 0;
+        long long sum = 0;
+        pgPool.withConnection([&sem,&batchesCount,&sum,ROWS_COUNT,BATCH_SIZE](db::BusyConnection& con) {
+            vector<any> params{ROWS_COUNT};
+            con.executeQueryStream([&batchesCount,&sum,BATCH_SIZE](db::QueryResultsArr& rows) {
+                REQUIRE(rows.size() > 0);
+                REQUIRE(rows.size() <= BATCH_SIZE);
+                for (auto& row: rows)
+                    sum += db::getIntValue(row.getValueView(0, 0));
+                ++batchesCount;
+                return true;
+            }, [&sem,ROWS_COUNT](int rowsCount) {
+                REQUIRE(rowsCount == ROWS_COUNT);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, BATCH_SIZE, "SELECT generate_series(1, ?)", params);
+        });
+        sem.wait();
+        REQUIRE(batchesCount == (ROWS_COUNT + BATCH_SIZE - 1) / BATCH_SIZE);
+        REQUIRE(sum == (long long) ROWS_COUNT * (ROWS_COUNT + 1) / 2);
+
+        // returning false stops the stream and cancels the query, connection is usable after it
+        pgPool.withConnection([&sem](db::BusyConnection& con) {
+            vector<any> params;
+            con.executeQueryStream([](db::QueryResultsArr& rows) {
+                return false;
+            }, [&sem](int rowsCount) {
+                REQUIRE(rowsCount == 100);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, 100, "SELECT generate_series(1, 100000000)", params);
+            con.executeQuery([&sem](db::QueryResult&& qr) {
+                REQUIRE(db::getIntValue(qr.getValueByIndex(0, 0)) == 1);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, "SELECT 1");
+        });
+        sem.wait();
+        sem.wait();
+
+        pgPool.withConnection([&sem](db::BusyConnection& con) {
+            vector<any> params;
+            con.executeQueryStream([](db::QueryResultsArr& rows) {
+                return true;
+            }, [](int rowsCount) {
+                throw std::runtime_error("executeQueryStream should fail");
+            }, [&sem](const string& errText) {
+                sem.notify();
+            }, 100, "SELECT * FROM missing_table", params);
+        });
+        sem.wait();
+    }
+
+    SECTION("executeQueryStreamAsync") {
+        Semaphore sem;
+        std::atomic<int> batchesCount = 0;
+        std::atomic<bool> isProcessing = false;
+        // batches are processed in another thread, next one is not read until resumeStream, and onDone comes
+        // after the last one is processed
+        pgPool.withConnection([&sem,&batchesCount,&isProcessing](db::BusyConnection& con) {
+            vector<any> params{1000};
+            con.executeQueryStreamAsync([&con,&batchesCount,&isProcessing](db::QueryResultsArr& rows, int batchId) {
+                REQUIRE(!isProcessing.exchange(true));
+                REQUIRE(rows.size() == 100);
+                ++batchesCount;
+                std::thread([&con,&isProcessing,batchId]() {
+                    std::this_thread::sleep_for(10ms);
+                    isProcessing = false;
+                    con.resumeStream(batchId, true);
+                }).detach();
+            }, [&sem,&isProcessing](int rowsCount) {
+                REQUIRE(!isProcessing);
+                REQUIRE(rowsCount == 1000);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, 100, "SELECT generate_series(1, ?)", params);
+        });
+        sem.wait();
+        REQUIRE(batchesCount == 10);
+
+        batchesCount = 0;
+        pgPool.withConnection([&sem,&batchesCount](db::BusyConnection& con) {
+            vector<any> params;
+            con.executeQueryStreamAsync([&con,&batchesCount](db::QueryResultsArr& rows, int batchId) {
+                std::thread([&con,batchId,isNeeded = ++batchesCount < 3]() {
+                    con.resumeStream(batchId, isNeeded);
+                }).detach();
+            }, [&sem](int rowsCount) {
+                REQUIRE(rowsCount == 300);
+                sem.notify();
+            }, [](const string& errText) {
+                throw std::runtime_error(errText);
+            }, 100, "SELECT generate_series(1, 100000000)", params);
+        });
+        sem.wait();
+        REQUIRE(batchesCount == 3);
+    }
+
+}
+
+TEST_CASE("PGPool_copyRows") {
+    int i = 0;
+    int rowsCount = 0;
+    auto data = db::encodeCopyRows({"int4", "int8", "bytea", "text", "float8", "bool", "int2"}, [&i](vector<any>& row) {
+        if (i == 3)
+            return false;
+        row.push_back(i);
+        row.push_back(i == 1 ? any() : any(string("-") + std::to_string(i)));
+        row.push_back(byte_vector(i, 7));
+        row.push_back(std::to_string(i));
+        row.push_back(i + 0.5);
+        row.push_back(i % 2 == 1);
+        row.push_back(1000.0);
+        ++i;
+        return true;
+    }, rowsCount);
+    REQUIRE(rowsCount == 3);
+    auto rows = db::decodeCopyRows(data);
+    REQUIRE(rows.size() == 3);
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(rows[i].size() == 7);
+        REQUIRE(db::getIntValue(*rows[i][0]) == i);
+        if (i == 1)
+            REQUIRE(!rows[i][1].has_value());
+        else
+            REQUIRE(db::getLongValue(*rows[i][1]) == -i);
+        // empty bytea of the first row is not NULL
+        REQUIRE(rows[i][2] == byte_vector(i, 7));
+        REQUIRE(db::getStringValue(*rows[i][3]) == std::to_string(i));
+        REQUIRE(db::getDoubleValue(*rows[i][4]) == i + 0.5);
+        REQUIRE(db::getBoolValue(*rows[i][5]) == (i % 2 == 1));
+        REQUIRE(db::getInt16Value(*rows[i][6]) == 1000);
+    }
+
+    REQUIRE_THROWS_AS(db::encodeCopyRows({"numeric"}, [](vector<any>& row) {return false;}, rowsCount), std::invalid_argument);
+    data.pop_back();
+    REQUIRE_THROWS_AS(db::decodeCopyRows(data), std::invalid_argument);
+}
+
+TEST_CASE("PGPool_getNumericValue") {
+    auto numeric = [](vector<short> words) {
+        string res;
+        for (short w: words) {
+            short be = htobe16(w);
+            res.append((const char*) &be, 2);
+        }
+        return res;
+    };
+    // ndigits, weight, sign, dscale, then base 10000 digits
+    REQUIRE(db::getNumericValue(numeric({0, 0, 0, 0})) == "0");
+    REQUIRE(db::getNumericValue(numeric({2, 1, 0, 0, 12, 3456})) == "123456");
+    REQUIRE(db::getNumericValue(numeric({2, 0, 0x4000, 4, 12, 3400})) == "-12.3400");
+    REQUIRE(db::getNumericValue(numeric({1, -2, 0, 8, 5})) == "0.00000005");
+    REQUIRE(db::getNumericValue(numeric({1, 2, 0, 1, 7})) == "700000000.0");
+    REQUIRE(db::getNumericValue(numeric({0, 0, (short) 0xC000, 0})) == "NaN");
+    REQUIRE_THROWS(db::getNumericValue(numeric({2, 0, 0, 0, 1})));
 }
 
 TEST_CASE("PGPool_replacePlaceholders") {
@@ -115,3 +115,52 @@ AutoThreadPool::Blocker::~Blocker() {
 
 
 
+
+void parallelFor(size_t count, const function<void(size_t)> &block, size_t maxThreads) {
+    if (maxThreads == 0)
+        maxThreads = thread::hardware_concurrency();
+    size_t helpersCount = count > 1 ? min(count, max(maxThreads, (size_t) 1)) - 1 : 0;
+
+    // helpers may start after all calls are done, so they share the state with the caller
+    struct State {
+        const function<void(size_t)> *block;
+        size_t count;
+        atomic<size_t> next = 0;
+        mutex mx;
+        condition_variable cvDone;
+        size_t done = 0;
+        exception_ptr error;
+    };
+    auto state = make_shared<State>();
+    state->block = &block;
+    state->count = count;
+
+    auto work = [state]() {
+        size_t processed = 0;
+        for (size_t i = state->next++; i < state->count; i = state->next++) {
+            try {
+                (*state->block)(i);
+            } catch (...) {
+                lock_guard lock(state->mx);
+                if (!state->error)
+                    state->error = current_exception();
+            }
+            ++processed;
+        }
+        if (processed > 0) {
+            lock_guard lock(state->mx);
+            state->done += processed;
+            if (state->done == state->count)
+                state->cvDone.notify_all();
+        }
+    };
+
+    for (size_t i = 0; i < helpersCount; ++i)
+        AutoThreadPool::defaultPool(work);
+    work();
+
+    unique_lock lock(state->mx);
+    state->cvDone.wait(lock, [&]() { return state->done == state->count; });
+    if (state->error)
+        rethrow_exception(state->error);
+}
@@ -10,6 +10,8 @@
 #include <thread>
 #include <set>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "Queue.h"
 #include "tools.h"
 
@@ -244,4 +246,18 @@ inline void runAsync(Function &f) {
     AutoThreadPool::defaultPool(f);
 }
 
+/**
+ * Call block(i) for every i in [0, count) in parallel, using the calling thread and up to maxThreads - 1 threads of
+ * the default pool, and return when all calls are done. 0 maxThreads means hardware concurrency.
+ *
+ * Indexes are taken one by one, so calls may take different time. As the calling thread does its share of work and
+ * waits only for calls already started by others, it is safe to use it from tasks of the pool itself. If some calls
+ * throw, the first exception is rethrown when all calls are done.
+ *
+ * @param count number of calls
+ * @param block to call with each index
+ * @param maxThreads maximum number of threads to use
+ */
+void parallelFor(size_t count, const function<void(size_t)> &block, size_t maxThreads = 0);
+
 #endif
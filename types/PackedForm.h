@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_PACKEDFORM_H
+#define U8_PACKEDFORM_H
+
+#include "UObject.h"
+
+/**
+ * Packed form of a container (UBinder or UArray) unpacked from BOSS: the slice of source bytes it was read from.
+ *
+ * Containers keep it while they are not modified, so packing the same subtree again copies the slice instead of
+ * encoding it. Modifying methods (set, insert, erase, push_back...) drop the packed form, reads don't, so a shared
+ * tree can be read from several threads. Values replaced in place through references returned by non-const
+ * accessors (operator[], get(), iterators) are not tracked: call setPackedForm(PackedForm()) after that. The slice
+ * holds a reference to the whole source buffer.
+ */
+class PackedForm {
+public:
+    PackedForm() = default;
+
+    PackedForm(const UObject& source, const unsigned char* data, unsigned int size, unsigned int objects)
+    : source(source), data(data), size(size), objects(objects) {}
+
+    bool empty() const {
+        return data == nullptr;
+    }
+
+    void reset() {
+        if (data != nullptr)
+            *this = PackedForm();
+    }
+
+    // UBytes owning the slice
+    UObject source;
+    const unsigned char* data = nullptr;
+    unsigned int size = 0;
+    // number of strings, binaries and containers in the slice, including the container itself
+    unsigned int objects = 0;
+};
+
+#endif //U8_PACKEDFORM_H
@@ -5,11 +5,11 @@
 #include "TestComplexObject.h"
 
 TestComplexObject::UTestComplexObjectData::UTestComplexObjectData()
-:  name(""), amount(0) {
+: UData(UType::TestComplexObject), name(""), amount(0) {
 }
 
 TestComplexObject::UTestComplexObjectData::UTestComplexObjectData(const std::string& name, int64_t amount)
-:  name(name), amount(amount) {
+: UData(UType::TestComplexObject), name(name), amount(amount) {
 }
 
 TestComplexObject::TestComplexObject()
@@ -21,18 +21,18 @@ TestComplexObject::TestComplexObject(const std::string& name, int64_t amount)
 }
 
 bool TestComplexObject::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UTestComplexObjectData>();
+    return object.type() == UType::TestComplexObject;
 }
 
 TestComplexObject& TestComplexObject::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UTestComplexObjectData>())
+    if(object.type() != UType::TestComplexObject)
         throw std::invalid_argument("object is not instance of TestComplexObject");
 
     return (TestComplexObject&) object;
 }
 
 const TestComplexObject& TestComplexObject::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UTestComplexObjectData>())
+    if(object.type() != UType::TestComplexObject)
         throw std::invalid_argument("object is not instance of TestComplexObject");
 
     return (const TestComplexObject&) object;
@@ -49,53 +49,53 @@ UArray UArray::filter(std::function<bool(const UObject&)> predicate) const {
 }
 
 std::insert_iterator<std::vector<UObject>> UArray::endInserter() {
-    return std::inserter(data<UArrayData>().array,end());
+    return std::inserter(mutableData().array,end());
 }
 
 void UArray::swap(UArray other) {
-    data<UArrayData>().array.swap(other.data<UArrayData>().array);
+    mutableData().array.swap(other.mutableData().array);
 }
 
 void UArray::resize(UArray::size_type count, const UArray::value_type &value) {
-    data<UArrayData>().array.resize(count,value);
+    mutableData().array.resize(count,value);
 }
 
 void UArray::resize(UArray::size_type count) {
-    data<UArrayData>().array.resize(count);
+    mutableData().array.resize(count);
 }
 
 void UArray::pop_back() {
-    data<UArrayData>().array.pop_back();
+    mutableData().array.pop_back();
 }
 
 void UArray::push_back(UObject &&value) {
-    data<UArrayData>().array.push_back(value);
+    mutableData().array.push_back(value);
 }
 
 void UArray::push_back(const UObject &value) {
-    data<UArrayData>().array.push_back(value);
+    mutableData().array.push_back(value);
 }
 
 UArray::iterator UArray::erase(UArray::const_iterator first, UArray::const_iterator last) {
-    return data<UArrayData>().array.erase(first,last);
+    return mutableData().array.erase(first,last);
 }
 
 UArray::iterator UArray::erase(UArray::const_iterator pos) {
-    return data<UArrayData>().array.erase(pos);
+    return mutableData().array.erase(pos);
 }
 
 template<class... Args>
 UArray::iterator UArray::emplace(UArray::const_iterator pos, Args &&... args) {
-    return data<UArrayData>().array.emplace(pos,args...);
+    return mutableData().array.emplace(pos,args...);
 }
 
 template<class... Args>
 void UArray::emplace_back(Args &&... args) {
-    data<UArrayData>().array.emplace_back(args...);
+    mutableData().array.emplace_back(args...);
 }
 
 void UArray::clear() noexcept {
-    data<UArrayData>().array.clear();
+    mutableData().array.clear();
 }
 
 void UArray::shrink_to_fit() {
@@ -203,25 +203,25 @@ UObject &UArray::at(UArray::size_type pos) {
 }
 
 UArray::iterator UArray::insert(UArray::const_iterator pos, std::initializer_list<UObject> ilist) {
-    return data<UArrayData>().array.insert(pos,ilist);
+    return mutableData().array.insert(pos,ilist);
 }
 
 UArray::iterator UArray::insert(UArray::const_iterator pos, const UObject &value) {
-    return data<UArrayData>().array.insert(pos,value);
+    return mutableData().array.insert(pos,value);
 }
 
 UArray::iterator UArray::insert(UArray::const_iterator pos, UObject &&value) {
-    return data<UArrayData>().array.insert(pos,value);
+    return mutableData().array.insert(pos,value);
 }
 
 UArray::iterator UArray::insert(UArray::const_iterator pos, UArray::size_type count, const UObject &value) {
-    return data<UArrayData>().array.insert(pos,count, value);
+    return mutableData().array.insert(pos,count, value);
 }
 
 //template<class InputIt>
 //UArray::iterator UArray::insert(UArray::const_iterator pos, InputIt first, InputIt last) {
 UArray::iterator UArray::insert(UArray::const_iterator pos, UArray::const_iterator first, UArray::const_iterator last) {
-    return data<UArrayData>().array.insert(pos,first, last);
+    return mutableData().array.insert(pos,first, last);
 }
 
 UArray::UArray(std::initializer_list<UObject> ilist) : UObject(std::make_shared<UArrayData>(ilist)) {
@@ -233,14 +233,14 @@ UArray::UArray() : UObject(std::make_shared<UArrayData>()) {
 }
 
 bool UArray::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UArrayData>();
+    return object.type() == UType::Array;
 }
 
-UArray::UArrayData::UArrayData(std::initializer_list<UObject> ilist) :  array(ilist) {
+UArray::UArrayData::UArrayData(std::initializer_list<UObject> ilist) : UData(UType::Array), array(ilist) {
 
 }
 
-UArray::UArrayData::UArrayData()  {
+UArray::UArrayData::UArrayData() : UData(UType::Array) {
 
 }
 
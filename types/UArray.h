@@ -8,6 +8,7 @@
 #include <string>
 #include <memory>
 #include "UObject.h"
+#include "PackedForm.h"
 #include <vector>
 #include <functional>
 
@@ -41,12 +42,30 @@ class UArray : public UObject {
         }
 
         std::vector<UObject> array;
+        PackedForm packed;
     };
 
+    UArrayData& mutableData() {
+        UArrayData& d = data<UArrayData>();
+        d.packed.reset();
+        return d;
+    }
+
 public:
 
     static bool isInstance(const UObject& object);
 
+    /**
+     * Packed form the array was unpacked from, or empty if it was created otherwise or modified since.
+     */
+    const PackedForm& packedForm() const {
+        return data<UArrayData>().packed;
+    }
+
+    void setPackedForm(const PackedForm& form) {
+        data<UArrayData>().packed = form;
+    }
+
 
     typedef  std::vector<UObject>::reverse_iterator reverse_iterator;
     typedef  std::vector<UObject>::const_reverse_iterator const_reverse_iterator;
@@ -61,14 +80,14 @@ class UArray : public UObject {
     UArray();
 
     static UArray& asInstance(UObject& object) {
-        if(!object.dataIsInstanceOf<UArrayData>())
+        if(object.type() != UType::Array)
             throw std::invalid_argument("object is not instance of UDouble");
 
         return (UArray&)object;
     }
 
     static const UArray& asInstance(const UObject& object) {
-        if(!object.dataIsInstanceOf<UArrayData>())
+        if(object.type() != UType::Array)
             throw std::invalid_argument("object is not instance of UDouble");
 
         return (const UArray&)object;
@@ -53,31 +53,37 @@ UBinder UBinder::filter(std::function<bool (const std::string& key, const UObjec
     return result;
 }
 
-std::insert_iterator<std::map<std::string,UObject>> UBinder::endInserter() {
-    return std::inserter(data<UBinderData>().binder,end());
+static bool keyLess(const UBinder::value_type& entry, const std::string& key) {
+    return entry.first.compare(key) < 0;
+}
+
+static bool keyGreater(const std::string& key, const UBinder::value_type& entry) {
+    return entry.first.compare(key) > 0;
+}
+
+UBinder::Inserter UBinder::endInserter() {
+    return Inserter(*this);
 }
 
 void UBinder::swap(UBinder other) {
-    data<UBinderData>().binder.swap(other.data<UBinderData>().binder);
+    mutableData().binder.swap(other.mutableData().binder);
 }
 
 UBinder::iterator UBinder::erase(UBinder::const_iterator first, UBinder::const_iterator last) {
-    return data<UBinderData>().binder.erase(first,last);
+    return mutableData().binder.erase(first,last);
 }
 
 UBinder::iterator UBinder::erase(UBinder::const_iterator pos) {
-    return data<UBinderData>().binder.erase(pos);
-}
-
-template<class... Args>
-UBinder::iterator UBinder::emplace(UBinder::const_iterator pos, Args &&... args) {
-    return data<UBinderData>().binder.emplace(pos,args...);
+    return mutableData().binder.erase(pos);
 }
 
 void UBinder::clear() noexcept {
-    data<UBinderData>().binder.clear();
+    mutableData().binder.clear();
 }
 
+void UBinder::reserve(UBinder::size_type n) {
+    data<UBinderData>().binder.reserve(n);
+}
 
 UBinder::size_type UBinder::max_size() const noexcept {
     return data<UBinderData>().binder.max_size();
@@ -152,121 +158,97 @@ UBinder::UBinder() : UObject(std::make_shared<UBinderData>()) {
 }
 
 bool UBinder::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UBinderData>();
-}
-
-template<class K>
-UBinder::const_iterator UBinder::upper_bound(const K &x) const {
-    return data<UBinderData>().binder.upper_bound(x);
-}
-
-template<class K>
-UBinder::iterator UBinder::upper_bound(const K &x) {
-    return data<UBinderData>().binder.upper_bound(x);
+    return object.type() == UType::Binder;
 }
 
 UBinder::const_iterator UBinder::upper_bound(const std::string &key) const {
-    return data<UBinderData>().binder.upper_bound(key);
+    auto& binder = data<UBinderData>().binder;
+    return std::upper_bound(binder.cbegin(), binder.cend(), key, keyGreater);
 }
 
 UBinder::iterator UBinder::upper_bound(const std::string &key) {
-    return data<UBinderData>().binder.upper_bound(key);
-}
-
-template<class K>
-UBinder::const_iterator UBinder::lower_bound(const K &x) const {
-    return data<UBinderData>().binder.lower_bound(x);
-}
-
-template<class K>
-UBinder::iterator UBinder::lower_bound(const K &x) {
-    return data<UBinderData>().binder.lower_bound(x);
+    auto& binder = data<UBinderData>().binder;
+    return std::upper_bound(binder.begin(), binder.end(), key, keyGreater);
 }
 
 UBinder::const_iterator UBinder::lower_bound(const std::string &key) const {
-    return data<UBinderData>().binder.lower_bound(key);
+    auto& binder = data<UBinderData>().binder;
+    return std::lower_bound(binder.cbegin(), binder.cend(), key, keyLess);
 }
 
 UBinder::iterator UBinder::lower_bound(const std::string &key) {
-    return data<UBinderData>().binder.lower_bound(key);
-}
-
-template<class K>
-std::pair<UBinder::const_iterator, UBinder::const_iterator> UBinder::equal_range(const K &x) const {
-    return data<UBinderData>().binder.equal_range(x);
-}
-
-template<class K>
-std::pair<UBinder::iterator, UBinder::iterator> UBinder::equal_range(const K &x) {
-    return data<UBinderData>().binder.equal_range(x);
+    auto& binder = data<UBinderData>().binder;
+    return std::lower_bound(binder.begin(), binder.end(), key, keyLess);
 }
 
 std::pair<UBinder::const_iterator, UBinder::const_iterator> UBinder::equal_range(const std::string &key) const {
-    return data<UBinderData>().binder.equal_range(key);
+    auto it = find(key);
+    return std::make_pair(it, it == cend() ? it : it + 1);
 }
 
 std::pair<UBinder::iterator, UBinder::iterator> UBinder::equal_range(const std::string &key) {
-    return data<UBinderData>().binder.equal_range(key);
-}
-
-template<class K>
-UBinder::const_iterator UBinder::find(const K &x) const {
-    return  data<UBinderData>().binder.find(x);
-}
-
-template<class K>
-UBinder::iterator UBinder::find(const K &x) {
-    return data<UBinderData>().binder.find(x);
+    auto it = find(key);
+    return std::make_pair(it, it == end() ? it : it + 1);
 }
 
 UBinder::const_iterator UBinder::find(const std::string &key) const {
-    return data<UBinderData>().binder.find(key);
+    auto it = lower_bound(key);
+    if (it != cend() && it->first == key)
+        return it;
+    return cend();
 }
 
 UBinder::iterator UBinder::find(const std::string &key) {
-    return data<UBinderData>().binder.find(key);
-}
-
-template<class K>
-UBinder::size_type UBinder::count(const K &x) const {
-    return data<UBinderData>().binder.count(x);
+    auto it = lower_bound(key);
+    if (it != end() && it->first == key)
+        return it;
+    return end();
 }
 
 UBinder::size_type UBinder::count(const std::string &key) const {
-    return data<UBinderData>().binder.count(key);
+    return find(key) != cend() ? 1 : 0;
 }
 
 void UBinder::insert(std::initializer_list<UBinder::value_type> ilist) {
-    return data<UBinderData>().binder.insert(ilist);
+    for (auto& value: ilist)
+        insert(value);
 }
 
 void UBinder::insert(const_iterator first, const_iterator last) {
-    return data<UBinderData>().binder.insert(first,last);
-}
-
-template<class P>
-UBinder::iterator UBinder::insert(UBinder::const_iterator hint, P &&value) {
-    return data<UBinderData>().binder.insert(hint,value);
+    for (auto it = first; it != last; it++)
+        insert(*it);
 }
 
 UBinder::iterator UBinder::insert(UBinder::const_iterator hint, const UBinder::value_type &value) {
-    return data<UBinderData>().binder.insert(hint,value);
-}
-
-template<class P>
-std::pair<UBinder::iterator, bool> UBinder::insert(P &&value) {
-    return data<UBinderData>().binder.insert(value);
+    return insert(value).first;
 }
 
 std::pair<UBinder::iterator, bool> UBinder::insert(const UBinder::value_type &value) {
-    return data<UBinderData>().binder.insert(value);
-}
+    auto& binder = mutableData().binder;
+
+    // keys usually come already sorted (unpacking, copying other binder), so try appending first
+    if (binder.empty() || binder.back().first < value.first) {
+        binder.push_back(value);
+        return std::make_pair(binder.end() - 1, true);
+    }
+
+    auto it = std::lower_bound(binder.begin(), binder.end(), value.first.str(), keyLess);
+    if (it != binder.end() && it->first == value.first)
+        return std::make_pair(it, false);
 
-UBinder::UBinderData::UBinderData(std::initializer_list<UBinder::value_type> ilist) :  binder(ilist) {
+    return std::make_pair(binder.insert(it, value), true);
+}
 
+UBinder::UBinderData::UBinderData(std::initializer_list<UBinder::value_type> ilist) : UData(UType::Binder) {
+    binder.reserve(ilist.size());
+    for (auto& value: ilist) {
+        auto it = std::lower_bound(binder.begin(), binder.end(), value.first.str(), keyLess);
+        if (it == binder.end() || it->first != value.first)
+            binder.insert(it, value);
+    }
 }
 
-UBinder::UBinderData::UBinderData()   {
+UBinder::UBinderData::UBinderData() : UData(UType::Binder) {
 
 }
 
@@ -345,14 +327,14 @@ template <typename T> T& UBinder::getOrNull(const std::string& key) {
 }
 
 UBinder &UBinder::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UBinderData>())
+    if(object.type() != UType::Binder)
         throw std::invalid_argument("object is not instance of UBinder");
 
     return (UBinder&)object;
 }
 
 const UBinder &UBinder::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UBinderData>())
+    if(object.type() != UType::Binder)
         throw std::invalid_argument("object is not instance of UBinder");
 
     return (const UBinder&)object;
@@ -361,11 +343,18 @@ const UBinder &UBinder::asInstance(const UObject &object) {
 
 
 void UBinder::set(const std::string& key, const UObject& value) {
-    UBinder::value_type pair(key, value);
-    auto result = insert(pair);
-    if(!result.second) {
-        std::swap(result.first->second,pair.second);
+    auto& binder = mutableData().binder;
+
+    if (binder.empty() || binder.back().first.compare(key) < 0) {
+        binder.emplace_back(key, value);
+        return;
     }
+
+    auto it = lower_bound(key);
+    if (it != binder.end() && it->first == key)
+        it->second = value;
+    else
+        binder.emplace(it, key, value);
 }
 
 void UBinder::set(const std::string& key, double value) {
@@ -9,16 +9,56 @@
 #include <memory>
 #include <algorithm>
 #include "UObject.h"
-#include <map>
+#include "PackedForm.h"
+#include "UKey.h"
+#include <vector>
+#include <iterator>
 #include <functional>
 class UArray;
 
+/**
+ * Key of a UBinder entry. Entries are sorted by their keys, so, like the key of std::map, it can't be assigned.
+ */
+class UBinderKey : public UKey {
+public:
+    UBinderKey(const UKey& key) : UKey(key) {}
+    UBinderKey(const UBinderKey&) = default;
+    UBinderKey(UBinderKey&&) = default;
+    UBinderKey& operator=(const UBinderKey&) = delete;
+    UBinderKey& operator=(UBinderKey&&) = delete;
+};
+
+/**
+ * Entry of UBinder, used as std::map entry: the value can be changed in place, the key can't.
+ */
+struct UBinderEntry {
+    UBinderEntry(const UKey& key, const UObject& value) : first(key), second(value) {}
+    UBinderEntry(const UBinderEntry&) = default;
+    UBinderEntry(UBinderEntry&&) = default;
+
+    // only for the storage, that moves entries when it inserts or erases
+    UBinderEntry& operator=(const UBinderEntry& other) {
+        static_cast<UKey&>(first) = other.first;
+        second = other.second;
+        return *this;
+    }
+
+    UBinderEntry& operator=(UBinderEntry&& other) {
+        static_cast<UKey&>(first) = std::move(other.first);
+        second = std::move(other.second);
+        return *this;
+    }
+
+    UBinderKey first;
+    UObject second;
+};
+
 class UBinder : public UObject {
 
 private:
     class UBinderData : public UData {
     public:
-        UBinderData(std::initializer_list<std::map<std::string, UObject>::value_type> ilist);
+        UBinderData(std::initializer_list<UBinderEntry> ilist);
         UBinderData();
         ~UBinderData() override;
 
@@ -42,9 +82,20 @@ class UBinder : public UObject {
             }
         }
 
-        std::map<std::string, UObject> binder;
+        /**
+         * Entries sorted by key, so iteration order (and packed BOSS form) is the same as of std::map,
+         * while small binders cost one allocation instead of one per node.
+         */
+        std::vector<UBinderEntry> binder;
+        PackedForm packed;
     };
 
+    UBinderData& mutableData() {
+        UBinderData& d = data<UBinderData>();
+        d.packed.reset();
+        return d;
+    }
+
     template <typename T> const T& get(const std::string& key) const;
     template <typename T> T& get(const std::string& key);
     template <typename T> const T& getOrNull(const std::string& key) const;
@@ -53,6 +104,10 @@ class UBinder : public UObject {
 
 public:
 
+    /**
+     * Unlike with std::map, references returned by get() and iterators don't survive set() or insert() of a new key
+     * and erase(), as entries are kept in one vector. Copy the value if it is needed after the binder is changed.
+     */
     const UObject& get(const std::string& key) const;
     UObject& get(const std::string& key);
 
@@ -76,6 +131,18 @@ class UBinder : public UObject {
 
 
     static bool isInstance(const UObject& object);
+
+    /**
+     * Packed form the binder was unpacked from, or empty if it was created otherwise or modified since.
+     */
+    const PackedForm& packedForm() const {
+        return data<UBinderData>().packed;
+    }
+
+    void setPackedForm(const PackedForm& form) {
+        data<UBinderData>().packed = form;
+    }
+
     static UBinder& asInstance(UObject& object);
 
     static const UBinder& asInstance(const UObject& object);
@@ -119,14 +186,40 @@ class UBinder : public UObject {
      * FROM std::map BEGIN
      */
 
-    typedef  std::map<std::string,UObject>::reverse_iterator reverse_iterator;
-    typedef  std::map<std::string,UObject>::const_reverse_iterator const_reverse_iterator;
-    typedef  std::map<std::string,UObject>::iterator iterator;
-    typedef  std::map<std::string,UObject>::const_iterator const_iterator;
-    typedef  std::map<std::string,UObject>::size_type size_type;
-    typedef  std::map<std::string,UObject>::reference reference;
-    typedef  std::map<std::string,UObject>::const_reference const_reference;
-    typedef  std::map<std::string,UObject>::value_type value_type;
+    typedef  std::vector<UBinderEntry>::reverse_iterator reverse_iterator;
+    typedef  std::vector<UBinderEntry>::const_reverse_iterator const_reverse_iterator;
+    typedef  std::vector<UBinderEntry>::iterator iterator;
+    typedef  std::vector<UBinderEntry>::const_iterator const_iterator;
+    typedef  std::vector<UBinderEntry>::size_type size_type;
+    typedef  std::vector<UBinderEntry>::reference reference;
+    typedef  std::vector<UBinderEntry>::const_reference const_reference;
+    typedef  std::vector<UBinderEntry>::value_type value_type;
+
+    /**
+     * Output iterator inserting values into the binder, like std::insert_iterator does for std::map.
+     */
+    class Inserter {
+    public:
+        typedef std::output_iterator_tag iterator_category;
+        typedef void value_type;
+        typedef void difference_type;
+        typedef void pointer;
+        typedef void reference;
+
+        explicit Inserter(UBinder& binder) : binder(&binder) {}
+
+        Inserter& operator=(const UBinder::value_type& value) {
+            binder->insert(value);
+            return *this;
+        }
+
+        Inserter& operator*() { return *this; }
+        Inserter& operator++() { return *this; }
+        Inserter& operator++(int) { return *this; }
+
+    private:
+        UBinder* binder;
+    };
 
 
     UBinder();
@@ -168,8 +261,10 @@ class UBinder : public UObject {
 
     void clear() noexcept;
 
-    template< class... Args >
-    iterator emplace( const_iterator pos, Args&&... args );
+    /**
+     * Preallocate storage for n entries. Useful when number of keys is known beforehand, e.g. when unpacking.
+     */
+    void reserve(size_type n);
 
     iterator erase( const_iterator pos );
 
@@ -178,13 +273,8 @@ class UBinder : public UObject {
     void swap( UBinder other );
 
     std::pair<iterator,bool> insert( const value_type& value );
-    template< class P >
-    std::pair<iterator,bool> insert( P&& value );
-    iterator insert( const_iterator hint, const value_type& value );
-
-    template< class P >
-    iterator insert( const_iterator hint, P&& value );
 
+    iterator insert( const_iterator hint, const value_type& value );
 
     void insert( const_iterator first, const_iterator last );
 
@@ -192,49 +282,23 @@ class UBinder : public UObject {
 
     size_type count( const std::string& key ) const;
 
-    template< class K >
-    size_type count( const K& x ) const;
-
     iterator find( const std::string& key );
 
     const_iterator find( const std::string& key ) const;
 
-    template< class K > iterator find( const K& x );
-
-    template< class K > const_iterator find( const K& x ) const;
-
-
     std::pair<iterator,iterator> equal_range( const std::string& key );
 
     std::pair<const_iterator,const_iterator> equal_range( const std::string& key ) const;
 
-    template< class K >
-    std::pair<iterator,iterator> equal_range( const K& x );
-
-    template< class K >
-    std::pair<const_iterator,const_iterator> equal_range( const K& x ) const;
-
     iterator lower_bound( const std::string& key );
 
     const_iterator lower_bound( const std::string& key ) const;
 
-    template< class K >
-    iterator lower_bound(const K& x);
-
-    template< class K >
-    const_iterator lower_bound(const K& x) const;
-
     iterator upper_bound( const std::string& key );
 
     const_iterator upper_bound( const std::string& key ) const;
 
-    template< class K >
-    iterator upper_bound( const K& x );
-
-    template< class K >
-    const_iterator upper_bound( const K& x ) const;
-
-    std::insert_iterator<std::map<std::string,UObject>> endInserter();
+    Inserter endInserter();
 
     /*
      * FROM std::map END
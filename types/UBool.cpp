@@ -4,33 +4,29 @@
 
 #include "UBool.h"
 
-UBool::UBoolData::UBoolData(bool v)  {
-    value = v;
-}
-
 bool UBool::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UBoolData>();
+    return object.type() == UType::Bool;
 }
 
 UBool &UBool::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UBoolData>())
+    if(object.type() != UType::Bool)
         throw std::invalid_argument("object is not instance of UBool");
 
     return (UBool&)object;
 }
 
 const UBool &UBool::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UBoolData>())
+    if(object.type() != UType::Bool)
         throw std::invalid_argument("object is not instance of UBool");
 
     return (const UBool&)object;
 }
 
 
-UBool::UBool(bool value) : UObject(std::make_shared<UBoolData>(value)) {
+UBool::UBool(bool value) : UObject(UType::Bool, value) {
 
 }
 
 bool UBool::get() const {
-    return data<UBoolData>().value;
+    return inlineBool();
 }
@@ -10,23 +10,6 @@
 #include "UObject.h"
 
 class UBool : public UObject {
-private:
-    class UBoolData : public UData {
-    public:
-        UBoolData(bool v);
-        ~UBoolData() = default;
-
-        Local<Object> serializeToV8(Local<Context> cxt, shared_ptr<Scripter> scripter) override {
-            return Local<Object>::Cast(Boolean::New(scripter->isolate(), value));
-        }
-
-        void dbgPrint(std::string prefix) override {
-            printf("%s\n", value?"true":"false");
-        }
-
-        bool value;
-    };
-
 public:
     static bool isInstance(const UObject& object);
 
@@ -6,28 +6,28 @@
 #include "UBytes.h"
 
 
-UBytes::UBytesData::UBytesData(const unsigned char* v, unsigned int size)   {
+UBytes::UBytesData::UBytesData(const unsigned char* v, unsigned int size) : UData(UType::Bytes) {
     value.assign(v,v+size);
 }
 
-UBytes::UBytesData::UBytesData()  {
+UBytes::UBytesData::UBytesData() : UData(UType::Bytes) {
 
 }
 
 
 bool UBytes::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UBytesData>();
+    return object.type() == UType::Bytes;
 }
 
 UBytes &UBytes::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UBytesData>())
+    if(object.type() != UType::Bytes)
         throw std::invalid_argument("object is not instance of UBytes");
 
     return (UBytes&)object;
 }
 
 const UBytes &UBytes::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UBytesData>())
+    if(object.type() != UType::Bytes)
         throw std::invalid_argument("object is not instance of UBytes");
 
     return (const UBytes&)object;
@@ -4,32 +4,28 @@
 
 #include "UDateTime.h"
 
-UDateTime::UDateTimeData::UDateTimeData(const TimePoint & v)  {
-    value = v;
-}
-
 bool UDateTime::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UDateTimeData>();
+    return object.type() == UType::DateTime;
 }
 
 UDateTime &UDateTime::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UDateTimeData>())
+    if(object.type() != UType::DateTime)
         throw std::invalid_argument("object is not instance of UDateTime");
 
     return (UDateTime&)object;
 }
 
 const UDateTime &UDateTime::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UDateTimeData>())
+    if(object.type() != UType::DateTime)
         throw std::invalid_argument("object is not instance of UDateTime");
 
     return (const UDateTime&)object;
 }
 
-UDateTime::UDateTime(const TimePoint& value) : UObject(std::make_shared<UDateTimeData>(value)) {
+UDateTime::UDateTime(const TimePoint& value) : UObject(UType::DateTime, (int64_t) value.time_since_epoch().count()) {
 
 }
 
-const TimePoint& UDateTime::get() const {
-    return data<UDateTimeData>().value;
+TimePoint UDateTime::get() const {
+    return TimePoint(TimePoint::duration(inlineInt()));
 }
@@ -14,23 +14,6 @@
 typedef std::chrono::time_point<std::chrono::high_resolution_clock> TimePoint;
 
 class UDateTime : public UObject {
-private:
-    class UDateTimeData : public UData {
-    public:
-        UDateTimeData(const TimePoint &v);
-        ~UDateTimeData() override = default;
-
-        Local<Object> serializeToV8(Local<Context> cxt, shared_ptr<Scripter> scripter) override {
-            return Local<Object>::Cast(Date::New(scripter->isolate()->GetCurrentContext(), double(value.time_since_epoch().count()*1e-6)).ToLocalChecked());
-        }
-
-        void dbgPrint(std::string prefix) override {
-            cout << "DateTime=" << value.time_since_epoch().count() << endl;
-        }
-
-        TimePoint value;
-    };
-
 public:
     static bool isInstance(const UObject& object);
 
@@ -41,7 +24,7 @@ class UDateTime : public UObject {
 
     UDateTime(const TimePoint& value);
 
-    const TimePoint& get() const;
+    TimePoint get() const;
 };
 
 
@@ -4,33 +4,29 @@
 
 #include "UDouble.h"
 
-UDouble::UDoubleData::UDoubleData(double v)  {
-    value = v;
-}
-
 bool UDouble::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UDoubleData>();
+    return object.type() == UType::Double;
 }
 
 UDouble &UDouble::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UDoubleData>())
+    if(object.type() != UType::Double)
         throw std::invalid_argument("object is not instance of UDouble");
 
     return (UDouble&)object;
 }
 
 const UDouble &UDouble::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UDoubleData>())
+    if(object.type() != UType::Double)
         throw std::invalid_argument("object is not instance of UDouble");
 
     return (const UDouble&)object;
 }
 
 
-UDouble::UDouble(double value) : UObject(std::make_shared<UDoubleData>(value)) {
+UDouble::UDouble(double value) : UObject(UType::Double, value) {
 
 }
 
 double UDouble::get() const {
-    return data<UDoubleData>().value;
+    return inlineDouble();
 }
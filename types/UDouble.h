@@ -10,23 +10,6 @@
 #include "UObject.h"
 
 class UDouble : public UObject {
-private:
-    class UDoubleData : public UData {
-    public:
-        UDoubleData(double v);
-        ~UDoubleData() override = default;
-
-        Local<Object> serializeToV8(Local<Context> cxt, shared_ptr<Scripter> scripter) override {
-            return Local<Object>::Cast(Number::New(scripter->isolate(), value));
-        }
-
-        void dbgPrint(std::string prefix) override {
-            printf("%f\n", value);
-        }
-
-        double value;
-    };
-
 public:
     static bool isInstance(const UObject& object);
 
@@ -4,33 +4,29 @@
 
 #include "UInt.h"
 
-UInt::UIntData::UIntData(int64_t v)  {
-    value = v;
-}
-
 bool UInt::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UIntData>();
+    return object.type() == UType::Int;
 }
 
 UInt &UInt::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UIntData>())
+    if(object.type() != UType::Int)
         throw std::invalid_argument("object is not instance of UInt");
 
     return (UInt&)object;
 }
 
 const UInt &UInt::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UIntData>())
+    if(object.type() != UType::Int)
         throw std::invalid_argument("object is not instance of UInt");
 
     return (const UInt&)object;
 }
 
 
-UInt::UInt(int64_t value) : UObject(std::make_shared<UIntData>(value)) {
+UInt::UInt(int64_t value) : UObject(UType::Int, value) {
 
 }
 
 int64_t UInt::get() const {
-    return data<UIntData>().value;
+    return inlineInt();
 }
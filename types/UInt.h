@@ -10,23 +10,6 @@
 #include "UObject.h"
 
 class UInt : public UObject {
-private:
-    class UIntData : public UData {
-    public:
-        UIntData(int64_t v);
-        ~UIntData() override = default;
-
-        Local<Object> serializeToV8(Local<Context> cxt, shared_ptr<Scripter> scripter) override {
-            return Local<Object>::Cast(Number::New(scripter->isolate(), value));
-        }
-
-        void dbgPrint(std::string prefix) override {
-            cout << value << endl;
-        }
-
-        int64_t value;
-    };
-
 public:
     static bool isInstance(const UObject& object);
 
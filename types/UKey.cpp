@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#include "UKey.h"
+#include <unordered_set>
+#include <array>
+#include <shared_mutex>
+#include <mutex>
+
+static const size_t MAX_INTERNED_KEYS = 1 << 16;
+static const size_t MAX_INTERNED_KEY_LENGTH = 64;
+// per thread cache of interned keys, indexed by key hash
+static const size_t RECENT_KEYS = 256;
+
+class UKeyTable {
+public:
+    /**
+     * Return pointer to the interned copy of key or nullptr, if the key can't be interned.
+     * Entries are never removed, so returned pointers stay valid until the program exit.
+     */
+    const std::string* intern(const std::string& key) {
+        if (key.size() > MAX_INTERNED_KEY_LENGTH)
+            return nullptr;
+        // keys interned recently by this thread are found without the lock
+        static thread_local std::array<const std::string*, RECENT_KEYS> recent {};
+        auto& slot = recent[std::hash<std::string>()(key) % RECENT_KEYS];
+        if (slot != nullptr && *slot == key)
+            return slot;
+        {
+            std::shared_lock lock(mutex);
+            auto it = keys.find(key);
+            if (it != keys.end())
+                return slot = &*it;
+            if (keys.size() >= MAX_INTERNED_KEYS)
+                return nullptr;
+        }
+        std::unique_lock lock(mutex);
+        if (keys.size() >= MAX_INTERNED_KEYS) {
+            auto it = keys.find(key);
+            return it != keys.end() ? slot = &*it : nullptr;
+        }
+        return slot = &*keys.insert(key).first;
+    }
+
+    size_t size() {
+        std::shared_lock lock(mutex);
+        return keys.size();
+    }
+
+private:
+    std::shared_mutex mutex;
+    std::unordered_set<std::string> keys;
+};
+
+static UKeyTable& keyTable() {
+    static UKeyTable table;
+    return table;
+}
+
+UKey::UKey(const std::string& key) {
+    ptr = keyTable().intern(key);
+    if (ptr == nullptr) {
+        owned = std::make_shared<const std::string>(key);
+        ptr = owned.get();
+    }
+}
+
+UKey::UKey(const char* key) : UKey(std::string(key)) {
+}
+
+size_t UKey::internedCount() {
+    return keyTable().size();
+}
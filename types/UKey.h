@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2019-present Sergey Chernov, iCodici S.n.C, All Rights Reserved.
+ */
+
+#ifndef U8_UKEY_H
+#define U8_UKEY_H
+
+#include <string>
+#include <memory>
+
+/**
+ * Key of UBinder.
+ *
+ * Keys are interned in a global table, so the same key stored in many binders ("__type", "state", "definition"...)
+ * shares one string and two interned keys are equal only if they point to the same entry. The table is bounded in
+ * both entry count and key length, as keys come from untrusted packed data; a key that doesn't fit owns its string.
+ */
+class UKey {
+public:
+    UKey(const std::string& key);
+    UKey(const char* key);
+
+    const std::string& str() const {
+        return *ptr;
+    }
+
+    operator const std::string&() const {
+        return *ptr;
+    }
+
+    const char* data() const {
+        return ptr->data();
+    }
+
+    size_t size() const {
+        return ptr->size();
+    }
+
+    bool isInterned() const {
+        return !owned;
+    }
+
+    int compare(const UKey& other) const {
+        if (ptr == other.ptr)
+            return 0;
+        return ptr->compare(*other.ptr);
+    }
+
+    int compare(const std::string& other) const {
+        return ptr->compare(other);
+    }
+
+    int compare(const char* other) const {
+        return ptr->compare(other);
+    }
+
+    /**
+     * Number of keys in the global table.
+     */
+    static size_t internedCount();
+
+private:
+    const std::string* ptr;
+    std::shared_ptr<const std::string> owned;
+};
+
+inline bool operator==(const UKey& a, const UKey& b) { return a.compare(b) == 0; }
+inline bool operator!=(const UKey& a, const UKey& b) { return a.compare(b) != 0; }
+inline bool operator<(const UKey& a, const UKey& b) { return a.compare(b) < 0; }
+inline bool operator==(const UKey& a, const std::string& b) { return a.compare(b) == 0; }
+inline bool operator!=(const UKey& a, const std::string& b) { return a.compare(b) != 0; }
+inline bool operator==(const std::string& a, const UKey& b) { return b.compare(a) == 0; }
+inline bool operator!=(const std::string& a, const UKey& b) { return b.compare(a) != 0; }
+inline bool operator==(const UKey& a, const char* b) { return a.compare(b) == 0; }
+inline bool operator!=(const UKey& a, const char* b) { return a.compare(b) != 0; }
+inline bool operator==(const char* a, const UKey& b) { return b.compare(a) == 0; }
+inline bool operator!=(const char* a, const UKey& b) { return b.compare(a) != 0; }
+
+#endif //U8_UKEY_H
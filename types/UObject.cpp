@@ -4,4 +4,43 @@
 
 #include "UObject.h"
 
-UObject nullObject;
\ No newline at end of file
+UObject nullObject;
+
+Local<Object> UObject::serializeToV8(Local<Context> cxt, shared_ptr<Scripter> scripter) const {
+    switch (tag) {
+        case UType::Null:
+            return Local<Object>::Cast(Null(scripter->isolate()));
+        case UType::Int:
+            return Local<Object>::Cast(Number::New(scripter->isolate(), scalar.i));
+        case UType::Double:
+            return Local<Object>::Cast(Number::New(scripter->isolate(), scalar.d));
+        case UType::Bool:
+            return Local<Object>::Cast(Boolean::New(scripter->isolate(), scalar.b));
+        case UType::DateTime:
+            return Local<Object>::Cast(Date::New(scripter->isolate()->GetCurrentContext(), double(scalar.i*1e-6)).ToLocalChecked());
+        default:
+            return ptr.get()->serializeToV8(cxt, scripter);
+    }
+}
+
+void UObject::dbgPrint(std::string prefix) const {
+    switch (tag) {
+        case UType::Null:
+            printf("null\n");
+            break;
+        case UType::Int:
+            cout << scalar.i << endl;
+            break;
+        case UType::Double:
+            printf("%f\n", scalar.d);
+            break;
+        case UType::Bool:
+            printf("%s\n", scalar.b?"true":"false");
+            break;
+        case UType::DateTime:
+            cout << "DateTime=" << scalar.i << endl;
+            break;
+        default:
+            ptr.get()->dbgPrint(prefix);
+    }
+}
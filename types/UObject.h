@@ -7,36 +7,55 @@
 
 #include <string>
 #include <memory>
+#include <cstdint>
 #include <v8.h>
 #include "../js_bindings/Scripter.h"
 
 using namespace v8;
 
-
-template<typename A, typename B> inline bool isInstanceOf(B *ptr) {
-    return dynamic_cast<A*>(ptr) != nullptr;
-}
-
-template<typename A, typename B> inline bool isInstanceOf(const B *ptr) {
-    return dynamic_cast<const A*>(ptr) != nullptr;
-}
+/**
+ * Type tag of the value held by UObject. Used for type checks instead of RTTI.
+ *
+ * Null, Int, Double, Bool and DateTime are scalars and are stored inline in UObject itself, without any heap
+ * allocation. All other types keep their payload in a shared UData with the same tag.
+ */
+enum class UType : uint8_t {
+    Null,
+    Int,
+    Double,
+    Bool,
+    DateTime,
+    String,
+    Bytes,
+    Array,
+    Binder,
+
+    // complex types
+    HashId,
+    KeyAddress,
+    PublicKey,
+    PrivateKey,
+    SerializationError,
+    TestComplexObject,
+
+    // complex types defined outside of the core take values from here on, see BaseSerializer::registerComplexType
+    Extension = 128
+};
 
 
 class UData {
 
 public:
-    bool isEmpty() const {
-        return empty;
+    UType type() const {
+        return tag;
     }
 
     virtual ~UData() {
 
     }
 
-    UData() = default;
+    UData(UType type) : tag(type) {
 
-    UData(bool empty) {
-        this->empty = empty;
     }
 
     virtual Local<Object> serializeToV8(Local<Context> cxt, shared_ptr<Scripter> scripter) {
@@ -48,18 +67,37 @@ class UData {
     }
 
 private:
-    bool empty = false;
+    const UType tag;
 };
 
 class UObject {
 
 private:
     std::shared_ptr<UData> ptr;
+    UType tag = UType::Null;
+
+    union {
+        int64_t i;
+        double d;
+        bool b;
+    } scalar = {0};
 
 protected:
 
-    UObject(const std::shared_ptr<UData>& p) : ptr(p) {
+    UObject(const std::shared_ptr<UData>& p) : ptr(p), tag(p->type()) {
+
+    };
+
+    UObject(UType type, int64_t value) : tag(type) {
+        scalar.i = value;
+    };
+
+    UObject(UType type, double value) : tag(type) {
+        scalar.d = value;
+    };
 
+    UObject(UType type, bool value) : tag(type) {
+        scalar.b = value;
     };
 
     template <typename  T> const T& data() const {
@@ -70,28 +108,33 @@ class UObject {
         return *static_cast<T*>(ptr.get());
     }
 
-public:
-    template <typename T> bool dataIsInstanceOf() const {
-        return isInstanceOf<T>(ptr.get());
+    int64_t inlineInt() const {
+        return scalar.i;
     }
 
-
-    bool isNull() const {
-        return data<UData>().isEmpty();
+    double inlineDouble() const {
+        return scalar.d;
     }
 
-    UObject() : ptr(std::make_shared<UData>(true)) {
-
-    };
+    bool inlineBool() const {
+        return scalar.b;
+    }
 
-    Local<Object> serializeToV8(Local<Context> cxt, shared_ptr<Scripter> scripter) const {
-        return ptr.get()->serializeToV8(cxt, scripter);
+public:
+    UType type() const {
+        return tag;
     }
 
-    void dbgPrint(std::string prefix = "") const {
-        ptr.get()->dbgPrint(prefix);
+    bool isNull() const {
+        return tag == UType::Null;
     }
 
+    UObject() = default;
+
+    Local<Object> serializeToV8(Local<Context> cxt, shared_ptr<Scripter> scripter) const;
+
+    void dbgPrint(std::string prefix = "") const;
+
 };
 
 extern UObject nullObject;
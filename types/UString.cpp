@@ -4,23 +4,23 @@
 
 #include "UString.h"
 
-UString::UStringData::UStringData(const std::string& v)  {
+UString::UStringData::UStringData(const std::string& v) : UData(UType::String) {
     value = v;
 }
 
 bool UString::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UStringData>();
+    return object.type() == UType::String;
 }
 
 UString &UString::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UStringData>())
+    if(object.type() != UType::String)
         throw std::invalid_argument("object is not instance of UString");
 
     return (UString&)object;
 }
 
 const UString &UString::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UStringData>())
+    if(object.type() != UType::String)
         throw std::invalid_argument("object is not instance of UString");
 
     return (const UString&)object;
@@ -5,10 +5,10 @@
 #include "UHashId.h"
 #include "../UBytes.h"
 
-UHashId::UHashIdData::UHashIdData() {
+UHashId::UHashIdData::UHashIdData() : UData(UType::HashId) {
 }
 
-UHashId::UHashIdData::UHashIdData(const crypto::HashId &val) {
+UHashId::UHashIdData::UHashIdData(const crypto::HashId &val) : UData(UType::HashId) {
     hashId = std::make_shared<crypto::HashId>(val);
 }
 
@@ -19,18 +19,18 @@ UHashId::UHashId(const crypto::HashId &val): UObject(std::make_shared<UHashIdDat
 }
 
 bool UHashId::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UHashIdData>();
+    return object.type() == UType::HashId;
 }
 
 UHashId& UHashId::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UHashIdData>())
+    if(object.type() != UType::HashId)
         throw std::invalid_argument("object is not instance of UHashId");
 
     return (UHashId&) object;
 }
 
 const UHashId& UHashId::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UHashIdData>())
+    if(object.type() != UType::HashId)
         throw std::invalid_argument("object is not instance of UHashId");
 
     return (const UHashId&) object;
@@ -5,10 +5,10 @@
 #include "UKeyAddress.h"
 #include "../UBytes.h"
 
-UKeyAddress::UKeyAddressData::UKeyAddressData() {
+UKeyAddress::UKeyAddressData::UKeyAddressData() : UData(UType::KeyAddress) {
 }
 
-UKeyAddress::UKeyAddressData::UKeyAddressData(const crypto::KeyAddress &val) {
+UKeyAddress::UKeyAddressData::UKeyAddressData(const crypto::KeyAddress &val) : UData(UType::KeyAddress) {
     keyAddress = std::make_shared<crypto::KeyAddress>(val);
 }
 
@@ -19,18 +19,18 @@ UKeyAddress::UKeyAddress(const crypto::KeyAddress &val): UObject(std::make_share
 }
 
 bool UKeyAddress::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UKeyAddressData>();
+    return object.type() == UType::KeyAddress;
 }
 
 UKeyAddress& UKeyAddress::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UKeyAddressData>())
+    if(object.type() != UType::KeyAddress)
         throw std::invalid_argument("object is not instance of UKeyAddress");
 
     return (UKeyAddress&) object;
 }
 
 const UKeyAddress& UKeyAddress::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UKeyAddressData>())
+    if(object.type() != UType::KeyAddress)
         throw std::invalid_argument("object is not instance of UKeyAddress");
 
     return (const UKeyAddress&) object;
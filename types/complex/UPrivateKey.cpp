@@ -5,10 +5,10 @@
 #include "UPrivateKey.h"
 #include "../UBytes.h"
 
-UPrivateKey::UPrivateKeyData::UPrivateKeyData() {
+UPrivateKey::UPrivateKeyData::UPrivateKeyData() : UData(UType::PrivateKey) {
 }
 
-UPrivateKey::UPrivateKeyData::UPrivateKeyData(const crypto::PrivateKey &val) {
+UPrivateKey::UPrivateKeyData::UPrivateKeyData(const crypto::PrivateKey &val) : UData(UType::PrivateKey) {
     privateKey = std::make_shared<crypto::PrivateKey>(val);
 }
 
@@ -19,18 +19,18 @@ UPrivateKey::UPrivateKey(const crypto::PrivateKey &val): UObject(std::make_share
 }
 
 bool UPrivateKey::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UPrivateKeyData>();
+    return object.type() == UType::PrivateKey;
 }
 
 UPrivateKey& UPrivateKey::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UPrivateKeyData>())
+    if(object.type() != UType::PrivateKey)
         throw std::invalid_argument("object is not instance of UPrivateKey");
 
     return (UPrivateKey&) object;
 }
 
 const UPrivateKey& UPrivateKey::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UPrivateKeyData>())
+    if(object.type() != UType::PrivateKey)
         throw std::invalid_argument("object is not instance of UPrivateKey");
 
     return (const UPrivateKey&) object;
@@ -5,10 +5,10 @@
 #include "UPublicKey.h"
 #include "../UBytes.h"
 
-UPublicKey::UPublicKeyData::UPublicKeyData() {
+UPublicKey::UPublicKeyData::UPublicKeyData() : UData(UType::PublicKey) {
 }
 
-UPublicKey::UPublicKeyData::UPublicKeyData(const crypto::PublicKey &val) {
+UPublicKey::UPublicKeyData::UPublicKeyData(const crypto::PublicKey &val) : UData(UType::PublicKey) {
     publicKey = std::make_shared<crypto::PublicKey>(val);
 }
 
@@ -19,18 +19,18 @@ UPublicKey::UPublicKey(const crypto::PublicKey &val): UObject(std::make_shared<U
 }
 
 bool UPublicKey::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<UPublicKeyData>();
+    return object.type() == UType::PublicKey;
 }
 
 UPublicKey& UPublicKey::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<UPublicKeyData>())
+    if(object.type() != UType::PublicKey)
         throw std::invalid_argument("object is not instance of UPublicKey");
 
     return (UPublicKey&) object;
 }
 
 const UPublicKey& UPublicKey::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<UPublicKeyData>())
+    if(object.type() != UType::PublicKey)
         throw std::invalid_argument("object is not instance of UPublicKey");
 
     return (const UPublicKey&) object;
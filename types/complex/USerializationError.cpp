@@ -4,26 +4,26 @@
 
 #include "USerializationError.h"
 
-USerializationError::USerializationErrorData::USerializationErrorData() {
+USerializationError::USerializationErrorData::USerializationErrorData() : UData(UType::SerializationError) {
 }
 
-USerializationError::USerializationErrorData::USerializationErrorData(const std::string& v)  {
+USerializationError::USerializationErrorData::USerializationErrorData(const std::string& v) : UData(UType::SerializationError) {
     strValue = v;
 }
 
 bool USerializationError::isInstance(const UObject &object) {
-    return object.dataIsInstanceOf<USerializationErrorData>();
+    return object.type() == UType::SerializationError;
 }
 
 USerializationError &USerializationError::asInstance(UObject &object) {
-    if(!object.dataIsInstanceOf<USerializationErrorData>())
+    if(object.type() != UType::SerializationError)
         throw std::invalid_argument("object is not instance of USerializationError");
 
     return (USerializationError&)object;
 }
 
 const USerializationError &USerializationError::asInstance(const UObject &object) {
-    if(!object.dataIsInstanceOf<USerializationErrorData>())
+    if(object.type() != UType::SerializationError)
         throw std::invalid_argument("object is not instance of USerializationError");
 
     return (const USerializationError&)object;